@@ -0,0 +1,256 @@
+/*------------------------------------------------------------------------------
+* epochstore.cpp : time-indexed store of measurement epochs
+*
+* notes  : the store keeps an index of the epochs of each rover sorted by
+*          time, so that the epoch of a rover and time or the epochs of a time
+*          span are found by binary search in O(log n). epochs are normally put
+*          in time order (append), epochs of a backward pass are inserted. an
+*          epoch put again for the same rover and time (within DTTOL) replaces
+*          the stored one. epochs of concurrent rovers at the same time are
+*          kept apart.
+*
+*          memory store (file=""): the messages are shared with the
+*          publication (boost::shared_ptr<const>), nothing is copied.
+*
+*          disk store: the messages are serialized and appended to a record
+*          file, the index keeps their offsets. the most recently used epochs
+*          read back from the file are kept in an lru cache of ncache epochs.
+*
+*          all functions are thread-safe (the processing puts epochs while
+*          the service of the epoch server looks them up).
+*-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <ros/serialization.h>
+
+#include "epochstore.h"
+
+/* type definitions ----------------------------------------------------------*/
+
+typedef gnss_msgs::GNSS_Raw_Array::ConstPtr epmsg_t;
+
+typedef struct {                    /* index of epoch */
+    gtime_t time;                   /* epoch time (gpst) */
+    epmsg_t msg;                    /* message (memory store) */
+    long off;                       /* offset of record (disk store) */
+    uint32_t len;                   /* length of record (disk store) */
+} epidx_t;
+
+typedef std::vector<epidx_t> epidxs_t; /* index of epochs sorted by time */
+
+typedef std::list<std::pair<long,epmsg_t> > eplru_t; /* lru list {off,msg} */
+
+struct epstore_t {                  /* store of measurement epochs */
+    std::mutex lock;                /* lock of store */
+    std::map<std::string,epidxs_t> idx; /* index of epochs of each rover */
+    FILE *fp;                       /* record file (NULL: memory store) */
+    size_t ncache;                  /* max number of cached epochs */
+    eplru_t lru;                    /* cached epochs, most recent first */
+    std::unordered_map<long,eplru_t::iterator> cache; /* cached epochs */
+};
+
+/* compare epoch time with time of index -------------------------------------*/
+static bool cmpidx(const epidx_t &a, const gtime_t &t)
+{
+    return timediff(a.time,t)<-DTTOL;
+}
+/* append serialized message to record file ----------------------------------*/
+static int putrec(epstore_t *st, const gnss_msgs::GNSS_Raw_Array &msg,
+                  epidx_t *ix)
+{
+    std::vector<uint8_t> buff(ros::serialization::serializationLength(msg));
+    ros::serialization::OStream os(buff.data(),(uint32_t)buff.size());
+    
+    ros::serialization::serialize(os,msg);
+    
+    if (fseek(st->fp,0,SEEK_END)) return 0;
+    ix->off=ftell(st->fp);
+    ix->len=(uint32_t)buff.size();
+    return fwrite(buff.data(),buff.size(),1,st->fp)==1;
+}
+/* message of index (disk store through lru cache) ---------------------------*/
+static epmsg_t getmsg(epstore_t *st, const epidx_t &ix)
+{
+    std::unordered_map<long,eplru_t::iterator>::iterator it;
+    gnss_msgs::GNSS_Raw_Array::Ptr msg;
+    std::vector<uint8_t> buff(ix.len);
+    
+    if (!st->fp) return ix.msg;
+    
+    if ((it=st->cache.find(ix.off))!=st->cache.end()) {
+        st->lru.splice(st->lru.begin(),st->lru,it->second);
+        return it->second->second;
+    }
+    if (fseek(st->fp,ix.off,SEEK_SET)||
+        (ix.len&&fread(buff.data(),ix.len,1,st->fp)!=1)) {
+        trace(2,"epstore: record read error off=%ld\n",ix.off);
+        return epmsg_t();
+    }
+    msg.reset(new gnss_msgs::GNSS_Raw_Array);
+    ros::serialization::IStream is(buff.data(),ix.len);
+    ros::serialization::deserialize(is,*msg);
+    
+    st->lru.push_front(std::make_pair(ix.off,epmsg_t(msg)));
+    st->cache[ix.off]=st->lru.begin();
+    if (st->lru.size()>st->ncache) {
+        st->cache.erase(st->lru.back().first);
+        st->lru.pop_back();
+    }
+    return msg;
+}
+/* index of epochs of rover (NULL: no epoch) ---------------------------------*/
+static epidxs_t *getidx(epstore_t *st, const char *rov)
+{
+    std::map<std::string,epidxs_t>::iterator it=st->idx.find(rov);
+    
+    return it==st->idx.end()?NULL:&it->second;
+}
+/* open store of measurement epochs --------------------------------------------
+* args   : char   *file     I   record file of disk store ("": memory store)
+*          int    ncache    I   number of cached epochs of disk store
+* return : store (NULL: error)
+*-----------------------------------------------------------------------------*/
+extern epstore_t *epstoreopen(const char *file, int ncache)
+{
+    epstore_t *st=new epstore_t;
+    
+    trace(3,"epstoreopen: file=%s ncache=%d\n",file,ncache);
+    
+    st->fp=NULL;
+    st->ncache=ncache>0?(size_t)ncache:1;
+    if (*file&&!(st->fp=fopen(file,"w+b"))) {
+        trace(1,"epstoreopen: file open error file=%s\n",file);
+        delete st;
+        return NULL;
+    }
+    return st;
+}
+/* close store of measurement epochs -----------------------------------------*/
+extern void epstoreclose(epstore_t *st)
+{
+    trace(3,"epstoreclose:\n");
+    
+    if (!st) return;
+    if (st->fp) fclose(st->fp);
+    delete st;
+}
+/* put epoch -------------------------------------------------------------------
+* args   : epstore_t *st    IO  store (NULL: none)
+*          char     *rov    I   rover id ("": unnamed)
+*          gtime_t  time    I   epoch time (gpst)
+*          GNSS_Raw_Array::ConstPtr &msg I measurements of epoch
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void epstoreput(epstore_t *st, const char *rov, gtime_t time,
+                       const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg)
+{
+    epidxs_t::iterator p;
+    epidxs_t *idx;
+    epidx_t ix;
+    
+    if (!st) return;
+    
+    ix.time=time;
+    ix.off=0;
+    ix.len=0;
+    
+    std::lock_guard<std::mutex> lock(st->lock);
+    
+    if (st->fp) {
+        if (!putrec(st,*msg,&ix)) {
+            trace(1,"epstoreput: record write error\n");
+            return;
+        }
+    }
+    else ix.msg=msg;
+    
+    idx=&st->idx[rov];
+    
+    if (idx->empty()||timediff(time,idx->back().time)>DTTOL) {
+        idx->push_back(ix); /* append in time order */
+        return;
+    }
+    p=std::lower_bound(idx->begin(),idx->end(),time,cmpidx);
+    if (p!=idx->end()&&fabs(timediff(p->time,time))<=DTTOL) {
+        *p=ix; /* replace epoch */
+    }
+    else idx->insert(p,ix);
+}
+/* get epoch -------------------------------------------------------------------
+* get the epoch of a rover nearest to time
+* args   : epstore_t *st    IO  store
+*          char     *rov    I   rover id ("": unnamed)
+*          gtime_t  time    I   time (gpst)
+*          double   tol     I   max time difference (s)
+* return : measurements of epoch (empty: no epoch within tol)
+*-----------------------------------------------------------------------------*/
+extern gnss_msgs::GNSS_Raw_Array::ConstPtr epstoreget(epstore_t *st,
+                                    const char *rov, gtime_t time, double tol)
+{
+    epidxs_t::iterator p;
+    epidxs_t *idx;
+    
+    if (!st) return epmsg_t();
+    
+    std::lock_guard<std::mutex> lock(st->lock);
+    
+    if (!(idx=getidx(st,rov))) return epmsg_t();
+    
+    p=std::lower_bound(idx->begin(),idx->end(),time,cmpidx);
+    
+    /* nearer of the epochs before and at/after time */
+    if (p!=idx->begin()&&(p==idx->end()||
+        fabs(timediff((p-1)->time,time))<fabs(timediff(p->time,time)))) p--;
+    
+    if (p==idx->end()||fabs(timediff(p->time,time))>tol+DTTOL) {
+        return epmsg_t();
+    }
+    return getmsg(st,*p);
+}
+/* get epochs of time span -----------------------------------------------------
+* args   : epstore_t *st    IO  store
+*          char     *rov    I   rover id ("": unnamed)
+*          gtime_t  ts      I   start time (gpst)
+*          gtime_t  te      I   end time (gpst), inclusive
+*          vector<GNSS_Raw_Array::ConstPtr> &msgs O measurements of epochs
+* return : number of epochs
+*-----------------------------------------------------------------------------*/
+extern int epstorerange(epstore_t *st, const char *rov, gtime_t ts,
+                        gtime_t te,
+                        std::vector<gnss_msgs::GNSS_Raw_Array::ConstPtr> &msgs)
+{
+    epidxs_t::iterator p;
+    epidxs_t *idx;
+    epmsg_t msg;
+    
+    msgs.clear();
+    if (!st) return 0;
+    
+    std::lock_guard<std::mutex> lock(st->lock);
+    
+    if (!(idx=getidx(st,rov))) return 0;
+    
+    p=std::lower_bound(idx->begin(),idx->end(),ts,cmpidx);
+    for (;p!=idx->end()&&timediff(p->time,te)<=DTTOL;p++) {
+        if ((msg=getmsg(st,*p))) msgs.push_back(msg);
+    }
+    return (int)msgs.size();
+}
+/* number of epochs of all rovers --------------------------------------------*/
+extern int epstoresize(epstore_t *st)
+{
+    std::map<std::string,epidxs_t>::iterator it;
+    int n=0;
+    
+    if (!st) return 0;
+    
+    std::lock_guard<std::mutex> lock(st->lock);
+    
+    for (it=st->idx.begin();it!=st->idx.end();++it) n+=(int)it->second.size();
+    return n;
+}
@@ -0,0 +1,33 @@
+/*------------------------------------------------------------------------------
+* epochstore.h : time-indexed store of measurement epochs
+*
+* notes  : the published measurements (GNSS_Raw_Array) are kept in memory or
+*          in a record file and are looked up by rover and epoch time, see
+*          epochstore.cpp.
+*-----------------------------------------------------------------------------*/
+#ifndef EPOCHSTORE_H
+#define EPOCHSTORE_H
+#include <vector>
+
+#include "rtklib.h"
+
+#include <gnss_msgs/GNSS_Raw_Array.h>
+
+/* type definitions ----------------------------------------------------------*/
+
+struct epstore_t;                   /* store of measurement epochs */
+
+/* function prototypes -------------------------------------------------------*/
+
+extern epstore_t *epstoreopen (const char *file, int ncache);
+extern void       epstoreclose(epstore_t *st);
+extern void       epstoreput  (epstore_t *st, const char *rov, gtime_t time,
+                               const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg);
+extern gnss_msgs::GNSS_Raw_Array::ConstPtr epstoreget(epstore_t *st,
+                               const char *rov, gtime_t time, double tol);
+extern int        epstorerange(epstore_t *st, const char *rov, gtime_t ts,
+                               gtime_t te,
+                               std::vector<gnss_msgs::GNSS_Raw_Array::ConstPtr> &msgs);
+extern int        epstoresize (epstore_t *st);
+
+#endif /* EPOCHSTORE_H */
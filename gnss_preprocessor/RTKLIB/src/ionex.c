@@ -58,6 +58,7 @@ static tec_t *addtec(const double *lats, const double *lons, const double *hgts,
     if (ndata[0]<=1||ndata[1]<=1||ndata[2]<=0) return NULL;
     
     if (nav->nt>=nav->ntmax) {
+        memacct(MEM_TEC,-(int64_t)sizeof(tec_t)*nav->ntmax);
         nav->ntmax+=256;
         if (!(nav_tec=(tec_t *)realloc(nav->tec,sizeof(tec_t)*nav->ntmax))) {
             trace(1,"readionex malloc error ntmax=%d\n",nav->ntmax);
@@ -65,6 +66,7 @@ static tec_t *addtec(const double *lats, const double *lons, const double *hgts,
             return NULL;
         }
         nav->tec=nav_tec;
+        memacct(MEM_TEC,(int64_t)sizeof(tec_t)*nav->ntmax);
     }
     p=nav->tec+nav->nt;
     p->time=time0;
@@ -81,6 +83,7 @@ static tec_t *addtec(const double *lats, const double *lons, const double *hgts,
         !(p->rms =(float  *)malloc(sizeof(float )*n))) {
         return NULL;
     }
+    memacct(MEM_TEC,(int64_t)(sizeof(double)+sizeof(float))*n);
     for (i=0;i<n;i++) {
         p->data[i]=0.0;
         p->rms [i]=0.0f;
@@ -254,6 +257,9 @@ static void combtec(nav_t *nav)
     }
     for (i=0;i<nav->nt;i++) {
         if (i>0&&timediff(nav->tec[i].time,nav->tec[n-1].time)==0.0) {
+            memacct(MEM_TEC,-(int64_t)(sizeof(double)+sizeof(float))*
+                    nav->tec[n-1].ndata[0]*nav->tec[n-1].ndata[1]*
+                    nav->tec[n-1].ndata[2]);
             free(nav->tec[n-1].data);
             free(nav->tec[n-1].rms );
             nav->tec[n-1]=nav->tec[i];
@@ -287,6 +293,7 @@ extern void readtec(const char *file, nav_t *nav, int opt)
     
     /* clear of tec grid data option */
     if (!opt) {
+        memacct(MEM_TEC,-(int64_t)sizeof(tec_t)*nav->ntmax);
         free(nav->tec); nav->tec=NULL; nav->nt=nav->ntmax=0;
     }
     for (i=0;i<MAXEXFILE;i++) {
@@ -39,6 +39,8 @@ static double elmask_,elmaskar_,elmaskhold_;
 static double antpos_[2][3];
 static char exsats_[1024];
 static char snrmask_[NFREQ][1024];
+static shard_t shard_;
+static char shardts_[64],shardte_[64];
 
 /* system options table ------------------------------------------------------*/
 #define SWTOPT  "0:off,1:on"
@@ -50,7 +52,7 @@ static char snrmask_[NFREQ][1024];
 #define EPHOPT  "0:brdc,1:precise,2:brdc+sbas,3:brdc+ssrapc,4:brdc+ssrcom"
 #define NAVOPT  "1:gps+2:sbas+4:glo+8:gal+16:qzs+32:bds+64:navic"
 #define GAROPT  "0:off,1:on"
-#define SOLOPT  "0:llh,1:xyz,2:enu,3:nmea"
+#define SOLOPT  "0:llh,1:xyz,2:enu,3:nmea,6:bin"
 #define TSYOPT  "0:gpst,1:utc,2:jst"
 #define TFTOPT  "0:tow,1:hms"
 #define DFTOPT  "0:deg,1:dms"
@@ -186,6 +188,19 @@ EXPORT opt_t sysopts[]={
     
     {"",0,NULL,""} /* terminator */
 };
+/* shard manifest options table ----------------------------------------------*/
+static opt_t shardopts[]={
+    {"shard-index",     0,  (void *)&shard_.index,       ""     },
+    {"shard-count",     0,  (void *)&shard_.count,       ""     },
+    {"shard-tstart",    2,  (void *) shardts_,           "gpst" },
+    {"shard-tend",      2,  (void *) shardte_,           "gpst" },
+    {"shard-warmup",    1,  (void *)&shard_.warmup,      "s"    },
+    {"shard-solfile",   2,  (void *) shard_.solfile,     ""     },
+    {"shard-statfile",  2,  (void *) shard_.statfile,    ""     },
+    {"shard-bagfile",   2,  (void *) shard_.bagfile,     ""     },
+    
+    {"",0,NULL,""} /* terminator */
+};
 /* discard space characters at tail ------------------------------------------*/
 static void chop(char *str)
 {
@@ -545,3 +560,63 @@ extern void setsysopts(const prcopt_t *prcopt, const solopt_t *solopt,
     if (filopt) filopt_=*filopt;
     sysopts2buff();
 }
+/* save shard manifest ---------------------------------------------------------
+* save manifest of a processing shard with the options of the processing
+* args   : char   *file     I  manifest file
+*          shard_t *shard   I  processing shard
+*          prcopt_t *popt   I  processing options
+*          solopt_t *sopt   I  solution options (requested output format)
+* return : status (1:ok,0:error)
+* notes  : the manifest is written in the format of the options file. file
+*          paths in the manifest should be relative to the manifest file.
+*-----------------------------------------------------------------------------*/
+extern int saveshard(const char *file, const shard_t *shard,
+                     const prcopt_t *popt, const solopt_t *sopt)
+{
+    trace(3,"saveshard: file=%s index=%d count=%d\n",file,shard->index,
+          shard->count);
+    
+    shard_=*shard;
+    time2str(shard->ts,shardts_,9);
+    time2str(shard->te,shardte_,9);
+    
+    if (!saveopts(file,"w","gnss_preprocessor shard manifest",shardopts)) {
+        return 0;
+    }
+    setsysopts(popt,sopt,NULL);
+    return saveopts(file,"a","processing options",sysopts);
+}
+/* load shard manifest ---------------------------------------------------------
+* load manifest of a processing shard
+* args   : char   *file     I  manifest file
+*          shard_t *shard   O  processing shard
+*          prcopt_t *popt   O  processing options (NULL: no output)
+*          solopt_t *sopt   O  solution options   (NULL: no output)
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int loadshard(const char *file, shard_t *shard, prcopt_t *popt,
+                     solopt_t *sopt)
+{
+    double ep[6]={0};
+    int i;
+    
+    trace(3,"loadshard: file=%s\n",file);
+    
+    memset(&shard_,0,sizeof(shard_t));
+    *shardts_=*shardte_='\0';
+    resetsysopts();
+    
+    if (!loadopts(file,shardopts)||!loadopts(file,sysopts)) return 0;
+    getsysopts(popt,sopt,NULL);
+    
+    for (i=0;i<2;i++) {
+        if (sscanf(i==0?shardts_:shardte_,"%lf/%lf/%lf %lf:%lf:%lf",ep,ep+1,
+                   ep+2,ep+3,ep+4,ep+5)<6) {
+            trace(2,"loadshard: no time span %s\n",file);
+            return 0;
+        }
+        if (i==0) shard_.ts=epoch2time(ep); else shard_.te=epoch2time(ep);
+    }
+    *shard=shard_;
+    return shard->count>0&&0<=shard->index&&shard->index<shard->count;
+}
@@ -24,7 +24,10 @@
 *                           use API sat2freq() to get carrier frequency
 *                           add output of velocity estimation error in estvel()
 *-----------------------------------------------------------------------------*/
+#include <atomic>
+
 #include "rtklib.h"
+#include "publish.h"
 
 #include <ros/ros.h>
 #include <geometry_msgs/TwistStamped.h>
@@ -50,17 +53,6 @@
 #define REL_HUMI    0.7         /* relative humidity for Saastamoinen model */
 #define MIN_EL      (5.0*D2R)   /* min elevation for measurement error (rad) */
 
-ros::Publisher pub_gnss_raw;
-ros::Publisher pub_gnss_fix;
-ros::Publisher pub_gnss_vel;
-
-extern void pntposRegisterPub(ros::NodeHandle &n)
-{
-    pub_gnss_raw = n.advertise<gnss_msgs::GNSS_Raw_Array>("gnss_raw", 1000);
-    pub_gnss_fix = n.advertise<sensor_msgs::NavSatFix>("gnss_fix", 1000);
-    pub_gnss_vel = n.advertise<geometry_msgs::TwistStamped>("gnss_vel", 1000);
-}
-
 /* pseudorange measurement error variance ------------------------------------*/
 static double varerr(const prcopt_t *opt, double el, int sys)
 {
@@ -286,7 +278,7 @@ static int rescode(int iter, const obsd_t *obs, int n, const double *rs,
         if (i<n-1&&i<MAXOBS-1&&sat==obs[i+1].sat) {
             trace(2,"duplicated obs data %s sat=%d\n",time_str(time,3),sat);
             i++;
-            ROS_INFO_STREAM("duplicated observation data " << time_str(time,3) << " sys = " << satsys(sat,NULL) << " sat = " << sat);
+            if (iter==0) pubstatrej(PUBS_DUP);
             continue;
         }
         /* excluded satellite? */
@@ -650,18 +642,15 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
     }
     
     /* create UNIX/ROS timestamp and write to header*/
-    static uint32_t Seq = 0;
-    gtime_t UTC = gpst2utc(obs[0].time);
+    static std::atomic<uint32_t> Seq(0); /* shared by processing threads */
     std_msgs::Header Header;
-    Header.stamp.sec = UTC.time;
-    Header.stamp.nsec = UTC.sec*1e9;
+    Header.stamp.fromNSec(gpst2utcns(time2ns(obs[0].time)));
     Header.frame_id = "earth_center";
-    Header.seq = Seq;
-    Seq++;
+    Header.seq = Seq++;
 
     /* construct data for WLS with gnss_msgs::GNSS_Raw_Array*/
-    gnss_msgs::GNSS_Raw_Array gnss_data;
-    gnss_data.header = Header;
+    gnss_msgs::GNSS_Raw_Array::Ptr gnss_data(new gnss_msgs::GNSS_Raw_Array);
+    gnss_data->header = Header;
     int current_week = 0;
     const double current_tow = time2gpst(obs[0].time, &current_week);
     const double gpstime = current_week * 86400 * 7 + current_tow;    // GPS time in seconds from start of GPS epoch inclusive leap seconds (86400 = sec per day)
@@ -669,6 +658,9 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
     /* satellite positons, velocities and clocks */
     satposs(sol->time,obs,n,nav,opt_.sateph,rs,dts,var,svh);
     
+    /* statistics of epoch */
+    pubstatobs(obs[0].time,n);
+    
     /* estimate receiver position with pseudorange */
     double pos[3], pos_bound[3];
     stat = estpos(obs,n,rs,dts,var,svh,nav,&opt_,sol,azel_,vsat,resp,msg);
@@ -680,7 +672,6 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
     pos_bound[2] = std::max(pos[2], -100.0);
 
     /* estimate receiver position with pseudorange by WLS and Eigen */
-    int CMP_cnt = 0, GPS_cnt = 0, GAL_cnt = 0, GLO_cnt = 0, SBS_cnt = 0, QZS_cnt = 0;
     for(int s_i = 0; s_i < n; s_i++)
     {
         /* create GNSS message */
@@ -726,6 +717,7 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
         double freq;
         if ((freq=sat2freq(obs[s_i].sat,obs[s_i].code[0],nav)) == 0.0)
         {
+            pubstatrej(PUBS_FREQ);
             continue;
         }
         gnss_raw.lamda = CLIGHT / freq;
@@ -734,6 +726,7 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
         double P,vmeas;
         if ((P = prange(obs+s_i,nav,&opt_,&vmeas)) == 0.0)
         {
+            pubstatrej(PUBS_PRANGE);
             continue;
         }
         gnss_raw.sat_clk_err = dts[s_i*2] * CLIGHT; // in meter
@@ -742,6 +735,7 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
         double dion, vion;
         if (!ionocorr(obs[s_i].time, nav, obs[s_i].sat, pos_bound, azel_+s_i*2, opt->ionoopt, &dion, &vion)) 
         {
+            pubstatrej(PUBS_IONO);
             continue;
         }
         dion*=SQR(FREQ1/freq);
@@ -752,6 +746,7 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
         double dtrp, vtrp;
         if (!tropcorr(obs[s_i].time, nav, pos_bound, azel_+s_i*2, opt->tropopt, &dtrp, &vtrp))
         {
+            pubstatrej(PUBS_TROP);
             continue;
         }
         gnss_raw.err_tropo = dtrp;
@@ -768,57 +763,42 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
         {
             if(sys==SYS_GPS)
             {
-                GPS_cnt++;
                 gnss_raw.sat_system = "GPS";
             }
             else if(sys==SYS_CMP)
             {
-                CMP_cnt++;
                 gnss_raw.sat_system = "BeiDou";
             }
             else if(sys==SYS_GAL)
             {
-                GAL_cnt++;
                 gnss_raw.sat_system = "Galileo";
             }
             else if(sys==SYS_GLO)
             {
-                GLO_cnt++;
                 gnss_raw.sat_system = "GLONASS";
             }
             else if(sys==SYS_SBS)
             {
-                SBS_cnt++;
                 gnss_raw.sat_system = "SBAS";
             }
             else if(sys==SYS_QZS)
             {
-                QZS_cnt++;
                 gnss_raw.sat_system = "QZSS";
             }
-            else
-            {
-                ROS_INFO_STREAM("Unknow!!!!! Satellite   " << current_tow);
-            }
-            gnss_data.GNSS_Raws.push_back(gnss_raw);
+            pubstatsys(sys);
+            gnss_data->GNSS_Raws.push_back(gnss_raw);
         }
         else
         {
-            ROS_INFO_STREAM("Elevation angle of sat prn nr. " << gnss_raw.prn_satellites_index  
-                            << " from sys " << sys << " is " << (gnss_raw.elevation) 
-                            << " <= " << opt_.elmin*R2D << " degrees -> ignoring.");
+            trace(4,"pntpos: sat=%d el=%.1f <= %.1f deg ignored\n",
+                  gnss_raw.prn_satellites_index,gnss_raw.elevation,
+                  opt_.elmin*R2D);
+            pubstatrej(PUBS_ELEV);
         }
     }
-
-    ROS_INFO_STREAM("GPS_cnt " << "["  << SYS_GPS << "]" << "    " << GPS_cnt);
-    ROS_INFO_STREAM("SBS_cnt " << "["  << SYS_SBS << "]" << "    " << SBS_cnt);
-    ROS_INFO_STREAM("GLO_cnt " << "["  << SYS_GLO << "]" << "    " << GLO_cnt);
-    ROS_INFO_STREAM("GAL_cnt " << "["  << SYS_GAL << "]" << "    " << GAL_cnt);
-    ROS_INFO_STREAM("QZS_cnt " << "["  << SYS_QZS << "]" << "   " << QZS_cnt);
-    ROS_INFO_STREAM("CMP_cnt " << "["  << SYS_CMP << "]" << "   " << CMP_cnt);
     
     /* publish raw GNSS measurements*/
-    pub_gnss_raw.publish(gnss_data);    
+    pubraw(obs[0].time, gnss_data);    
 
     /* RAIM FDE */
     if (!stat&&n>=6&&opt->posopt[4]) {
@@ -826,17 +806,17 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
     }
     
     /* copy RTKLIB position solution */
-    sensor_msgs::NavSatFix Fix;
-    Fix.header = Header;
-    Fix.latitude  = pos[0] * R2D;
-    Fix.longitude = pos[1] * R2D;
-    Fix.altitude  = pos[2];
+    sensor_msgs::NavSatFix::Ptr Fix(new sensor_msgs::NavSatFix);
+    Fix->header = Header;
+    Fix->latitude  = pos[0] * R2D;
+    Fix->longitude = pos[1] * R2D;
+    Fix->altitude  = pos[2];
     
     /* TODO: copy estimated variance */
-    Fix.position_covariance_type = sensor_msgs::NavSatFix::COVARIANCE_TYPE_UNKNOWN;
+    Fix->position_covariance_type = sensor_msgs::NavSatFix::COVARIANCE_TYPE_UNKNOWN;
     
     /* publish position */
-    pub_gnss_fix.publish(Fix);
+    pubfix(obs[0].time, Fix);
     
     /* estimate receiver velocity with Doppler */
     if (stat) {
@@ -844,15 +824,15 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
     }
     
     /* publish RTKLIB velocity solution as twist stamped*/
-    geometry_msgs::TwistStamped Twist;
-    Twist.header = Header;
-    Twist.twist.linear.x = sol->rr[3];
-    Twist.twist.linear.y = sol->rr[4];
-    Twist.twist.linear.z = sol->rr[5];
+    geometry_msgs::TwistStamped::Ptr Twist(new geometry_msgs::TwistStamped);
+    Twist->header = Header;
+    Twist->twist.linear.x = sol->rr[3];
+    Twist->twist.linear.y = sol->rr[4];
+    Twist->twist.linear.z = sol->rr[5];
     
     /* TODO: add covariance? */
     
-    pub_gnss_vel.publish(Twist);
+    pubvel(obs[0].time, Twist);
     
     /* continue with RTKLIB code*/        
     if (azel) {
@@ -45,41 +45,169 @@
 *                            writing solution file in binary mode
 *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
+#include "publish.h"
 
 #include <ros/ros.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #define MIN(x,y)    ((x)<(y)?(x):(y))
 #define SQRT(x)     ((x)<=0.0||(x)!=(x)?0.0:sqrt(x))
 
 #define MAXPRCDAYS  100          /* max days of continuous processing */
+#define DTTOLNS     ((gtimens_t)(DTTOL*NS_SEC)) /* time tolerance (ns) */
 #define MAXINFILE   1000         /* max number of input files */
+#define SPILLREC    (4+200)      /* spilled solution record length (bytes) */
+#define SPILLWIN    (1<<20)      /* spilled solution window size (bytes) */
+#define MAXUNITTHR  64           /* max number of processing unit threads */
+#define CKPTMAGIC   0x504B4347   /* magic number of checkpoint ("GCKP") */
+#define CKPTVER     1            /* version of checkpoint */
+
+typedef struct {        /* spilled solution buffer type */
+    FILE *fp;           /* temporary file */
+    int n;              /* number of solutions */
+    uint8_t *win;       /* mapped window */
+    long off,len;       /* window offset/length (bytes) */
+} spill_t;
+
+typedef struct {        /* checkpoint header type */
+    int32_t magic,ver;  /* magic number/version */
+    int32_t mode,soltype; /* positioning mode/solution type */
+    int32_t revs;       /* direction of pass (0:fwd,1:bwd) */
+    int32_t iobsu,iobsr,isbs; /* current rover/base obs and sbas index */
+    int32_t nobs,nsbs;  /* number of obs data/sbas messages */
+    int32_t nspf,nspb;  /* number of spilled forward/backward solutions */
+    gtime_t tobs;       /* time of first obs data */
+    gtime_t time;       /* time of last processed epoch */
+    long outoff;        /* size of output file (bytes) */
+    long statoff;       /* size of solution status file (bytes) */
+    sol_t sol;          /* static solution */
+    gtime_t tsol;       /* time of static solution */
+    double rb[3];       /* base position of static solution */
+} ckpt_t;
+
+typedef struct {        /* processing unit type */
+    gtime_t ts,te;      /* output time span [ts-DTTOL,te) (gpst) */
+    gtime_t tsr,ter;    /* processing time span including warm-up (gpst) */
+    char *ifile[MAXINFILE]; /* input files */
+    int index[MAXINFILE]; /* input file index */
+    int n;              /* number of input files */
+    char ofile[1024];   /* output file */
+    char tfile[1024];   /* temporary output file ("": no) */
+    int flag;           /* output header/trace flag */
+    int stat;           /* processing status */
+    int done;           /* processed flag */
+    pubunit_t *pub;     /* captured products (NULL: published directly) */
+} tunit_t;
+
+typedef struct {        /* processing unit thread pool type */
+    tunit_t *unit;      /* processing units */
+    int n,next;         /* number of units/next unit to process */
+    int abort;          /* abort flag */
+    double ti;          /* processing interval (s) */
+    const prcopt_t *popt; /* processing options */
+    const solopt_t *sopt; /* solution options */
+    const filopt_t *fopt; /* file options */
+    const char *rov,*base; /* rover/base station id list */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* condition of processed units */
+} tpool_t;
+
+typedef struct {        /* data shared by rovers type */
+    nav_t nav;          /* navigation data (read-only) */
+    obs_t obs;          /* observation data of other receivers */
+    sta_t sta[MAXRCV];  /* station information of other receivers */
+    int rcv[MAXINFILE]; /* receiver number of input files */
+    int rov[MAXINFILE]; /* input files of rover (with rover keyword) */
+} share_t;
+
+typedef struct {        /* rover job type */
+    char id[64];        /* rover id */
+    char *ifile[MAXINFILE]; /* input files */
+    char ofile[1024];   /* output file */
+    int stat;           /* processing status */
+    int done;           /* processed flag */
+    pubunit_t *pub;     /* captured products */
+} rjob_t;
+
+typedef struct {        /* rover thread pool type */
+    rjob_t *job;        /* rover jobs */
+    int n,next;         /* number of jobs/next job to process */
+    int abort;          /* abort flag */
+    gtime_t ts,te;      /* processing time span (gpst) */
+    double ti;          /* processing interval (s) */
+    const prcopt_t *popt; /* processing options */
+    const solopt_t *sopt; /* solution options */
+    const filopt_t *fopt; /* file options */
+    int flag;           /* output header/trace flag */
+    const int *index;   /* input file index */
+    int nf;             /* number of input files */
+    const share_t *share; /* data shared by rovers */
+    gtime_t tsout,teout; /* output time span of calling thread */
+    const sbs_t *sbs;   /* sbas messages of calling thread */
+    const char *rtcm;   /* rtcm data file of calling thread */
+    const char *base;   /* base station of calling thread */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* condition of processed jobs */
+} rpool_t;
+
+typedef struct {        /* multi-base rtk type */
+    int n;              /* number of base stations */
+    int sel;            /* solution (0:best,1:blended) */
+    rtk_t *rtk[MAXBASE]; /* rtk control/result structs of base stations */
+    obsd_t *obs[MAXBASE]; /* rover and base obs data of secondary filters */
+    int nobs[MAXBASE];  /* number of obs data of secondary filters */
+    int stat[MAXBASE];  /* status of filters */
+    const nav_t *nav;   /* navigation data */
+    satst_t satu;       /* satellite states of rover obs data */
+    sol_t sol;          /* combined solution */
+    double rb[3];       /* base position of combined solution */
+    int seq,done;       /* epoch sequence/number of processed secondary filters */
+    int next,quit;      /* next base station of thread/quit flag */
+    int nt;             /* number of threads */
+    thread_t thread[MAXBASE]; /* threads of secondary filters */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* condition of epoch sequence/processed filters */
+} mbase_t;
 
 /* constants/global variables ------------------------------------------------*/
 
 static pcvs_t pcvss={0};        /* receiver antenna parameters */
 static pcvs_t pcvsr={0};        /* satellite antenna parameters */
-static obs_t obss={0};          /* observation data */
-static nav_t navs={0};          /* navigation data */
-static sbs_t sbss={0};          /* sbas messages */
-static sta_t stas[MAXRCV];      /* station infomation */
-static int nepoch=0;            /* number of observation epochs */
-static int iobsu =0;            /* current rover observation data index */
-static int iobsr =0;            /* current reference observation data index */
-static int isbs  =0;            /* current sbas message index */
-static int revs  =0;            /* analysis direction (0:forward,1:backward) */
-static int aborts=0;            /* abort status */
-static sol_t *solf;             /* forward solutions */
-static sol_t *solb;             /* backward solutions */
-static double *rbf;             /* forward base positions */
-static double *rbb;             /* backward base positions */
-static int isolf=0;             /* current forward solutions index */
-static int isolb=0;             /* current backward solutions index */
-static char proc_rov [64]="";   /* rover for current processing */
-static char proc_base[64]="";   /* base station for current processing */
-static char rtcm_file[1024]=""; /* rtcm data file */
-static char rtcm_path[1024]=""; /* rtcm data path */
-static rtcm_t rtcm;             /* rtcm control struct */
-static FILE *fp_rtcm=NULL;      /* rtcm data file pointer */
+static gtime_t tsproc={0};      /* start time of processing units */
+
+/* global variables (for each processing thread) -----------------------------*/
+
+static THREADLOCAL obs_t obss={0};          /* observation data */
+static THREADLOCAL nav_t navs={0};          /* navigation data */
+static THREADLOCAL sbs_t sbss={0};          /* sbas messages */
+static THREADLOCAL sta_t stas[MAXRCV];      /* station infomation */
+static THREADLOCAL int nepoch=0;            /* number of observation epochs */
+static THREADLOCAL int iobsu =0;            /* current rover obs data index */
+static THREADLOCAL int iobsr =0;            /* current base obs data index */
+static THREADLOCAL int iobsb[MAXBASE];      /* current obs data index of bases */
+static THREADLOCAL int isbs  =0;            /* current sbas message index */
+static THREADLOCAL int revs  =0;            /* direction (0:fwd,1:bwd) */
+static THREADLOCAL int aborts=0;            /* abort status */
+static THREADLOCAL spill_t spf;             /* forward solutions */
+static THREADLOCAL spill_t spb;             /* backward solutions */
+static THREADLOCAL gtime_t tsout={0};       /* output start time (0:no limit) */
+static THREADLOCAL gtime_t teout={0};       /* output end time (0:no limit) */
+static THREADLOCAL char proc_rov [64]="";   /* rover for current processing */
+static THREADLOCAL char proc_base[64]="";   /* base station of processing */
+static THREADLOCAL char rtcm_file[1024]=""; /* rtcm data file */
+static THREADLOCAL char rtcm_path[1024]=""; /* rtcm data path */
+static THREADLOCAL rtcm_t rtcm;             /* rtcm control struct */
+static THREADLOCAL FILE *fp_rtcm=NULL;      /* rtcm data file pointer */
+static THREADLOCAL binw_t binw_sol;         /* binary solution writer */
+static THREADLOCAL const share_t *share=NULL; /* data shared by rovers */
+static THREADLOCAL int inpool=0;            /* thread of unit pool */
+static THREADLOCAL char ckpt_file[1024]=""; /* checkpoint file ("":off) */
+static THREADLOCAL char ckpt_warm[1024]=""; /* checkpoint for warm start */
+static THREADLOCAL ckpt_t ckpt_res;         /* checkpoint to resume from */
+static THREADLOCAL gtime_t ckpt_time={0};   /* time of last checkpoint */
 
 extern void wait(int seconds)
 {
@@ -140,6 +268,10 @@ static void outheader(FILE *fp, char **file, int n, const prcopt_t *popt,
     
     trace(3,"outheader: n=%d\n",n);
     
+    if (sopt->posf==SOLF_BIN) {
+        outsolhead(fp,sopt);
+        return;
+    }
     if (sopt->posf==SOLF_NMEA||sopt->posf==SOLF_STAT) {
         return;
     }
@@ -181,28 +313,35 @@ static void outheader(FILE *fp, char **file, int n, const prcopt_t *popt,
     
     outsolhead(fp,sopt);
 }
-/* search next observation data index ----------------------------------------*/
+/* search next observation data index ------------------------------------------
+* the epochs are matched by the time in integer ns, which is exact at the
+* tolerance DTTOL
+*-----------------------------------------------------------------------------*/
 static int nextobsf(const obs_t *obs, int *i, int rcv)
 {
-    double tt;
+    gtimens_t t0;
     int n;
     
     for (;*i<obs->n;(*i)++) if (obs->data[*i].rcv==rcv) break;
+    if (*i>=obs->n) return 0;
+    t0=time2ns(obs->data[*i].time);
     for (n=0;*i+n<obs->n;n++) {
-        tt=timediff(obs->data[*i+n].time,obs->data[*i].time);
-        if (obs->data[*i+n].rcv!=rcv||tt>DTTOL) break;
+        if (obs->data[*i+n].rcv!=rcv||
+            time2ns(obs->data[*i+n].time)-t0>DTTOLNS) break;
     }
     return n;
 }
 static int nextobsb(const obs_t *obs, int *i, int rcv)
 {
-    double tt;
+    gtimens_t t0;
     int n;
     
     for (;*i>=0;(*i)--) if (obs->data[*i].rcv==rcv) break;
+    if (*i<0) return 0;
+    t0=time2ns(obs->data[*i].time);
     for (n=0;*i-n>=0;n++) {
-        tt=timediff(obs->data[*i-n].time,obs->data[*i].time);
-        if (obs->data[*i-n].rcv!=rcv||tt<-DTTOL) break;
+        if (obs->data[*i-n].rcv!=rcv||
+            time2ns(obs->data[*i-n].time)-t0<-DTTOLNS) break;
     }
     return n;
 }
@@ -242,11 +381,37 @@ static void update_rtcm_ssr(gtime_t time)
         }
     }
 }
-/* input obs data, navigation messages and sbas correction -------------------*/
-static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
+/* carrier-phase bias correction by ssr --------------------------------------*/
+static void corr_phase_bias_ssr(obsd_t *obs, int n, const nav_t *nav)
+{
+    double freq;
+    uint8_t code;
+    int i,j;
+    
+    for (i=0;i<n;i++) for (j=0;j<NFREQ;j++) {
+        code=obs[i].code[j];
+        
+        if ((freq=sat2freq(obs[i].sat,code,nav))==0.0) continue;
+        
+        /* correct phase bias (cyc) */
+        obs[i].L[j]-=nav->ssr[obs[i].sat-1].pbias[code-1]*freq/CLIGHT;
+    }
+}
+/* input obs data, navigation messages and sbas correction ---------------------
+* input obs data of rover and base station of the next epoch, exclude
+* satellites, correct carrier-phase biases and set the obs data of the epoch to
+* the structure of arrays for the measurement models
+* args   : obsd_t *obs      O   obs data of epoch (rover and base station)
+*          obsb_t *ob       O   obs data of epoch (structure of arrays)
+*          int    solq      I   solution status of previous epoch
+*          prcopt_t *popt   I   processing options
+* return : number of obs data (-1:end of data or aborted)
+*-----------------------------------------------------------------------------*/
+static int inputobs(obsd_t *obs, obsb_t *ob, int solq, const prcopt_t *popt)
 {
     gtime_t time={0};
-    int i,nu,nr,n=0;
+    gtimens_t tu;
+    int i,nu,nr,n=0,m;
     
     trace(3,"infunc  : revs=%d iobsu=%d iobsr=%d isbs=%d\n",revs,iobsu,iobsr,isbs);
     
@@ -258,13 +423,14 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
     }
     if (!revs) { /* input forward data */
         if ((nu=nextobsf(&obss,&iobsu,1))<=0) return -1;
+        tu=time2ns(obss.data[iobsu].time);
         if (popt->intpref) {
             for (;(nr=nextobsf(&obss,&iobsr,2))>0;iobsr+=nr)
-                if (timediff(obss.data[iobsr].time,obss.data[iobsu].time)>-DTTOL) break;
+                if (time2ns(obss.data[iobsr].time)-tu>-DTTOLNS) break;
         }
         else {
             for (i=iobsr;(nr=nextobsf(&obss,&i,2))>0;iobsr=i,i+=nr)
-                if (timediff(obss.data[i].time,obss.data[iobsu].time)>DTTOL) break;
+                if (time2ns(obss.data[i].time)-tu>DTTOLNS) break;
         }
         nr=nextobsf(&obss,&iobsr,2);
         if (nr<=0) {
@@ -291,13 +457,14 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
     }
     else { /* input backward data */
         if ((nu=nextobsb(&obss,&iobsu,1))<=0) return -1;
+        tu=time2ns(obss.data[iobsu].time);
         if (popt->intpref) {
             for (;(nr=nextobsb(&obss,&iobsr,2))>0;iobsr-=nr)
-                if (timediff(obss.data[iobsr].time,obss.data[iobsu].time)<DTTOL) break;
+                if (time2ns(obss.data[iobsr].time)-tu<DTTOLNS) break;
         }
         else {
             for (i=iobsr;(nr=nextobsb(&obss,&i,2))>0;iobsr=i,i-=nr)
-                if (timediff(obss.data[i].time,obss.data[iobsu].time)<-DTTOL) break;
+                if (time2ns(obss.data[i].time)-tu<-DTTOLNS) break;
         }
         nr=nextobsb(&obss,&iobsr,2);
         for (i=0;i<nu&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsu-nu+1+i];
@@ -315,23 +482,490 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
             isbs--;
         }
     }
-    return n;
+    /* exclude satellites */
+    for (i=m=0;i<n;i++) {
+        if ((satsys(obs[i].sat,NULL)&popt->navsys)&&
+            popt->exsats[obs[i].sat-1]!=1) obs[m++]=obs[i];
+    }
+    if (m<=0) return ob->n=0;
+    
+    /* carrier-phase bias correction */
+    if (!strstr(popt->pppopt,"-ENA_FCB")) {
+        corr_phase_bias_ssr(obs,m,&navs);
+    }
+    return setobsb(obs,m,&navs,ob);
 }
-/* carrier-phase bias correction by ssr --------------------------------------*/
-static void corr_phase_bias_ssr(obsd_t *obs, int n, const nav_t *nav)
+/* input obs data of additional base station -----------------------------------
+* input obs data of the additional base station b (receiver b+2) matched to the
+* rover epoch as the base station obs data by inputobs()
+* args   : obsd_t *obs      O   obs data of base station (rcv=2)
+*          int    nmax      I   max number of obs data
+*          int    b         I   index of base station (1:first additional)
+*          gtime_t time     I   time of rover epoch
+*          prcopt_t *popt   I   processing options
+* return : number of obs data
+*-----------------------------------------------------------------------------*/
+static int inputbase(obsd_t *obs, int nmax, int b, gtime_t time,
+                     const prcopt_t *popt)
 {
-    double freq;
-    uint8_t code;
-    int i,j;
+    gtimens_t tu=time2ns(time);
+    int i,nr,rcv=b+2,*ib=iobsb+b;
     
-    for (i=0;i<n;i++) for (j=0;j<NFREQ;j++) {
-        code=obs[i].code[j];
+    if (!revs) { /* input forward data */
+        if (popt->intpref) {
+            for (;(nr=nextobsf(&obss,ib,rcv))>0;*ib+=nr)
+                if (time2ns(obss.data[*ib].time)-tu>-DTTOLNS) break;
+        }
+        else {
+            for (i=*ib;(nr=nextobsf(&obss,&i,rcv))>0;*ib=i,i+=nr)
+                if (time2ns(obss.data[i].time)-tu>DTTOLNS) break;
+        }
+        nr=nextobsf(&obss,ib,rcv);
+        for (i=0;i<nr&&i<nmax;i++) obs[i]=obss.data[*ib+i];
+    }
+    else { /* input backward data */
+        if (popt->intpref) {
+            for (;(nr=nextobsb(&obss,ib,rcv))>0;*ib-=nr)
+                if (time2ns(obss.data[*ib].time)-tu<DTTOLNS) break;
+        }
+        else {
+            for (i=*ib;(nr=nextobsb(&obss,&i,rcv))>0;*ib=i,i-=nr)
+                if (time2ns(obss.data[i].time)-tu<-DTTOLNS) break;
+        }
+        nr=nextobsb(&obss,ib,rcv);
+        for (i=0;i<nr&&i<nmax;i++) obs[i]=obss.data[*ib-nr+1+i];
+    }
+    for (nr=i,i=0;i<nr;i++) obs[i].rcv=2;
+    return nr;
+}
+/* write solution to output file ---------------------------------------------*/
+static void writesol(FILE *fp, const sol_t *sol, const double *rb,
+                     const solopt_t *sopt)
+{
+    uint8_t buff[MAXSOLMSG+1];
+    int n;
+    
+    if (!binw_sol.state) {
+        outsol(fp,sol,rb,sopt);
+    }
+    else if ((n=outsols(buff,sol,rb,sopt))>0) {
+        binwrite(&binw_sol,buff,n);
+    }
+}
+/* open spilled solution buffer ------------------------------------------------
+* temporary file or named file of checkpointed session, which is truncated to
+* n solutions on resume
+*-----------------------------------------------------------------------------*/
+static int spillopen(spill_t *sp, const char *file, int n)
+{
+    sp->n=0; sp->win=NULL; sp->off=sp->len=0;
+    
+    if (!*file) return (sp->fp=tmpfile())!=NULL;
+    
+    if (n<=0) return (sp->fp=fopen(file,"w+b"))!=NULL;
+    
+    if (truncfile(file,(long)n*SPILLREC)<0||!(sp->fp=fopen(file,"r+b"))) {
+        return 0;
+    }
+    fseek(sp->fp,0,SEEK_END);
+    sp->n=n;
+    return 1;
+}
+/* close spilled solution buffer ---------------------------------------------*/
+static void spillclose(spill_t *sp)
+{
+    if (sp->win) memacct(MEM_SOL,-(int64_t)sp->len);
+#ifdef WIN32
+    free(sp->win);
+#else
+    if (sp->win) munmap(sp->win,sp->len);
+#endif
+    if (sp->fp) fclose(sp->fp);
+    sp->fp=NULL; sp->win=NULL; sp->n=0;
+}
+/* spill solution ------------------------------------------------------------*/
+static int spillsol(spill_t *sp, const sol_t *sol, const double *rb)
+{
+    uint8_t buff[SPILLREC];
+    
+    if (fwrite(buff,outsolbin(buff,sol,rb),1,sp->fp)!=1) return 0;
+    sp->n++;
+    return 1;
+}
+/* get spilled solution --------------------------------------------------------
+* map the window of the temporary file including solution i on demand, so that
+* the memory needed for the combined solution does not grow with the number of
+* epochs
+*-----------------------------------------------------------------------------*/
+static int spillget(spill_t *sp, int i, sol_t *sol, double *rb)
+{
+    long off=(long)i*SPILLREC,size=(long)sp->n*SPILLREC;
+    
+    if (i<0||i>=sp->n) return 0;
+    
+    if (!sp->win||off<sp->off||off+SPILLREC>sp->off+sp->len) {
+        if (sp->win) memacct(MEM_SOL,-(int64_t)sp->len);
+#ifdef WIN32
+        free(sp->win);
+        fflush(sp->fp);
+        sp->off=off/SPILLWIN*SPILLWIN;
+        sp->len=MIN(SPILLWIN+SPILLREC,size-sp->off);
+        if (!(sp->win=(uint8_t *)malloc(sp->len))||
+            fseek(sp->fp,sp->off,SEEK_SET)||
+            fread(sp->win,sp->len,1,sp->fp)!=1) {
+            free(sp->win); sp->win=NULL;
+            return 0;
+        }
+#else
+        if (sp->win) munmap(sp->win,sp->len);
+        fflush(sp->fp);
+        sp->off=off/SPILLWIN*SPILLWIN; /* page aligned */
+        sp->len=MIN(SPILLWIN+SPILLREC,size-sp->off);
+        sp->win=(uint8_t *)mmap(NULL,sp->len,PROT_READ,MAP_SHARED,
+                                fileno(sp->fp),sp->off);
+        if (sp->win==MAP_FAILED) {
+            sp->win=NULL;
+            return 0;
+        }
+#endif
+        memacct(MEM_SOL,(int64_t)sp->len);
+    }
+    return insolbin(sp->win+off-sp->off,sol,rb)>0;
+}
+/* output checkpoint -----------------------------------------------------------
+* write filter state and processing cursor to the checkpoint file at every
+* interval popt->ckptint of data time. the outputs written before are flushed,
+* so that their sizes in the checkpoint are on the disk.
+*-----------------------------------------------------------------------------*/
+static void outckpt(FILE *fp, const rtk_t *rtk, gtime_t time, const sol_t *sol,
+                    gtime_t tsol, const double *rb, const prcopt_t *popt)
+{
+    FILE *fpc;
+    ckpt_t ck;
+    char tfile[1100];
+    int i,stat;
+    
+    if (!*ckpt_file||popt->ckptint<=0.0) return;
+    
+    if (ckpt_time.time&&fabs(timediff(time,ckpt_time))<popt->ckptint-DTTOL) {
+        return;
+    }
+    ckpt_time=time;
+    
+    memset(&ck,0,sizeof(ck));
+    if (fp) {
+        binwflush(&binw_sol);
+        fflush(fp);
+        ck.outoff=ftell(fp);
+    }
+    if (spf.fp) fflush(spf.fp);
+    if (spb.fp) fflush(spb.fp);
+    ck.statoff=rtkflushstat();
+    
+    ck.magic=CKPTMAGIC;
+    ck.ver=CKPTVER;
+    ck.mode=popt->mode;
+    ck.soltype=popt->soltype;
+    ck.revs=revs;
+    ck.iobsu=iobsu; ck.iobsr=iobsr; ck.isbs=isbs;
+    ck.nobs=obss.n; ck.nsbs=sbss.n;
+    ck.nspf=spf.n; ck.nspb=spb.n;
+    if (obss.n>0) ck.tobs=obss.data[0].time;
+    ck.time=time;
+    ck.sol=*sol;
+    ck.tsol=tsol;
+    for (i=0;i<3;i++) ck.rb[i]=rb[i];
+    
+    /* replace checkpoint by complete temporary file */
+    sprintf(tfile,"%s.tmp",ckpt_file);
+    if (!(fpc=fopen(tfile,"wb"))) {
+        trace(2,"checkpoint open error: %s\n",tfile);
+        return;
+    }
+    stat=fwrite(&ck,sizeof(ck),1,fpc)==1&&rtksave(rtk,fpc);
+    if (fclose(fpc)||!stat) {
+        trace(2,"checkpoint write error: %s\n",tfile);
+        remove(tfile);
+        return;
+    }
+#ifdef WIN32
+    remove(ckpt_file);
+#endif
+    if (rename(tfile,ckpt_file)) {
+        trace(2,"checkpoint rename error: %s\n",ckpt_file);
+    }
+}
+/* resume processing from checkpoint -----------------------------------------*/
+static int resumepos(rtk_t *rtk, sol_t *sol, gtime_t *tsol, double *rb)
+{
+    FILE *fp;
+    const ckpt_t *ck=&ckpt_res;
+    int i,stat;
+    
+    trace(3,"resumepos: file=%s\n",ckpt_file);
+    
+    if (!(fp=fopen(ckpt_file,"rb"))) return 0;
+    stat=!fseek(fp,sizeof(ckpt_t),SEEK_SET)&&rtkload(rtk,fp);
+    fclose(fp);
+    if (!stat) return 0;
+    
+    iobsu=ck->iobsu; iobsr=ck->iobsr; isbs=ck->isbs;
+    *sol=ck->sol;
+    *tsol=ck->tsol;
+    for (i=0;i<3;i++) rb[i]=ck->rb[i];
+    ckpt_time=ck->time;
+    
+    /* sbas corrections of messages before checkpoint */
+    for (i=revs?sbss.n-1:0;revs?i>isbs:i<isbs;i+=revs?-1:1) {
+        if (getbitu(sbss.msgs[i].msg,8,6)!=9) { /* except for geo nav */
+            sbsupdatecorr(sbss.msgs+i,&navs);
+        }
+    }
+    return 1;
+}
+/* warm start of filter by checkpoint ----------------------------------------*/
+static int warmstart(rtk_t *rtk, const char *file)
+{
+    FILE *fp;
+    ckpt_t ck;
+    int stat;
+    
+    trace(3,"warmstart: file=%s\n",file);
+    
+    if (!(fp=fopen(file,"rb"))) return 0;
+    stat=fread(&ck,sizeof(ck),1,fp)==1&&ck.magic==CKPTMAGIC&&
+         ck.ver==CKPTVER&&rtkload(rtk,fp);
+    fclose(fp);
+    return stat;
+}
+/* solution in output time span ----------------------------------------------*/
+static int outspan(gtime_t time)
+{
+    gtimens_t t=time2ns(time);
+    
+    if (tsout.time&&t-time2ns(tsout)<-DTTOLNS) return 0;
+    if (teout.time&&t>=time2ns(teout)) return 0;
+    return 1;
+}
+/* filter thread of additional base station ----------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI basethread(void *arg)
+#else
+static void *basethread(void *arg)
+#endif
+{
+    mbase_t *mb=(mbase_t *)arg;
+    int b,seq=0,quit;
+    
+    pubsetdrop(); /* products published by filter of first base station */
+    
+    rtklib_lock(&mb->lock);
+    b=++mb->next;
+    rtklib_unlock(&mb->lock);
+    
+    for (;;) {
+        rtklib_lock(&mb->lock);
+        while (mb->seq==seq&&!mb->quit) condwait(&mb->cond,&mb->lock);
+        seq=mb->seq;
+        quit=mb->quit;
+        rtklib_unlock(&mb->lock);
+        if (quit) break;
         
-        if ((freq=sat2freq(obs[i].sat,code,nav))==0.0) continue;
+        mb->stat[b]=rtkpos(mb->rtk[b],mb->obs[b],mb->nobs[b],mb->nav);
         
-        /* correct phase bias (cyc) */
-        obs[i].L[j]-=nav->ssr[obs[i].sat-1].pbias[code-1]*freq/CLIGHT;
+        rtklib_lock(&mb->lock);
+        mb->done++;
+        condsignal(&mb->cond);
+        rtklib_unlock(&mb->lock);
     }
+    return 0;
+}
+/* open multi-base rtk ---------------------------------------------------------
+* open filters of the base stations popt->nbase against the same rover. the
+* filter of the first base station is rtk and runs on the calling thread, the
+* filters of the additional base stations run on threads of their own.
+* args   : rtk_t    *rtk    IO  rtk control struct of first base station
+*          prcopt_t *popt   I   processing options
+* return : multi-base rtk (NULL: error)
+*-----------------------------------------------------------------------------*/
+static mbase_t *mbopen(rtk_t *rtk, const prcopt_t *popt)
+{
+    mbase_t *mb;
+    prcopt_t opt=*popt;
+    int i,j;
+    
+    trace(3,"mbopen  : nbase=%d basesel=%d\n",popt->nbase,popt->basesel);
+    
+    if (!(mb=(mbase_t *)calloc(1,sizeof(mbase_t)))) return NULL;
+    
+    mb->sel=popt->basesel;
+    mb->nav=&navs;
+    mb->rtk[0]=rtk;
+    mb->satu.n=-1;
+    rtk->satu=&mb->satu;
+    initlock(&mb->lock);
+    initcond(&mb->cond);
+    
+    for (i=1;i<popt->nbase&&i<MAXBASE;i++) {
+        if (!(mb->rtk[i]=(rtk_t *)malloc(sizeof(rtk_t)))||
+            !(mb->obs[i]=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS*2))) {
+            free(mb->rtk[i]);
+            break;
+        }
+        for (j=0;j<3;j++) opt.rb[j]=popt->rbs[i-1][j];
+        rtkinit(mb->rtk[i],&opt);
+        mb->rtk[i]->satu=&mb->satu;
+        iobsb[i]=revs?obss.n-1:0;
+    }
+    for (mb->n=i;mb->nt<mb->n-1;mb->nt++) {
+#ifdef WIN32
+        if (!(mb->thread[mb->nt]=CreateThread(NULL,0,basethread,mb,0,NULL))) {
+            break;
+        }
+#else
+        if (pthread_create(mb->thread+mb->nt,NULL,basethread,mb)) break;
+#endif
+    }
+    if (mb->nt<mb->n-1) {
+        showmsg("error : filter thread of base station %d",mb->nt+2);
+        for (i=mb->nt+1;i<mb->n;i++) {
+            rtkfree(mb->rtk[i]); free(mb->rtk[i]); free(mb->obs[i]);
+        }
+        mb->n=mb->nt+1;
+    }
+    return mb;
+}
+/* close multi-base rtk ------------------------------------------------------*/
+static void mbclose(mbase_t *mb)
+{
+    int i;
+    
+    trace(3,"mbclose :\n");
+    
+    rtklib_lock(&mb->lock);
+    mb->quit=1;
+    condsignal(&mb->cond);
+    rtklib_unlock(&mb->lock);
+    
+    for (i=0;i<mb->nt;i++) {
+#ifdef WIN32
+        WaitForSingleObject(mb->thread[i],INFINITE);
+        CloseHandle(mb->thread[i]);
+#else
+        pthread_join(mb->thread[i],NULL);
+#endif
+    }
+    for (i=1;i<mb->n;i++) {
+        rtkfree(mb->rtk[i]); free(mb->rtk[i]); free(mb->obs[i]);
+    }
+    mb->rtk[0]->satu=NULL;
+    free(mb);
+}
+/* combine solutions of base stations ------------------------------------------
+* select the solution of best quality and least position variance or blend the
+* solutions of best quality weighted by the inverse traces of the position
+* covariances. the covariances of the blended solution are the weighted means
+* of the covariances, since the errors of the filters are correlated through
+* the common rover.
+*-----------------------------------------------------------------------------*/
+static int combbase(mbase_t *mb)
+{
+    const sol_t *sol;
+    double var[MAXBASE],w,ws=0.0;
+    int i,j,k=-1,pri[]={6,1,2,3,4,5,1,6};
+    
+    for (i=0;i<mb->n;i++) {
+        sol=&mb->rtk[i]->sol;
+        var[i]=sol->qr[0]+sol->qr[1]+sol->qr[2];
+        if (!mb->stat[i]||sol->stat==SOLQ_NONE) continue;
+        if (k<0||pri[sol->stat]<pri[mb->rtk[k]->sol.stat]||
+            (pri[sol->stat]==pri[mb->rtk[k]->sol.stat]&&var[i]<var[k])) k=i;
+    }
+    if (k<0) k=0; /* no solution */
+    
+    mb->sol=mb->rtk[k]->sol;
+    for (i=0;i<3;i++) mb->rb[i]=mb->rtk[k]->rb[i];
+    
+    trace(4,"combbase: base=%d stat=%d var=%.3e\n",k+1,mb->sol.stat,var[k]);
+    
+    if (!mb->sel||!mb->stat[k]||mb->sol.stat==SOLQ_NONE||var[k]<=0.0) {
+        return mb->stat[k];
+    }
+    
+    /* blend solutions of best quality */
+    for (i=0;i<6;i++) mb->sol.rr[i]=mb->sol.qr[i]=mb->sol.qv[i]=0.0;
+    
+    for (i=0;i<mb->n;i++) {
+        sol=&mb->rtk[i]->sol;
+        if (!mb->stat[i]||pri[sol->stat]!=pri[mb->sol.stat]) continue;
+        w=1.0/var[i];
+        for (j=0;j<6;j++) {
+            mb->sol.rr[j]+=w*sol->rr[j];
+            mb->sol.qr[j]+=w*sol->qr[j];
+            mb->sol.qv[j]+=w*sol->qv[j];
+        }
+        ws+=w;
+    }
+    for (i=0;i<6;i++) {
+        mb->sol.rr[i]/=ws; mb->sol.qr[i]/=(float)ws; mb->sol.qv[i]/=(float)ws;
+    }
+    return mb->stat[k];
+}
+/* multi-base rtk positioning of epoch -----------------------------------------
+* process the epoch by the filters of all base stations in parallel and
+* combine the solutions. the satellite states of the rover are computed once
+* and shared by the filters.
+* args   : mbase_t *mb      IO  multi-base rtk
+*          obsd_t *obs      I   rover and first base station obs data of epoch
+*          obsb_t *obb      I   obs data of epoch set by inputobs()
+*          prcopt_t *popt   I   processing options
+* return : status of combined solution (0:no solution)
+*-----------------------------------------------------------------------------*/
+static int rtkposm(mbase_t *mb, const obsd_t *obs, const obsb_t *obb,
+                   const prcopt_t *popt)
+{
+    obsd_t *ob;
+    int i,j,k,nu,nr,n=obb->n;
+    
+    for (nu=0;nu<n&&obs[nu].rcv==1;nu++) ;
+    
+    /* satellite states of rover shared by filters */
+    mb->satu.n=-1;
+    if (nu<=MAXOBS) {
+        satposs(obs[0].time,obs,nu,mb->nav,popt->sateph,mb->satu.rs,
+                mb->satu.dts,mb->satu.var,mb->satu.svh);
+        mb->satu.n=nu;
+    }
+    /* rover and base station obs data of secondary filters */
+    for (i=1;i<mb->n;i++) {
+        ob=mb->obs[i];
+        for (j=0;j<nu;j++) ob[j]=obs[j];
+        nr=inputbase(ob+nu,MAXOBS*2-nu,i,obs[0].time,popt);
+        
+        /* exclude satellites */
+        for (j=k=nu;j<nu+nr;j++) {
+            if ((satsys(ob[j].sat,NULL)&popt->navsys)&&
+                popt->exsats[ob[j].sat-1]!=1) ob[k++]=ob[j];
+        }
+        /* carrier-phase bias correction */
+        if (!strstr(popt->pppopt,"-ENA_FCB")) {
+            corr_phase_bias_ssr(ob+nu,k-nu,mb->nav);
+        }
+        mb->nobs[i]=k;
+    }
+    rtklib_lock(&mb->lock);
+    mb->done=0;
+    mb->seq++;
+    condsignal(&mb->cond);
+    rtklib_unlock(&mb->lock);
+    
+    mb->stat[0]=rtkposb(mb->rtk[0],obs,obb,mb->nav);
+    
+    rtklib_lock(&mb->lock);
+    while (mb->done<mb->nt) condwait(&mb->cond,&mb->lock);
+    rtklib_unlock(&mb->lock);
+    
+    return combbase(mb);
 }
 /* process positioning -------------------------------------------------------*/
 static void procpos(FILE *fp, const prcopt_t *popt, const solopt_t *sopt,
@@ -340,64 +974,97 @@ static void procpos(FILE *fp, const prcopt_t *popt, const solopt_t *sopt,
     gtime_t time={0};
     sol_t sol={{0}};
     rtk_t rtk;
+    mbase_t *mb=NULL;
     obsd_t obs[MAXOBS*2]; /* for rover and base */
+    obsb_t *ob;
+    const sol_t *psol;
+    const double *prb;
     double rb[3]={0};
-    int i,nobs,n,solstatic,pri[]={6,1,2,3,4,5,1,6};
+    int i,n,stat,solstatic,pri[]={6,1,2,3,4,5,1,6};
     
     trace(3,"procpos : mode=%d\n",mode);
     
     solstatic=sopt->solstatic&&
               (popt->mode==PMODE_STATIC||popt->mode==PMODE_PPP_STATIC);
     
+    if (!(ob=(obsb_t *)malloc(sizeof(obsb_t)))) {
+        showmsg("error : memory allocation of obs data");
+        aborts=1;
+        return;
+    }
     rtkinit(&rtk,popt);
     rtcm_path[0]='\0';
+    ckpt_time=time;
+    
+    /* filters of multiple base stations */
+    if (popt->nbase>1&&PMODE_DGPS<=popt->mode&&popt->mode<=PMODE_STATIC&&
+        !(mb=mbopen(&rtk,popt))) {
+        showmsg("error : memory allocation of multi-base rtk");
+        aborts=1;
+        rtkfree(&rtk);
+        free(ob);
+        return;
+    }
     
-    ROS_INFO("\033[1;32m----> start rtkpos.\033[0m");wait(2);
-    while ((nobs=inputobs(obs,rtk.sol.stat,popt))>=0) {
-        
-        /* exclude satellites */
-        for (i=n=0;i<nobs;i++) {
-            if ((satsys(obs[i].sat,NULL)&popt->navsys)&&
-                popt->exsats[obs[i].sat-1]!=1) obs[n++]=obs[i];
+    /* resume from checkpoint or warm start of first pass */
+    if (ckpt_res.magic&&ckpt_res.revs==revs) {
+        ckpt_res.magic=0;
+        if (!resumepos(&rtk,&sol,&time,rb)) {
+            showmsg("error : checkpoint read %s",ckpt_file);
+            aborts=1;
+            rtkfree(&rtk);
+            free(ob);
+            return;
         }
+    }
+    else if (*ckpt_warm) {
+        if (!warmstart(&rtk,ckpt_warm)) {
+            showmsg("error : no filter state for warm start in %s",ckpt_warm);
+        }
+        ckpt_warm[0]='\0';
+    }
+    ROS_INFO("\033[1;32m----> start rtkpos.\033[0m");if (!popt->measonly) wait(2);
+    for (;(n=inputobs(obs,ob,rtk.sol.stat,popt))>=0;
+         outckpt(fp,&rtk,obs[0].time,&sol,time,rb,popt)) {
+        
         if (n<=0) continue;
         
-        /* carrier-phase bias correction */
-        if (!strstr(popt->pppopt,"-ENA_FCB")) {
-            corr_phase_bias_ssr(obs,n,&navs);
-        }
-        if (!rtkpos(&rtk,obs,n,&navs)) continue;
+        stat=mb?rtkposm(mb,obs,ob,popt):rtkposb(&rtk,obs,ob,&navs);
+        pubendepoch();
+        if (!stat) continue;
+        
+        psol=mb?&mb->sol:&rtk.sol;
+        prb =mb? mb->rb :rtk.rb;
         
         if (mode==0) { /* forward/backward */
-            if (!solstatic) {
-                outsol(fp,&rtk.sol,rtk.rb,sopt);
+            if (!outspan(psol->time)) {
+                continue; /* warm-up of processing unit */
+            }
+            else if (!solstatic) {
+                writesol(fp,psol,prb,sopt);
             }
-            else if (time.time==0||pri[rtk.sol.stat]<=pri[sol.stat]) {
-                sol=rtk.sol;
-                for (i=0;i<3;i++) rb[i]=rtk.rb[i];
-                if (time.time==0||timediff(rtk.sol.time,time)<0.0) {
-                    time=rtk.sol.time;
+            else if (time.time==0||pri[psol->stat]<=pri[sol.stat]) {
+                sol=*psol;
+                for (i=0;i<3;i++) rb[i]=prb[i];
+                if (time.time==0||timediff(psol->time,time)<0.0) {
+                    time=psol->time;
                 }
             }
         }
-        else if (!revs) { /* combined-forward */
-            if (isolf>=nepoch) return;
-            solf[isolf]=rtk.sol;
-            for (i=0;i<3;i++) rbf[i+isolf*3]=rtk.rb[i];
-            isolf++;
-        }
-        else { /* combined-backward */
-            if (isolb>=nepoch) return;
-            solb[isolb]=rtk.sol;
-            for (i=0;i<3;i++) rbb[i+isolb*3]=rtk.rb[i];
-            isolb++;
+        else if (!spillsol(revs?&spb:&spf,psol,prb)) {
+            /* combined-forward/backward */
+            showmsg("error : solution spill");
+            aborts=1;
+            break;
         }
     }
     if (mode==0&&solstatic&&time.time!=0.0) {
         sol.time=time;
-        outsol(fp,&sol,rb,sopt);
+        writesol(fp,&sol,rb,sopt);
     }
+    if (mb) mbclose(mb);
     rtkfree(&rtk);
+    free(ob);
 }
 /* validation of combined solutions ------------------------------------------*/
 static int valcomb(const sol_t *solf, const sol_t *solb)
@@ -427,64 +1094,70 @@ static int valcomb(const sol_t *solf, const sol_t *solb)
 static void combres(FILE *fp, const prcopt_t *popt, const solopt_t *sopt)
 {
     gtime_t time={0};
-    sol_t sols={{0}},sol={{0}};
+    sol_t sols={{0}},sol={{0}},solf={{0}},solb={{0}};
     double tt,Qf[9],Qb[9],Qs[9],rbs[3]={0},rb[3]={0},rr_f[3],rr_b[3],rr_s[3];
+    double rbf[3],rbb[3];
     int i,j,k,solstatic,pri[]={0,1,2,3,4,5,1,6};
     
-    trace(3,"combres : isolf=%d isolb=%d\n",isolf,isolb);
+    trace(3,"combres : nf=%d nb=%d\n",spf.n,spb.n);
     
     solstatic=sopt->solstatic&&
               (popt->mode==PMODE_STATIC||popt->mode==PMODE_PPP_STATIC);
     
-    for (i=0,j=isolb-1;i<isolf&&j>=0;i++,j--) {
+    /* merge forward solutions with reversed backward solutions */
+    for (i=0,j=spb.n-1;i<spf.n&&j>=0;i++,j--) {
         
-        if ((tt=timediff(solf[i].time,solb[j].time))<-DTTOL) {
-            sols=solf[i];
-            for (k=0;k<3;k++) rbs[k]=rbf[k+i*3];
+        if (!spillget(&spf,i,&solf,rbf)||!spillget(&spb,j,&solb,rbb)) {
+            showmsg("error : solution spill");
+            break;
+        }
+        if ((tt=timediff(solf.time,solb.time))<-DTTOL) {
+            sols=solf;
+            for (k=0;k<3;k++) rbs[k]=rbf[k];
             j++;
         }
         else if (tt>DTTOL) {
-            sols=solb[j];
-            for (k=0;k<3;k++) rbs[k]=rbb[k+j*3];
+            sols=solb;
+            for (k=0;k<3;k++) rbs[k]=rbb[k];
             i--;
         }
-        else if (solf[i].stat<solb[j].stat) {
-            sols=solf[i];
-            for (k=0;k<3;k++) rbs[k]=rbf[k+i*3];
+        else if (solf.stat<solb.stat) {
+            sols=solf;
+            for (k=0;k<3;k++) rbs[k]=rbf[k];
         }
-        else if (solf[i].stat>solb[j].stat) {
-            sols=solb[j];
-            for (k=0;k<3;k++) rbs[k]=rbb[k+j*3];
+        else if (solf.stat>solb.stat) {
+            sols=solb;
+            for (k=0;k<3;k++) rbs[k]=rbb[k];
         }
         else {
-            sols=solf[i];
+            sols=solf;
             sols.time=timeadd(sols.time,-tt/2.0);
             
             if ((popt->mode==PMODE_KINEMA||popt->mode==PMODE_MOVEB)&&
                 sols.stat==SOLQ_FIX) {
                 
                 /* degrade fix to float if validation failed */
-                if (!valcomb(solf+i,solb+j)) sols.stat=SOLQ_FLOAT;
+                if (!valcomb(&solf,&solb)) sols.stat=SOLQ_FLOAT;
             }
             for (k=0;k<3;k++) {
-                Qf[k+k*3]=solf[i].qr[k];
-                Qb[k+k*3]=solb[j].qr[k];
+                Qf[k+k*3]=solf.qr[k];
+                Qb[k+k*3]=solb.qr[k];
             }
-            Qf[1]=Qf[3]=solf[i].qr[3];
-            Qf[5]=Qf[7]=solf[i].qr[4];
-            Qf[2]=Qf[6]=solf[i].qr[5];
-            Qb[1]=Qb[3]=solb[j].qr[3];
-            Qb[5]=Qb[7]=solb[j].qr[4];
-            Qb[2]=Qb[6]=solb[j].qr[5];
+            Qf[1]=Qf[3]=solf.qr[3];
+            Qf[5]=Qf[7]=solf.qr[4];
+            Qf[2]=Qf[6]=solf.qr[5];
+            Qb[1]=Qb[3]=solb.qr[3];
+            Qb[5]=Qb[7]=solb.qr[4];
+            Qb[2]=Qb[6]=solb.qr[5];
             
             if (popt->mode==PMODE_MOVEB) {
-                for (k=0;k<3;k++) rr_f[k]=solf[i].rr[k]-rbf[k+i*3];
-                for (k=0;k<3;k++) rr_b[k]=solb[j].rr[k]-rbb[k+j*3];
+                for (k=0;k<3;k++) rr_f[k]=solf.rr[k]-rbf[k];
+                for (k=0;k<3;k++) rr_b[k]=solb.rr[k]-rbb[k];
                 if (smoother(rr_f,Qf,rr_b,Qb,3,rr_s,Qs)) continue;
                 for (k=0;k<3;k++) sols.rr[k]=rbs[k]+rr_s[k];
             }
             else {
-                if (smoother(solf[i].rr,Qf,solb[j].rr,Qb,3,sols.rr,Qs)) continue;
+                if (smoother(solf.rr,Qf,solb.rr,Qb,3,sols.rr,Qs)) continue;
             }
             sols.qr[0]=(float)Qs[0];
             sols.qr[1]=(float)Qs[4];
@@ -496,16 +1169,16 @@ static void combres(FILE *fp, const prcopt_t *popt, const solopt_t *sopt)
             /* smoother for velocity solution */
             if (popt->dynamics) {
                 for (k=0;k<3;k++) {
-                    Qf[k+k*3]=solf[i].qv[k];
-                    Qb[k+k*3]=solb[j].qv[k];
+                    Qf[k+k*3]=solf.qv[k];
+                    Qb[k+k*3]=solb.qv[k];
                 }
-                Qf[1]=Qf[3]=solf[i].qv[3];
-                Qf[5]=Qf[7]=solf[i].qv[4];
-                Qf[2]=Qf[6]=solf[i].qv[5];
-                Qb[1]=Qb[3]=solb[j].qv[3];
-                Qb[5]=Qb[7]=solb[j].qv[4];
-                Qb[2]=Qb[6]=solb[j].qv[5];
-                if (smoother(solf[i].rr+3,Qf,solb[j].rr+3,Qb,3,sols.rr+3,Qs)) continue;
+                Qf[1]=Qf[3]=solf.qv[3];
+                Qf[5]=Qf[7]=solf.qv[4];
+                Qf[2]=Qf[6]=solf.qv[5];
+                Qb[1]=Qb[3]=solb.qv[3];
+                Qb[5]=Qb[7]=solb.qv[4];
+                Qb[2]=Qb[6]=solb.qv[5];
+                if (smoother(solf.rr+3,Qf,solb.rr+3,Qb,3,sols.rr+3,Qs)) continue;
                 sols.qv[0]=(float)Qs[0];
                 sols.qv[1]=(float)Qs[4];
                 sols.qv[2]=(float)Qs[8];
@@ -514,8 +1187,15 @@ static void combres(FILE *fp, const prcopt_t *popt, const solopt_t *sopt)
                 sols.qv[5]=(float)Qs[2];
             }
         }
-        if (!solstatic) {
-            outsol(fp,&sols,rbs,sopt);
+        if (!outspan(sols.time)) {
+            continue; /* warm-up of processing unit */
+        }
+        else if (!solstatic) {
+            writesol(fp,&sols,rbs,sopt);
+            
+            /* publish buffered products with combined solution */
+            pubflush(sols.time);
+            pubsmoothed(&sols);
         }
         else if (time.time==0||pri[sols.stat]<=pri[sol.stat]) {
             sol=sols;
@@ -527,7 +1207,8 @@ static void combres(FILE *fp, const prcopt_t *popt, const solopt_t *sopt)
     }
     if (solstatic&&time.time!=0.0) {
         sol.time=time;
-        outsol(fp,&sol,rb,sopt);
+        writesol(fp,&sol,rb,sopt);
+        pubsmoothed(&sol);
     }
 }
 /* read prec ephemeris, sbas data, tec grid and open rtcm --------------------*/
@@ -547,7 +1228,8 @@ static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
     /* read precise ephemeris files */
     for (i=0;i<n;i++) {
         if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
-        readsp3(infile[i],nav,0);
+        if (prcopt->shmprod) shmreadsp3(infile[i],nav,0);
+        else readsp3(infile[i],nav,0);
     }
     /* read precise clock files */
     for (i=0;i<n;i++) {
@@ -566,6 +1248,7 @@ static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
          trace(1,"error : sbas ephem memory allocation");
          return;
     }
+    memacct(MEM_NAV,(int64_t)sizeof(seph_t)*nav->nsmax);
     for (i=0;i<nav->ns;i++) nav->seph[i]=seph0;
     
     /* set rtcm file and initialize rtcm struct */
@@ -580,6 +1263,12 @@ static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
         }
     }
 }
+/* memory of tec grid data ---------------------------------------------------*/
+static int64_t tecmem(const tec_t *tec)
+{
+    return (int64_t)(sizeof(double)+sizeof(float))*tec->ndata[0]*
+           tec->ndata[1]*tec->ndata[2];
+}
 /* free prec ephemeris and sbas data -----------------------------------------*/
 static void freepreceph(nav_t *nav, sbs_t *sbs)
 {
@@ -587,13 +1276,19 @@ static void freepreceph(nav_t *nav, sbs_t *sbs)
     
     trace(3,"freepreceph:\n");
     
-    free(nav->peph); nav->peph=NULL; nav->ne=nav->nemax=0;
+    memacct(MEM_PREC,-(int64_t)sizeof(peph_t)*nav->nemax-
+                      (int64_t)sizeof(pclk_t)*nav->ncmax);
+    memacct(MEM_NAV ,-(int64_t)sizeof(seph_t)*nav->nsmax);
+    memacct(MEM_TEC ,-(int64_t)sizeof(tec_t )*nav->ntmax);
+    for (i=0;i<nav->nt;i++) memacct(MEM_TEC,-tecmem(nav->tec+i));
+    
+    shmfree(nav->peph); nav->peph=NULL; nav->ne=nav->nemax=0;
     free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
     free(sbs->msgs); sbs->msgs=NULL; sbs->n =sbs->nmax =0;
     for (i=0;i<nav->nt;i++) {
-        free(nav->tec[i].data);
-        free(nav->tec[i].rms );
+        shmfree(nav->tec[i].data);
+        shmfree(nav->tec[i].rms );
     }
     free(nav->tec ); nav->tec =NULL; nav->nt=nav->ntmax=0;
     
@@ -609,6 +1304,10 @@ static int readobsnav(gtime_t ts, gtime_t te, double ti, char **infile,
     
     trace(3,"readobsnav: ts=%s n=%d\n",time_str(ts,0),n);
     
+    /* sbas ephemeris allocated by readpreceph() is not used */
+    memacct(MEM_NAV,-(int64_t)sizeof(seph_t)*nav->nsmax);
+    free(nav->seph);
+    
     obs->data=NULL; obs->n =obs->nmax =0;
     nav->eph =NULL; nav->n =nav->nmax =0;
     nav->geph=NULL; nav->ng=nav->ngmax=0;
@@ -624,7 +1323,7 @@ static int readobsnav(gtime_t ts, gtime_t te, double ti, char **infile,
         }
         /* read rinex obs and nav file */
         if (readrnxt(infile[i],rcv,ts,te,ti,prcopt->rnxopt[rcv<=1?0:1],obs,nav,
-                     rcv<=2?sta+rcv-1:NULL)<0) {
+                     rcv<=MAXRCV?sta+rcv-1:NULL)<0) {
             checkbrk("error : insufficient memory");
             trace(1,"insufficient memory\n");
             return 0;
@@ -663,11 +1362,216 @@ static void freeobsnav(obs_t *obs, nav_t *nav)
 {
     trace(3,"freeobsnav:\n");
     
+    /* references to data shared by rovers */
+    if (share) {
+        if (nav->eph ==share->nav.eph ) nav->eph =NULL;
+        if (nav->geph==share->nav.geph) nav->geph=NULL;
+        nav->alm=NULL; nav->na=nav->namax=0;
+        nav->tec=NULL; nav->nt=nav->ntmax=0;
+        nav->erp.data=NULL; nav->erp.n=nav->erp.nmax=0;
+    }
+    memacct(MEM_OBS,-(int64_t)sizeof(obsd_t)*obs->nmax);
+    if (nav->eph ) memacct(MEM_NAV,-(int64_t)sizeof(eph_t )*nav->nmax );
+    if (nav->geph) memacct(MEM_NAV,-(int64_t)sizeof(geph_t)*nav->ngmax);
+    if (nav->seph) memacct(MEM_NAV,-(int64_t)sizeof(seph_t)*nav->nsmax);
+    
     free(obs->data); obs->data=NULL; obs->n =obs->nmax =0;
     free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;
     free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
 }
+/* read data shared by rovers --------------------------------------------------
+* read the input files without rover keywords (navigation data, observation
+* data of other receivers), ionosphere and erp data once for all rovers
+*-----------------------------------------------------------------------------*/
+static int readshare(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
+                     const filopt_t *fopt, char **infile, const int *index,
+                     int n, share_t *sh)
+{
+    const char *ext;
+    char path[1024];
+    int i,ind=0,nobs,obsg=0,rcv=1;
+    
+    trace(3,"readshare: n=%d\n",n);
+    
+    for (i=0;i<n;i++) {
+        if (checkbrk("")) return 0;
+        
+        /* receiver number same as readobsnav() */
+        if (index[i]!=ind) {
+            if (obsg) rcv++;
+            ind=index[i]; obsg=0;
+        }
+        sh->rcv[i]=rcv;
+        
+        /* input files of rover read by each rover */
+        if ((sh->rov[i]=strstr(infile[i],"%r")!=NULL)) {
+            obsg=1;
+            continue;
+        }
+        nobs=sh->obs.n;
+        if (readrnxt(infile[i],rcv,ts,te,ti,popt->rnxopt[rcv<=1?0:1],&sh->obs,
+                     &sh->nav,rcv<=MAXRCV?sh->sta+rcv-1:NULL)<0) {
+            checkbrk("error : insufficient memory");
+            trace(1,"insufficient memory\n");
+            return 0;
+        }
+        if (sh->obs.n>nobs) obsg=1;
+    }
+    uniqnav(&sh->nav);
+    
+    /* precise ephemeris and clock of calling thread */
+    sh->nav.peph=navs.peph; sh->nav.ne=navs.ne; sh->nav.nemax=navs.nemax;
+    sh->nav.pclk=navs.pclk; sh->nav.nc=navs.nc; sh->nav.ncmax=navs.ncmax;
+    
+    /* read ionosphere data file */
+    if (*fopt->iono&&(ext=strrchr(fopt->iono,'.'))) {
+        if (strlen(ext)==4&&(ext[3]=='i'||ext[3]=='I')) {
+            reppath(fopt->iono,path,ts,"","");
+            if (popt->shmprod) shmreadtec(path,&sh->nav,1);
+            else readtec(path,&sh->nav,1);
+        }
+    }
+    /* read erp data */
+    if (*fopt->eop) {
+        memacct(MEM_NAV,-(int64_t)sizeof(erpd_t)*navs.erp.nmax);
+        free(navs.erp.data); navs.erp.data=NULL; navs.erp.n=navs.erp.nmax=0;
+        reppath(fopt->eop,path,ts,"","");
+        if (!readerp(path,&sh->nav.erp)) {
+            showmsg("error : no erp data %s",path);
+            trace(2,"no erp data %s\n",path);
+        }
+    }
+    return 1;
+}
+/* free data shared by rovers ------------------------------------------------*/
+static void freeshare(share_t *sh)
+{
+    int i;
+    
+    trace(3,"freeshare:\n");
+    
+    memacct(MEM_OBS,-(int64_t)sizeof(obsd_t)*sh->obs.nmax);
+    memacct(MEM_NAV,-(int64_t)sizeof(eph_t )*sh->nav.nmax-
+                     (int64_t)sizeof(geph_t)*sh->nav.ngmax-
+                     (int64_t)sizeof(seph_t)*sh->nav.nsmax-
+                     (int64_t)sizeof(alm_t )*sh->nav.namax-
+                     (int64_t)sizeof(erpd_t)*sh->nav.erp.nmax);
+    memacct(MEM_TEC,-(int64_t)sizeof(tec_t )*sh->nav.ntmax);
+    for (i=0;i<sh->nav.nt;i++) memacct(MEM_TEC,-tecmem(sh->nav.tec+i));
+    
+    free(sh->obs.data);
+    free(sh->nav.eph );
+    free(sh->nav.geph);
+    free(sh->nav.seph);
+    free(sh->nav.alm );
+    for (i=0;i<sh->nav.nt;i++) {
+        shmfree(sh->nav.tec[i].data);
+        shmfree(sh->nav.tec[i].rms );
+    }
+    free(sh->nav.tec);
+    free(sh->nav.erp.data);
+}
+/* read obs and nav data of rover ----------------------------------------------
+* read the input files of a rover and add the data shared by rovers. the
+* ephemerides are referenced unless the rover files contain ephemerides.
+* sbas ephemerides are copied as they are updated by sbas messages.
+*-----------------------------------------------------------------------------*/
+static int readrovobs(gtime_t ts, gtime_t te, double ti, char **infile, int n,
+                      const prcopt_t *prcopt, obs_t *obs, nav_t *nav,
+                      sta_t *sta)
+{
+    const share_t *sh=share;
+    obsd_t *data;
+    eph_t *eph;
+    geph_t *geph;
+    seph_t *seph;
+    int i,rcv;
+    
+    trace(3,"readrovobs: ts=%s n=%d\n",time_str(ts,0),n);
+    
+    /* sbas ephemeris allocated by readpreceph() is not used */
+    memacct(MEM_NAV,-(int64_t)sizeof(seph_t)*nav->nsmax);
+    free(nav->seph);
+    
+    *nav=sh->nav;
+    obs->data=NULL; obs->n =obs->nmax =0;
+    nav->eph =NULL; nav->n =nav->nmax =0;
+    nav->geph=NULL; nav->ng=nav->ngmax=0;
+    nav->seph=NULL; nav->ns=nav->nsmax=0;
+    nepoch=0;
+    for (i=0;i<MAXRCV;i++) sta[i]=sh->sta[i];
+    
+    for (i=0;i<n;i++) {
+        if (checkbrk("")) return 0;
+        if (!sh->rov[i]) continue;
+        
+        rcv=sh->rcv[i];
+        if (readrnxt(infile[i],rcv,ts,te,ti,prcopt->rnxopt[rcv<=1?0:1],obs,nav,
+                     rcv<=MAXRCV?sta+rcv-1:NULL)<0) {
+            checkbrk("error : insufficient memory");
+            trace(1,"insufficient memory\n");
+            return 0;
+        }
+    }
+    /* add observation data of other receivers */
+    if (sh->obs.n>0) {
+        if (!(data=(obsd_t *)realloc(obs->data,sizeof(obsd_t)*(obs->n+sh->obs.n)))) {
+            checkbrk("error : insufficient memory");
+            return 0;
+        }
+        memcpy(data+obs->n,sh->obs.data,sizeof(obsd_t)*sh->obs.n);
+        memacct(MEM_OBS,(int64_t)sizeof(obsd_t)*(obs->n+sh->obs.n-obs->nmax));
+        obs->data=data;
+        obs->n=obs->nmax=obs->n+sh->obs.n;
+    }
+    if (obs->n<=0) {
+        checkbrk("error : no obs data");
+        trace(1,"\n");
+        return 0;
+    }
+    /* add shared ephemerides */
+    if (nav->n>0||nav->ng>0||nav->ns>0) {
+        if (!(eph =(eph_t  *)realloc(nav->eph ,sizeof(eph_t )*(nav->n +sh->nav.n +1)))||
+            !(geph=(geph_t *)realloc(nav->geph,sizeof(geph_t)*(nav->ng+sh->nav.ng+1)))||
+            !(seph=(seph_t *)realloc(nav->seph,sizeof(seph_t)*(nav->ns+sh->nav.ns+1)))) {
+            checkbrk("error : insufficient memory");
+            return 0;
+        }
+        memcpy(eph +nav->n ,sh->nav.eph ,sizeof(eph_t )*sh->nav.n );
+        memcpy(geph+nav->ng,sh->nav.geph,sizeof(geph_t)*sh->nav.ng);
+        memcpy(seph+nav->ns,sh->nav.seph,sizeof(seph_t)*sh->nav.ns);
+        memacct(MEM_NAV,(int64_t)sizeof(eph_t )*(nav->n +sh->nav.n -nav->nmax )+
+                        (int64_t)sizeof(geph_t)*(nav->ng+sh->nav.ng-nav->ngmax)+
+                        (int64_t)sizeof(seph_t)*(nav->ns+sh->nav.ns-nav->nsmax));
+        nav->eph =eph ; nav->n =nav->nmax =nav->n +sh->nav.n ;
+        nav->geph=geph; nav->ng=nav->ngmax=nav->ng+sh->nav.ng;
+        nav->seph=seph; nav->ns=nav->nsmax=nav->ns+sh->nav.ns;
+        uniqnav(nav);
+    }
+    else {
+        nav->eph =sh->nav.eph ; nav->n =nav->nmax =sh->nav.n ;
+        nav->geph=sh->nav.geph; nav->ng=nav->ngmax=sh->nav.ng;
+        if (sh->nav.ns>0) {
+            if (!(nav->seph=(seph_t *)malloc(sizeof(seph_t)*sh->nav.ns))) {
+                checkbrk("error : insufficient memory");
+                return 0;
+            }
+            memcpy(nav->seph,sh->nav.seph,sizeof(seph_t)*sh->nav.ns);
+            nav->ns=nav->nsmax=sh->nav.ns;
+            memacct(MEM_NAV,(int64_t)sizeof(seph_t)*nav->nsmax);
+        }
+    }
+    if (nav->n<=0&&nav->ng<=0&&nav->ns<=0) {
+        checkbrk("error : no nav data");
+        trace(1,"\n");
+        return 0;
+    }
+    /* sort observation data */
+    nepoch=sortobs(obs);
+    
+    return 1;
+}
 /* average of single position ------------------------------------------------*/
 static int avepos(double *ra, int rcv, const obs_t *obs, const nav_t *nav,
                   const prcopt_t *opt)
@@ -736,12 +1640,33 @@ static int getstapos(const char *file, char *name, double *r)
     trace(1,"no station position: %s %s\n",name,file);
     return 0;
 }
+/* antenna position of rinex header ------------------------------------------*/
+static int rnxpos(const sta_t *sta, double *rr)
+{
+    double del[3],pos[3],dr[3]={0};
+    int i;
+    
+    if (norm(sta->pos,3)<=0.0) return 0;
+    
+    /* antenna delta */
+    if (sta->deltype==0) { /* enu */
+        for (i=0;i<3;i++) del[i]=sta->del[i];
+        del[2]+=sta->hgt;
+        ecef2pos(sta->pos,pos);
+        enu2ecef(pos,del,dr);
+    }
+    else { /* xyz */
+        for (i=0;i<3;i++) dr[i]=sta->del[i];
+    }
+    for (i=0;i<3;i++) rr[i]=sta->pos[i]+dr[i];
+    return 1;
+}
 /* antenna phase center position ---------------------------------------------*/
 static int antpos(prcopt_t *opt, int rcvno, const obs_t *obs, const nav_t *nav,
                   const sta_t *sta, const char *posfile)
 {
-    double *rr=rcvno==1?opt->ru:opt->rb,del[3],pos[3],dr[3]={0};
-    int i,postype=rcvno==1?opt->rovpos:opt->refpos;
+    double *rr=rcvno==1?opt->ru:opt->rb;
+    int postype=rcvno==1?opt->rovpos:opt->refpos;
     char *name;
     
     trace(3,"antpos  : rcvno=%d\n",rcvno);
@@ -760,22 +1685,30 @@ static int antpos(prcopt_t *opt, int rcvno, const obs_t *obs, const nav_t *nav,
         }
     }
     else if (postype==POSOPT_RINEX) { /* get from rinex header */
-        if (norm(stas[rcvno==1?0:1].pos,3)<=0.0) {
+        if (!rnxpos(stas+(rcvno==1?0:1),rr)) {
             showmsg("error : no position in rinex header");
             trace(1,"no position position in rinex header\n");
             return 0;
         }
-        /* antenna delta */
-        if (stas[rcvno==1?0:1].deltype==0) { /* enu */
-            for (i=0;i<3;i++) del[i]=stas[rcvno==1?0:1].del[i];
-            del[2]+=stas[rcvno==1?0:1].hgt;
-            ecef2pos(stas[rcvno==1?0:1].pos,pos);
-            enu2ecef(pos,del,dr);
-        }
-        else { /* xyz */
-            for (i=0;i<3;i++) dr[i]=stas[rcvno==1?0:1].del[i];
+    }
+    return 1;
+}
+/* positions of additional base stations ---------------------------------------
+* positions of the additional base stations of multi-base rtk not set by the
+* options are the approximate positions of the rinex headers
+*-----------------------------------------------------------------------------*/
+static int basepos(prcopt_t *opt)
+{
+    int i;
+    
+    for (i=1;i<opt->nbase&&i<MAXBASE;i++) {
+        if (norm(opt->rbs[i-1],3)>0.0) continue;
+        
+        if (!rnxpos(stas+i+1,opt->rbs[i-1])) {
+            showmsg("error : no position of base station %d",i+1);
+            trace(1,"no position of base station %d\n",i+1);
+            return 0;
         }
-        for (i=0;i<3;i++) rr[i]=stas[rcvno==1?0:1].pos[i]+dr[i];
     }
     return 1;
 }
@@ -786,13 +1719,15 @@ static int openses(const prcopt_t *popt, const solopt_t *sopt,
     trace(3,"openses :\n");
     
     /* read satellite antenna parameters */
-    if (*fopt->satantp&&!(readpcv(fopt->satantp,pcvs))) {
+    if (*fopt->satantp&&!(popt->shmprod?shmreadpcv(fopt->satantp,pcvs):
+                                        readpcv(fopt->satantp,pcvs))) {
         showmsg("error : no sat ant pcv in %s",fopt->satantp);
         trace(1,"sat antenna pcv read error: %s\n",fopt->satantp);
         return 0;
     }
     /* read receiver antenna parameters */
-    if (*fopt->rcvantp&&!(readpcv(fopt->rcvantp,pcvr))) {
+    if (*fopt->rcvantp&&!(popt->shmprod?shmreadpcv(fopt->rcvantp,pcvr):
+                                        readpcv(fopt->rcvantp,pcvr))) {
         showmsg("error : no rec ant pcv in %s",fopt->rcvantp);
         trace(1,"rec antenna pcv read error: %s\n",fopt->rcvantp);
         return 0;
@@ -812,13 +1747,15 @@ static void closeses(nav_t *nav, pcvs_t *pcvs, pcvs_t *pcvr)
     trace(3,"closeses:\n");
     
     /* free antenna parameters */
-    free(pcvs->pcv); pcvs->pcv=NULL; pcvs->n=pcvs->nmax=0;
-    free(pcvr->pcv); pcvr->pcv=NULL; pcvr->n=pcvr->nmax=0;
+    memacct(MEM_PCV,-(int64_t)sizeof(pcv_t)*(pcvs->nmax+pcvr->nmax));
+    shmfree(pcvs->pcv); pcvs->pcv=NULL; pcvs->n=pcvs->nmax=0;
+    shmfree(pcvr->pcv); pcvr->pcv=NULL; pcvr->n=pcvr->nmax=0;
     
     /* close geoid data */
     closegeoid();
     
     /* free erp data */
+    memacct(MEM_NAV,-(int64_t)sizeof(erpd_t)*nav->erp.nmax);
     free(nav->erp.data); nav->erp.data=NULL; nav->erp.n=nav->erp.nmax=0;
     
     /* close solution statistics and debug trace */
@@ -902,11 +1839,94 @@ static int outhead(const char *outfile, char **infile, int n,
     return 1;
 }
 /* open output file for append -----------------------------------------------*/
-static FILE *openfile(const char *outfile)
+static FILE *openfile(const char *outfile, const solopt_t *sopt)
 {
+    FILE *fp;
+    
     trace(3,"openfile: outfile=%s\n",outfile);
     
-    return !*outfile?stdout:fopen(outfile,"ab");
+    if (!(fp=!*outfile?stdout:fopen(outfile,"ab"))) return NULL;
+    
+    /* binary solutions written by background thread */
+    if (sopt->posf==SOLF_BIN&&!binwopen(&binw_sol,fp,0)) {
+        showmsg("error : binary writer open");
+    }
+    return fp;
+}
+/* close output file ---------------------------------------------------------*/
+static void closefile(FILE *fp)
+{
+    trace(3,"closefile:\n");
+    
+    binwclose(&binw_sol);
+    fclose(fp);
+}
+/* open checkpoint of session --------------------------------------------------
+* set checkpoint file <outfile>.ckpt and read the checkpoint to resume from.
+* checkpoints are not used without output file, in processing units or with
+* multiple base stations. they are not used either if products of a pass are
+* buffered for publication (backward pass or PUBP_COMBINED), since the buffer
+* is not in the checkpoint and a resumed run would not publish all epochs.
+*
+* the warm start by fopt->warmst is set for the first pass of the session. in
+* processing units (time units, shards or a processing time span) it is set
+* only for the unit starting at the start of processing, the other units start
+* after the state of the warm start. with multiple base stations it is set
+* for the filter of the first base station.
+*-----------------------------------------------------------------------------*/
+static int openckpt(const char *outfile, gtime_t ts, const prcopt_t *popt,
+                    const filopt_t *fopt)
+{
+    FILE *fp;
+    ckpt_t ck;
+    int stat;
+    
+    ckpt_file[0]=ckpt_warm[0]='\0';
+    ckpt_res.magic=0;
+    
+    if (!tsout.time||(tsproc.time&&timediff(ts,tsproc)<=DTTOL)) {
+        strcpy(ckpt_warm,fopt->warmst);
+    }
+    if (tsout.time||teout.time||popt->nbase>1) return 0;
+    
+    if (!*outfile||(popt->ckptint<=0.0&&!popt->resume)) return 0;
+    
+    if (pubbuffered(popt->mode==PMODE_SINGLE?0:popt->soltype)) {
+        showmsg("error : no checkpoint with buffered publication");
+        return 0;
+    }
+    sprintf(ckpt_file,"%.1000s.ckpt",outfile);
+    
+    if (!popt->resume||!(fp=fopen(ckpt_file,"rb"))) return 0;
+    
+    stat=fread(&ck,sizeof(ck),1,fp)==1&&ck.magic==CKPTMAGIC&&
+         ck.ver==CKPTVER&&ck.mode==popt->mode&&ck.soltype==popt->soltype&&
+         ck.nobs==obss.n&&ck.nsbs==sbss.n&&
+         (obss.n<=0||timediff(ck.tobs,obss.data[0].time)==0.0);
+    fclose(fp);
+    
+    if (!stat) {
+        showmsg("error : checkpoint of other session %s",ckpt_file);
+        return 0;
+    }
+    ckpt_res=ck;
+    ckpt_warm[0]='\0';
+    return 1;
+}
+/* close checkpoint of session -------------------------------------------------
+* remove checkpoint and spilled solutions of completed session
+*-----------------------------------------------------------------------------*/
+static void closeckpt(void)
+{
+    char file[1100];
+    
+    if (*ckpt_file&&!aborts) {
+        remove(ckpt_file);
+        sprintf(file,"%s.fwd",ckpt_file); remove(file);
+        sprintf(file,"%s.bwd",ckpt_file); remove(file);
+    }
+    ckpt_file[0]=ckpt_warm[0]='\0';
+    ckpt_res.magic=0;
 }
 /* execute processing session ------------------------------------------------*/
 static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
@@ -914,12 +1934,17 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
                    char **infile, const int *index, int n, char *outfile)
 {
     FILE *fp;
+    gtime_t t0={0};
     prcopt_t popt_=*popt;
-    char tracefile[1024],statfile[1024],path[1024];
+    char tracefile[1024],statfile[1024],path[1024],spill[2][1100]={"",""};
     const char *ext;
+    int resume;
     
     trace(3,"execses : n=%d outfile=%s\n",n,outfile);
     
+    /* measurement-only preprocessing needs a single forward pass */
+    if (popt_.measonly&&popt_.soltype==2) popt_.soltype=0;
+    
     /* open debug trace */
     if (flag&&sopt->trace>0) {
         if (*outfile) {
@@ -933,15 +1958,17 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         traceopen(tracefile);
         tracelevel(sopt->trace);
     }
-    /* read ionosphere data file */
-    if (*fopt->iono&&(ext=strrchr(fopt->iono,'.'))) {
+    /* read ionosphere data file (unless shared by rovers) */
+    if (!share&&*fopt->iono&&(ext=strrchr(fopt->iono,'.'))) {
         if (strlen(ext)==4&&(ext[3]=='i'||ext[3]=='I')) {
             reppath(fopt->iono,path,ts,"","");
-            readtec(path,&navs,1);
+            if (popt->shmprod) shmreadtec(path,&navs,1);
+            else readtec(path,&navs,1);
         }
     }
-    /* read erp data */
-    if (*fopt->eop) {
+    /* read erp data (unless shared by rovers) */
+    if (!share&&*fopt->eop) {
+        memacct(MEM_NAV,-(int64_t)sizeof(erpd_t)*navs.erp.nmax);
         free(navs.erp.data); navs.erp.data=NULL; navs.erp.n=navs.erp.nmax=0;
         reppath(fopt->eop,path,ts,"","");
         if (!readerp(path,&navs.erp)) {
@@ -950,8 +1977,13 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         }
     }
     /* read obs and nav data */
-    ROS_INFO("\033[1;32m----> start readobsnav.\033[0m");wait(2);
-    if (!readobsnav(ts,te,ti,infile,index,n,&popt_,&obss,&navs,stas)) return 0;
+    ROS_INFO("\033[1;32m----> start readobsnav.\033[0m");if (!popt_.measonly) wait(2);
+    if (share) {
+        if (!readrovobs(ts,te,ti,infile,n,&popt_,&obss,&navs,stas)) return 0;
+    }
+    else if (!readobsnav(ts,te,ti,infile,index,n,&popt_,&obss,&navs,stas)) {
+        return 0;
+    }
     
     /* read dcb parameters */
     if (*fopt->dcb) {
@@ -979,70 +2011,248 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             freeobsnav(&obss,&navs);
             return 0;
         }
+        if (popt_.nbase>1&&!basepos(&popt_)) {
+            freeobsnav(&obss,&navs);
+            return 0;
+        }
+    }
+    /* checkpoint of session and resume (outputs truncated to checkpoint) */
+    resume=openckpt(outfile,ts,&popt_,fopt);
+    if (resume&&(popt_.mode==PMODE_SINGLE||popt_.soltype!=2)&&
+        truncfile(outfile,ckpt_res.outoff)<0) {
+        showmsg("error : output file shorter than checkpoint %s",outfile);
+        resume=ckpt_res.magic=0;
     }
-    /* open solution statistics */
-    if (flag&&sopt->sstat>0) {
+    if (*ckpt_file) {
+        sprintf(spill[0],"%s.fwd",ckpt_file);
+        sprintf(spill[1],"%s.bwd",ckpt_file);
+    }
+    /* open solution statistics (for each rover if shared by rovers) */
+    if ((flag||share)&&sopt->sstat>0) {
         strcpy(statfile,outfile);
         strcat(statfile,".stat");
         rtkclosestat();
-        rtkopenstat(statfile,sopt->sstat);
+        if (resume) {
+            if (!rtkresumestat(statfile,sopt->sstat,sopt->posf==SOLF_BIN,
+                               ckpt_res.statoff)) {
+                showmsg("error : solution status file %s",statfile);
+            }
+        }
+        else if (sopt->posf==SOLF_BIN) rtkopenstatb(statfile,sopt->sstat);
+        else rtkopenstat(statfile,sopt->sstat);
     }
-    /* write header to output file */
-    if (flag&&!outhead(outfile,infile,n,&popt_,sopt)) {
+    /* write header to output file (combined solutions written at the end) */
+    if (flag&&(!resume||(popt_.mode!=PMODE_SINGLE&&popt_.soltype==2))&&
+        !outhead(outfile,infile,n,&popt_,sopt)) {
+        closeckpt();
         freeobsnav(&obss,&navs);
         return 0;
     }
     iobsu=iobsr=isbs=revs=aborts=0;
     
     if (popt_.mode==PMODE_SINGLE||popt_.soltype==0) {
-        if ((fp=openfile(outfile))) {
-            ROS_INFO("\033[1;32m----> start procpos.\033[0m");wait(2);
+        if ((fp=openfile(outfile,sopt))) {
+            ROS_INFO("\033[1;32m----> start procpos.\033[0m");if (!popt_.measonly) wait(2);
+            pubsetpass(0,0);
             procpos(fp,&popt_,sopt,0); /* forward */
-            fclose(fp);
+            closefile(fp);
         }
     }
     else if (popt_.soltype==1) {
-        if ((fp=openfile(outfile))) {
+        if ((fp=openfile(outfile,sopt))) {
             revs=1; iobsu=iobsr=obss.n-1; isbs=sbss.n-1;
+            pubsetpass(1,0);
             procpos(fp,&popt_,sopt,0); /* backward */
-            fclose(fp);
+            closefile(fp);
         }
+        pubflush(t0);
     }
     else { /* combined */
-        solf=(sol_t *)malloc(sizeof(sol_t)*nepoch);
-        solb=(sol_t *)malloc(sizeof(sol_t)*nepoch);
-        rbf=(double *)malloc(sizeof(double)*nepoch*3);
-        rbb=(double *)malloc(sizeof(double)*nepoch*3);
-        
-        if (solf&&solb) {
-            isolf=isolb=0;
-            procpos(NULL,&popt_,sopt,1); /* forward */
+        if (spillopen(&spf,spill[0],resume?ckpt_res.nspf:0)&&
+            spillopen(&spb,spill[1],resume?ckpt_res.nspb:0)) {
+            if (!resume||ckpt_res.revs==0) {
+                pubsetpass(0,1);
+                procpos(NULL,&popt_,sopt,1); /* forward */
+            }
             revs=1; iobsu=iobsr=obss.n-1; isbs=sbss.n-1;
+            pubsetpass(1,1);
             procpos(NULL,&popt_,sopt,1); /* backward */
             
             /* combine forward/backward solutions */
-            if (!aborts&&(fp=openfile(outfile))) {
+            if (!aborts&&(fp=openfile(outfile,sopt))) {
                 combres(fp,&popt_,sopt);
-                fclose(fp);
+                closefile(fp);
             }
+            /* publish remaining buffered products */
+            pubflush(t0);
         }
-        else showmsg("error : memory allocation");
-        free(solf);
-        free(solb);
-        free(rbf);
-        free(rbb);
+        else showmsg("error : temporary file");
+        spillclose(&spf);
+        spillclose(&spb);
     }
+    closeckpt();
+    
     /* free obs and nav data */
     freeobsnav(&obss,&navs);
     
     return aborts?1:0;
 }
-/* execute processing session for each rover ---------------------------------*/
+/* rover processing thread ---------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI roverthread(void *arg)
+#else
+static void *roverthread(void *arg)
+#endif
+{
+    rpool_t *pool=(rpool_t *)arg;
+    rjob_t *job;
+    int i,stat;
+    
+    /* context of calling thread */
+    share=pool->share;
+    tsout=pool->tsout;
+    teout=pool->teout;
+    rtkstatspan(tsout,teout);
+    sbss=*pool->sbs;
+    strcpy(proc_base,pool->base);
+    strcpy(rtcm_file,pool->rtcm);
+    if (*rtcm_file) init_rtcm(&rtcm);
+    
+    for (;;) {
+        rtklib_lock(&pool->lock);
+        i=pool->next++;
+        rtklib_unlock(&pool->lock);
+        if (i>=pool->n) break;
+        
+        job=pool->job+i;
+        if (pool->abort) stat=1;
+        else {
+            strcpy(proc_rov,job->id);
+            pubsetrover(job->id);
+            job->pub=pubopenunit(tsout,teout);
+            stat=execses(pool->ts,pool->te,pool->ti,pool->popt,pool->sopt,
+                         pool->fopt,pool->flag,job->ifile,pool->index,pool->nf,
+                         job->ofile);
+            pubcloseunit();
+        }
+        rtklib_lock(&pool->lock);
+        job->stat=stat;
+        job->done=1;
+        if (stat==1) pool->abort=1;
+        condsignal(&pool->cond);
+        rtklib_unlock(&pool->lock);
+    }
+    /* free rtcm data and references to data of calling thread */
+    if (fp_rtcm) fclose(fp_rtcm);
+    fp_rtcm=NULL;
+    if (*rtcm_file) free_rtcm(&rtcm);
+    memset(&sbss,0,sizeof(sbs_t));
+    navs.peph=NULL; navs.ne=navs.nemax=0;
+    navs.pclk=NULL; navs.nc=navs.ncmax=0;
+    share=NULL;
+    return 0;
+}
+/* execute processing sessions of rovers on threads ----------------------------
+* each thread processes the rovers with its own obs data and rtk control
+* struct, referencing the data shared by rovers. the products are captured by
+* the threads and published in order of the rovers.
+* return : status (0:ok,0>:error,1:aborted)
+*-----------------------------------------------------------------------------*/
+static int execrovs(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
+                    const solopt_t *sopt, const filopt_t *fopt, int flag,
+                    char **infile, const int *index, int n, char *outfile,
+                    const char *rov)
+{
+    rpool_t pool={0};
+    rjob_t *job;
+    thread_t thread[MAXUNITTHR];
+    gtime_t t0={0};
+    char *rov_,*p,*q;
+    int i,j,nj=0,nt=0,stat=0;
+    
+    trace(3,"execrovs: n=%d nthread=%d\n",n,popt->nthread);
+    
+    if (!(rov_=(char *)malloc(strlen(rov)+1))) return -1;
+    strcpy(rov_,rov);
+    if (!(job=(rjob_t *)calloc(strlen(rov)/2+1,sizeof(rjob_t)))) {
+        free(rov_);
+        return -1;
+    }
+    for (p=rov_;;p=q+1) { /* for each rover */
+        if ((q=strchr(p,' '))) *q='\0';
+        
+        if (*p) {
+            sprintf(job[nj].id,"%.63s",p);
+            for (j=0;j<n;j++) {
+                if (!(job[nj].ifile[j]=(char *)malloc(1024))) break;
+                reppath(infile[j],job[nj].ifile[j],t0,p,"");
+            }
+            reppath(outfile,job[nj++].ofile,t0,p,"");
+            if (j<n) {
+                stat=-1;
+                break;
+            }
+        }
+        if (!q) break;
+    }
+    free(rov_);
+    
+    pool.job=job; pool.n=stat?0:nj;
+    pool.ts=ts; pool.te=te; pool.ti=ti;
+    pool.popt=popt; pool.sopt=sopt; pool.fopt=fopt; pool.flag=flag;
+    pool.index=index; pool.nf=n; pool.share=share;
+    pool.tsout=tsout; pool.teout=teout;
+    pool.sbs=&sbss; pool.rtcm=rtcm_file; pool.base=proc_base;
+    initlock(&pool.lock);
+    initcond(&pool.cond);
+    
+    for (i=0;i<popt->nthread&&i<pool.n&&i<MAXUNITTHR;i++) {
+#ifdef WIN32
+        if (!(thread[nt]=CreateThread(NULL,0,roverthread,&pool,0,NULL))) break;
+#else
+        if (pthread_create(thread+nt,NULL,roverthread,&pool)) break;
+#endif
+        nt++;
+    }
+    if (nt<=0&&pool.n>0) { /* no thread created */
+        showmsg("error : thread creation");
+        pool.n=0;
+        stat=-1;
+    }
+    for (i=0;i<pool.n;i++) {
+        rtklib_lock(&pool.lock);
+        while (!job[i].done) condwait(&pool.cond,&pool.lock);
+        rtklib_unlock(&pool.lock);
+        
+        /* publish products in order of rovers */
+        pubemitunit(job[i].pub); job[i].pub=NULL;
+        
+        if (job[i].stat==1) stat=1;
+        else if (stat!=1) stat=job[i].stat;
+    }
+    for (i=0;i<nt;i++) {
+#ifdef WIN32
+        WaitForSingleObject(thread[i],INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i],NULL);
+#endif
+    }
+    for (i=0;i<nj;i++) for (j=0;j<n;j++) free(job[i].ifile[j]);
+    free(job);
+    return stat;
+}
+/* execute processing session for each rover -----------------------------------
+* the navigation data, the observation data of other receivers, ionosphere and
+* erp data are read once and shared by the rovers. the rovers are processed on
+* popt->nthread threads if the output files of the rovers are separated.
+*-----------------------------------------------------------------------------*/
 static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
                      const solopt_t *sopt, const filopt_t *fopt, int flag,
                      char **infile, const int *index, int n, char *outfile,
                      const char *rov)
 {
+    share_t *sh;
     gtime_t t0={0};
     int i,stat=0;
     char *ifile[MAXINFILE],ofile[1024],*rov_,*p,*q,s[64]="";
@@ -1061,11 +2271,26 @@ static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
                 return 0;
             }
         }
-        for (p=rov_;;p=q+1) { /* for each rover */
+        /* read data shared by rovers */
+        if (!(sh=(share_t *)calloc(1,sizeof(share_t)))||
+            !readshare(ts,te,ti,popt,fopt,infile,index,n,sh)) {
+            if (sh) freeshare(sh);
+            free(sh); free(rov_); for (i=0;i<n;i++) free(ifile[i]);
+            return 0;
+        }
+        share=sh;
+        
+        /* rovers on threads (not in threads of unit pool) */
+        if (popt->nthread>1&&!inpool&&strstr(outfile,"%r")&&strchr(rov,' ')) {
+            stat=execrovs(ts,te,ti,popt,sopt,fopt,flag,infile,index,n,outfile,
+                          rov);
+        }
+        else for (p=rov_;;p=q+1) { /* for each rover */
             if ((q=strchr(p,' '))) *q='\0';
             
             if (*p) {
                 strcpy(proc_rov,p);
+                pubsetrover(p);
                 if (ts.time) time2str(ts,s,0); else *s='\0';
                 if (checkbrk("reading    : %s",s)) {
                     stat=1;
@@ -1079,6 +2304,8 @@ static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             }
             if (stat==1||!q) break;
         }
+        share=NULL;
+        freeshare(sh); free(sh);
         free(rov_); for (i=0;i<n;i++) free(ifile[i]);
     }
     else {
@@ -1145,6 +2372,325 @@ static int execses_b(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
     
     return stat;
 }
+/* time span of rover observation data -----------------------------------------
+* time span of the first input file with observation data. rover keywords are
+* replaced by the first rover.
+*-----------------------------------------------------------------------------*/
+static int obsspan(char **infile, int n, const char *rov, gtime_t *ts,
+                   gtime_t *te)
+{
+    obs_t obs={0};
+    nav_t *nav;
+    gtime_t t0={0};
+    char rov_[64]="",path[1024];
+    int i,j;
+    
+    trace(3,"obsspan : n=%d\n",n);
+    
+    if (!(nav=(nav_t *)calloc(1,sizeof(nav_t)))) return 0;
+    
+    sscanf(rov,"%63s",rov_);
+    
+    /* first input file with observation data */
+    for (i=0;i<n&&obs.n<=0;i++) {
+        if (strstr(infile[i],"%r")) reppath(infile[i],path,t0,rov_,"");
+        else sprintf(path,"%.1023s",infile[i]);
+        if (strchr(path,'%')) continue;
+        readrnxt(path,1,t0,t0,0.0,"",&obs,nav,NULL);
+    }
+    for (i=0;i<obs.n;i++) if (obs.data[i].rcv==1) break;
+    for (j=obs.n-1;j>=0;j--) if (obs.data[j].rcv==1) break;
+    if (i<=j) {
+        if (ts->time==0) *ts=obs.data[i].time;
+        if (te->time==0) *te=obs.data[j].time;
+    }
+    freeobs(&obs);
+    freenav(nav,0xFF);
+    free(nav);
+    return i<=j;
+}
+/* temporary output file of processing unit to stdout ------------------------*/
+static void tmpunitfile(char *tfile, int nu)
+{
+    const char *dir;
+    
+#ifdef WIN32
+    if (!(dir=getenv("TEMP"))) dir=".";
+    sprintf(tfile,"%.900s\\postpos.%lu.%d.tmp",dir,GetCurrentProcessId(),nu);
+#else
+    if (!(dir=getenv("TMPDIR"))) dir="/tmp";
+    sprintf(tfile,"%.900s/postpos.%d.%d.tmp",dir,(int)getpid(),nu);
+#endif
+}
+/* append output of processing unit (file="": stdout) ------------------------*/
+static void appendfile(const char *file, const char *tfile, int trunc,
+                       long skip)
+{
+    FILE *ifp,*ofp;
+    char buff[65536];
+    size_t n;
+    
+    trace(3,"appendfile: file=%s tfile=%s\n",file,tfile);
+    
+    if (!(ifp=fopen(tfile,"rb"))) return;
+    
+    if (!(ofp=!*file?stdout:fopen(file,trunc?"wb":"ab"))) {
+        showmsg("error : open output file %s",file);
+        fclose(ifp);
+        return;
+    }
+    fseek(ifp,skip,SEEK_SET);
+    while ((n=fread(buff,1,sizeof(buff),ifp))>0) fwrite(buff,1,n,ofp);
+    if (ofp==stdout) fflush(ofp); else fclose(ofp);
+    fclose(ifp);
+    remove(tfile);
+}
+/* stitch output file of processing unit -------------------------------------*/
+static void stitchfile(const char *ofile, const char *tfile, int flag,
+                       const solopt_t *sopt)
+{
+    uint8_t buff[16];
+    char file[1024],sfile[1024];
+    long skip=0;
+    
+    appendfile(ofile,tfile,flag,0);
+    
+    if (sopt->sstat<=0) return;
+    
+    /* header of binary solution status only at start of file */
+    if (!flag&&sopt->posf==SOLF_BIN) skip=outsolbinh(buff,SOLB_STAT);
+    sprintf(file ,"%.1000s.stat",ofile);
+    sprintf(sfile,"%.1000s.stat",tfile);
+    appendfile(file,sfile,flag,skip);
+}
+/* stitch outputs of processing unit (for each rover) ------------------------*/
+static void stitchunit(const tunit_t *unit, const solopt_t *sopt,
+                       const char *rov)
+{
+    gtime_t t0={0};
+    char ofile[1024],tfile[1024],*rov_,*p,*q;
+    
+    if (!*unit->tfile) return;
+    
+    if (!strstr(unit->ofile,"%r")) {
+        stitchfile(unit->ofile,unit->tfile,unit->flag,sopt);
+        return;
+    }
+    if (!(rov_=(char *)malloc(strlen(rov)+1))) return;
+    strcpy(rov_,rov);
+    
+    for (p=rov_;;p=q+1) { /* for each rover */
+        if ((q=strchr(p,' '))) *q='\0';
+        
+        if (*p) {
+            reppath(unit->ofile,ofile,t0,p,"");
+            reppath(unit->tfile,tfile,t0,p,"");
+            stitchfile(ofile,tfile,unit->flag,sopt);
+        }
+        if (!q) break;
+    }
+    free(rov_);
+}
+/* execute processing unit ---------------------------------------------------*/
+static int execunit(tunit_t *unit, double ti, const prcopt_t *popt,
+                    const solopt_t *sopt, const filopt_t *fopt,
+                    const char *rov, const char *base, int capture)
+{
+    gtime_t t0={0};
+    char statfile[1024],*outfile=*unit->tfile?unit->tfile:unit->ofile;
+    int stat;
+    
+    trace(3,"execunit: ts=%s\n",time_str(unit->ts,0));
+    
+    /* output only in time span of unit (no warm-up) */
+    tsout=unit->ts;
+    teout=unit->te;
+    rtkstatspan(unit->ts,unit->te);
+    if (capture) unit->pub=pubopenunit(unit->ts,unit->te);
+    
+    /* solution status to temporary file (opened by rovers with keywords) */
+    if (*unit->tfile&&!unit->flag&&sopt->sstat>0&&!strstr(unit->tfile,"%r")) {
+        strcpy(statfile,unit->tfile);
+        strcat(statfile,".stat");
+        if (sopt->posf==SOLF_BIN) rtkopenstatb(statfile,sopt->sstat);
+        else rtkopenstat(statfile,sopt->sstat);
+    }
+    stat=execses_b(unit->tsr,unit->ter,ti,popt,sopt,fopt,unit->flag,
+                   unit->ifile,unit->index,unit->n,outfile,rov,base);
+    
+    if (*unit->tfile) rtkclosestat();
+    if (capture) pubcloseunit();
+    tsout=teout=t0;
+    rtkstatspan(t0,t0);
+    return stat;
+}
+/* processing unit thread ----------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI unitthread(void *arg)
+#else
+static void *unitthread(void *arg)
+#endif
+{
+    tpool_t *pool=(tpool_t *)arg;
+    tunit_t *unit;
+    int i,stat;
+    
+    inpool=1;
+    
+    for (;;) {
+        rtklib_lock(&pool->lock);
+        i=pool->next++;
+        rtklib_unlock(&pool->lock);
+        if (i>=pool->n) break;
+        
+        unit=pool->unit+i;
+        stat=pool->abort?1:execunit(unit,pool->ti,pool->popt,pool->sopt,
+                                    pool->fopt,pool->rov,pool->base,1);
+        rtklib_lock(&pool->lock);
+        unit->stat=stat;
+        unit->done=1;
+        if (stat==1) pool->abort=1;
+        condsignal(&pool->cond);
+        rtklib_unlock(&pool->lock);
+    }
+    /* free erp data of thread */
+    memacct(MEM_NAV,-(int64_t)sizeof(erpd_t)*navs.erp.nmax);
+    free(navs.erp.data); navs.erp.data=NULL; navs.erp.n=navs.erp.nmax=0;
+    inpool=0;
+    return 0;
+}
+/* execute processing units ----------------------------------------------------
+* execute processing units in time order or on a pool of threads
+* args   : tunit_t *unit    IO  processing units
+*          int    n         I   number of processing units
+*          (others are same as postpos())
+* return : status (0:ok,0>:error,1:aborted)
+* notes  : the products of multiple units (or of the unit of a shard) are
+*          captured and published in time order after each unit, so the
+*          message stream does not depend on the number of threads.
+*          the threads write the outputs of the units to temporary files. the
+*          main thread appends the outputs to the output files and publishes
+*          the products in time order of the units, as soon as the preceding
+*          units are processed.
+*-----------------------------------------------------------------------------*/
+static int execunits(tunit_t *unit, int n, double ti, const prcopt_t *popt,
+                     const solopt_t *sopt, const filopt_t *fopt,
+                     const char *rov, const char *base)
+{
+    tpool_t pool={0};
+    thread_t thread[MAXUNITTHR];
+    int i,nt=0,stat=0;
+    
+    trace(3,"execunits: n=%d nthread=%d\n",n,popt->nthread);
+    
+    if (popt->nthread<=1||n<=1) {
+        for (i=0;i<n;i++) {
+            stat=execunit(unit+i,ti,popt,sopt,fopt,rov,base,
+                          n>1||popt->nshard>1);
+            stitchunit(unit+i,sopt,rov);
+            pubemitunit(unit[i].pub); unit[i].pub=NULL;
+            if (stat==1) break;
+        }
+        return stat;
+    }
+    pool.unit=unit; pool.n=n; pool.ti=ti;
+    pool.popt=popt; pool.sopt=sopt; pool.fopt=fopt;
+    pool.rov=rov; pool.base=base;
+    initlock(&pool.lock);
+    initcond(&pool.cond);
+    
+    for (i=0;i<popt->nthread&&i<n&&i<MAXUNITTHR;i++) {
+#ifdef WIN32
+        if (!(thread[nt]=CreateThread(NULL,0,unitthread,&pool,0,NULL))) break;
+#else
+        if (pthread_create(thread+nt,NULL,unitthread,&pool)) break;
+#endif
+        nt++;
+    }
+    if (nt<=0) unitthread(&pool); /* no thread created */
+    
+    for (i=0;i<n;i++) {
+        rtklib_lock(&pool.lock);
+        while (!unit[i].done) condwait(&pool.cond,&pool.lock);
+        rtklib_unlock(&pool.lock);
+        
+        /* stitch outputs and publish products in time order of units */
+        stitchunit(unit+i,sopt,rov);
+        pubemitunit(unit[i].pub); unit[i].pub=NULL;
+        
+        if (unit[i].stat==1) stat=1;
+        else if (stat!=1) stat=unit[i].stat;
+    }
+    for (i=0;i<nt;i++) {
+#ifdef WIN32
+        WaitForSingleObject(thread[i],INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i],NULL);
+#endif
+    }
+    return stat;
+}
+/* free processing units -----------------------------------------------------*/
+static void freeunits(tunit_t *unit, int n)
+{
+    int i,j;
+    
+    for (i=0;i<n;i++) for (j=0;j<unit[i].n;j++) free(unit[i].ifile[j]);
+    free(unit);
+}
+/* select processing units of shard --------------------------------------------
+* select the consecutive processing units of the shard popt->ishard out of
+* popt->nshard shards and free the others
+*-----------------------------------------------------------------------------*/
+static int selshard(tunit_t *unit, int *n, const prcopt_t *popt)
+{
+    int i,j,i0,i1;
+    
+    i0=*n*popt->ishard/popt->nshard;
+    i1=*n*(popt->ishard+1)/popt->nshard;
+    
+    trace(3,"selshard: n=%d i0=%d i1=%d\n",*n,i0,i1);
+    
+    if (popt->ishard<0||popt->ishard>=popt->nshard||i0>=i1) {
+        showmsg("error : no processing unit of shard %d/%d",popt->ishard,
+                popt->nshard);
+        return 0;
+    }
+    for (i=0;i<*n;i++) {
+        if (i>=i0&&i<i1) continue;
+        for (j=0;j<unit[i].n;j++) free(unit[i].ifile[j]);
+    }
+    memmove(unit,unit+i0,sizeof(tunit_t)*(i1-i0));
+    *n=i1-i0;
+    unit[0].flag=1; /* new output file */
+    return 1;
+}
+/* output manifest of shard --------------------------------------------------*/
+static void outshard(const tunit_t *unit, int n, const prcopt_t *popt,
+                     const solopt_t *sopt)
+{
+    shard_t shard={0};
+    const char *p,*q;
+    char file[1024],bag[1024];
+    
+    p=(p=strrchr(unit[0].ofile,FILEPATHSEP))?p+1:unit[0].ofile;
+    q=(q=strrchr(pubbagfile(bag),FILEPATHSEP))?q+1:bag;
+    
+    shard.index=popt->ishard;
+    shard.count=popt->nshard;
+    shard.ts=unit[0].ts;
+    shard.te=unit[n-1].te;
+    shard.warmup=popt->tuwarm;
+    strcpy(shard.solfile,p);
+    if (sopt->sstat>0) sprintf(shard.statfile,"%.1000s.stat",p);
+    strcpy(shard.bagfile,q);
+    
+    sprintf(file,"%.1000s.shard",unit[0].ofile);
+    if (!saveshard(file,&shard,popt,sopt)) {
+        showmsg("error : open shard manifest %s",file);
+    }
+}
 /* post-processing positioning -------------------------------------------------
 * post-processing positioning
 * args   : gtime_t ts       I   processing start time (ts.time==0: no limit)
@@ -1187,22 +2733,49 @@ static int execses_b(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
 *          are output to a single output file.
 *
 *          ssr corrections are valid only for forward estimation.
+*
+*          if popt->nshard>1, only the processing units of the shard
+*          popt->ishard are processed (the units are split into popt->nshard
+*          consecutive shards, with tu=0 one unit per shard). the solutions
+*          are written in the binary format and a manifest of the shard is
+*          written to <outfile>.shard. the outputs of all shards are merged
+*          by the tool gnss_shardmerge.
 *-----------------------------------------------------------------------------*/
 extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
                    const prcopt_t *popt, const solopt_t *sopt,
                    const filopt_t *fopt, char **infile, int n, char *outfile,
                    const char *rov, const char *base)
 {
-    gtime_t tts,tte,ttte;
+    gtime_t tts,tte,ttte,tsr,ter;
+    tunit_t *unit=NULL,*unit_;
+    solopt_t sopt_=*sopt;
     double tunit,tss;
-    int i,j,k,nf,stat=0,week,flag=1,index[MAXINFILE]={0};
-    char *ifile[MAXINFILE],ofile[1024],*ext;
+    int i,j,k,nf,nu=0,nmax=0,stat=0,week,flag=1,rovs,shard=0;
+    int index[MAXINFILE]={0};
+    char *ifile[MAXINFILE],ofile[1024],msg[256],*ext;
     
     trace(3,"postpos : ti=%.0f tu=%.0f n=%d outfile=%s\n",ti,tu,n,outfile);
     
+    /* partial solutions of shard in binary format */
+    if (popt->nshard>1) {
+        if (!*outfile) {
+            showmsg("error : no output file of shard");
+            return -1;
+        }
+        sopt_.posf=SOLF_BIN;
+    }
     /* open processing session */
     if (!openses(popt,sopt,fopt,&navs,&pcvss,&pcvsr)) return -1;
     
+    /* time span of rover observation data for processing units */
+    if ((tu>0.0||popt->nshard>1)&&(ts.time==0||te.time==0)) {
+        if (!obsspan(infile,n,rov,&ts,&te)) ts.time=te.time=0;
+    }
+    if (popt->nshard>1&&(ts.time==0||te.time==0)) {
+        showmsg("error : no time span of shards");
+        closeses(&navs,&pcvss,&pcvsr);
+        return -1;
+    }
     if (ts.time!=0&&te.time!=0&&tu>=0.0) {
         if (timediff(te,ts)<0.0) {
             showmsg("error : no period");
@@ -1216,19 +2789,38 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
                 return -1;
             }
         }
+        /* one processing unit per shard */
+        if ((shard=popt->nshard>1&&tu==0.0)) {
+            tu=ceil((timediff(te,ts)+DTTOL)/popt->nshard);
+        }
         if (tu==0.0||tu>86400.0*MAXPRCDAYS) tu=86400.0*MAXPRCDAYS;
         settspan(ts,te);
+        tsproc=ts;
         tunit=tu<86400.0?tu:86400.0;
-        tss=tunit*(int)floor(time2gpst(ts,&week)/tunit);
+        
+        /* multiple rovers with rover keywords */
+        for (i=0;i<n;i++) if (strstr(infile[i],"%r")) break;
+        rovs=i<n&&strchr(rov,' ');
+        
+        /* units of shards start at ts (no extra unit by alignment to tu) */
+        tss=time2gpst(ts,&week);
+        if (!shard) tss=tunit*(int)floor(tss/tunit);
         
         for (i=0;;i++) { /* for each periods */
             tts=gpst2time(week,tss+i*tu);
             tte=timeadd(tts,tu-DTTOL);
-            if (timediff(tts,te)>0.0) break;
+            if (timediff(tts,te)>0.0||(shard&&i>=popt->nshard)) break;
             if (timediff(tts,ts)<0.0) tts=ts;
             if (timediff(tte,te)>0.0) tte=te;
             
+            /* warm-up of filters before and after period */
+            tsr=timeadd(tts,-popt->tuwarm);
+            ter=timeadd(tte, popt->tuwarm);
+            if (timediff(tsr,ts)<0.0) tsr=ts;
+            if (timediff(ter,te)>0.0) ter=te;
+            
             strcpy(proc_rov ,"");
+            pubsetrover("");
             strcpy(proc_base,"");
             if (checkbrk("reading    : %s",time_str(tts,0))) {
                 stat=1;
@@ -1243,7 +2835,7 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
                 }
                 else {
                     /* include next day precise ephemeris or rinex brdc nav */
-                    ttte=tte;
+                    ttte=ter;
                     if (ext&&(!strcmp(ext,".sp3")||!strcmp(ext,".SP3")||
                               !strcmp(ext,".eph")||!strcmp(ext,".EPH"))) {
                         ttte=timeadd(ttte,3600.0);
@@ -1251,7 +2843,7 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
                     else if (strstr(infile[j],"brdc")) {
                         ttte=timeadd(ttte,7200.0);
                     }
-                    nf+=reppaths(infile[j],ifile+nf,MAXINFILE-nf,tts,ttte,"","");
+                    nf+=reppaths(infile[j],ifile+nf,MAXINFILE-nf,tsr,ttte,"","");
                 }
                 while (k<nf) index[k++]=j;
                 
@@ -1262,13 +2854,51 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
             }
             if (!reppath(outfile,ofile,tts,"","")&&i>0) flag=0;
             
-            /* execute processing session */
-            stat=execses_b(tts,tte,ti,popt,sopt,fopt,flag,ifile,index,nf,ofile,
-                           rov,base);
+            /* add processing unit */
+            if (nu>=nmax) {
+                nmax=nmax<=0?16:nmax*2;
+                if (!(unit_=(tunit_t *)realloc(unit,sizeof(tunit_t)*nmax))) {
+                    showmsg("error : memory allocation");
+                    stat=-1;
+                    break;
+                }
+                unit=unit_;
+            }
+            memset(unit+nu,0,sizeof(tunit_t));
+            unit[nu].ts=tts; /* next unit starts at te+DTTOL */
+            unit[nu].te=timeadd(gpst2time(week,tss+(i+1)*tu),-DTTOL);
+            if (shard&&timediff(unit[nu].te,te)>0.0) unit[nu].te=te;
+            unit[nu].tsr=tsr; unit[nu].ter=ter;
+            for (j=0;j<nf;j++) {
+                if (!(unit[nu].ifile[j]=(char *)malloc(strlen(ifile[j])+1))) break;
+                strcpy(unit[nu].ifile[j],ifile[j]);
+                unit[nu].index[j]=index[j];
+                unit[nu].n++;
+            }
+            strcpy(unit[nu].ofile,ofile);
             
-            if (stat==1) break;
+            /* outputs of parallel units or rovers to temporary files */
+            if ((popt->nthread>1||rovs)&&*ofile) {
+                sprintf(unit[nu].tfile,"%.1000s.%d.tmp",ofile,nu);
+            }
+            else if (popt->nthread>1) { /* stitched to stdout */
+                tmpunitfile(unit[nu].tfile,nu);
+            }
+            unit[nu++].flag=flag;
         }
         for (i=0;i<MAXINFILE;i++) free(ifile[i]);
+        
+        /* processing units of shard */
+        if (stat>=0&&popt->nshard>1&&!selshard(unit,&nu,popt)) stat=-1;
+        
+        /* execute processing units */
+        if (stat>=0) {
+            k=execunits(unit,nu,ti,popt,&sopt_,fopt,rov,base);
+            if (stat==0) stat=k;
+        }
+        if (stat==0&&popt->nshard>1) outshard(unit,nu,popt,sopt);
+        freeunits(unit,nu);
+        tsproc.time=0;
     }
     else if (ts.time!=0) {
         for (i=0;i<n&&i<MAXINFILE;i++) {
@@ -1297,5 +2927,11 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
     /* close processing session */
     closeses(&navs,&pcvss,&pcvsr);
     
+    /* report memory of subsystems */
+    memreport(msg);
+    trace(2,"postpos : memory %s\n",msg);
+    showmsg("memory (current/peak): %s",msg);
+    pubmemory(1);
+    
     return stat;
 }
@@ -344,7 +344,7 @@ static void initx(rtk_t *rtk, double xi, double var, int i)
     }
 }
 /* geometry-free phase measurement -------------------------------------------*/
-static double gfmeas(const obsd_t *obs, const nav_t *nav)
+extern double gfmeas(const obsd_t *obs, const nav_t *nav)
 {
     double freq1,freq2;
 
@@ -354,7 +354,7 @@ static double gfmeas(const obsd_t *obs, const nav_t *nav)
     return (obs->L[0]/freq1-obs->L[1]/freq2)*CLIGHT;
 }
 /* Melbourne-Wubbena linear combination --------------------------------------*/
-static double mwmeas(const obsd_t *obs, const nav_t *nav)
+extern double mwmeas(const obsd_t *obs, const nav_t *nav)
 {
     double freq1,freq2;
 
@@ -390,6 +390,8 @@ static void corr_meas(const obsd_t *obs, const nav_t *nav, const double *azel,
             if (obs->code[i]==CODE_L1C) P[i]+=nav->cbias[obs->sat-1][1];
             if (obs->code[i]==CODE_L2C) P[i]+=nav->cbias[obs->sat-1][2];
         }
+        /* satellite code bias correction by ssr or observable-specific bias */
+        P[i]-=nav->ssr[obs->sat-1].cbias[obs->code[i]-1];
     }
     /* iono-free LC */
     *Lc=*Pc=0.0;
@@ -467,7 +469,7 @@ static void detslp_mw(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 /* temporal update of position -----------------------------------------------*/
 static void udpos_ppp(rtk_t *rtk)
 {
-    double *F,*P,*FP,*x,*xp,pos[3],Q[9]={0},Qv[9];
+    double *FP,tt,tt2,p,pos[3],Q[9]={0},Qv[9];
     int i,j,*ix,nx;
     
     trace(3,"udpos_ppp:\n");
@@ -508,31 +510,32 @@ static void udpos_ppp(rtk_t *rtk)
         free(ix);
         return;
     }
-    /* state transition of position/velocity/acceleration */
-    F=eye(nx); P=mat(nx,nx); FP=mat(nx,nx); x=mat(nx,1); xp=mat(nx,1);
-    
-    for (i=0;i<6;i++) {
-        F[i+(i+3)*nx]=rtk->tt;
+    /* state transition of position/velocity/acceleration: x=F*x, P=F*P*F'
+       (F=I except rows of position/velocity, only their rows/columns of P
+       are changed) */
+    tt=rtk->tt; tt2=SQR(rtk->tt)/2.0;
+    FP=mat(6,nx);
+    for (i=0;i<6;i++) for (j=0;j<nx;j++) {
+        FP[i+j*6]=rtk->P[ix[i]+ix[j]*rtk->nx]+tt*rtk->P[ix[i+3]+ix[j]*rtk->nx];
+        if (i<3) FP[i+j*6]+=tt2*rtk->P[ix[i+6]+ix[j]*rtk->nx];
     }
-    for (i=0;i<3;i++) {
-        F[i+(i+6)*nx]=SQR(rtk->tt)/2.0;
+    for (i=0;i<6;i++) {
+        rtk->x[ix[i]]+=tt*rtk->x[ix[i+3]];
+        if (i<3) rtk->x[ix[i]]+=tt2*rtk->x[ix[i+6]];
     }
-    for (i=0;i<nx;i++) {
-        x[i]=rtk->x[ix[i]];
-        for (j=0;j<nx;j++) {
-            P[i+j*nx]=rtk->P[ix[i]+ix[j]*rtk->nx];
+    for (i=0;i<nx;i++) for (j=0;j<6;j++) {
+        if (i<6) {
+            p=FP[i+j*6]+tt*FP[i+(j+3)*6];
+            if (j<3) p+=tt2*FP[i+(j+6)*6];
         }
-    }
-    /* x=F*x, P=F*P*F+Q */
-    matmul("NN",nx,1,nx,1.0,F,x,0.0,xp);
-    matmul("NN",nx,nx,nx,1.0,F,P,0.0,FP);
-    matmul("NT",nx,nx,nx,1.0,FP,F,0.0,P);
-    
-    for (i=0;i<nx;i++) {
-        rtk->x[ix[i]]=xp[i];
-        for (j=0;j<nx;j++) {
-            rtk->P[ix[i]+ix[j]*rtk->nx]=P[i+j*nx];
+        else {
+            p=rtk->P[ix[i]+ix[j]*rtk->nx]+tt*rtk->P[ix[i]+ix[j+3]*rtk->nx];
+            if (j<3) p+=tt2*rtk->P[ix[i]+ix[j+6]*rtk->nx];
         }
+        rtk->P[ix[i]+ix[j]*rtk->nx]=p;
+    }
+    for (i=0;i<6;i++) for (j=6;j<nx;j++) {
+        rtk->P[ix[i]+ix[j]*rtk->nx]=FP[i+j*6];
     }
     /* process noise added to only acceleration */
     Q[0]=Q[4]=SQR(rtk->opt.prn[3])*fabs(rtk->tt);
@@ -542,7 +545,7 @@ static void udpos_ppp(rtk_t *rtk)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    free(ix); free(FP);
 }
 /* temporal update of clock --------------------------------------------------*/
 static void udclk_ppp(rtk_t *rtk)
@@ -670,11 +673,13 @@ static void udbias_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     
     for (f=0;f<NF(&rtk->opt);f++) {
         
-        /* reset phase-bias if expire obs outage counter */
+        /* reset phase-bias if expire obs outage counter (skip reset ones) */
         for (i=0;i<MAXSAT;i++) {
-            if (++rtk->ssat[i].outc[f]>(uint32_t)rtk->opt.maxout||
-                rtk->opt.modear==ARMODE_INST||clk_jump) {
-                initx(rtk,0.0,0.0,IB(i+1,f,&rtk->opt));
+            j=IB(i+1,f,&rtk->opt);
+            if ((++rtk->ssat[i].outc[f]>(uint32_t)rtk->opt.maxout||
+                 rtk->opt.modear==ARMODE_INST||clk_jump)&&
+                (rtk->x[j]!=0.0||rtk->P[j+j*rtk->nx]!=0.0)) {
+                initx(rtk,0.0,0.0,j);
             }
         }
         for (i=k=0;i<n&&i<MAXOBS;i++) {
@@ -854,21 +859,29 @@ static int model_iono(gtime_t time, const double *pos, const double *azel,
     }
     return 0;
 }
-/* phase and code residuals --------------------------------------------------*/
+/* set design matrix element of active state ---------------------------------*/
+static void seth(double *h, const int *jx, int i, double hi)
+{
+    if (jx[i]>=0) h[jx[i]]=hi;
+}
+/* phase and code residuals ----------------------------------------------------
+* notes  : H is the design matrix of the active states (na x nv), jx[i] is the
+*          index of state i in the active states (-1: not active)
+*-----------------------------------------------------------------------------*/
 static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                    const double *dts, const double *var_rs, const int *svh,
                    const double *dr, int *exc, const nav_t *nav,
-                   const double *x, rtk_t *rtk, double *v, double *H, double *R,
-                   double *azel)
+                   const double *x, const int *jx, int na, rtk_t *rtk,
+                   double *v, double *H, double *R, double *azel)
 {
     prcopt_t *opt=&rtk->opt;
     double y,r,cdtr,bias,C=0.0,rr[3],pos[3],e[3],dtdx[3],L[NFREQ],P[NFREQ],Lc,Pc;
     double var[MAXOBS*2],dtrp=0.0,dion=0.0,vart=0.0,vari=0.0,dcb,freq;
     double dantr[NFREQ]={0},dants[NFREQ]={0};
-    double ve[MAXOBS*2*NFREQ]={0},vmax=0;
+    double ve[MAXOBS*2*NFREQ]={0},vmax=0,*h;
     char str[32];
     int ne=0,obsi[MAXOBS*2*NFREQ]={0},frqi[MAXOBS*2*NFREQ],maxobs,maxfrq,rej;
-    int i,j,k,sat,sys,nv=0,nx=rtk->nx,stat=1;
+    int i,j,k,sat,sys,nv=0,stat=1;
     
     time2str(obs[0].time,str,2);
     
@@ -922,7 +935,9 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                 if ((freq=sat2freq(sat,obs[i].code[j/2],nav))==0.0) continue;
                 C=SQR(FREQ1/freq)*ionmapf(pos,azel+i*2)*(j%2==0?-1.0:1.0);
             }
-            for (k=0;k<nx;k++) H[k+nx*nv]=k<3?-e[k]:0.0;
+            h=H+na*nv;
+            for (k=0;k<na;k++) h[k]=0.0;
+            for (k=0;k<3;k++) seth(h,jx,k,-e[k]);
             
             /* receiver clock */
             switch (sys) {
@@ -933,24 +948,24 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                 default:      k=0; break;
             }
             cdtr=x[IC(k,opt)];
-            H[IC(k,opt)+nx*nv]=1.0;
+            seth(h,jx,IC(k,opt),1.0);
             
             if (opt->tropopt==TROPOPT_EST||opt->tropopt==TROPOPT_ESTG) {
                 for (k=0;k<(opt->tropopt>=TROPOPT_ESTG?3:1);k++) {
-                    H[IT(opt)+k+nx*nv]=dtdx[k];
+                    seth(h,jx,IT(opt)+k,dtdx[k]);
                 }
             }
             if (opt->ionoopt==IONOOPT_EST) {
                 if (rtk->x[II(sat,opt)]==0.0) continue;
-                H[II(sat,opt)+nx*nv]=C;
+                seth(h,jx,II(sat,opt),C);
             }
             if (j/2==2&&j%2==1) { /* L5-receiver-dcb */
                 dcb+=rtk->x[ID(opt)];
-                H[ID(opt)+nx*nv]=1.0;
+                seth(h,jx,ID(opt),1.0);
             }
             if (j%2==0) { /* phase bias */
                 if ((bias=x[IB(sat,j/2,opt)])==0.0) continue;
-                H[IB(sat,j/2,opt)+nx*nv]=1.0;
+                seth(h,jx,IB(sat,j/2,opt),1.0);
             }
             /* residual */
             v[nv]=y-(r+cdtr-CLIGHT*dts[i*2]+dtrp+C*dion+dcb+bias);
@@ -1075,24 +1090,92 @@ static int test_hold_amb(rtk_t *rtk)
     /* test # of continuous fixed */
     return ++rtk->nfix>=rtk->opt.minfix;
 }
-/* precise point positioning -------------------------------------------------*/
+/* active states -------------------------------------------------------------*/
+static int active_states(const rtk_t *rtk, int *ix, int *jx)
+{
+    int i,na=0;
+    
+    for (i=0;i<rtk->nx;i++) {
+        if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) {
+            if (ix) ix[na]=i;
+            if (jx) jx[i]=na;
+            na++;
+        }
+        else if (jx) jx[i]=-1;
+    }
+    return na;
+}
+/* gather/scatter active states ----------------------------------------------*/
+static void get_active(const double *x, const double *P, int nx, const int *ix,
+                       int na, double *xa, double *Pa)
+{
+    int i,j;
+    
+    for (i=0;i<na;i++) xa[i]=x[ix[i]];
+    for (j=0;j<na;j++) for (i=0;i<na;i++) Pa[i+j*na]=P[ix[i]+ix[j]*nx];
+}
+static void put_active(const double *xa, const double *Pa, const int *ix,
+                       int na, int nx, double *x, double *P)
+{
+    int i,j;
+    
+    for (i=0;i<na;i++) x[ix[i]]=xa[i];
+    for (j=0;j<na;j++) for (i=0;i<na;i++) P[ix[i]+ix[j]*nx]=Pa[i+j*na];
+}
+/* work buffer of ppp --------------------------------------------------------*/
+static void *workbuf(rtk_t *rtk, size_t size)
+{
+    void *p;
+    
+    if (size>rtk->nwork) {
+        if (!(p=realloc(rtk->work,size))) return NULL;
+        memacct(MEM_FILT,(int64_t)size-(int64_t)rtk->nwork);
+        rtk->work=p;
+        rtk->nwork=size;
+    }
+    return rtk->work;
+}
+/* precise point positioning ---------------------------------------------------
+* notes  : the filter is updated for the active states (x[i]!=0 and P[i,i]>0)
+*          only. the active states and their covariance are gathered from
+*          rtk->x/P, rolled back by gathering them again for a rejected
+*          iteration and scattered to rtk->x/P when the solution is accepted.
+*          the cost per epoch is proportional to the number of the active
+*          states instead of the number of states. rtk->Pa is updated for
+*          the active states only. the buffers are kept in rtk->work.
+*-----------------------------------------------------------------------------*/
 extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
     const prcopt_t *opt=&rtk->opt;
-    double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*Pp,dr[3]={0},std[3];
+    double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*xs,*Ps,dr[3]={0},std[3];
     char str[32];
-    int i,j,nv,info,svh[MAXOBS],exc[MAXOBS]={0},stat=SOLQ_SINGLE;
+    int i,j,k,na,nv,nx=rtk->nx,info,*ix,*jx,svh[MAXOBS],exc[MAXOBS]={0};
+    int stat=SOLQ_SINGLE,fix=0;
     
     time2str(obs[0].time,str,2);
     trace(3,"pppos   : time=%s nx=%d n=%d\n",str,rtk->nx,n);
     
-    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); azel=zeros(2,n);
-    
     for (i=0;i<MAXSAT;i++) for (j=0;j<opt->nf;j++) rtk->ssat[i].fix[j]=0;
     
     /* temporal update of ekf states */
     udstate_ppp(rtk,obs,n,nav);
     
+    /* work buffers for active states */
+    na=active_states(rtk,NULL,NULL);
+    nv=n*opt->nf*2;
+    if (!(rs=(double *)workbuf(rtk,sizeof(double)*(11*n+nx+na+na*na+nv+na*nv+
+                                                   nv*nv)+
+                                   sizeof(int)*(na+nx)))) {
+        trace(2,"%s ppp work buffer allocation error\n",str);
+        return;
+    }
+    dts=rs+6*n; var=dts+2*n; azel=var+n; xp=azel+2*n; xs=xp+nx; Ps=xs+na;
+    v=Ps+na*na; H=v+nv; R=H+na*nv; ix=(int *)(R+nv*nv); jx=ix+na;
+    active_states(rtk,ix,jx);
+    for (i=0;i<2*n;i++) azel[i]=0.0;
+    
+    trace(3,"%s ppp active states na=%d\n",str,na);
+    
     /* satellite positions and clocks */
     satposs(obs[0].time,obs,n,nav,rtk->opt.sateph,rs,dts,var,svh);
     
@@ -1105,29 +1188,29 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         tidedisp(gpst2utc(obs[0].time),rtk->x,opt->tidecorr==1?1:7,&nav->erp,
                  opt->odisp[0],dr);
     }
-    nv=n*rtk->opt.nf*2+MAXSAT+3;
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx);
-    v=mat(nv,1); H=mat(rtk->nx,nv); R=mat(nv,nv);
-    
     for (i=0;i<MAX_ITER;i++) {
         
-        matcpy(xp,rtk->x,rtk->nx,1);
-        matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
+        /* active states of prior (roll back rejected iteration) */
+        matcpy(xp,rtk->x,nx,1);
+        get_active(rtk->x,rtk->P,nx,ix,na,xs,Ps);
         
         /* prefit residuals */
-        if (!(nv=ppp_res(0,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel))) {
+        if (!(nv=ppp_res(0,obs,n,rs,dts,var,svh,dr,exc,nav,xp,jx,na,rtk,v,H,R,
+                         azel))) {
             trace(2,"%s ppp (%d) no valid obs data\n",str,i+1);
             break;
         }
         /* measurement update of ekf states */
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        if ((info=filter(xs,Ps,H,v,R,na,nv))) {
             trace(2,"%s ppp (%d) filter error info=%d\n",str,i+1,info);
             break;
         }
+        for (k=0;k<na;k++) xp[ix[k]]=xs[k];
+        
         /* postfit residuals */
-        if (ppp_res(i+1,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel)) {
-            matcpy(rtk->x,xp,rtk->nx,1);
-            matcpy(rtk->P,Pp,rtk->nx,rtk->nx);
+        if (ppp_res(i+1,obs,n,rs,dts,var,svh,dr,exc,nav,xp,jx,na,rtk,v,H,R,
+                    azel)) {
+            put_active(xs,Ps,ix,na,nx,rtk->x,rtk->P);
             stat=SOLQ_PPP;
             break;
         }
@@ -1138,13 +1221,16 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     if (stat==SOLQ_PPP) {
         
         /* ambiguity resolution in ppp */
-        if (ppp_ar(rtk,obs,n,exc,nav,azel,xp,Pp)&&
-            ppp_res(9,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel)) {
-            
-            matcpy(rtk->xa,xp,rtk->nx,1);
-            matcpy(rtk->Pa,Pp,rtk->nx,rtk->nx);
+        if (ppp_ar(rtk,obs,n,exc,nav,azel,jx,na,xs,Ps)) {
+            for (k=0;k<na;k++) xp[ix[k]]=xs[k];
+            fix=ppp_res(9,obs,n,rs,dts,var,svh,dr,exc,nav,xp,jx,na,rtk,v,H,R,
+                        azel);
+        }
+        if (fix) {
+            matcpy(rtk->xa,xp,nx,1);
+            put_active(xs,Ps,ix,na,nx,rtk->xa,rtk->Pa);
             
-            for (i=0;i<3;i++) std[i]=sqrt(Pp[i+i*rtk->nx]);
+            for (i=0;i<3;i++) std[i]=sqrt(rtk->Pa[i+i*nx]);
             if (norm(std,3)<MAX_STD_FIX) stat=SOLQ_FIX;
         }
         else {
@@ -1155,12 +1241,9 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         
         /* hold fixed ambiguities */
         if (stat==SOLQ_FIX&&test_hold_amb(rtk)) {
-            matcpy(rtk->x,xp,rtk->nx,1);
-            matcpy(rtk->P,Pp,rtk->nx,rtk->nx);
+            put_active(xs,Ps,ix,na,nx,rtk->x,rtk->P);
             trace(2,"%s hold ambiguity\n",str);
             rtk->nfix=0;
         }
     }
-    free(rs); free(dts); free(var); free(azel);
-    free(xp); free(Pp); free(v); free(H); free(R);
 }
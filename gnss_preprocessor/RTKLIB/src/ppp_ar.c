@@ -4,18 +4,317 @@
 * reference :
 *    [1] H.Okumura, C-gengo niyoru saishin algorithm jiten (in Japanese),
 *        Software Technology, 1991
+*    [2] M.Ge, G.Gendt, M.Rothacher, C.Shi, J.Liu, Resolution of GPS
+*        carrier-phase ambiguities in precise point positioning (PPP) with
+*        daily observations, Journal of Geodesy, 82, 2008
 *
 *          Copyright (C) 2012-2015 by T.TAKASU, All rights reserved.
 *
+* notes  : the ambiguities are fixed as single-differences between satellites
+*          of a system (the receiver biases cancel). the satellite phase and
+*          code biases must be given by ssr corrections or a SINEX-BIAS file
+*          (observable-specific biases, see readdcb()), the phase biases are
+*          corrected in the observation data and the code biases are
+*          corrected in the measurement model.
+*
+*          ionoopt=IONOOPT_IFLC:
+*            the wide-lane ambiguities are fixed by rounding the averaged
+*            Melbourne-Wubbena combinations, the narrow-lane ambiguities of the
+*            iono-free phase-biases are fixed by LAMBDA [2].
+*          other ionoopt:
+*            the ambiguities of the phase-biases of each frequency are fixed
+*            by LAMBDA. with 2 or more frequencies, only satellites with fixed
+*            wide-lane ambiguities are used.
+*
+*          ambc[sat-1].LC[0],LCv[0],n[0],epoch[0] hold the average, variance,
+*          number of epochs and last epoch of the Melbourne-Wubbena
+*          combination (cycle).
+*
 * version : $Revision:$ $Date:$
 * history : 2013/03/11  1.0  new
 *           2016/05/10  1.1  delete codes
+*           2026/10/17  1.2  wide-lane/narrow-lane ambiguity resolution
 *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
 
-/* ambiguity resolution in ppp -----------------------------------------------*/
+#define SQR(x)      ((x)*(x))
+#define ROUND(x)    floor((x)+0.5)
+
+#define MIN_NEP_WL  20              /* min epochs of averaged wide-lane */
+#define MAX_GAP_WL  60.0            /* max gap of averaged wide-lane (s) */
+#define MAX_FRAC_WL 0.25            /* max fraction to fix wide-lane (cycle) */
+#define MAX_STD_WL  0.15            /* max std-dev to fix wide-lane (cycle) */
+#define MIN_NAMB    3               /* min number of ambiguities to fix */
+#define MAX_DROP    4               /* max ambiguities excluded to pass ratio */
+#define VAR_HOLDAMB 0.001           /* variance of fixed ambiguity (cycle^2) */
+
+#define SYS_AR      (SYS_GPS|SYS_GAL|SYS_QZS|SYS_CMP) /* systems for ar */
+
+#define NF(opt)     ((opt)->ionoopt==IONOOPT_IFLC?1:(opt)->nf)
+#define IB(s,f,opt) (pppnx(opt)-MAXSAT*(NF(opt)-(f))+(s)-1)
+
+typedef struct {        /* single-differenced ambiguity type */
+    int sat1,sat2;      /* reference/target satellite number */
+    int f;              /* frequency index of phase-bias */
+    double lam;         /* wavelength of ambiguity (m) */
+    double offset;      /* offset of phase-bias (m) */
+    double el;          /* elevation angle of target satellite (rad) */
+} sdamb_t;
+
+/* frequencies of satellite (0:no frequency) ---------------------------------*/
+static int sat_freq(const obsd_t *obs, const nav_t *nav, int nf, double *freq)
+{
+    int i;
+    
+    for (i=0;i<nf;i++) {
+        if ((freq[i]=sat2freq(obs->sat,obs->code[i],nav))==0.0) return 0;
+    }
+    return 1;
+}
+/* average Melbourne-Wubbena combinations ------------------------------------*/
+static void average_mw(rtk_t *rtk, const obsd_t *obs, int n, const int *exc,
+                       const nav_t *nav)
+{
+    ambc_t *amb;
+    obsd_t obsc;
+    double freq[2],mw,d;
+    int i,sat;
+    
+    for (i=0;i<n&&i<MAXOBS;i++) {
+        sat=obs[i].sat;
+        amb=rtk->ambc+sat-1;
+        if (exc[i]||!sat_freq(obs+i,nav,2,freq)) continue;
+        
+        /* code bias correction */
+        obsc=obs[i];
+        obsc.P[0]-=nav->ssr[sat-1].cbias[obsc.code[0]-1];
+        obsc.P[1]-=nav->ssr[sat-1].cbias[obsc.code[1]-1];
+        
+        if ((mw=mwmeas(&obsc,nav))==0.0) continue;
+        mw/=CLIGHT/(freq[0]-freq[1]); /* (m) -> (cycle) */
+        
+        if (amb->n[0]<=0||rtk->ssat[sat-1].slip[0]||rtk->ssat[sat-1].slip[1]||
+            fabs(timediff(obs[i].time,amb->epoch[0]))>MAX_GAP_WL) {
+            amb->n[0]=1;
+            amb->LC[0]=mw;
+            amb->LCv[0]=0.0;
+        }
+        else {
+            d=mw-amb->LC[0];
+            amb->n[0]++;
+            amb->LC [0]+=d/amb->n[0];
+            amb->LCv[0]+=(d*(mw-amb->LC[0])-amb->LCv[0])/amb->n[0];
+        }
+        amb->epoch[0]=obs[i].time;
+    }
+}
+/* fix single-differenced wide-lane ambiguity --------------------------------*/
+static int fix_wl(const rtk_t *rtk, int sat1, int sat2, double *Nw)
+{
+    const ambc_t *amb1=rtk->ambc+sat1-1,*amb2=rtk->ambc+sat2-1;
+    double Bw,std;
+    
+    if (amb1->n[0]<MIN_NEP_WL||amb2->n[0]<MIN_NEP_WL) return 0;
+    
+    Bw=amb2->LC[0]-amb1->LC[0];
+    std=sqrt(amb1->LCv[0]/amb1->n[0]+amb2->LCv[0]/amb2->n[0]);
+    *Nw=ROUND(Bw);
+    
+    trace(4,"fix_wl : sat=%3d-%3d Bw=%8.3f std=%6.3f\n",sat1,sat2,Bw,std);
+    
+    return fabs(Bw-*Nw)<=MAX_FRAC_WL&&std<=MAX_STD_WL;
+}
+/* test satellite for ambiguity resolution -----------------------------------*/
+static int test_sat(const rtk_t *rtk, const obsd_t *obs, const nav_t *nav,
+                    const double *azel, const int *jx)
+{
+    const prcopt_t *opt=&rtk->opt;
+    int f,sat=obs->sat,nf=opt->ionoopt==IONOOPT_IFLC?2:opt->nf;
+    
+    if (!(satsys(sat,NULL)&SYS_AR)||azel[1]<opt->elmaskar) return 0;
+    if ((int)rtk->ssat[sat-1].lock[0]<opt->minlock) return 0;
+    
+    for (f=0;f<nf;f++) {
+        if (obs->code[f]==CODE_NONE) return 0;
+        
+        /* satellite phase bias available */
+        if (nav->ssr[sat-1].pbias[obs->code[f]-1]==0.0) return 0;
+    }
+    for (f=0;f<NF(opt);f++) {
+        if (!rtk->ssat[sat-1].vsat[f]||jx[IB(sat,f,opt)]<0) return 0;
+    }
+    return 1;
+}
+/* select single-differenced ambiguities -------------------------------------*/
+static int sel_amb(const rtk_t *rtk, const obsd_t *obs, int n, const int *exc,
+                   const nav_t *nav, const double *azel, const int *jx,
+                   sdamb_t *amb)
+{
+    const prcopt_t *opt=&rtk->opt;
+    const int sys[]={SYS_GPS,SYS_GAL,SYS_QZS,SYS_CMP,0};
+    sdamb_t tmp;
+    double freq1[NFREQ],freq2[NFREQ],Nw=0.0,C;
+    int i,j,k,f,m,ref,na=0,nf=opt->ionoopt==IONOOPT_IFLC?2:opt->nf;
+    
+    for (m=0;sys[m];m++) {
+        
+        /* reference satellite with max elevation */
+        for (i=0,ref=-1;i<n&&i<MAXOBS;i++) {
+            if (exc[i]||satsys(obs[i].sat,NULL)!=sys[m]) continue;
+            if (!test_sat(rtk,obs+i,nav,azel+i*2,jx)) continue;
+            if (nf>=2&&rtk->ambc[obs[i].sat-1].n[0]<MIN_NEP_WL) continue;
+            if (ref<0||azel[1+i*2]>azel[1+ref*2]) ref=i;
+        }
+        if (ref<0||!sat_freq(obs+ref,nav,nf,freq1)) continue;
+        
+        for (i=0;i<n&&i<MAXOBS;i++) {
+            if (i==ref||exc[i]||satsys(obs[i].sat,NULL)!=sys[m]) continue;
+            if (!test_sat(rtk,obs+i,nav,azel+i*2,jx)) continue;
+            if (!sat_freq(obs+i,nav,nf,freq2)) continue;
+            
+            for (f=0;f<nf;f++) if (freq1[f]!=freq2[f]) break;
+            if (f<nf) continue;
+            
+            /* wide-lane ambiguity */
+            if (nf>=2&&!fix_wl(rtk,obs[ref].sat,obs[i].sat,&Nw)) continue;
+            
+            for (f=0;f<NF(opt);f++) {
+                amb[na].sat1=obs[ref].sat;
+                amb[na].sat2=obs[i].sat;
+                amb[na].f=f;
+                amb[na].el=azel[1+i*2];
+                
+                if (opt->ionoopt==IONOOPT_IFLC) {
+                    
+                    /* narrow-lane ambiguity of iono-free phase-bias [2] */
+                    C=SQR(freq1[0])-SQR(freq1[1]);
+                    amb[na].lam=CLIGHT/(freq1[0]+freq1[1]);
+                    amb[na].offset=CLIGHT*freq1[1]/C*Nw;
+                }
+                else {
+                    amb[na].lam=CLIGHT/freq1[f];
+                    amb[na].offset=0.0;
+                }
+                na++;
+            }
+        }
+    }
+    /* sort by elevation angle (descending) */
+    for (i=1;i<na;i++) for (j=i;j>0&&amb[j].el>amb[j-1].el;j--) {
+        tmp=amb[j]; amb[j]=amb[j-1]; amb[j-1]=tmp;
+    }
+    for (k=0;k<na;k++) {
+        trace(4,"sel_amb: sat=%3d-%3d f=%d lam=%.4f offset=%.4f\n",amb[k].sat1,
+              amb[k].sat2,amb[k].f,amb[k].lam,amb[k].offset);
+    }
+    return na;
+}
+/* fix single-differenced ambiguities by lambda ------------------------------*/
+static int fix_amb(rtk_t *rtk, const sdamb_t *amb, int na, const int *jx,
+                   int nx, double *x, double *P)
+{
+    const prcopt_t *opt=&rtk->opt;
+    double *a,*Q,*F,*H,*v,*R,s[2],lami,lamj;
+    int k,l,m,ik,jk,il,jl,info,stat=0;
+    
+    a=mat(na,1); Q=mat(na,na); F=mat(na,2);
+    
+    /* exclude ambiguities of low elevation until ratio-test passed */
+    for (m=na;m>=MIN_NAMB&&m>=na-MAX_DROP;m--) {
+        
+        for (k=0;k<m;k++) {
+            ik=jx[IB(amb[k].sat2,amb[k].f,opt)];
+            jk=jx[IB(amb[k].sat1,amb[k].f,opt)];
+            lami=amb[k].lam;
+            a[k]=(x[ik]-x[jk]-amb[k].offset)/lami;
+            
+            for (l=0;l<m;l++) {
+                il=jx[IB(amb[l].sat2,amb[l].f,opt)];
+                jl=jx[IB(amb[l].sat1,amb[l].f,opt)];
+                lamj=amb[l].lam;
+                Q[k+l*m]=(P[ik+il*nx]-P[ik+jl*nx]-P[jk+il*nx]+P[jk+jl*nx])/
+                         (lami*lamj);
+            }
+        }
+        if ((info=lambda(m,2,a,Q,F,s))) {
+            trace(2,"ppp_ar lambda error info=%d\n",info);
+            break;
+        }
+        rtk->sol.ratio=s[0]>0.0?(float)(s[1]/s[0]):0.0f;
+        if (rtk->sol.ratio>999.9) rtk->sol.ratio=999.9f;
+        
+        trace(3,"fix_amb: n=%2d ratio=%.2f\n",m,s[0]>0.0?s[1]/s[0]:0.0);
+        
+        if (s[0]<=0.0||s[1]/s[0]>=opt->thresar[0]) {
+            stat=1;
+            break;
+        }
+    }
+    if (stat) {
+        
+        /* constraint to fixed ambiguities */
+        H=zeros(nx,m); v=mat(m,1); R=zeros(m,m);
+        
+        for (k=0;k<m;k++) {
+            ik=jx[IB(amb[k].sat2,amb[k].f,opt)];
+            jk=jx[IB(amb[k].sat1,amb[k].f,opt)];
+            H[ik+k*nx]= 1.0;
+            H[jk+k*nx]=-1.0;
+            v[k]=F[k]*amb[k].lam+amb[k].offset-(x[ik]-x[jk]);
+            R[k+k*m]=VAR_HOLDAMB*SQR(amb[k].lam);
+        }
+        if ((info=filter(x,P,H,v,R,nx,m))) {
+            trace(2,"ppp_ar filter error info=%d\n",info);
+            stat=0;
+        }
+        for (k=0;k<m&&stat;k++) {
+            rtk->ssat[amb[k].sat1-1].fix[amb[k].f]=2;
+            rtk->ssat[amb[k].sat2-1].fix[amb[k].f]=2;
+        }
+        free(H); free(v); free(R);
+    }
+    free(a); free(Q); free(F);
+    return stat;
+}
+/* ambiguity resolution in ppp -------------------------------------------------
+* fix the carrier-phase ambiguities of ppp and constrain the states to them
+* args   : rtk_t    *rtk    IO  rtk control/result struct
+*          obsd_t   *obs    I   observation data
+*          int      n       I   number of observation data
+*          int      *exc    I   excluded satellites (exc[i]: obs[i])
+*          nav_t    *nav    I   navigation data
+*          double   *azel   I   azimuth/elevation angles (rad) (2 x n)
+*          int      *jx     I   index of states in active states (-1: inactive)
+*          int      na      I   number of active states
+*          double   *x      IO  active states (na x 1)
+*          double   *P      IO  covariance of active states (na x na)
+* return : status (1:fixed,0:not fixed)
+* notes  : ambiguity resolution is enabled by opt.arppp
+*-----------------------------------------------------------------------------*/
 extern int ppp_ar(rtk_t *rtk, const obsd_t *obs, int n, int *exc,
-                  const nav_t *nav, const double *azel, double *x, double *P)
+                  const nav_t *nav, const double *azel, const int *jx, int na,
+                  double *x, double *P)
 {
-    return 0;
+    const prcopt_t *opt=&rtk->opt;
+    sdamb_t *amb;
+    int nb,nf=opt->ionoopt==IONOOPT_IFLC?2:opt->nf,stat=0;
+    
+    trace(3,"ppp_ar : n=%d\n",n);
+    
+    if (!opt->arppp||opt->modear==ARMODE_OFF||opt->thresar[0]<1.0) return 0;
+    
+    /* satellite phase biases not corrected */
+    if (strstr(opt->pppopt,"-ENA_FCB")) return 0;
+    
+    /* average Melbourne-Wubbena combinations */
+    if (nf>=2) average_mw(rtk,obs,n,exc,nav);
+    
+    if (!(amb=(sdamb_t *)malloc(sizeof(sdamb_t)*MAXOBS*NFREQ))) return 0;
+    
+    /* select and fix single-differenced ambiguities */
+    if ((nb=sel_amb(rtk,obs,n,exc,nav,azel,jx,amb))>=MIN_NAMB) {
+        stat=fix_amb(rtk,amb,nb,jx,na,x,P);
+    }
+    free(amb);
+    return stat;
 }
@@ -126,6 +126,7 @@ static int addpeph(nav_t *nav, peph_t *peph)
     peph_t *nav_peph;
     
     if (nav->ne>=nav->nemax) {
+        memacct(MEM_PREC,-(int64_t)sizeof(peph_t)*nav->nemax);
         nav->nemax+=256;
         if (!(nav_peph=(peph_t *)realloc(nav->peph,sizeof(peph_t)*nav->nemax))) {
             trace(1,"readsp3b malloc error n=%d\n",nav->nemax);
@@ -133,6 +134,7 @@ static int addpeph(nav_t *nav, peph_t *peph)
             return 0;
         }
         nav->peph=nav_peph;
+        memacct(MEM_PREC,(int64_t)sizeof(peph_t)*nav->nemax);
     }
     nav->peph[nav->ne++]=*peph;
     return 1;
@@ -337,16 +339,75 @@ extern int readsap(const char *file, gtime_t time, nav_t *nav)
         pcv=searchpcv(i+1,"",time,&pcvs);
         nav->pcvs[i]=pcv?*pcv:pcv0;
     }
+    memacct(MEM_PCV,-(int64_t)sizeof(pcv_t)*pcvs.nmax);
     free(pcvs.pcv);
     return 1;
 }
+/* set string without tail space ---------------------------------------------*/
+static void setstr(char *dst, const char *src, int n)
+{
+    char *p=dst;
+    const char *q=src;
+    while (*q&&q<src+n) *p++=*q++;
+    *p--='\0';
+    while (p>=dst&&*p==' ') *p--='\0';
+}
+/* read SINEX-BIAS file (satellite observable-specific biases) ---------------*/
+static int readbiasf(FILE *fp, nav_t *nav)
+{
+    static uint8_t set[MAXSAT][MAXCODE];
+    double bias,freq;
+    char buff[256],id[8],obs[8],unit[8];
+    int sat,code,type,data=0,n=0;
+    
+    memset(set,0,sizeof(set));
+    
+    while (fgets(buff,sizeof(buff),fp)) {
+        
+        if      (strstr(buff,"+BIAS/SOLUTION")) data=1;
+        else if (strstr(buff,"-BIAS/SOLUTION")) data=0;
+        
+        if (!data||strncmp(buff," OSB ",5)||strlen(buff)<91) continue;
+        
+        /* satellite biases (no station) */
+        setstr(id,buff+15,9);
+        if (*id) continue;
+        
+        setstr(id  ,buff+11,3);
+        setstr(obs ,buff+25,4);
+        setstr(unit,buff+65,4);
+        if (!(sat=satid2no(id))||!(code=obs2code(obs+1))) continue;
+        if      (obs[0]=='C') type=1;
+        else if (obs[0]=='L') type=2;
+        else continue;
+        
+        /* first record of satellite and observable */
+        if (set[sat-1][code-1]&type) continue;
+        set[sat-1][code-1]|=type;
+        
+        bias=str2num(buff,70,21);
+        if (!strcmp(unit,"ns")) {
+            bias*=1E-9*CLIGHT; /* ns -> m */
+        }
+        else if (!strcmp(unit,"cyc")&&(freq=sat2freq(sat,code,nav))>0.0) {
+            bias*=CLIGHT/freq; /* cycle -> m */
+        }
+        else continue;
+        
+        if (type==1) nav->ssr[sat-1].cbias[code-1]=(float)bias;
+        else         nav->ssr[sat-1].pbias[code-1]=bias;
+        n++;
+    }
+    trace(3,"readbiasf: n=%d\n",n);
+    return n>0;
+}
 /* read DCB parameters file --------------------------------------------------*/
 static int readdcbf(const char *file, nav_t *nav, const sta_t *sta)
 {
     FILE *fp;
     double cbias;
     char buff[256],str1[32],str2[32]="";
-    int i,j,sat,type=0;
+    int i,j,sat,type=0,stat;
     
     trace(3,"readdcbf: file=%s\n",file);
     
@@ -356,6 +417,12 @@ static int readdcbf(const char *file, nav_t *nav, const sta_t *sta)
     }
     while (fgets(buff,sizeof(buff),fp)) {
         
+        /* SINEX-BIAS file */
+        if (!strncmp(buff,"%=BIA",5)) {
+            stat=readbiasf(fp,nav);
+            fclose(fp);
+            return stat;
+        }
         if      (strstr(buff,"DIFFERENTIAL (P1-P2) CODE BIASES")) type=1;
         else if (strstr(buff,"DIFFERENTIAL (P1-C1) CODE BIASES")) type=2;
         else if (strstr(buff,"DIFFERENTIAL (P2-C2) CODE BIASES")) type=3;
@@ -389,6 +456,10 @@ static int readdcbf(const char *file, nav_t *nav, const sta_t *sta)
 *                                 (NULL: no use)
 * return : status (1:ok,0:error)
 * notes  : currently only support P1-P2, P1-C1, P2-C2, bias in DCB file
+*          the satellite observable-specific biases (OSB) of a SINEX-BIAS file
+*          are stored as ssr code and phase biases (nav->ssr[sat-1].cbias,
+*          pbias) (m). the first record of each satellite and observable is
+*          used.
 *-----------------------------------------------------------------------------*/
 extern int readdcb(const char *file, nav_t *nav, const sta_t *sta)
 {
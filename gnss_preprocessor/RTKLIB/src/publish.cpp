@@ -0,0 +1,963 @@
+/*------------------------------------------------------------------------------
+* publish.cpp : publication of gnss measurements and solutions to ros topics
+*
+* notes  : in combined mode (soltype=2) every epoch is processed twice, once
+*          by the forward and once by the backward filter. the publication
+*          policy selects the pass whose products are published:
+*
+*              PUBP_ALL      : every pass, as processed (one copy per pass)
+*              PUBP_FORWARD  : forward pass, emitted while processing
+*              PUBP_BACKWARD : backward pass, buffered and emitted in time
+*                              order with the combined solution
+*              PUBP_COMBINED : forward pass, buffered and emitted in time
+*                              order with the combined solution
+*
+*          products of a backward-only session (soltype=1) are buffered and
+*          emitted in time order at the end of the session.
+*
+*          at most PUBB_NMEM buffered epochs are kept in memory. further epochs
+*          are serialized to a temporary spill file and read back when they
+*          are emitted, so only an index of the epochs grows with the length
+*          of the pass.
+*
+*          the pass state and the buffer belong to the calling thread. if the
+*          processing units of postpos() run in parallel, each thread captures
+*          the products of its unit in a pubunit_t. the captured products are
+*          emitted in time order of the units by pubemitunit().
+*
+*          the products are passed as boost::shared_ptr<const> messages. they
+*          are shared, not copied, when buffered or captured and subscribers in
+*          the same process (nodelet manager) receive them without
+*          serialization. a message must not be modified once it is passed.
+*
+*          if a measurement bag is opened by pubopenbag() (shard mode), all
+*          products are written to the bag instead of the ros topics.
+*
+*          if an export directory is opened by pubopenexport(), the rover and
+*          base station measurements are also written to the columnar exports
+*          <dir>/gnss_raw and <dir>/gnss_raw_base (see rawexport.cpp) in the
+*          order they are published. each row is labeled with the rover set by
+*          pubsetrover() when the measurements were published.
+*
+*          if the epoch server is opened by pubopenstore(), the rover and base
+*          station measurements are also kept in time-indexed stores (see
+*          epochstore.cpp) and the epochs of any rover and time or time span
+*          are returned by pubgetepochs() and the service get_epochs. the
+*          epochs are stored under the rover set by pubsetrover(). an epoch
+*          published again (every pass of policy PUBP_ALL) replaces the
+*          stored one of the same rover.
+*
+*          if a shared memory ring is opened by pubopenring(), the products of
+*          every epoch are also written to the ring (see shmring.h). the epoch
+*          is committed when it is emitted as a whole (buffered or captured
+*          products) or by pubendepoch() after its processing.
+*
+*          the statistics of an epoch are counted in the processing thread by
+*          pubstatobs(), pubstatsys(), pubstatrej() and pubstatcommon() and
+*          published by pubendepoch() as a product of the epoch (gnss_stats).
+*          the totals of all threads are summed atomically and logged to the
+*          console at most every PUBS_LOGINT seconds.
+*
+*          the current and peak memory of the processing subsystems are
+*          published as a diagnostic status on /diagnostics by pubmemory(),
+*          at most every PUBS_MEMINT seconds while processing and at the end of
+*          postpos(). the status is always published to the ros topic, also
+*          if the products are written to a measurement bag.
+*-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <ros/serialization.h>
+#include <rosbag/bag.h>
+#include <gnss_msgs/GetEpochs.h>
+
+#include "publish.h"
+#include "epochstore.h"
+#include "rawexport.h"
+#include "shmpub.h"
+
+/* constants -----------------------------------------------------------------*/
+
+#define PUB_DIRECT  0               /* pass state: publish immediately */
+#define PUB_BUFFER  1               /* pass state: buffer products */
+#define PUB_DROP    2               /* pass state: drop products */
+
+#define PUB_RAW     0x01            /* product: rover measurements */
+#define PUB_FIX     0x02            /* product: rover position */
+#define PUB_VEL     0x04            /* product: rover velocity */
+#define PUB_BASE    0x08            /* product: base station measurements */
+#define PUB_SMOOTH  0x10            /* product: combined solution */
+#define PUB_STATS   0x20            /* product: epoch statistics */
+
+#define PUBS_NSYS   7               /* number of counted systems (incl. other) */
+#define PUBS_LOGINT 10.0            /* interval of statistics log (s) */
+#define PUBS_MEMINT 1000            /* interval of memory diagnostics (ms) */
+#define PUBB_NMEM   256             /* max buffered epochs kept in memory */
+#define PUBR_LEN    16              /* max length of rover id (incl. '\0') */
+
+/* type definitions ----------------------------------------------------------*/
+
+typedef struct {                    /* products of an epoch */
+    gtime_t time;                   /* epoch time of rover (gpst) */
+    int flag;                       /* available products (PUB_???) */
+    char rov[PUBR_LEN];             /* rover id ("": unnamed) */
+    gnss_msgs::GNSS_Raw_Array::ConstPtr raw;  /* rover measurements */
+    gnss_msgs::GNSS_Raw_Array::ConstPtr base; /* base station measurements */
+    sensor_msgs::NavSatFix::ConstPtr fix;     /* rover position */
+    geometry_msgs::TwistStamped::ConstPtr vel; /* rover velocity */
+    sensor_msgs::NavSatFix::ConstPtr smoothed; /* combined solution */
+    gnss_msgs::GNSS_Epoch_Stats::ConstPtr stats; /* epoch statistics */
+} pubepoch_t;
+
+typedef struct {                    /* index of spilled epoch */
+    gtime_t time;                   /* epoch time of rover (gpst) */
+    long off;                       /* offset of record in spill file */
+    uint32_t len;                   /* length of record (bytes) */
+} pubrec_t;
+
+typedef struct {                    /* buffered products of a pass */
+    std::vector<pubepoch_t> data;   /* epochs in memory */
+    std::vector<pubrec_t> rec;      /* epochs in spill file */
+    FILE *fp;                       /* spill file (NULL: none) */
+    size_t ipub;                    /* index of next epoch to emit */
+    int sorted;                     /* epochs sorted by time */
+} pubbuf_t;
+
+struct pubunit_t {                  /* products of a processing unit */
+    gtime_t ts,te;                  /* time span [ts-DTTOL,te) of unit (gpst) */
+    std::vector<pubepoch_t> data;   /* captured epochs */
+};
+
+typedef struct {                    /* statistics of an epoch */
+    gtime_t time;                   /* epoch time of rover (gpst) (0: none) */
+    int nobs;                       /* observed satellites */
+    int nsys[PUBS_NSYS];            /* published satellites of systems */
+    int nrej[PUBS_NREJ];            /* rejected satellites of reasons */
+    int ncommon;                    /* common satellites (-1: none) */
+} pubstat_t;
+
+/* global variables ----------------------------------------------------------*/
+
+static ros::Publisher pub_gnss_raw;
+static ros::Publisher pub_gnss_fix;
+static ros::Publisher pub_gnss_vel;
+static ros::Publisher pub_station_raw;
+static ros::Publisher pub_gnss_fix_smoothed;
+static ros::Publisher pub_gnss_stats;
+static ros::Publisher pub_diagnostics;
+
+static int pubpolicy=PUBP_FORWARD;  /* publication policy (PUBP_???) */
+static rosbag::Bag *pubbag=NULL;    /* measurement bag (NULL: ros topics) */
+static rawexp_t *pubexp[2]={0};     /* columnar exports {rover,base} */
+static shmpub_t *pubring=NULL;      /* shared memory ring */
+static epstore_t *pubstore[2]={0};  /* epoch server stores {rover,base} */
+static ros::ServiceServer pubsrv;   /* service of epoch server */
+static std::atomic<uint32_t> nepoch_tot(0); /* total epochs */
+static std::atomic<uint32_t> nsys_tot[PUBS_NSYS]; /* total satellites */
+static std::atomic<uint32_t> nrej_tot[PUBS_NREJ]; /* total rejections */
+static std::atomic<uint32_t> memtick(0); /* tick of last memory diagnostics */
+
+/* global variables (for each processing thread) -----------------------------*/
+
+static THREADLOCAL int pubstate=PUB_DIRECT; /* state of current pass */
+static THREADLOCAL pubbuf_t *pubbuf=NULL;  /* buffered epochs (NULL: none) */
+static THREADLOCAL pubunit_t *pubunit=NULL; /* capturing processing unit */
+static THREADLOCAL pubstat_t pubstat={{0}}; /* statistics of current epoch */
+static THREADLOCAL char pubrov[PUBR_LEN]=""; /* rover of current processing */
+
+/* register publishers -------------------------------------------------------*/
+extern void publishRegisterPub(ros::NodeHandle &n)
+{
+    pub_gnss_raw = n.advertise<gnss_msgs::GNSS_Raw_Array>("gnss_raw", 1000);
+    pub_gnss_fix = n.advertise<sensor_msgs::NavSatFix>("gnss_fix", 1000);
+    pub_gnss_vel = n.advertise<geometry_msgs::TwistStamped>("gnss_vel", 1000);
+    pub_station_raw = n.advertise<gnss_msgs::GNSS_Raw_Array>("gnss_raw_base", 1000);
+    pub_gnss_fix_smoothed = n.advertise<sensor_msgs::NavSatFix>("gnss_fix_smoothed", 1000);
+    pub_gnss_stats = n.advertise<gnss_msgs::GNSS_Epoch_Stats>("gnss_stats", 1000);
+    pub_diagnostics = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+}
+/* export message to exports, epoch server and shared memory ring -----------*/
+static void expmsg(const ros::Publisher &pub, gtime_t time, const char *rov,
+                   const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg)
+{
+    int base=pub==pub_station_raw;
+    
+    rawexpwrite(pubexp[base],time,rov,*msg);
+    epstoreput(pubstore[base],rov,time,msg);
+    shmpubraw(pubring,time,rov,base,*msg);
+}
+static void expmsg(const ros::Publisher &pub, gtime_t time, const char *rov,
+                   const sensor_msgs::NavSatFix::ConstPtr &msg)
+{
+    shmpubfix(pubring,time,rov,pub==pub_gnss_fix_smoothed,*msg);
+}
+static void expmsg(const ros::Publisher &pub, gtime_t time, const char *rov,
+                   const geometry_msgs::TwistStamped::ConstPtr &msg)
+{
+    shmpubvel(pubring,time,rov,*msg);
+}
+/* export epoch statistics -----------------------------------------------------
+* the epoch statistics are diagnostics of the processing, not measurements or
+* solutions. the exports, the epoch server and the shared memory ring have no
+* record for them, so they are only published or written to the bag.
+*-----------------------------------------------------------------------------*/
+static void expmsg(const ros::Publisher &pub, gtime_t time, const char *rov,
+                   const gnss_msgs::GNSS_Epoch_Stats::ConstPtr &msg)
+{
+}
+/* publish message or write it to measurement bag ----------------------------*/
+template <class M>
+static void pubmsg(const ros::Publisher &pub, gtime_t time, const char *rov,
+                   const boost::shared_ptr<const M> &msg)
+{
+    expmsg(pub,time,rov,msg);
+    
+    if (!pubbag) {
+        pub.publish(msg);
+        return;
+    }
+    /* bag time of message is epoch time in utc */
+    pubbag->write(pub.getTopic(),
+                  ros::Time().fromNSec(gpst2utcns(time2ns(time))),msg);
+}
+/* set publication policy ----------------------------------------------------*/
+extern void pubsetpolicy(int policy)
+{
+    pubpolicy=policy;
+}
+/* products buffered in a pass -------------------------------------------------
+* args   : int    soltype   I   solution type (0:forward,1:backward,2:combined)
+* return : products of a pass buffered until its end (1:yes,0:no)
+*-----------------------------------------------------------------------------*/
+extern int pubbuffered(int soltype)
+{
+    if (soltype==0||pubpolicy==PUBP_ALL) return 0;
+    if (soltype==1) return 1;
+    return pubpolicy==PUBP_BACKWARD||pubpolicy==PUBP_COMBINED;
+}
+/* set processing pass ---------------------------------------------------------
+* args   : int    revs      I   analysis direction (0:forward,1:backward)
+*          int    combined  I   combined forward/backward processing (0:no,1:yes)
+*-----------------------------------------------------------------------------*/
+extern void pubsetpass(int revs, int combined)
+{
+    if (pubpolicy==PUBP_ALL) {
+        pubstate=PUB_DIRECT;
+    }
+    else if (!combined) { /* single pass in time order or in reverse order */
+        pubstate=revs?PUB_BUFFER:PUB_DIRECT;
+    }
+    else if (pubpolicy==PUBP_BACKWARD) {
+        pubstate=revs?PUB_BUFFER:PUB_DROP;
+    }
+    else if (pubpolicy==PUBP_COMBINED) {
+        pubstate=revs?PUB_DROP:PUB_BUFFER;
+    }
+    else { /* PUBP_FORWARD */
+        pubstate=revs?PUB_DROP:PUB_DIRECT;
+    }
+    trace(3,"pubsetpass: revs=%d combined=%d state=%d\n",revs,combined,pubstate);
+}
+/* drop products of calling thread ---------------------------------------------
+* drop products of the calling thread whose epochs are published by another
+* thread (secondary filters of multi-base rtk)
+*-----------------------------------------------------------------------------*/
+extern void pubsetdrop(void)
+{
+    pubstate=PUB_DROP;
+}
+/* set rover of calling thread -------------------------------------------------
+* set the rover id labeling the products published by the calling thread
+* args   : char   *rov      I   rover id ("": unnamed, truncated to PUBR_LEN-1)
+*-----------------------------------------------------------------------------*/
+extern void pubsetrover(const char *rov)
+{
+    sprintf(pubrov,"%.*s",PUBR_LEN-1,rov);
+}
+/* compare epoch time of buffered products -----------------------------------*/
+static bool cmpepoch(const pubepoch_t &a, const pubepoch_t &b)
+{
+    return timediff(a.time,b.time)<-DTTOL;
+}
+/* epoch in time span of capturing unit --------------------------------------*/
+static int inunit(gtime_t time)
+{
+    if (pubunit->ts.time&&timediff(time,pubunit->ts)<-DTTOL) return 0;
+    if (pubunit->te.time&&timediff(time,pubunit->te)>=0.0) return 0;
+    return 1;
+}
+/* captured products of an epoch -----------------------------------------------
+* products of the same epoch published one by one are merged unless the
+* product is already captured (every pass of policy PUBP_ALL)
+*-----------------------------------------------------------------------------*/
+static pubepoch_t *unitepoch(gtime_t time, int flag)
+{
+    std::vector<pubepoch_t> &data=pubunit->data;
+    pubepoch_t ep;
+    
+    if (!inunit(time)) return NULL;
+    
+    if (!data.empty()&&fabs(timediff(data.back().time,time))<=DTTOL&&
+        !(data.back().flag&flag)&&!strcmp(data.back().rov,pubrov)) {
+        return &data.back();
+    }
+    ep.time=time;
+    ep.flag=0;
+    strcpy(ep.rov,pubrov);
+    data.push_back(ep);
+    return &data.back();
+}
+/* emit products of an epoch -------------------------------------------------*/
+static void emitepoch(const pubepoch_t *ep)
+{
+    if (pubunit) { /* capture for processing unit */
+        if (inunit(ep->time)) pubunit->data.push_back(*ep);
+        return;
+    }
+    const char *rov=ep->rov;
+    
+    if (ep->flag&PUB_RAW   ) pubmsg(pub_gnss_raw,ep->time,rov,ep->raw);
+    if (ep->flag&PUB_FIX   ) pubmsg(pub_gnss_fix,ep->time,rov,ep->fix);
+    if (ep->flag&PUB_VEL   ) pubmsg(pub_gnss_vel,ep->time,rov,ep->vel);
+    if (ep->flag&PUB_BASE  ) pubmsg(pub_station_raw,ep->time,rov,ep->base);
+    if (ep->flag&PUB_SMOOTH) {
+        pubmsg(pub_gnss_fix_smoothed,ep->time,rov,ep->smoothed);
+    }
+    if (ep->flag&PUB_STATS ) pubmsg(pub_gnss_stats,ep->time,rov,ep->stats);
+    shmpubcommit(pubring);
+}
+/* compare epoch time of spilled products ------------------------------------*/
+static bool cmprec(const pubrec_t &a, const pubrec_t &b)
+{
+    return timediff(a.time,b.time)<-DTTOL;
+}
+/* append serialized message to record ---------------------------------------*/
+template <class M>
+static void putmsg(std::vector<uint8_t> &buff, const M &msg)
+{
+    uint32_t len=ros::serialization::serializationLength(msg);
+    size_t off=buff.size();
+    
+    buff.resize(off+4+len);
+    memcpy(&buff[off],&len,4);
+    ros::serialization::OStream os(&buff[off+4],len);
+    ros::serialization::serialize(os,msg);
+}
+/* read serialized message of record -----------------------------------------*/
+template <class M>
+static uint8_t *getmsg(uint8_t *p, boost::shared_ptr<const M> &msg)
+{
+    boost::shared_ptr<M> m(new M);
+    uint32_t len;
+    
+    memcpy(&len,p,4);
+    ros::serialization::IStream is(p+4,len);
+    ros::serialization::deserialize(is,*m);
+    msg=m;
+    return p+4+len;
+}
+/* spill buffered epochs in memory to spill file -------------------------------
+* records: flag (int32), rover id (PUBR_LEN bytes) and the messages of the
+* products in order of PUB_???, each preceded by its length (uint32). the
+* epochs stay in memory if the spill file cannot be opened. epochs not written
+* on a write error are lost.
+*-----------------------------------------------------------------------------*/
+static void spillepochs(pubbuf_t *buf)
+{
+    std::vector<uint8_t> buff;
+    pubrec_t rec;
+    size_t i=0;
+    
+    if (!buf->fp&&!(buf->fp=tmpfile())) {
+        trace(1,"pubspill: spill file open error\n");
+        return;
+    }
+    if (fseek(buf->fp,0,SEEK_END)) i=buf->data.size();
+    
+    for (;i<buf->data.size();i++) {
+        const pubepoch_t &ep=buf->data[i];
+        
+        buff.resize(4+PUBR_LEN);
+        memcpy(&buff[0],&ep.flag,4);
+        memcpy(&buff[4],ep.rov,PUBR_LEN);
+        if (ep.flag&PUB_RAW   ) putmsg(buff,*ep.raw);
+        if (ep.flag&PUB_FIX   ) putmsg(buff,*ep.fix);
+        if (ep.flag&PUB_VEL   ) putmsg(buff,*ep.vel);
+        if (ep.flag&PUB_BASE  ) putmsg(buff,*ep.base);
+        if (ep.flag&PUB_SMOOTH) putmsg(buff,*ep.smoothed);
+        if (ep.flag&PUB_STATS ) putmsg(buff,*ep.stats);
+        
+        rec.time=ep.time;
+        rec.off=ftell(buf->fp);
+        rec.len=(uint32_t)buff.size();
+        if (fwrite(buff.data(),buff.size(),1,buf->fp)!=1) break;
+        buf->rec.push_back(rec);
+    }
+    if (i<buf->data.size()) {
+        trace(1,"pubspill: spill file write error n=%d\n",
+              (int)(buf->data.size()-i));
+    }
+    std::vector<pubepoch_t>().swap(buf->data);
+}
+/* read spilled epoch --------------------------------------------------------*/
+static int readepoch(pubbuf_t *buf, const pubrec_t &rec, pubepoch_t *ep)
+{
+    std::vector<uint8_t> buff(rec.len);
+    uint8_t *p=buff.data();
+    
+    if (fseek(buf->fp,rec.off,SEEK_SET)||fread(p,rec.len,1,buf->fp)!=1) {
+        trace(1,"pubspill: spill file read error off=%ld\n",rec.off);
+        return 0;
+    }
+    ep->time=rec.time;
+    memcpy(&ep->flag,p,4); p+=4;
+    memcpy(ep->rov,p,PUBR_LEN); p+=PUBR_LEN;
+    if (ep->flag&PUB_RAW   ) p=getmsg(p,ep->raw);
+    if (ep->flag&PUB_FIX   ) p=getmsg(p,ep->fix);
+    if (ep->flag&PUB_VEL   ) p=getmsg(p,ep->vel);
+    if (ep->flag&PUB_BASE  ) p=getmsg(p,ep->base);
+    if (ep->flag&PUB_SMOOTH) p=getmsg(p,ep->smoothed);
+    if (ep->flag&PUB_STATS ) p=getmsg(p,ep->stats);
+    return 1;
+}
+/* buffered products of an epoch -----------------------------------------------
+* the products of an epoch are complete when the next epoch is buffered. the
+* complete epochs are spilled every PUBB_NMEM epochs in memory.
+*-----------------------------------------------------------------------------*/
+static pubepoch_t *bufepoch(gtime_t time)
+{
+    std::vector<pubepoch_t> *data;
+    pubepoch_t ep;
+    
+    if (!pubbuf) {
+        pubbuf=new pubbuf_t;
+        pubbuf->fp=NULL;
+        pubbuf->ipub=0;
+        pubbuf->sorted=1;
+    }
+    data=&pubbuf->data;
+    
+    if (!data->empty()&&fabs(timediff(data->back().time,time))<=DTTOL&&
+        !strcmp(data->back().rov,pubrov)) {
+        return &data->back();
+    }
+    if (!data->empty()&&timediff(time,data->back().time)<0.0) {
+        pubbuf->sorted=0;
+    }
+    else if (data->empty()&&!pubbuf->rec.empty()&&
+             timediff(time,pubbuf->rec.back().time)<0.0) {
+        pubbuf->sorted=0;
+    }
+    if (data->size()>=PUBB_NMEM&&data->size()%PUBB_NMEM==0) {
+        spillepochs(pubbuf);
+    }
+    
+    ep.time=time;
+    ep.flag=0;
+    strcpy(ep.rov,pubrov);
+    data->push_back(ep);
+    return &data->back();
+}
+/* products of an epoch to be buffered or captured ---------------------------*/
+static pubepoch_t *outepoch(gtime_t time, int flag)
+{
+    if (pubstate==PUB_BUFFER) return bufepoch(time);
+    if (pubstate==PUB_DIRECT&&pubunit) return unitepoch(time,flag);
+    return NULL;
+}
+/* emit buffered products ------------------------------------------------------
+* emit buffered products in time order up to the specified time
+* args   : gtime_t time     I   time to emit products up to (time.time==0: all)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void pubflush(gtime_t time)
+{
+    pubbuf_t *buf=pubbuf;
+    pubepoch_t ep;
+    size_t n;
+    
+    if (!buf) return;
+    
+    /* all epochs to spill file once spilled */
+    if (buf->fp&&!buf->data.empty()) spillepochs(buf);
+    
+    if (!buf->sorted) {
+        if (buf->fp) std::stable_sort(buf->rec.begin(),buf->rec.end(),cmprec);
+        else std::stable_sort(buf->data.begin(),buf->data.end(),cmpepoch);
+        buf->sorted=1;
+    }
+    n=buf->fp?buf->rec.size():buf->data.size();
+    
+    for (;buf->ipub<n;buf->ipub++) {
+        if (!buf->fp) {
+            if (time.time&&
+                timediff(buf->data[buf->ipub].time,time)>DTTOL) break;
+            emitepoch(&buf->data[buf->ipub]);
+        }
+        else {
+            if (time.time&&
+                timediff(buf->rec[buf->ipub].time,time)>DTTOL) break;
+            if (readepoch(buf,buf->rec[buf->ipub],&ep)) emitepoch(&ep);
+        }
+    }
+    if (buf->ipub>=n) {
+        if (buf->fp) fclose(buf->fp);
+        delete buf;
+        pubbuf=NULL;
+    }
+}
+/* log total statistics ------------------------------------------------------*/
+static void logstats(gtime_t time)
+{
+    int week;
+    double tow=time2gpst(time,&week);
+    
+    ROS_INFO_THROTTLE(PUBS_LOGINT,"week=%4d tow=%6.0f epochs=%u sats=%u/%u/%u/"
+        "%u/%u/%u/%u (gps/sbs/glo/gal/qzs/cmp/other) rejected: elev=%u "
+        "freq=%u prange=%u iono=%u trop=%u dup=%u",week,tow,
+        nepoch_tot.load(),nsys_tot[0].load(),nsys_tot[1].load(),
+        nsys_tot[2].load(),nsys_tot[3].load(),nsys_tot[4].load(),
+        nsys_tot[5].load(),nsys_tot[6].load(),nrej_tot[PUBS_ELEV].load(),
+        nrej_tot[PUBS_FREQ].load(),nrej_tot[PUBS_PRANGE].load(),
+        nrej_tot[PUBS_IONO].load(),nrej_tot[PUBS_TROP].load(),
+        nrej_tot[PUBS_DUP].load());
+}
+/* publish statistics of epoch -----------------------------------------------*/
+static void pubstats(void)
+{
+    static std::atomic<uint32_t> Seq(0);
+    gnss_msgs::GNSS_Epoch_Stats::Ptr stats(new gnss_msgs::GNSS_Epoch_Stats);
+    pubepoch_t *ep;
+    double tow;
+    int i,week;
+    
+    tow=time2gpst(pubstat.time,&week);
+    stats->header.stamp.fromNSec(gpst2utcns(time2ns(pubstat.time)));
+    stats->header.seq=Seq++;
+    stats->GNSS_time=week*86400*7+tow;
+    stats->total_sv=pubstat.nobs;
+    stats->GPS_cnt=pubstat.nsys[0];
+    stats->SBS_cnt=pubstat.nsys[1];
+    stats->GLO_cnt=pubstat.nsys[2];
+    stats->GAL_cnt=pubstat.nsys[3];
+    stats->QZS_cnt=pubstat.nsys[4];
+    stats->CMP_cnt=pubstat.nsys[5];
+    stats->other_cnt=pubstat.nsys[6];
+    stats->low_elevation=pubstat.nrej[PUBS_ELEV];
+    stats->no_frequency=pubstat.nrej[PUBS_FREQ];
+    stats->no_pseudorange=pubstat.nrej[PUBS_PRANGE];
+    stats->no_iono=pubstat.nrej[PUBS_IONO];
+    stats->no_tropo=pubstat.nrej[PUBS_TROP];
+    stats->duplicated=pubstat.nrej[PUBS_DUP];
+    stats->common_sv=pubstat.ncommon;
+    
+    nepoch_tot++;
+    for (i=0;i<PUBS_NSYS;i++) nsys_tot[i]+=pubstat.nsys[i];
+    for (i=0;i<PUBS_NREJ;i++) nrej_tot[i]+=pubstat.nrej[i];
+    logstats(pubstat.time);
+    
+    if (pubstate==PUB_DIRECT&&!pubunit) {
+        pubmsg<gnss_msgs::GNSS_Epoch_Stats>(pub_gnss_stats,pubstat.time,pubrov,
+                                            stats);
+    }
+    else if ((ep=outepoch(pubstat.time,PUB_STATS))) {
+        ep->stats=stats;
+        ep->flag|=PUB_STATS;
+    }
+}
+/* end of epoch ----------------------------------------------------------------
+* publish the statistics of the epoch and commit the epoch to the shared memory
+* ring
+*-----------------------------------------------------------------------------*/
+extern void pubendepoch(void)
+{
+    if (pubstat.time.time&&pubstate!=PUB_DROP) pubstats();
+    pubstat.time.time=0;
+    
+    if (pubstate==PUB_DIRECT&&!pubunit) shmpubcommit(pubring);
+    
+    pubmemory(0);
+}
+/* publish memory diagnostics --------------------------------------------------
+* publish the current and peak memory of the processing subsystems as a
+* diagnostic status on /diagnostics
+* args   : int    force     I   publish regardless of the interval (1:on)
+* return : none
+* notes  : without force, the status is published at most every PUBS_MEMINT ms
+*          by any of the processing threads
+*-----------------------------------------------------------------------------*/
+extern void pubmemory(int force)
+{
+    diagnostic_msgs::DiagnosticArray::Ptr diag;
+    diagnostic_msgs::DiagnosticStatus status;
+    diagnostic_msgs::KeyValue value;
+    uint32_t tick=tickget(),last=memtick.load();
+    int64_t cur,peak,sum=0;
+    char buff[64];
+    int i;
+    
+    if (force) memtick=tick;
+    else if (tick-last<PUBS_MEMINT||
+             !memtick.compare_exchange_strong(last,tick)) return;
+    
+    diag.reset(new diagnostic_msgs::DiagnosticArray);
+    
+    for (i=0;i<MEM_NSUB;i++) {
+        memstat(i,&cur,&peak);
+        sum+=cur;
+        value.key=std::string(memname(i))+" current (bytes)";
+        value.value=std::to_string((long long)cur);
+        status.values.push_back(value);
+        value.key=std::string(memname(i))+" peak (bytes)";
+        value.value=std::to_string((long long)peak);
+        status.values.push_back(value);
+    }
+    sprintf(buff,"%.1f MB allocated",sum/1E6);
+    status.level=diagnostic_msgs::DiagnosticStatus::OK;
+    status.name="gnss_preprocessor: memory";
+    status.hardware_id="gnss_preprocessor";
+    status.message=buff;
+    diag->header.stamp=ros::Time::now();
+    diag->status.push_back(status);
+    pub_diagnostics.publish(diag);
+}
+/* publish rover measurements ------------------------------------------------*/
+extern void pubraw(gtime_t time, const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg)
+{
+    pubepoch_t *ep;
+
+    if (pubstate==PUB_DIRECT&&!pubunit) {
+        pubmsg(pub_gnss_raw,time,pubrov,msg);
+    }
+    else if ((ep=outepoch(time,PUB_RAW))) {
+        ep->raw=msg;
+        ep->flag|=PUB_RAW;
+    }
+}
+/* publish base station measurements -----------------------------------------*/
+extern void pubrawbase(gtime_t time,
+                       const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg)
+{
+    pubepoch_t *ep;
+
+    if (pubstate==PUB_DIRECT&&!pubunit) {
+        pubmsg(pub_station_raw,time,pubrov,msg);
+    }
+    else if ((ep=outepoch(time,PUB_BASE))) {
+        ep->base=msg;
+        ep->flag|=PUB_BASE;
+    }
+}
+/* publish rover position ----------------------------------------------------*/
+extern void pubfix(gtime_t time, const sensor_msgs::NavSatFix::ConstPtr &msg)
+{
+    pubepoch_t *ep;
+
+    if (pubstate==PUB_DIRECT&&!pubunit) {
+        pubmsg(pub_gnss_fix,time,pubrov,msg);
+    }
+    else if ((ep=outepoch(time,PUB_FIX))) {
+        ep->fix=msg;
+        ep->flag|=PUB_FIX;
+    }
+}
+/* publish rover velocity ----------------------------------------------------*/
+extern void pubvel(gtime_t time, const geometry_msgs::TwistStamped::ConstPtr &msg)
+{
+    pubepoch_t *ep;
+
+    if (pubstate==PUB_DIRECT&&!pubunit) {
+        pubmsg(pub_gnss_vel,time,pubrov,msg);
+    }
+    else if ((ep=outepoch(time,PUB_VEL))) {
+        ep->vel=msg;
+        ep->flag|=PUB_VEL;
+    }
+}
+/* publish combined forward/backward solution --------------------------------*/
+extern void pubsmoothed(const sol_t *sol)
+{
+    static std::atomic<uint32_t> Seq(0);
+    sensor_msgs::NavSatFix::Ptr Fix(new sensor_msgs::NavSatFix);
+    pubepoch_t *ep;
+    double pos[3],P[9],Q[9];
+    int i,j;
+
+    Fix->header.stamp.fromNSec(gpst2utcns(time2ns(sol->time)));
+    Fix->header.frame_id="earth_center";
+    Fix->header.seq=Seq++;
+
+    ecef2pos(sol->rr,pos);
+    Fix->latitude =pos[0]*R2D;
+    Fix->longitude=pos[1]*R2D;
+    Fix->altitude =pos[2];
+
+    /* position covariance in east/north/up */
+    P[0]     =sol->qr[0]; /* xx */
+    P[4]     =sol->qr[1]; /* yy */
+    P[8]     =sol->qr[2]; /* zz */
+    P[1]=P[3]=sol->qr[3]; /* xy */
+    P[5]=P[7]=sol->qr[4]; /* yz */
+    P[2]=P[6]=sol->qr[5]; /* zx */
+    covenu(pos,P,Q);
+    for (i=0;i<3;i++) for (j=0;j<3;j++) {
+        Fix->position_covariance[i*3+j]=Q[i+j*3];
+    }
+    Fix->position_covariance_type=sensor_msgs::NavSatFix::COVARIANCE_TYPE_KNOWN;
+
+    if (!pubunit) {
+        pubmsg<sensor_msgs::NavSatFix>(pub_gnss_fix_smoothed,sol->time,pubrov,
+                                       Fix);
+        shmpubcommit(pubring);
+    }
+    else if ((ep=unitepoch(sol->time,PUB_SMOOTH))) {
+        ep->smoothed=Fix;
+        ep->flag|=PUB_SMOOTH;
+    }
+}
+/* count observed satellites of epoch -----------------------------------------
+* start the statistics of an epoch (continued for the same epoch time)
+* args   : gtime_t time     I   epoch time of rover (gpst)
+*          int    n         I   number of observed satellites
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void pubstatobs(gtime_t time, int n)
+{
+    if (!pubstat.time.time||fabs(timediff(time,pubstat.time))>DTTOL) {
+        memset(&pubstat,0,sizeof(pubstat));
+        pubstat.time=time;
+        pubstat.ncommon=-1;
+    }
+    pubstat.nobs+=n;
+}
+/* count published satellite of epoch ----------------------------------------*/
+extern void pubstatsys(int sys)
+{
+    int i;
+    
+    switch (sys) {
+        case SYS_GPS: i=0; break;
+        case SYS_SBS: i=1; break;
+        case SYS_GLO: i=2; break;
+        case SYS_GAL: i=3; break;
+        case SYS_QZS: i=4; break;
+        case SYS_CMP: i=5; break;
+        default     : i=6; break;
+    }
+    pubstat.nsys[i]++;
+}
+/* count rejected satellite of epoch (PUBS_???) ------------------------------*/
+extern void pubstatrej(int reason)
+{
+    if (0<=reason&&reason<PUBS_NREJ) pubstat.nrej[reason]++;
+}
+/* set common satellites of rover and base station of epoch ------------------*/
+extern void pubstatcommon(int ns)
+{
+    pubstat.ncommon=ns;
+}
+/* open processing unit --------------------------------------------------------
+* capture the products of the calling thread for a processing unit instead of
+* publishing them. products out of the time span of the unit (warm-up) are
+* dropped.
+* args   : gtime_t ts       I   start time of unit (gpst) (0: no limit)
+*          gtime_t te       I   end time of unit, exclusive (gpst) (0: no limit)
+* return : processing unit (NULL: error)
+*-----------------------------------------------------------------------------*/
+extern pubunit_t *pubopenunit(gtime_t ts, gtime_t te)
+{
+    pubunit_t *unit=new pubunit_t;
+    
+    unit->ts=ts;
+    unit->te=te;
+    pubunit=unit;
+    return unit;
+}
+/* close processing unit -----------------------------------------------------*/
+extern void pubcloseunit(void)
+{
+    if (!pubunit) return;
+    std::stable_sort(pubunit->data.begin(),pubunit->data.end(),cmpepoch);
+    pubunit=NULL;
+}
+/* emit products of processing unit --------------------------------------------
+* publish the captured products of a closed processing unit and free it
+* args   : pubunit_t *unit  IO  processing unit
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void pubemitunit(pubunit_t *unit)
+{
+    size_t i;
+    
+    if (!unit) return;
+    for (i=0;i<unit->data.size();i++) emitepoch(&unit->data[i]);
+    delete unit;
+}
+/* open measurement bag --------------------------------------------------------
+* write all products to a bag file instead of publishing them
+* args   : char   *file     I   bag file
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int pubopenbag(const char *file)
+{
+    pubclosebag();
+    pubbag=new rosbag::Bag;
+    try {
+        pubbag->open(file,rosbag::bagmode::Write);
+    }
+    catch (const rosbag::BagException &e) {
+        ROS_ERROR("pubopenbag: %s\n",e.what());
+        delete pubbag;
+        pubbag=NULL;
+        return 0;
+    }
+    return 1;
+}
+/* close measurement bag -----------------------------------------------------*/
+extern void pubclosebag(void)
+{
+    if (!pubbag) return;
+    pubbag->close();
+    delete pubbag;
+    pubbag=NULL;
+}
+/* file of measurement bag -----------------------------------------------------
+* args   : char   *file     O   file of measurement bag ("": not open)
+* return : file
+*-----------------------------------------------------------------------------*/
+extern char *pubbagfile(char *file)
+{
+    strcpy(file,pubbag?pubbag->getFileName().c_str():"");
+    return file;
+}
+/* open columnar export --------------------------------------------------------
+* write the published rover and base station measurements to columnar exports
+* args   : char   *dir      I   export directory
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int pubopenexport(const char *dir)
+{
+    std::string path(dir);
+    
+    pubcloseexport();
+    
+    if (!(pubexp[0]=rawexpopen((path+FILEPATHSEP+"gnss_raw").c_str()))||
+        !(pubexp[1]=rawexpopen((path+FILEPATHSEP+"gnss_raw_base").c_str()))) {
+        ROS_ERROR("pubopenexport: export open error dir=%s\n",dir);
+        pubcloseexport();
+        return 0;
+    }
+    return 1;
+}
+/* close columnar export -----------------------------------------------------*/
+extern void pubcloseexport(void)
+{
+    rawexpclose(pubexp[0]);
+    rawexpclose(pubexp[1]);
+    pubexp[0]=pubexp[1]=NULL;
+}
+/* open shared memory ring -----------------------------------------------------
+* write the products of every epoch to a shared memory ring
+* args   : char   *name     I   name of shared memory object
+*          int    nslot     I   number of slots (epochs)
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int pubopenring(const char *name, int nslot)
+{
+    pubclosering();
+    
+    if (!(pubring=shmpubopen(name,nslot))) {
+        ROS_ERROR("pubopenring: ring open error name=%s\n",name);
+        return 0;
+    }
+    return 1;
+}
+/* close shared memory ring --------------------------------------------------*/
+extern void pubclosering(void)
+{
+    shmpubclose(pubring);
+    pubring=NULL;
+}
+/* gps time of seconds since gps epoch ---------------------------------------*/
+static gtime_t gpssec2time(double sec)
+{
+    int week=(int)floor(sec/604800.0);
+    
+    return gpst2time(week,sec-week*604800.0);
+}
+/* service of epoch server ---------------------------------------------------*/
+static bool getepochs(gnss_msgs::GetEpochs::Request &req,
+                      gnss_msgs::GetEpochs::Response &res)
+{
+    std::vector<gnss_msgs::GNSS_Raw_Array::ConstPtr> msgs;
+    size_t i;
+    
+    if (!pubgetepochs(req.rover.c_str(),gpssec2time(req.start),
+                      gpssec2time(req.end),req.tolerance,req.base,msgs)) {
+        return !!pubstore[req.base?1:0];
+    }
+    for (i=0;i<msgs.size();i++) res.epochs.push_back(*msgs[i]);
+    return true;
+}
+/* open epoch server -----------------------------------------------------------
+* keep the published rover and base station measurements in time-indexed
+* stores and advertise the service get_epochs
+* args   : ros::NodeHandle &n I node handle of service
+*          char   *file     I   record file of disk store ("": memory store),
+*                               the base station epochs are stored in
+*                               <file>.base
+*          int    ncache    I   number of cached epochs of disk store
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int pubopenstore(ros::NodeHandle &n, const char *file, int ncache)
+{
+    std::string base=*file?std::string(file)+".base":"";
+    
+    pubclosestore();
+    
+    if (!(pubstore[0]=epstoreopen(file,ncache))||
+        !(pubstore[1]=epstoreopen(base.c_str(),ncache))) {
+        ROS_ERROR("pubopenstore: store open error file=%s\n",file);
+        pubclosestore();
+        return 0;
+    }
+    pubsrv=n.advertiseService("get_epochs",getepochs);
+    return 1;
+}
+/* close epoch server --------------------------------------------------------*/
+extern void pubclosestore(void)
+{
+    pubsrv.shutdown();
+    epstoreclose(pubstore[0]);
+    epstoreclose(pubstore[1]);
+    pubstore[0]=pubstore[1]=NULL;
+}
+/* get epochs of epoch server --------------------------------------------------
+* get the published measurements of an epoch or of the epochs of a time span
+* args   : char   *rov      I   rover id ("": unnamed, see pubsetrover())
+*          gtime_t ts       I   time or start time of span (gpst)
+*          gtime_t te       I   end time of span, inclusive (gpst)
+*                               (te<=ts: epoch nearest to ts within tol)
+*          double  tol      I   max time difference of nearest epoch (s)
+*          int     base     I   measurements (0:rover,1:base station)
+*          vector<GNSS_Raw_Array::ConstPtr> &msgs O measurements of epochs
+* return : number of epochs
+*-----------------------------------------------------------------------------*/
+extern int pubgetepochs(const char *rov, gtime_t ts, gtime_t te, double tol,
+                        int base,
+                        std::vector<gnss_msgs::GNSS_Raw_Array::ConstPtr> &msgs)
+{
+    gnss_msgs::GNSS_Raw_Array::ConstPtr msg;
+    epstore_t *st=pubstore[base?1:0];
+    char id[PUBR_LEN];
+    
+    msgs.clear();
+    
+    sprintf(id,"%.*s",PUBR_LEN-1,rov); /* as stored by pubsetrover() */
+    
+    if (timediff(te,ts)>0.0) return epstorerange(st,id,ts,te,msgs);
+    
+    if ((msg=epstoreget(st,id,ts,tol))) msgs.push_back(msg);
+    return (int)msgs.size();
+}
@@ -0,0 +1,96 @@
+/*------------------------------------------------------------------------------
+* publish.h : publication of gnss measurements and solutions to ros topics
+*
+* notes  : all ros topics of the preprocessor are published through the
+*          functions of this module. the publication policy decides which
+*          processing pass emits the per-epoch products and whether they are
+*          emitted immediately or buffered and emitted in time order.
+*
+*          the statistics of an epoch (satellites per system and rejections)
+*          are counted by the processing thread and published once per epoch
+*          by pubendepoch() instead of being logged to the console.
+*
+*          the memory of the processing subsystems (see memstat()) is reported
+*          on the diagnostics topic by pubmemory().
+*-----------------------------------------------------------------------------*/
+#ifndef PUBLISH_H
+#define PUBLISH_H
+#include <vector>
+
+#include "rtklib.h"
+
+#include <ros/ros.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <sensor_msgs/NavSatFix.h>
+#include <gnss_msgs/GNSS_Raw_Array.h>
+#include <gnss_msgs/GNSS_Epoch_Stats.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+/* constants -----------------------------------------------------------------*/
+
+#define PUBP_ALL      0     /* publication policy: every pass */
+#define PUBP_FORWARD  1     /* publication policy: forward pass only */
+#define PUBP_BACKWARD 2     /* publication policy: backward pass only */
+#define PUBP_COMBINED 3     /* publication policy: with combined solution */
+
+#define PUBS_ELEV     0     /* rejection: elevation not above mask */
+#define PUBS_FREQ     1     /* rejection: no carrier frequency */
+#define PUBS_PRANGE   2     /* rejection: no corrected pseudorange */
+#define PUBS_IONO     3     /* rejection: no ionospheric correction */
+#define PUBS_TROP     4     /* rejection: no tropospheric correction */
+#define PUBS_DUP      5     /* rejection: duplicated observation data */
+#define PUBS_NREJ     6     /* number of rejection reasons */
+
+/* type definitions ----------------------------------------------------------*/
+
+struct pubunit_t;                   /* products of a processing unit */
+
+/* function prototypes -------------------------------------------------------*/
+
+extern void publishRegisterPub(ros::NodeHandle &n);
+
+extern void pubsetpolicy(int policy);
+extern int  pubbuffered (int soltype);
+extern void pubsetpass  (int revs, int combined);
+extern void pubsetdrop  (void);
+extern void pubsetrover (const char *rov);
+extern void pubflush    (gtime_t time);
+extern void pubendepoch (void);
+
+extern void pubraw     (gtime_t time,
+                        const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg);
+extern void pubrawbase (gtime_t time,
+                        const gnss_msgs::GNSS_Raw_Array::ConstPtr &msg);
+extern void pubfix     (gtime_t time, const sensor_msgs::NavSatFix::ConstPtr &msg);
+extern void pubvel     (gtime_t time,
+                        const geometry_msgs::TwistStamped::ConstPtr &msg);
+extern void pubsmoothed(const sol_t *sol);
+
+extern void pubstatobs   (gtime_t time, int n);
+extern void pubstatsys   (int sys);
+extern void pubstatrej   (int reason);
+extern void pubstatcommon(int ns);
+
+extern void pubmemory(int force);
+
+extern pubunit_t *pubopenunit(gtime_t ts, gtime_t te);
+extern void pubcloseunit(void);
+extern void pubemitunit (pubunit_t *unit);
+
+extern int  pubopenbag (const char *file);
+extern void pubclosebag(void);
+extern char *pubbagfile (char *file);
+
+extern int  pubopenexport (const char *dir);
+extern void pubcloseexport(void);
+
+extern int  pubopenring (const char *name, int nslot);
+extern void pubclosering(void);
+
+extern int  pubopenstore (ros::NodeHandle &n, const char *file, int ncache);
+extern void pubclosestore(void);
+extern int  pubgetepochs (const char *rov, gtime_t ts, gtime_t te, double tol,
+                          int base,
+                          std::vector<gnss_msgs::GNSS_Raw_Array::ConstPtr> &msgs);
+
+#endif /* PUBLISH_H */
@@ -0,0 +1,243 @@
+/*------------------------------------------------------------------------------
+* rawexport.cpp : columnar export of gnss measurements
+*
+* notes  : the measurements of all epochs are appended row by row (one row per
+*          satellite) to one file per GNSS_Raw field in the export directory:
+*
+*              <field>.npy       : column of the field (numpy format 1.0)
+*              epoch_offset.npy  : first row of each epoch (int64), followed
+*                                  by the number of rows
+*              epoch_time.npy    : epoch time (gpst, s since 1980/1/6 as
+*                                  GNSS_time)
+*              rover.npy         : rover id of the row ("": unnamed), to tell
+*                                  apart the rows of multiple rovers
+*              schema.json       : columns, dtypes, data offsets and sizes
+*
+*          the columns are little-endian flat arrays after a fixed header of
+*          NPYHLEN bytes, so they can be memory-mapped by numpy (np.load(...,
+*          mmap_mode='r')) or by matlab (memmapfile(...,'Offset',128)). the
+*          shape in the headers and the sizes in the schema are written when
+*          the export is closed. while the export is written, the number of
+*          rows is (file size - NPYHLEN) / item size.
+*-----------------------------------------------------------------------------*/
+#include "rawexport.h"
+
+/* constants -----------------------------------------------------------------*/
+
+#define NPYHLEN     128             /* npy header length (bytes) */
+#define NCOL        (sizeof(cols)/sizeof(*cols))
+#define EXPBUFF     65536           /* file buffer of a column (bytes) */
+
+#define MIN(x,y)    ((x)<(y)?(x):(y))
+
+/* type definitions ----------------------------------------------------------*/
+
+typedef struct {                    /* column of export */
+    const char *name;               /* field name */
+    const char *descr;              /* numpy dtype */
+    int size;                       /* item size (bytes) */
+} expcol_t;
+
+struct rawexp_t {                   /* columnar export */
+    char dir[1024];                 /* export directory */
+    FILE *fp[32];                   /* column files */
+    FILE *fp_off,*fp_time;          /* epoch offset/time files */
+    int64_t nrow;                   /* number of rows */
+    int64_t nep;                    /* number of epochs */
+};
+
+/* columns of GNSS_Raw (order of message definition) -------------------------*/
+static const expcol_t cols[]={
+    {"GNSS_time"           ,"<f8",8},
+    {"total_sv"            ,"<i8",8},
+    {"prn_satellites_index","<i8",8},
+    {"pseudorange"         ,"<f8",8},
+    {"raw_pseudorange"     ,"<f8",8},
+    {"carrier_phase"       ,"<f8",8},
+    {"lamda"               ,"<f8",8},
+    {"snr"                 ,"<f8",8},
+    {"elevation"           ,"<f8",8},
+    {"azimuth"             ,"<f8",8},
+    {"err_tropo"           ,"<f8",8},
+    {"err_iono"            ,"<f8",8},
+    {"sat_clk_err"         ,"<f8",8},
+    {"sat_pos_x"           ,"<f8",8},
+    {"sat_pos_y"           ,"<f8",8},
+    {"sat_pos_z"           ,"<f8",8},
+    {"sat_system"          ,"|S8",8},
+    {"visable"             ,"<i8",8},
+    {"valid"               ,"|b1",1},
+    {"rover"               ,"|S16",16} /* not in GNSS_Raw: rover id */
+};
+/* write npy header ----------------------------------------------------------*/
+static void npyhead(FILE *fp, const char *descr, int64_t n)
+{
+    char buff[NPYHLEN+1];
+    int len;
+    
+    memcpy(buff,"\x93NUMPY\x01\x00",8);
+    buff[8]=(char)((NPYHLEN-10)&0xFF);
+    buff[9]=(char)((NPYHLEN-10)>>8);
+    len=10+sprintf(buff+10,"{'descr': '%s', 'fortran_order': False, "
+                   "'shape': (%lld,), }",descr,(long long)n);
+    memset(buff+len,' ',NPYHLEN-1-len);
+    buff[NPYHLEN-1]='\n';
+    fseek(fp,0,SEEK_SET);
+    fwrite(buff,NPYHLEN,1,fp);
+}
+/* open column file ----------------------------------------------------------*/
+static FILE *opencol(const char *dir, const char *name, const char *descr)
+{
+    FILE *fp;
+    char file[1100];
+    
+    sprintf(file,"%s%c%s.npy",dir,FILEPATHSEP,name);
+    if (!(fp=fopen(file,"wb"))) return NULL;
+    setvbuf(fp,NULL,_IOFBF,EXPBUFF);
+    npyhead(fp,descr,0);
+    return fp;
+}
+/* close column file ---------------------------------------------------------*/
+static void closecol(FILE *fp, const char *descr, int64_t n)
+{
+    if (!fp) return;
+    npyhead(fp,descr,n);
+    fclose(fp);
+}
+/* write schema --------------------------------------------------------------*/
+static void outschema(const rawexp_t *exp)
+{
+    FILE *fp;
+    char file[1100];
+    size_t i;
+    
+    sprintf(file,"%s%cschema.json",exp->dir,FILEPATHSEP);
+    if (!(fp=fopen(file,"w"))) return;
+    
+    fprintf(fp,"{\n  \"format\": \"npy\",\n  \"header_bytes\": %d,\n",NPYHLEN);
+    fprintf(fp,"  \"rows\": %lld,\n  \"epochs\": %lld,\n",(long long)exp->nrow,
+            (long long)exp->nep);
+    fprintf(fp,"  \"epoch_offset\": {\"file\": \"epoch_offset.npy\", "
+            "\"dtype\": \"<i8\", \"length\": %lld},\n",(long long)exp->nep+1);
+    fprintf(fp,"  \"epoch_time\": {\"file\": \"epoch_time.npy\", "
+            "\"dtype\": \"<f8\", \"length\": %lld, \"unit\": \"gpst s since "
+            "1980/1/6\"},\n",(long long)exp->nep);
+    fprintf(fp,"  \"columns\": [\n");
+    for (i=0;i<NCOL;i++) {
+        fprintf(fp,"    {\"name\": \"%s\", \"file\": \"%s.npy\", \"dtype\": "
+                "\"%s\", \"itemsize\": %d}%s\n",cols[i].name,cols[i].name,
+                cols[i].descr,cols[i].size,i<NCOL-1?",":"");
+    }
+    fprintf(fp,"  ]\n}\n");
+    fclose(fp);
+}
+/* open columnar export --------------------------------------------------------
+* create the export directory and the column files
+* args   : char   *dir      I   export directory
+* return : columnar export (NULL: error)
+*-----------------------------------------------------------------------------*/
+extern rawexp_t *rawexpopen(const char *dir)
+{
+    rawexp_t *exp;
+    char path[1100];
+    size_t i;
+    
+    trace(3,"rawexpopen: dir=%s\n",dir);
+    
+    if (!(exp=(rawexp_t *)calloc(1,sizeof(rawexp_t)))) return NULL;
+    
+    sprintf(exp->dir,"%.1023s",dir);
+    sprintf(path,"%s%c",dir,FILEPATHSEP);
+    createdir(path);
+    
+    for (i=0;i<NCOL;i++) {
+        if (!(exp->fp[i]=opencol(dir,cols[i].name,cols[i].descr))) break;
+    }
+    if (i<NCOL||!(exp->fp_off =opencol(dir,"epoch_offset","<i8"))||
+                !(exp->fp_time=opencol(dir,"epoch_time"  ,"<f8"))) {
+        trace(1,"rawexpopen: file open error dir=%s\n",dir);
+        rawexpclose(exp);
+        return NULL;
+    }
+    outschema(exp);
+    return exp;
+}
+/* write measurements of an epoch ----------------------------------------------
+* args   : rawexp_t *exp    IO  columnar export
+*          gtime_t  time    I   epoch time (gpst)
+*          char     *rov    I   rover id ("": unnamed)
+*          GNSS_Raw_Array &msg I measurements of the epoch
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void rawexpwrite(rawexp_t *exp, gtime_t time, const char *rov,
+                        const gnss_msgs::GNSS_Raw_Array &msg)
+{
+    char sys[8],id[16]={0};
+    uint8_t valid;
+    double t;
+    size_t i;
+    int week;
+    
+    if (!exp) return;
+    
+    t=time2gpst(time,&week);
+    t+=week*604800.0;
+    memcpy(id,rov,MIN(strlen(rov),sizeof(id)));
+    
+    fwrite(&exp->nrow,8,1,exp->fp_off);
+    fwrite(&t,8,1,exp->fp_time);
+    exp->nep++;
+    
+    for (i=0;i<msg.GNSS_Raws.size();i++) {
+        const gnss_msgs::GNSS_Raw &r=msg.GNSS_Raws[i];
+    
+        memset(sys,0,sizeof(sys));
+        r.sat_system.copy(sys,sizeof(sys));
+        valid=r.valid?1:0;
+    
+        fwrite(&r.GNSS_time           ,8,1,exp->fp[ 0]);
+        fwrite(&r.total_sv            ,8,1,exp->fp[ 1]);
+        fwrite(&r.prn_satellites_index,8,1,exp->fp[ 2]);
+        fwrite(&r.pseudorange         ,8,1,exp->fp[ 3]);
+        fwrite(&r.raw_pseudorange     ,8,1,exp->fp[ 4]);
+        fwrite(&r.carrier_phase       ,8,1,exp->fp[ 5]);
+        fwrite(&r.lamda               ,8,1,exp->fp[ 6]);
+        fwrite(&r.snr                 ,8,1,exp->fp[ 7]);
+        fwrite(&r.elevation           ,8,1,exp->fp[ 8]);
+        fwrite(&r.azimuth             ,8,1,exp->fp[ 9]);
+        fwrite(&r.err_tropo           ,8,1,exp->fp[10]);
+        fwrite(&r.err_iono            ,8,1,exp->fp[11]);
+        fwrite(&r.sat_clk_err         ,8,1,exp->fp[12]);
+        fwrite(&r.sat_pos_x           ,8,1,exp->fp[13]);
+        fwrite(&r.sat_pos_y           ,8,1,exp->fp[14]);
+        fwrite(&r.sat_pos_z           ,8,1,exp->fp[15]);
+        fwrite(sys                    ,8,1,exp->fp[16]);
+        fwrite(&r.visable             ,8,1,exp->fp[17]);
+        fwrite(&valid                 ,1,1,exp->fp[18]);
+        fwrite(id                     ,16,1,exp->fp[19]);
+    }
+    exp->nrow+=(int64_t)msg.GNSS_Raws.size();
+}
+/* close columnar export -------------------------------------------------------
+* write the number of rows to the headers and the schema and close the files
+* args   : rawexp_t *exp    IO  columnar export
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void rawexpclose(rawexp_t *exp)
+{
+    size_t i;
+    
+    trace(3,"rawexpclose:\n");
+    
+    if (!exp) return;
+    
+    if (exp->fp_off) { /* number of rows after the last epoch */
+        fseek(exp->fp_off,0,SEEK_END);
+        fwrite(&exp->nrow,8,1,exp->fp_off);
+    }
+    for (i=0;i<NCOL;i++) closecol(exp->fp[i],cols[i].descr,exp->nrow);
+    closecol(exp->fp_off ,"<i8",exp->nep+1);
+    closecol(exp->fp_time,"<f8",exp->nep);
+    if (exp->fp_off&&exp->fp_time) outschema(exp);
+    free(exp);
+}
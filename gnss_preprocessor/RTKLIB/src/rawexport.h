@@ -0,0 +1,25 @@
+/*------------------------------------------------------------------------------
+* rawexport.h : columnar export of gnss measurements
+*
+* notes  : the measurements (GNSS_Raw_Array) are written to a directory with
+*          one numpy array file (.npy) per GNSS_Raw field and a json schema,
+*          see rawexport.cpp.
+*-----------------------------------------------------------------------------*/
+#ifndef RAWEXPORT_H
+#define RAWEXPORT_H
+#include "rtklib.h"
+
+#include <gnss_msgs/GNSS_Raw_Array.h>
+
+/* type definitions ----------------------------------------------------------*/
+
+struct rawexp_t;                    /* columnar export */
+
+/* function prototypes -------------------------------------------------------*/
+
+extern rawexp_t *rawexpopen (const char *dir);
+extern void      rawexpwrite(rawexp_t *exp, gtime_t time, const char *rov,
+                             const gnss_msgs::GNSS_Raw_Array &msg);
+extern void      rawexpclose(rawexp_t *exp);
+
+#endif /* RAWEXPORT_H */
@@ -874,6 +874,7 @@ static int addobsdata(obs_t *obs, const obsd_t *data)
     obsd_t *obs_data;
     
     if (obs->nmax<=obs->n) {
+        memacct(MEM_OBS,-(int64_t)sizeof(obsd_t)*obs->nmax);
         if (obs->nmax<=0) obs->nmax=NINCOBS; else obs->nmax*=2;
         if (!(obs_data=(obsd_t *)realloc(obs->data,sizeof(obsd_t)*obs->nmax))) {
             trace(1,"addobsdata: malloc error n=%dx%d\n",sizeof(obsd_t),obs->nmax);
@@ -881,6 +882,7 @@ static int addobsdata(obs_t *obs, const obsd_t *data)
             return -1;
         }
         obs->data=obs_data;
+        memacct(MEM_OBS,(int64_t)sizeof(obsd_t)*obs->nmax);
     }
     obs->data[obs->n++]=*data;
     return 1;
@@ -1357,6 +1359,7 @@ static int add_eph(nav_t *nav, const eph_t *eph)
     eph_t *nav_eph;
     
     if (nav->nmax<=nav->n) {
+        memacct(MEM_NAV,-(int64_t)sizeof(eph_t)*nav->nmax);
         nav->nmax+=1024;
         if (!(nav_eph=(eph_t *)realloc(nav->eph,sizeof(eph_t)*nav->nmax))) {
             trace(1,"decode_eph malloc error: n=%d\n",nav->nmax);
@@ -1364,6 +1367,7 @@ static int add_eph(nav_t *nav, const eph_t *eph)
             return 0;
         }
         nav->eph=nav_eph;
+        memacct(MEM_NAV,(int64_t)sizeof(eph_t)*nav->nmax);
     }
     nav->eph[nav->n++]=*eph;
     return 1;
@@ -1373,6 +1377,7 @@ static int add_geph(nav_t *nav, const geph_t *geph)
     geph_t *nav_geph;
     
     if (nav->ngmax<=nav->ng) {
+        memacct(MEM_NAV,-(int64_t)sizeof(geph_t)*nav->ngmax);
         nav->ngmax+=1024;
         if (!(nav_geph=(geph_t *)realloc(nav->geph,sizeof(geph_t)*nav->ngmax))) {
             trace(1,"decode_geph malloc error: n=%d\n",nav->ngmax);
@@ -1380,6 +1385,7 @@ static int add_geph(nav_t *nav, const geph_t *geph)
             return 0;
         }
         nav->geph=nav_geph;
+        memacct(MEM_NAV,(int64_t)sizeof(geph_t)*nav->ngmax);
     }
     nav->geph[nav->ng++]=*geph;
     return 1;
@@ -1389,6 +1395,7 @@ static int add_seph(nav_t *nav, const seph_t *seph)
     seph_t *nav_seph;
     
     if (nav->nsmax<=nav->ns) {
+        memacct(MEM_NAV,-(int64_t)sizeof(seph_t)*nav->nsmax);
         nav->nsmax+=1024;
         if (!(nav_seph=(seph_t *)realloc(nav->seph,sizeof(seph_t)*nav->nsmax))) {
             trace(1,"decode_seph malloc error: n=%d\n",nav->nsmax);
@@ -1396,6 +1403,7 @@ static int add_seph(nav_t *nav, const seph_t *seph)
             return 0;
         }
         nav->seph=nav_seph;
+        memacct(MEM_NAV,(int64_t)sizeof(seph_t)*nav->nsmax);
     }
     nav->seph[nav->ns++]=*seph;
     return 1;
@@ -1460,6 +1468,7 @@ static int readrnxclk(FILE *fp, const char *opt, int index, nav_t *nav)
         for (i=0,j=40;i<2;i++,j+=20) data[i]=str2num(buff,j,19);
         
         if (nav->nc>=nav->ncmax) {
+            memacct(MEM_PREC,-(int64_t)sizeof(pclk_t)*nav->ncmax);
             nav->ncmax+=1024;
             if (!(nav_pclk=(pclk_t *)realloc(nav->pclk,sizeof(pclk_t)*(nav->ncmax)))) {
                 trace(1,"readrnxclk malloc error: nmax=%d\n",nav->ncmax);
@@ -1467,6 +1476,7 @@ static int readrnxclk(FILE *fp, const char *opt, int index, nav_t *nav)
                 return -1;
             }
             nav->pclk=nav_pclk;
+            memacct(MEM_PREC,(int64_t)sizeof(pclk_t)*nav->ncmax);
         }
         if (nav->nc<=0||fabs(timediff(time,nav->pclk[nav->nc-1].time))>1E-9) {
             nav->nc++;
@@ -1656,6 +1666,7 @@ static void combpclk(nav_t *nav)
     }
     nav->nc=i+1;
     
+    memacct(MEM_PREC,-(int64_t)sizeof(pclk_t)*nav->ncmax);
     if (!(nav_pclk=(pclk_t *)realloc(nav->pclk,sizeof(pclk_t)*nav->nc))) {
         free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;
         trace(1,"combpclk malloc error nc=%d\n",nav->nc);
@@ -1663,6 +1674,7 @@ static void combpclk(nav_t *nav)
     }
     nav->pclk=nav_pclk;
     nav->ncmax=nav->nc;
+    memacct(MEM_PREC,(int64_t)sizeof(pclk_t)*nav->ncmax);
     
     trace(4,"combpclk: nc=%d\n",nav->nc);
 }
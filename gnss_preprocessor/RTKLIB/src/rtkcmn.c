@@ -153,6 +153,9 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#else
+#include <io.h>
 #endif
 #include "rtklib.h"
 
@@ -163,10 +166,12 @@
 
 #define SQR(x)      ((x)*(x))
 #define MAX_VAR_EPH SQR(300.0)  /* max variance eph to reject satellite (m^2) */
+#define NSATTBL     256         /* size of satellite number tables */
+#define NSYSTBL     8           /* number of systems of satellite/code tables */
 
-static const double gpst0[]={1980,1, 6,0,0,0}; /* gps time reference */
-static const double gst0 []={1999,8,22,0,0,0}; /* galileo system time reference */
-static const double bdt0 []={2006,1, 1,0,0,0}; /* beidou time reference */
+static const time_t gpst0= 315964800; /* gps time reference (1980/1/6) */
+static const time_t gst0 = 935280000; /* galileo time reference (1999/8/22) */
+static const time_t bdt0 =1136073600; /* beidou time reference (2006/1/1) */
 
 static double leaps[MAXLEAPS+1][7]={ /* leap seconds (y,m,d,h,m,s,utc-gpst) */
     {2017,1,1,0,0,0,-18},
@@ -189,6 +194,8 @@ static double leaps[MAXLEAPS+1][7]={ /* leap seconds (y,m,d,h,m,s,utc-gpst) */
     {1981,7,1,0,0,0, -1},
     {0}
 };
+static time_t leapt[MAXLEAPS+1];    /* start times of leap seconds (utc) */
+static int leapt_ok=0;              /* leapt state (0:unset,1:setting,2:set) */
 const double chisqr[100]={      /* chi-sqr(n) (alpha=0.001) */
     10.8,13.8,16.3,18.5,20.5,22.5,24.3,26.1,27.9,29.6,
     31.3,32.9,34.5,36.1,37.7,39.3,40.8,42.3,43.8,45.3,
@@ -269,8 +276,129 @@ static char codepris[7][MAXFREQ][16]={  /* code priority for each freq-index */
     {"IQXDPAN" ,"IQXDPZ"    ,"DPX"     ,"IQXA"   ,"DPX"    ,""      ,""}, /* BDS */
     {"ABCX"    ,"ABCX"      ,""        ,""       ,""       ,""      ,""}  /* IRN */
 };
+static uint8_t codepri[NSYSTBL+1][MAXCODE+1]; /* code priority by code */
+static int codepri_ok=0;            /* code priority by code set */
 static fatalfunc_t *fatalfunc=NULL; /* fatal callback function */
 
+/* satellite and obs code tables -----------------------------------------------
+* the tables are generated at compile time by the macros below from the
+* satellite numbering of satno() and the frequency bands of obscodes[].
+* rows of the tables by system are indexed by sysidx[] (0: no system).
+*-----------------------------------------------------------------------------*/
+#if MAXSAT>=NSATTBL||MAXPRNQZS>=NSATTBL
+#error "satellite number tables too small"
+#endif
+#define OFSGLO      (NSATGPS)       /* satellite number offset of GLONASS */
+#define OFSGAL      (OFSGLO+NSATGLO) /* satellite number offset of Galileo */
+#define OFSQZS      (OFSGAL+NSATGAL) /* satellite number offset of QZSS */
+#define OFSCMP      (OFSQZS+NSATQZS) /* satellite number offset of BeiDou */
+#define OFSIRN      (OFSCMP+NSATCMP) /* satellite number offset of NavIC */
+#define OFSLEO      (OFSIRN+NSATIRN) /* satellite number offset of LEO */
+#define OFSSBS      (OFSLEO+NSATLEO) /* satellite number offset of SBAS */
+
+#define REP4_(M,i,n)   M(i,n) M(i,(n)+1) M(i,(n)+2) M(i,(n)+3)
+#define REP16_(M,i,n)  REP4_(M,i,n) REP4_(M,i,(n)+4) REP4_(M,i,(n)+8) \
+                       REP4_(M,i,(n)+12)
+#define REP64_(M,i,n)  REP16_(M,i,n) REP16_(M,i,(n)+16) REP16_(M,i,(n)+32) \
+                       REP16_(M,i,(n)+48)
+#define REP256_(M,i,n) REP64_(M,i,n) REP64_(M,i,(n)+64) REP64_(M,i,(n)+128) \
+                       REP64_(M,i,(n)+192)
+
+/* system and prn/slot number of satellite number s */
+#define SATSYS_(s) \
+    ((s)<=0     ?SYS_NONE:(s)<=OFSGLO?SYS_GPS:(s)<=OFSGAL?SYS_GLO: \
+     (s)<=OFSQZS?SYS_GAL :(s)<=OFSCMP?SYS_QZS:(s)<=OFSIRN?SYS_CMP: \
+     (s)<=OFSLEO?SYS_IRN :(s)<=OFSSBS?SYS_LEO:(s)<=MAXSAT?SYS_SBS:SYS_NONE)
+#define SATPRN_(s) \
+    ((s)<=0     ?0: \
+     (s)<=OFSGLO?(s)+MINPRNGPS-1       :(s)<=OFSGAL?(s)-OFSGLO+MINPRNGLO-1: \
+     (s)<=OFSQZS?(s)-OFSGAL+MINPRNGAL-1:(s)<=OFSCMP?(s)-OFSQZS+MINPRNQZS-1: \
+     (s)<=OFSIRN?(s)-OFSCMP+MINPRNCMP-1:(s)<=OFSLEO?(s)-OFSIRN+MINPRNIRN-1: \
+     (s)<=OFSSBS?(s)-OFSLEO+MINPRNLEO-1:(s)<=MAXSAT?(s)-OFSSBS+MINPRNSBS-1:0)
+#define SATENT_(i,s) {SATSYS_(s),SATPRN_(s)},
+
+/* satellite number of prn/slot number p of system row i */
+#define SATNUM_(p,min,max,ofs) \
+    ((p)>0&&(min)<=(p)&&(p)<=(max)?(p)-(min)+(ofs)+1:0)
+#define SATNO_(i,p) \
+    ((i)==1?SATNUM_(p,MINPRNGPS,MAXPRNGPS,0     ): \
+     (i)==2?SATNUM_(p,MINPRNGLO,MAXPRNGLO,OFSGLO): \
+     (i)==3?SATNUM_(p,MINPRNGAL,MAXPRNGAL,OFSGAL): \
+     (i)==4?SATNUM_(p,MINPRNQZS,MAXPRNQZS,OFSQZS): \
+     (i)==5?SATNUM_(p,MINPRNSBS,MAXPRNSBS,OFSSBS): \
+     (i)==6?SATNUM_(p,MINPRNCMP,MAXPRNCMP,OFSCMP): \
+     (i)==7?SATNUM_(p,MINPRNIRN,MAXPRNIRN,OFSIRN): \
+     (i)==8?SATNUM_(p,MINPRNLEO,MAXPRNLEO,OFSLEO):0)
+#define SATNOENT_(i,p) SATNO_(i,p),
+
+/* frequency bands of obscodes[] */
+#define B5_(M,i,a,b,c,d,e) M(i,a) M(i,b) M(i,c) M(i,d) M(i,e)
+#define CODEBANDS_(M,i) \
+    B5_(M,i,0,1,1,1,1) B5_(M,i,1,1,1,1,1) /*  0- 9 */ \
+    B5_(M,i,1,1,1,1,2) B5_(M,i,2,2,2,2,2) /* 10-19 */ \
+    B5_(M,i,2,2,2,2,5) B5_(M,i,5,5,7,7,7) /* 20-29 */ \
+    B5_(M,i,6,6,6,6,6) B5_(M,i,6,6,8,8,8) /* 30-39 */ \
+    B5_(M,i,2,2,6,6,3) B5_(M,i,3,3,1,1,5) /* 40-49 */ \
+    B5_(M,i,5,5,9,9,9) B5_(M,i,9,1,5,5,5) /* 50-59 */ \
+    B5_(M,i,6,7,7,7,8) M(i,8) M(i,4) M(i,4) M(i,4) /* 60-68 */
+
+/* frequency index of band b of system row i (see code2idx()) */
+#define BIDX_(b,k) ((uint64_t)((k)+1)<<(4*(b)))
+#define BANDMAP_(i) \
+    ((i)==1?BIDX_(1,0)|BIDX_(2,1)|BIDX_(5,2):                        /* GPS */ \
+     (i)==2?BIDX_(1,0)|BIDX_(2,1)|BIDX_(3,2)|BIDX_(4,0)|BIDX_(6,1):  /* GLO */ \
+     (i)==3?BIDX_(1,0)|BIDX_(7,1)|BIDX_(5,2)|BIDX_(6,3)|BIDX_(8,4):  /* GAL */ \
+     (i)==4?BIDX_(1,0)|BIDX_(2,1)|BIDX_(5,2)|BIDX_(6,3):             /* QZS */ \
+     (i)==5?BIDX_(1,0)|BIDX_(5,1):                                   /* SBS */ \
+     (i)==6?BIDX_(1,0)|BIDX_(2,0)|BIDX_(7,1)|BIDX_(5,2)|BIDX_(6,3)|  /* BDS */ \
+            BIDX_(8,4): \
+     (i)==7?BIDX_(5,0)|BIDX_(9,1):0)                                 /* IRN */
+#define BANDIDX_(i,b) ((int)((BANDMAP_(i)>>(4*(b)))&0xF)-1)
+#define IDXENT_(i,b) BANDIDX_(i,b),
+
+/* carrier frequency of band b of system row i (GLONASS: fcn=0) */
+#define BANDFRQ_(i,b) \
+    (BANDIDX_(i,b)<0?0.0: \
+     (i)==2?((b)==1?FREQ1_GLO:(b)==2?FREQ2_GLO:(b)==3?FREQ3_GLO: \
+             (b)==4?FREQ1a_GLO:FREQ2a_GLO): \
+     (i)==6&&(b)==2?FREQ1_CMP:(i)==6&&(b)==7?FREQ2_CMP: \
+     (i)==6&&(b)==6?FREQ3_CMP: \
+     (b)==1?FREQ1:(b)==2?FREQ2:(b)==5?FREQ5:(b)==6?FREQ6: \
+     (b)==7?FREQ7:(b)==8?FREQ8:FREQ9)
+#define FRQENT_(i,b) BANDFRQ_(i,b),
+
+/* GLONASS frequency step per fcn of band b */
+#define DFRQENT_(i,b) ((b)==1?DFRQ1_GLO:(b)==2?DFRQ2_GLO:0.0),
+
+static const uint8_t sysidx[SYS_LEO+1]={ /* system row of tables (0: none) */
+    [SYS_GPS]=1,[SYS_GLO]=2,[SYS_GAL]=3,[SYS_QZS]=4,[SYS_SBS]=5,[SYS_CMP]=6,
+    [SYS_IRN]=7,[SYS_LEO]=8
+};
+static const struct {               /* system and prn/slot by satellite */
+    uint8_t sys,prn;
+} satent[NSATTBL]={
+    REP256_(SATENT_,0,0)
+};
+static const uint8_t satnos[NSYSTBL+1][NSATTBL]={ /* satellite number by prn */
+    {0},
+    {REP256_(SATNOENT_,1,0)},{REP256_(SATNOENT_,2,0)},{REP256_(SATNOENT_,3,0)},
+    {REP256_(SATNOENT_,4,0)},{REP256_(SATNOENT_,5,0)},{REP256_(SATNOENT_,6,0)},
+    {REP256_(SATNOENT_,7,0)},{REP256_(SATNOENT_,8,0)}
+};
+static const int8_t codeidxs[NSYSTBL+1][MAXCODE+1]={ /* freq index by code */
+    {CODEBANDS_(IDXENT_,0)},{CODEBANDS_(IDXENT_,1)},{CODEBANDS_(IDXENT_,2)},
+    {CODEBANDS_(IDXENT_,3)},{CODEBANDS_(IDXENT_,4)},{CODEBANDS_(IDXENT_,5)},
+    {CODEBANDS_(IDXENT_,6)},{CODEBANDS_(IDXENT_,7)},{CODEBANDS_(IDXENT_,8)}
+};
+static const double codefrqs[NSYSTBL+1][MAXCODE+1]={ /* frequency by code */
+    {CODEBANDS_(FRQENT_,0)},{CODEBANDS_(FRQENT_,1)},{CODEBANDS_(FRQENT_,2)},
+    {CODEBANDS_(FRQENT_,3)},{CODEBANDS_(FRQENT_,4)},{CODEBANDS_(FRQENT_,5)},
+    {CODEBANDS_(FRQENT_,6)},{CODEBANDS_(FRQENT_,7)},{CODEBANDS_(FRQENT_,8)}
+};
+static const double codedfrq[MAXCODE+1]={ /* GLONASS frequency step by code */
+    CODEBANDS_(DFRQENT_,0)
+};
+
 /* crc tables generated by util/gencrc ---------------------------------------*/
 static const uint16_t tbl_CRC16[]={
     0x0000,0x1021,0x2042,0x3063,0x4084,0x50A5,0x60C6,0x70E7,
@@ -390,36 +518,8 @@ extern void add_fatal(fatalfunc_t *func)
 *-----------------------------------------------------------------------------*/
 extern int satno(int sys, int prn)
 {
-    if (prn<=0) return 0;
-    switch (sys) {
-        case SYS_GPS:
-            if (prn<MINPRNGPS||MAXPRNGPS<prn) return 0;
-            return prn-MINPRNGPS+1;
-        case SYS_GLO:
-            if (prn<MINPRNGLO||MAXPRNGLO<prn) return 0;
-            return NSATGPS+prn-MINPRNGLO+1;
-        case SYS_GAL:
-            if (prn<MINPRNGAL||MAXPRNGAL<prn) return 0;
-            return NSATGPS+NSATGLO+prn-MINPRNGAL+1;
-        case SYS_QZS:
-            if (prn<MINPRNQZS||MAXPRNQZS<prn) return 0;
-            return NSATGPS+NSATGLO+NSATGAL+prn-MINPRNQZS+1;
-        case SYS_CMP:
-            if (prn<MINPRNCMP||MAXPRNCMP<prn) return 0;
-            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+prn-MINPRNCMP+1;
-        case SYS_IRN:
-            if (prn<MINPRNIRN||MAXPRNIRN<prn) return 0;
-            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+NSATCMP+prn-MINPRNIRN+1;
-        case SYS_LEO:
-            if (prn<MINPRNLEO||MAXPRNLEO<prn) return 0;
-            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+NSATCMP+NSATIRN+
-                   prn-MINPRNLEO+1;
-        case SYS_SBS:
-            if (prn<MINPRNSBS||MAXPRNSBS<prn) return 0;
-            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+NSATCMP+NSATIRN+NSATLEO+
-                   prn-MINPRNSBS+1;
-    }
-    return 0;
+    if (sys<=0||SYS_LEO<sys||prn<=0||NSATTBL<=prn) return 0;
+    return satnos[sysidx[sys]][prn];
 }
 /* satellite number to satellite system ----------------------------------------
 * convert satellite number to satellite system
@@ -429,35 +529,9 @@ extern int satno(int sys, int prn)
 *-----------------------------------------------------------------------------*/
 extern int satsys(int sat, int *prn)
 {
-    int sys=SYS_NONE;
     if (sat<=0||MAXSAT<sat) sat=0;
-    else if (sat<=NSATGPS) {
-        sys=SYS_GPS; sat+=MINPRNGPS-1;
-    }
-    else if ((sat-=NSATGPS)<=NSATGLO) {
-        sys=SYS_GLO; sat+=MINPRNGLO-1;
-    }
-    else if ((sat-=NSATGLO)<=NSATGAL) {
-        sys=SYS_GAL; sat+=MINPRNGAL-1;
-    }
-    else if ((sat-=NSATGAL)<=NSATQZS) {
-        sys=SYS_QZS; sat+=MINPRNQZS-1; 
-    }
-    else if ((sat-=NSATQZS)<=NSATCMP) {
-        sys=SYS_CMP; sat+=MINPRNCMP-1; 
-    }
-    else if ((sat-=NSATCMP)<=NSATIRN) {
-        sys=SYS_IRN; sat+=MINPRNIRN-1; 
-    }
-    else if ((sat-=NSATIRN)<=NSATLEO) {
-        sys=SYS_LEO; sat+=MINPRNLEO-1; 
-    }
-    else if ((sat-=NSATLEO)<=NSATSBS) {
-        sys=SYS_SBS; sat+=MINPRNSBS-1; 
-    }
-    else sat=0;
-    if (prn) *prn=sat;
-    return sys;
+    if (prn) *prn=satent[sat].prn;
+    return satent[sat].sys;
 }
 /* satellite id to satellite number --------------------------------------------
 * convert satellite id to satellite number
@@ -595,98 +669,6 @@ extern char *code2obs(uint8_t code)
     if (code<=CODE_NONE||MAXCODE<code) return "";
     return obscodes[code];
 }
-/* GPS obs code to frequency -------------------------------------------------*/
-static int code2freq_GPS(uint8_t code, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    switch (obs[0]) {
-        case '1': *freq=FREQ1; return 0; /* L1 */
-        case '2': *freq=FREQ2; return 1; /* L2 */
-        case '5': *freq=FREQ5; return 2; /* L5 */
-    }
-    return -1;
-}
-/* GLONASS obs code to frequency ---------------------------------------------*/
-static int code2freq_GLO(uint8_t code, int fcn, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    if (fcn<-7||fcn>6) return -1;
-    
-    switch (obs[0]) {
-        case '1': *freq=FREQ1_GLO+DFRQ1_GLO*fcn; return 0; /* G1 */
-        case '2': *freq=FREQ2_GLO+DFRQ2_GLO*fcn; return 1; /* G2 */
-        case '3': *freq=FREQ3_GLO;               return 2; /* G3 */
-        case '4': *freq=FREQ1a_GLO;              return 0; /* G1a */
-        case '6': *freq=FREQ2a_GLO;              return 1; /* G2a */
-    }
-    return -1;
-}
-/* Galileo obs code to frequency ---------------------------------------------*/
-static int code2freq_GAL(uint8_t code, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    switch (obs[0]) {
-        case '1': *freq=FREQ1; return 0; /* E1 */
-        case '7': *freq=FREQ7; return 1; /* E5b */
-        case '5': *freq=FREQ5; return 2; /* E5a */
-        case '6': *freq=FREQ6; return 3; /* E6 */
-        case '8': *freq=FREQ8; return 4; /* E5ab */
-    }
-    return -1;
-}
-/* QZSS obs code to frequency ------------------------------------------------*/
-static int code2freq_QZS(uint8_t code, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    switch (obs[0]) {
-        case '1': *freq=FREQ1; return 0; /* L1 */
-        case '2': *freq=FREQ2; return 1; /* L2 */
-        case '5': *freq=FREQ5; return 2; /* L5 */
-        case '6': *freq=FREQ6; return 3; /* L6 */
-    }
-    return -1;
-}
-/* SBAS obs code to frequency ------------------------------------------------*/
-static int code2freq_SBS(uint8_t code, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    switch (obs[0]) {
-        case '1': *freq=FREQ1; return 0; /* L1 */
-        case '5': *freq=FREQ5; return 1; /* L5 */
-    }
-    return -1;
-}
-/* BDS obs code to frequency -------------------------------------------------*/
-static int code2freq_BDS(uint8_t code, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    switch (obs[0]) {
-        case '1': *freq=FREQ1;     return 0; /* B1C */
-        case '2': *freq=FREQ1_CMP; return 0; /* B1I */
-        case '7': *freq=FREQ2_CMP; return 1; /* B2I/B2b */
-        case '5': *freq=FREQ5;     return 2; /* B2a */
-        case '6': *freq=FREQ3_CMP; return 3; /* B3 */
-        case '8': *freq=FREQ8;     return 4; /* B2ab */
-    }
-    return -1;
-}
-/* NavIC obs code to frequency -----------------------------------------------*/
-static int code2freq_IRN(uint8_t code, double *freq)
-{
-    char *obs=code2obs(code);
-    
-    switch (obs[0]) {
-        case '5': *freq=FREQ5; return 0; /* L5 */
-        case '9': *freq=FREQ9; return 1; /* S */
-    }
-    return -1;
-}
 /* system and obs code to frequency index --------------------------------------
 * convert system and obs code to frequency index
 * args   : int    sys       I   satellite system (SYS_???)
@@ -704,18 +686,8 @@ static int code2freq_IRN(uint8_t code, double *freq)
 *-----------------------------------------------------------------------------*/
 extern int code2idx(int sys, uint8_t code)
 {
-    double freq;
-    
-    switch (sys) {
-        case SYS_GPS: return code2freq_GPS(code,&freq);
-        case SYS_GLO: return code2freq_GLO(code,0,&freq);
-        case SYS_GAL: return code2freq_GAL(code,&freq);
-        case SYS_QZS: return code2freq_QZS(code,&freq);
-        case SYS_SBS: return code2freq_SBS(code,&freq);
-        case SYS_CMP: return code2freq_BDS(code,&freq);
-        case SYS_IRN: return code2freq_IRN(code,&freq);
-    }
-    return -1;
+    if (sys<=0||SYS_LEO<sys||MAXCODE<code) return -1;
+    return codeidxs[sysidx[sys]][code];
 }
 /* system and obs code to frequency --------------------------------------------
 * convert system and obs code to carrier frequency
@@ -726,18 +698,12 @@ extern int code2idx(int sys, uint8_t code)
 *-----------------------------------------------------------------------------*/
 extern double code2freq(int sys, uint8_t code, int fcn)
 {
-    double freq=0.0;
-    
-    switch (sys) {
-        case SYS_GPS: (void)code2freq_GPS(code,&freq); break;
-        case SYS_GLO: (void)code2freq_GLO(code,fcn,&freq); break;
-        case SYS_GAL: (void)code2freq_GAL(code,&freq); break;
-        case SYS_QZS: (void)code2freq_QZS(code,&freq); break;
-        case SYS_SBS: (void)code2freq_SBS(code,&freq); break;
-        case SYS_CMP: (void)code2freq_BDS(code,&freq); break;
-        case SYS_IRN: (void)code2freq_IRN(code,&freq); break;
+    if (sys<=0||SYS_LEO<sys||MAXCODE<code) return 0.0;
+    if (sys==SYS_GLO) {
+        if (fcn<-7||fcn>6) return 0.0;
+        return codefrqs[sysidx[sys]][code]+codedfrq[code]*fcn;
     }
-    return freq;
+    return codefrqs[sysidx[sys]][code];
 }
 /* satellite and obs code to frequency -----------------------------------------
 * convert satellite and obs code to carrier frequency
@@ -745,6 +711,8 @@ extern double code2freq(int sys, uint8_t code, int fcn)
 *          uint8_t code     I   obs code (CODE_???)
 *          nav_t  *nav_t    I   navigation data for GLONASS (NULL: not used)
 * return : carrier frequency (Hz) (0.0: error)
+* notes  : the GLONASS fcn is taken from nav->glo_fcn[] (set by uniqnav() from
+*          the ephemerides) or else searched in the ephemerides
 *-----------------------------------------------------------------------------*/
 extern double sat2freq(int sat, uint8_t code, const nav_t *nav)
 {
@@ -754,19 +722,36 @@ extern double sat2freq(int sat, uint8_t code, const nav_t *nav)
     
     if (sys==SYS_GLO) {
         if (!nav) return 0.0;
-        for (i=0;i<nav->ng;i++) {
-            if (nav->geph[i].sat==sat) break;
+        if (nav->glo_fcn[prn-1]>0) {
+            fcn=nav->glo_fcn[prn-1]-8;
         }
-        if (i<nav->ng) {
+        else {
+            for (i=0;i<nav->ng;i++) {
+                if (nav->geph[i].sat==sat) break;
+            }
+            if (i>=nav->ng) return 0.0;
             fcn=nav->geph[i].frq;
         }
-        else if (nav->glo_fcn[prn-1]>0) {
-            fcn=nav->glo_fcn[prn-1]-8;
-        }
-        else return 0.0;
     }
     return code2freq(sys,code,fcn);
 }
+/* set code priority by code ---------------------------------------------------
+* set the table of code priorities by code from codepris[]
+*-----------------------------------------------------------------------------*/
+static void setcodepris(void)
+{
+    static const int sys[]={SYS_GPS,SYS_GLO,SYS_GAL,SYS_QZS,SYS_SBS,SYS_CMP,
+                            SYS_IRN};
+    const char *p;
+    int i,j,code;
+    
+    for (i=0;i<7;i++) for (code=1;code<=MAXCODE;code++) {
+        if ((j=code2idx(sys[i],(uint8_t)code))<0) continue;
+        p=strchr(codepris[i][j],obscodes[code][1]);
+        codepri[sysidx[sys[i]]][code]=p?14-(int)(p-codepris[i][j]):0;
+    }
+    __atomic_store_n(&codepri_ok,1,__ATOMIC_RELEASE);
+}
 /* set code priority -----------------------------------------------------------
 * set code priority for multiple codes in a frequency
 * args   : int    sys       I   system (or of SYS_???)
@@ -787,6 +772,8 @@ extern void setcodepri(int sys, int idx, const char *pri)
     if (sys&SYS_SBS) strcpy(codepris[4][idx],pri);
     if (sys&SYS_CMP) strcpy(codepris[5][idx],pri);
     if (sys&SYS_IRN) strcpy(codepris[6][idx],pri);
+    
+    setcodepris();
 }
 /* get code priority -----------------------------------------------------------
 * get code priority for multiple codes in a frequency
@@ -799,28 +786,33 @@ extern int getcodepri(int sys, uint8_t code, const char *opt)
 {
     const char *p,*optstr;
     char *obs,str[8]="";
-    int i,j;
+    
+    if (sys<=0||SYS_LEO<sys||MAXCODE<code||!sysidx[sys]) return 0;
+    
+    if (!__atomic_load_n(&codepri_ok,__ATOMIC_ACQUIRE)) setcodepris();
+    
+    /* search code priority */
+    if (!opt||!strchr(opt,'-')) return codepri[sysidx[sys]][code];
     
     switch (sys) {
-        case SYS_GPS: i=0; optstr="-GL%2s"; break;
-        case SYS_GLO: i=1; optstr="-RL%2s"; break;
-        case SYS_GAL: i=2; optstr="-EL%2s"; break;
-        case SYS_QZS: i=3; optstr="-JL%2s"; break;
-        case SYS_SBS: i=4; optstr="-SL%2s"; break;
-        case SYS_CMP: i=5; optstr="-CL%2s"; break;
-        case SYS_IRN: i=6; optstr="-IL%2s"; break;
+        case SYS_GPS: optstr="-GL%2s"; break;
+        case SYS_GLO: optstr="-RL%2s"; break;
+        case SYS_GAL: optstr="-EL%2s"; break;
+        case SYS_QZS: optstr="-JL%2s"; break;
+        case SYS_SBS: optstr="-SL%2s"; break;
+        case SYS_CMP: optstr="-CL%2s"; break;
+        case SYS_IRN: optstr="-IL%2s"; break;
         default: return 0;
     }
-    if ((j=code2idx(sys,code))<0) return 0;
+    if (code2idx(sys,code)<0) return 0;
     obs=code2obs(code);
     
     /* parse code options */
-    for (p=opt;p&&(p=strchr(p,'-'));p++) {
+    for (p=opt;(p=strchr(p,'-'));p++) {
         if (sscanf(p,optstr,str)<1||str[0]!=obs[0]) continue;
         return str[1]==obs[1]?15:0;
     }
-    /* search code priority */
-    return (p=strchr(codepris[i][j],obs[1]))?14-(int)(p-codepris[i][j]):0;
+    return codepri[sysidx[sys]][code];
 }
 /* extract unsigned/signed bits ------------------------------------------------
 * extract unsigned/signed bits from byte data
@@ -1470,7 +1462,7 @@ extern void time2epoch(gtime_t t, double *ep)
 *-----------------------------------------------------------------------------*/
 extern gtime_t gpst2time(int week, double sec)
 {
-    gtime_t t=epoch2time(gpst0);
+    gtime_t t={gpst0};
     
     if (sec<-1E9||1E9<sec) sec=0.0;
     t.time+=(time_t)86400*7*week+(int)sec;
@@ -1485,8 +1477,7 @@ extern gtime_t gpst2time(int week, double sec)
 *-----------------------------------------------------------------------------*/
 extern double time2gpst(gtime_t t, int *week)
 {
-    gtime_t t0=epoch2time(gpst0);
-    time_t sec=t.time-t0.time;
+    time_t sec=t.time-gpst0;
     int w=(int)(sec/(86400*7));
     
     if (week) *week=w;
@@ -1500,7 +1491,7 @@ extern double time2gpst(gtime_t t, int *week)
 *-----------------------------------------------------------------------------*/
 extern gtime_t gst2time(int week, double sec)
 {
-    gtime_t t=epoch2time(gst0);
+    gtime_t t={gst0};
     
     if (sec<-1E9||1E9<sec) sec=0.0;
     t.time+=(time_t)86400*7*week+(int)sec;
@@ -1515,8 +1506,7 @@ extern gtime_t gst2time(int week, double sec)
 *-----------------------------------------------------------------------------*/
 extern double time2gst(gtime_t t, int *week)
 {
-    gtime_t t0=epoch2time(gst0);
-    time_t sec=t.time-t0.time;
+    time_t sec=t.time-gst0;
     int w=(int)(sec/(86400*7));
     
     if (week) *week=w;
@@ -1530,7 +1520,7 @@ extern double time2gst(gtime_t t, int *week)
 *-----------------------------------------------------------------------------*/
 extern gtime_t bdt2time(int week, double sec)
 {
-    gtime_t t=epoch2time(bdt0);
+    gtime_t t={bdt0};
     
     if (sec<-1E9||1E9<sec) sec=0.0;
     t.time+=(time_t)86400*7*week+(int)sec;
@@ -1545,8 +1535,7 @@ extern gtime_t bdt2time(int week, double sec)
 *-----------------------------------------------------------------------------*/
 extern double time2bdt(gtime_t t, int *week)
 {
-    gtime_t t0=epoch2time(bdt0);
-    time_t sec=t.time-t0.time;
+    time_t sec=t.time-bdt0;
     int w=(int)(sec/(86400*7));
     
     if (week) *week=w;
@@ -1572,7 +1561,35 @@ extern gtime_t timeadd(gtime_t t, double sec)
 *-----------------------------------------------------------------------------*/
 extern double timediff(gtime_t t1, gtime_t t2)
 {
-    return difftime(t1.time,t2.time)+t1.sec-t2.sec;
+    return (double)(t1.time-t2.time)+t1.sec-t2.sec;
+}
+/* time to time in ns ----------------------------------------------------------
+* convert gtime_t struct to integer time in ns
+* args   : gtime_t t        I   gtime_t struct
+* return : time (ns) since 1970/1/1 in the time system of t
+* notes  : fraction of second is rounded to ns
+*-----------------------------------------------------------------------------*/
+extern gtimens_t time2ns(gtime_t t)
+{
+    double tt=floor(t.sec);
+    
+    return ((gtimens_t)t.time+(gtimens_t)tt)*NS_SEC+
+           (gtimens_t)floor((t.sec-tt)*1E9+0.5);
+}
+/* time in ns to time ----------------------------------------------------------
+* convert integer time in ns to gtime_t struct
+* args   : gtimens_t t      I   time (ns) since 1970/1/1
+* return : gtime_t struct
+*-----------------------------------------------------------------------------*/
+extern gtime_t ns2time(gtimens_t t)
+{
+    gtime_t time;
+    gtimens_t sec=t/NS_SEC,ns=t%NS_SEC;
+    
+    if (ns<0) {sec--; ns+=NS_SEC;}
+    time.time=(time_t)sec;
+    time.sec=ns*1E-9;
+    return time;
 }
 /* get current time in utc -----------------------------------------------------
 * get current time in utc
@@ -1593,9 +1610,9 @@ extern gtime_t timeget(void)
     ep[3]=ts.wHour; ep[4]=ts.wMinute; ep[5]=ts.wSecond+ts.wMilliseconds*1E-3;
 #else
     struct timeval tv;
-    struct tm *tt;
+    struct tm tm,*tt;
     
-    if (!gettimeofday(&tv,NULL)&&(tt=gmtime(&tv.tv_sec))) {
+    if (!gettimeofday(&tv,NULL)&&(tt=gmtime_r(&tv.tv_sec,&tm))) {
         ep[0]=tt->tm_year+1900; ep[1]=tt->tm_mon+1; ep[2]=tt->tm_mday;
         ep[3]=tt->tm_hour; ep[4]=tt->tm_min; ep[5]=tt->tm_sec+tv.tv_usec*1E-6;
     }
@@ -1683,6 +1700,7 @@ static int read_leaps_usno(FILE *fp)
 *              year month day hour min sec UTC-GPST(s)
 *          (2) The date and time indicate the start UTC time for the UTC-GPST
 *          (3) The date and time should be descending order.
+*          the table is not locked. call it before the processing threads.
 *-----------------------------------------------------------------------------*/
 extern int read_leaps(const char *file)
 {
@@ -1698,8 +1716,28 @@ extern int read_leaps(const char *file)
     }
     for (i=0;i<7;i++) leaps[n][i]=0.0;
     fclose(fp);
+    
+    /* start times of leap seconds of new table */
+    for (i=0;leaps[i][0]>0;i++) leapt[i]=epoch2time(leaps[i]).time;
+    __atomic_store_n(&leapt_ok,2,__ATOMIC_RELEASE);
     return 1;
 }
+/* set start times of leap seconds ---------------------------------------------
+* set start times of leap seconds of the default table by the first caller.
+* the other callers wait until the times are set.
+*-----------------------------------------------------------------------------*/
+static void setleapt(void)
+{
+    int i,stat=0;
+    
+    if (!__atomic_compare_exchange_n(&leapt_ok,&stat,1,0,__ATOMIC_ACQUIRE,
+                                     __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&leapt_ok,__ATOMIC_ACQUIRE)!=2) sleepms(0);
+        return;
+    }
+    for (i=0;leaps[i][0]>0;i++) leapt[i]=epoch2time(leaps[i]).time;
+    __atomic_store_n(&leapt_ok,2,__ATOMIC_RELEASE);
+}
 /* gpstime to utc --------------------------------------------------------------
 * convert gpstime to utc considering leap seconds
 * args   : gtime_t t        I   time expressed in gpstime
@@ -1711,9 +1749,11 @@ extern gtime_t gpst2utc(gtime_t t)
     gtime_t tu;
     int i;
     
+    if (__atomic_load_n(&leapt_ok,__ATOMIC_ACQUIRE)!=2) setleapt();
+    
     for (i=0;leaps[i][0]>0;i++) {
         tu=timeadd(t,leaps[i][6]);
-        if (timediff(tu,epoch2time(leaps[i]))>=0.0) return tu;
+        if ((double)(tu.time-leapt[i])+tu.sec>=0.0) return tu;
     }
     return t;
 }
@@ -1727,8 +1767,46 @@ extern gtime_t utc2gpst(gtime_t t)
 {
     int i;
     
+    if (__atomic_load_n(&leapt_ok,__ATOMIC_ACQUIRE)!=2) setleapt();
+    
+    for (i=0;leaps[i][0]>0;i++) {
+        if ((double)(t.time-leapt[i])+t.sec<0.0) continue;
+        return timeadd(t,-leaps[i][6]);
+    }
+    return t;
+}
+/* gpstime to utc in ns --------------------------------------------------------
+* convert gpstime to utc considering leap seconds with integer time in ns
+* args   : gtimens_t t      I   time (ns) expressed in gpstime
+* return : time (ns) expressed in utc
+*-----------------------------------------------------------------------------*/
+extern gtimens_t gpst2utcns(gtimens_t t)
+{
+    gtimens_t ls;
+    int i;
+    
+    if (__atomic_load_n(&leapt_ok,__ATOMIC_ACQUIRE)!=2) setleapt();
+    
     for (i=0;leaps[i][0]>0;i++) {
-        if (timediff(t,epoch2time(leaps[i]))>=0.0) return timeadd(t,-leaps[i][6]);
+        ls=(gtimens_t)leaps[i][6]*NS_SEC;
+        if (t+ls>=(gtimens_t)leapt[i]*NS_SEC) return t+ls;
+    }
+    return t;
+}
+/* utc to gpstime in ns --------------------------------------------------------
+* convert utc to gpstime considering leap seconds with integer time in ns
+* args   : gtimens_t t      I   time (ns) expressed in utc
+* return : time (ns) expressed in gpstime
+*-----------------------------------------------------------------------------*/
+extern gtimens_t utc2gpstns(gtimens_t t)
+{
+    int i;
+    
+    if (__atomic_load_n(&leapt_ok,__ATOMIC_ACQUIRE)!=2) setleapt();
+    
+    for (i=0;leaps[i][0]>0;i++) {
+        if (t<(gtimens_t)leapt[i]*NS_SEC) continue;
+        return t-(gtimens_t)leaps[i][6]*NS_SEC;
     }
     return t;
 }
@@ -1811,7 +1889,7 @@ extern void time2str(gtime_t t, char *s, int n)
 *-----------------------------------------------------------------------------*/
 extern char *time_str(gtime_t t, int n)
 {
-    static char buff[64];
+    static THREADLOCAL char buff[64];
     time2str(t,buff,n);
     return buff;
 }
@@ -2204,8 +2282,8 @@ static void nut_iau1980(double t, const double *f, double *dpsi, double *deps)
 extern void eci2ecef(gtime_t tutc, const double *erpv, double *U, double *gmst)
 {
     const double ep2000[]={2000,1,1,12,0,0};
-    static gtime_t tutc_;
-    static double U_[9],gmst_;
+    static THREADLOCAL gtime_t tutc_;
+    static THREADLOCAL double U_[9],gmst_;
     gtime_t tgps;
     double eps,ze,th,z,t,t2,t3,dpsi,deps,gast,f[5];
     double R1[9],R2[9],R3[9],R[9],W[9],N[9],P[9],NP[9];
@@ -2281,6 +2359,7 @@ static void addpcv(const pcv_t *pcv, pcvs_t *pcvs)
     pcv_t *pcvs_pcv;
     
     if (pcvs->nmax<=pcvs->n) {
+        memacct(MEM_PCV,-(int64_t)sizeof(pcv_t)*pcvs->nmax);
         pcvs->nmax+=256;
         if (!(pcvs_pcv=(pcv_t *)realloc(pcvs->pcv,sizeof(pcv_t)*pcvs->nmax))) {
             trace(1,"addpcv: memory allocation error\n");
@@ -2288,6 +2367,7 @@ static void addpcv(const pcv_t *pcv, pcvs_t *pcvs)
             return;
         }
         pcvs->pcv=pcvs_pcv;
+        memacct(MEM_PCV,(int64_t)sizeof(pcv_t)*pcvs->nmax);
     }
     pcvs->pcv[pcvs->n++]=*pcv;
 }
@@ -2507,8 +2587,8 @@ extern pcv_t *searchpcv(int sat, const char *type, gtime_t time,
 *-----------------------------------------------------------------------------*/
 extern void readpos(const char *file, const char *rcv, double *pos)
 {
-    static double poss[2048][3];
-    static char stas[2048][16];
+    static THREADLOCAL double poss[2048][3];
+    static THREADLOCAL char stas[2048][16];
     FILE *fp;
     int i,j,len,np=0;
     char buff[256],str[256];
@@ -2613,6 +2693,7 @@ extern int readerp(const char *file, erp_t *erp)
             continue;
         }
         if (erp->n>=erp->nmax) {
+            memacct(MEM_NAV,-(int64_t)sizeof(erpd_t)*erp->nmax);
             erp->nmax=erp->nmax<=0?128:erp->nmax*2;
             erp_data=(erpd_t *)realloc(erp->data,sizeof(erpd_t)*erp->nmax);
             if (!erp_data) {
@@ -2621,6 +2702,7 @@ extern int readerp(const char *file, erp_t *erp)
                 return 0;
             }
             erp->data=erp_data;
+            memacct(MEM_NAV,(int64_t)sizeof(erpd_t)*erp->nmax);
         }
         erp->data[erp->n].mjd=v[0];
         erp->data[erp->n].xp=v[1]*1E-6*AS2R;
@@ -2712,6 +2794,7 @@ static void uniqeph(nav_t *nav)
     }
     nav->n=j+1;
     
+    memacct(MEM_NAV,-(int64_t)sizeof(eph_t)*nav->nmax);
     if (!(nav_eph=(eph_t *)realloc(nav->eph,sizeof(eph_t)*nav->n))) {
         trace(1,"uniqeph malloc error n=%d\n",nav->n);
         free(nav->eph); nav->eph=NULL; nav->n=nav->nmax=0;
@@ -2719,6 +2802,7 @@ static void uniqeph(nav_t *nav)
     }
     nav->eph=nav_eph;
     nav->nmax=nav->n;
+    memacct(MEM_NAV,(int64_t)sizeof(eph_t)*nav->nmax);
     
     trace(4,"uniqeph: n=%d\n",nav->n);
 }
@@ -2751,6 +2835,7 @@ static void uniqgeph(nav_t *nav)
     }
     nav->ng=j+1;
     
+    memacct(MEM_NAV,-(int64_t)sizeof(geph_t)*nav->ngmax);
     if (!(nav_geph=(geph_t *)realloc(nav->geph,sizeof(geph_t)*nav->ng))) {
         trace(1,"uniqgeph malloc error ng=%d\n",nav->ng);
         free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;
@@ -2758,6 +2843,7 @@ static void uniqgeph(nav_t *nav)
     }
     nav->geph=nav_geph;
     nav->ngmax=nav->ng;
+    memacct(MEM_NAV,(int64_t)sizeof(geph_t)*nav->ngmax);
     
     trace(4,"uniqgeph: ng=%d\n",nav->ng);
 }
@@ -2789,6 +2875,7 @@ static void uniqseph(nav_t *nav)
     }
     nav->ns=j+1;
     
+    memacct(MEM_NAV,-(int64_t)sizeof(seph_t)*nav->nsmax);
     if (!(nav_seph=(seph_t *)realloc(nav->seph,sizeof(seph_t)*nav->ns))) {
         trace(1,"uniqseph malloc error ns=%d\n",nav->ns);
         free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
@@ -2796,6 +2883,7 @@ static void uniqseph(nav_t *nav)
     }
     nav->seph=nav_seph;
     nav->nsmax=nav->ns;
+    memacct(MEM_NAV,(int64_t)sizeof(seph_t)*nav->nsmax);
     
     trace(4,"uniqseph: ns=%d\n",nav->ns);
 }
@@ -2806,12 +2894,20 @@ static void uniqseph(nav_t *nav)
 *-----------------------------------------------------------------------------*/
 extern void uniqnav(nav_t *nav)
 {
+    int i,prn;
+    
     trace(3,"uniqnav: neph=%d ngeph=%d nseph=%d\n",nav->n,nav->ng,nav->ns);
     
     /* unique ephemeris */
     uniqeph (nav);
     uniqgeph(nav);
     uniqseph(nav);
+    
+    /* GLONASS fcn of satellites resolved from ephemerides */
+    for (i=nav->ng-1;i>=0;i--) {
+        if (satsys(nav->geph[i].sat,&prn)!=SYS_GLO||prn>32) continue;
+        nav->glo_fcn[prn-1]=nav->geph[i].frq+8;
+    }
 }
 /* compare observation data -------------------------------------------------*/
 static int cmpobs(const void *p1, const void *p2)
@@ -2854,6 +2950,39 @@ extern int sortobs(obs_t *obs)
     }
     return n;
 }
+/* observation data of epoch to structure of arrays ----------------------------
+* set observation data of an epoch to the structure of arrays used by the
+* measurement models
+* args   : obsd_t *obs      I   observation data of epoch
+*          int    n         I   number of observation data
+*          nav_t  *nav      I   navigation data (for GLONASS frequencies)
+*          obsb_t *ob       O   observation data of epoch (structure of arrays)
+* return : number of observation data set
+* notes  : ob->freq[f][i] is the carrier frequency of obs[i].code[f] by
+*          sat2freq(). observation data over MAXOBS*2 are not set.
+*-----------------------------------------------------------------------------*/
+extern int setobsb(const obsd_t *obs, int n, const nav_t *nav, obsb_t *ob)
+{
+    int i,f;
+    
+    if (n>MAXOBS*2) n=MAXOBS*2;
+    
+    for (i=0;i<n;i++) {
+        ob->time[i]=obs[i].time;
+        ob->sat [i]=obs[i].sat;
+        ob->rcv [i]=obs[i].rcv;
+    }
+    for (f=0;f<NFREQ+NEXOBS;f++) for (i=0;i<n;i++) {
+        ob->SNR [f][i]=obs[i].SNR [f];
+        ob->LLI [f][i]=obs[i].LLI [f];
+        ob->code[f][i]=obs[i].code[f];
+        ob->L   [f][i]=obs[i].L   [f];
+        ob->P   [f][i]=obs[i].P   [f];
+        ob->D   [f][i]=obs[i].D   [f];
+        ob->freq[f][i]=sat2freq(obs[i].sat,obs[i].code[f],nav);
+    }
+    return ob->n=n;
+}
 /* screen by time --------------------------------------------------------------
 * screening by time start, time end, and time interval
 * args   : gtime_t time  I      time
@@ -2997,6 +3126,7 @@ extern int savenav(const char *file, const nav_t *nav)
 *-----------------------------------------------------------------------------*/
 extern void freeobs(obs_t *obs)
 {
+    memacct(MEM_OBS,-(int64_t)sizeof(obsd_t)*obs->nmax);
     free(obs->data); obs->data=NULL; obs->n=obs->nmax=0;
 }
 /* free navigation data ---------------------------------------------------------
@@ -3011,6 +3141,14 @@ extern void freeobs(obs_t *obs)
 *-----------------------------------------------------------------------------*/
 extern void freenav(nav_t *nav, int opt)
 {
+    if (opt&0x01) memacct(MEM_NAV ,-(int64_t)sizeof(eph_t )*nav->nmax );
+    if (opt&0x02) memacct(MEM_NAV ,-(int64_t)sizeof(geph_t)*nav->ngmax);
+    if (opt&0x04) memacct(MEM_NAV ,-(int64_t)sizeof(seph_t)*nav->nsmax);
+    if (opt&0x08) memacct(MEM_PREC,-(int64_t)sizeof(peph_t)*nav->nemax);
+    if (opt&0x10) memacct(MEM_PREC,-(int64_t)sizeof(pclk_t)*nav->ncmax);
+    if (opt&0x20) memacct(MEM_NAV ,-(int64_t)sizeof(alm_t )*nav->namax);
+    if (opt&0x40) memacct(MEM_TEC ,-(int64_t)sizeof(tec_t )*nav->ntmax);
+    
     if (opt&0x01) {free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;}
     if (opt&0x02) {free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;}
     if (opt&0x04) {free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;}
@@ -3019,56 +3157,559 @@ extern void freenav(nav_t *nav, int opt)
     if (opt&0x20) {free(nav->alm ); nav->alm =NULL; nav->na=nav->namax=0;}
     if (opt&0x40) {free(nav->tec ); nav->tec =NULL; nav->nt=nav->ntmax=0;}
 }
-/* debug trace functions -----------------------------------------------------*/
+/* memory accounting -----------------------------------------------------------
+* the memory of the observation, navigation, solution and filter data is
+* accounted by subsystem. the functions growing, shrinking or freeing the data
+* report the change of the allocated capacity, including products attached
+* from the shared memory product store.
+*-----------------------------------------------------------------------------*/
+static int64_t mem_cur [MEM_NSUB]={0}; /* current bytes of subsystems */
+static int64_t mem_peak[MEM_NSUB]={0}; /* peak bytes of subsystems */
+
+/* account memory of subsystem -------------------------------------------------
+* args   : int     sub      I   memory subsystem (MEM_???)
+*          int64_t bytes    I   allocated bytes (negative: freed bytes)
+* return : none
+* notes  : the current and peak bytes are updated atomically
+*-----------------------------------------------------------------------------*/
+extern void memacct(int sub, int64_t bytes)
+{
+    int64_t cur,peak;
+    
+    if (sub<0||sub>=MEM_NSUB||bytes==0) return;
+    
+    cur=__atomic_add_fetch(mem_cur+sub,bytes,__ATOMIC_RELAXED);
+    peak=__atomic_load_n(mem_peak+sub,__ATOMIC_RELAXED);
+    while (cur>peak&&!__atomic_compare_exchange_n(mem_peak+sub,&peak,cur,1,
+           __ATOMIC_RELAXED,__ATOMIC_RELAXED)) ;
+}
+/* current and peak memory of subsystem ----------------------------------------
+* args   : int     sub      I   memory subsystem (MEM_???)
+*          int64_t *cur     O   current bytes (NULL: no output)
+*          int64_t *peak    O   peak bytes    (NULL: no output)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void memstat(int sub, int64_t *cur, int64_t *peak)
+{
+    if (cur ) *cur =0;
+    if (peak) *peak=0;
+    if (sub<0||sub>=MEM_NSUB) return;
+    if (cur ) *cur =__atomic_load_n(mem_cur +sub,__ATOMIC_RELAXED);
+    if (peak) *peak=__atomic_load_n(mem_peak+sub,__ATOMIC_RELAXED);
+}
+/* name of memory subsystem --------------------------------------------------*/
+extern const char *memname(int sub)
+{
+    static const char *name[]={"obs","nav","prec","tec","pcv","sol","filt"};
+    
+    return 0<=sub&&sub<MEM_NSUB?name[sub]:"";
+}
+/* memory report ---------------------------------------------------------------
+* output current and peak memory of subsystems
+* args   : char   *buff     O   memory report ("name cur/peak ..." in MB)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void memreport(char *buff)
+{
+    int64_t cur,peak;
+    char *p=buff;
+    int i;
+    
+    for (i=0;i<MEM_NSUB;i++) {
+        memstat(i,&cur,&peak);
+        p+=sprintf(p,"%s%s %.1f/%.1f",i?" ":"",memname(i),cur/1E6,peak/1E6);
+    }
+    p+=sprintf(p," MB");
+}
+/* debug trace functions -------------------------------------------------------
+* trace records are written to a lock-free ring buffer of the calling thread
+* as the format id and the raw arguments. a background thread writes the
+* buffers to the binary trace file, which is converted to text by convtrace().
+* string arguments are recorded up to TRMAXSTR bytes, and a truncated string is
+* followed by "..." in the text.
+*-----------------------------------------------------------------------------*/
+#define TRBUFSIZE   (1<<22)     /* size of trace buffer of thread (bytes) */
+#define TRMAXREC    (1<<16)     /* max length of trace record (bytes) */
+#define TRMAXFMT    4096        /* max number of trace formats */
+#define TRMAXARG    32          /* max number of arguments of trace format */
+#define TRMAXSTR    1024        /* max length of string argument */
+#define TRSTRCUT    0x8000      /* flag of truncated string argument */
+#define TRFLUSHMS   100         /* interval of flushing trace buffers (ms) */
+#define TRMAXWAIT   1000        /* max wait for space of full buffer (ms) */
+#define TRMAGIC     0x43525454  /* magic number of trace file ("TTRC") */
+#define TRVER       1           /* version of trace file */
+
+#define TRID_PAD    0           /* trace record id: padding */
+#define TRID_TEXT   1           /* trace record id: text */
+#define TRID_MAT    2           /* trace record id: matrix rows */
+#define TRID_FMT    3           /* trace record id: first format */
+
+#define TRF_LEVEL   1           /* trace record flag: level prefix */
+#define TRF_TICK    2           /* trace record flag: tick time prefix */
+
+#define TRB_FMT     1           /* trace file block: format string */
+#define TRB_REC     2           /* trace file block: trace records */
+#define TRB_DROP    3           /* trace file block: dropped records */
+
+#define TA_INT      1           /* trace argument type: int */
+#define TA_LONG     2           /* trace argument type: long */
+#define TA_LLONG    3           /* trace argument type: long long */
+#define TA_SIZE     4           /* trace argument type: size_t */
+#define TA_PTR      5           /* trace argument type: pointer */
+#define TA_DBL      6           /* trace argument type: double */
+#define TA_LDBL     7           /* trace argument type: long double */
+#define TA_STR      8           /* trace argument type: string */
+
+typedef struct {        /* trace record header type */
+    uint32_t len;       /* record length (bytes) (multiple of 16) */
+    uint16_t id;        /* format id (TRID_???) */
+    uint8_t level;      /* trace level */
+    uint8_t flag;       /* record flags (TRF_???) */
+    uint64_t seq;       /* sequence number of trace calls */
+} trhdr_t;
+
+/* parse conversion specification of trace format ------------------------------
+* args   : char   *p        I   conversion specification ('%...')
+*          int    *type     O   argument types of '*' and value (TA_???)
+*          int    *n        O   number of arguments (0:"%%")
+* return : pointer to character next to specification
+*-----------------------------------------------------------------------------*/
+static const char *trspec(const char *p, int *type, int *n)
+{
+    int lm=0;
+    
+    *n=0;
+    for (p++;*p&&strchr("-+ #0'",*p);p++) ;
+    if (*p=='*') {type[(*n)++]=TA_INT; p++;}
+    else while (isdigit((unsigned char)*p)) p++;
+    if (*p=='.') {
+        if (*++p=='*') {type[(*n)++]=TA_INT; p++;}
+        else while (isdigit((unsigned char)*p)) p++;
+    }
+    for (;*p&&strchr("hlLqjzt",*p);p++) {
+        if      (*p=='l') lm=lm==TA_LONG?TA_LLONG:TA_LONG;
+        else if (*p=='z') lm=TA_SIZE;
+        else if (*p!='h') lm=TA_LLONG;
+    }
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            type[(*n)++]=lm?lm:TA_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a':
+        case 'A':
+            type[(*n)++]=lm==TA_LLONG?TA_LDBL:TA_DBL;
+            break;
+        case 's': type[(*n)++]=TA_STR; break;
+        case 'p': type[(*n)++]=TA_PTR; break;
+        case '%': *n=0; break;
+        default : *n=-1; return p; /* invalid specification */
+    }
+    return p+1;
+}
 #ifdef TRACE
 
+typedef struct {        /* trace format type */
+    const char *fmt;    /* format string */
+    int narg;           /* number of arguments */
+    uint8_t type[TRMAXARG]; /* argument types (TA_???) */
+} trfmt_t;
+
+typedef struct trbuf_tag { /* trace buffer type */
+    uint8_t *buff;      /* ring buffer (TRBUFSIZE bytes) */
+    uint32_t head;      /* write position (written by thread) */
+    uint32_t tail;      /* read position (written by flushing thread) */
+    uint32_t drop;      /* number of dropped records */
+    uint32_t ndrop;     /* number of dropped records written to file */
+    int state;          /* state (0:in use,1:thread exited,2:free) */
+    struct trbuf_tag *next; /* next trace buffer */
+} trbuf_t;
+
 static FILE *fp_trace=NULL;     /* file pointer of trace */
 static char file_trace[1024];   /* trace file */
 static int level_trace=0;       /* level of trace */
 static uint32_t tick_trace=0;   /* tick time at traceopen (ms) */
 static gtime_t time_trace={0};  /* time at traceopen */
-static lock_t lock_trace;       /* lock for trace */
+static lock_t lock_trace;       /* lock for trace formats and buffers */
+static int init_trace=0;        /* trace lock and thread key initialized */
+static trfmt_t trfmts[TRMAXFMT]; /* trace formats */
+static int nfmt=TRID_FMT;       /* number of trace formats (incl. reserved) */
+static int nfmtout=TRID_FMT;    /* number of trace formats written to file */
+static const char *trkeys[TRMAXFMT*2]; /* hash table of format strings */
+static uint16_t trvals[TRMAXFMT*2]; /* format ids of hash table */
+static trbuf_t *trbufs=NULL;    /* trace buffers of threads */
+static uint64_t trseq=0;        /* sequence number of trace calls */
+static int trquit=0;            /* quit flag of flushing thread */
+static int trwake=0;            /* wake flag of flushing thread */
+static thread_t trthread;       /* flushing thread */
+static THREADLOCAL trbuf_t *trbuf=NULL; /* trace buffer of thread */
+#ifdef WIN32
+static DWORD trexitkey;         /* key of thread exit of trace buffer */
+#else
+static pthread_key_t trexitkey; /* key of thread exit of trace buffer */
+#endif
 
+/* release trace buffer at thread exit ---------------------------------------*/
+#ifdef WIN32
+static void WINAPI trexit(void *arg)
+#else
+static void trexit(void *arg)
+#endif
+{
+    __atomic_store_n(&((trbuf_t *)arg)->state,1,__ATOMIC_RELEASE);
+}
+/* trace buffer of thread ------------------------------------------------------
+* trace buffer of the calling thread. the buffers of exited threads are reused
+* after they are written to the trace file.
+*-----------------------------------------------------------------------------*/
+static trbuf_t *trgetbuf(void)
+{
+    trbuf_t *b;
+    
+    if (trbuf) return trbuf;
+    
+    rtklib_lock(&lock_trace);
+    
+    for (b=trbufs;b;b=b->next) if (b->state==2) break;
+    
+    if (!b&&(b=(trbuf_t *)calloc(1,sizeof(trbuf_t)))) {
+        if (!(b->buff=(uint8_t *)malloc(TRBUFSIZE))) {
+            free(b);
+            b=NULL;
+        }
+        else {
+            b->next=trbufs;
+            trbufs=b;
+        }
+    }
+    if (b) {
+        b->drop=b->ndrop=0;
+        b->state=0;
+#ifdef WIN32
+        FlsSetValue(trexitkey,b);
+#else
+        pthread_setspecific(trexitkey,b);
+#endif
+    }
+    rtklib_unlock(&lock_trace);
+    return trbuf=b;
+}
+/* trace format of format string -----------------------------------------------
+* the formats are searched by the address of the format string without lock.
+* new formats are parsed and added under the lock. formats with an invalid
+* specification or too many arguments are added as text (NULL).
+*-----------------------------------------------------------------------------*/
+static const trfmt_t *trgetfmt(const char *format)
+{
+    const char *key,*p;
+    trfmt_t *f;
+    uint32_t i=(uint32_t)((uintptr_t)format>>2)*2654435761u&(TRMAXFMT*2-1);
+    int j,n,type[3];
+    
+    for (;(key=__atomic_load_n(trkeys+i,__ATOMIC_ACQUIRE));
+         i=(i+1)&(TRMAXFMT*2-1)) {
+        if (key==format) return trvals[i]==TRID_TEXT?NULL:trfmts+trvals[i];
+    }
+    rtklib_lock(&lock_trace);
+    
+    for (;(key=trkeys[i]);i=(i+1)&(TRMAXFMT*2-1)) { /* added by other thread */
+        if (key==format) {
+            rtklib_unlock(&lock_trace);
+            return trvals[i]==TRID_TEXT?NULL:trfmts+trvals[i];
+        }
+    }
+    if (nfmt>=TRMAXFMT) {
+        rtklib_unlock(&lock_trace);
+        return NULL;
+    }
+    f=trfmts+nfmt;
+    f->fmt=format;
+    f->narg=0;
+    
+    for (p=format;*p&&f->narg>=0;) {
+        if (*p!='%') {p++; continue;}
+        p=trspec(p,type,&n);
+        if (n<0||f->narg+n>TRMAXARG) {
+            f->narg=-1;
+            break;
+        }
+        for (j=0;j<n;j++) f->type[f->narg++]=(uint8_t)type[j];
+    }
+    trvals[i]=(uint16_t)(f->narg<0?TRID_TEXT:nfmt++);
+    __atomic_store_n(trkeys+i,format,__ATOMIC_RELEASE);
+    
+    rtklib_unlock(&lock_trace);
+    return f->narg<0?NULL:f;
+}
+/* reserve space of trace record -----------------------------------------------
+* reserve contiguous TRMAXREC bytes at the head of trace buffer
+* return : space of trace record (NULL: buffer full)
+*-----------------------------------------------------------------------------*/
+static uint8_t *trreserve(trbuf_t *b)
+{
+    trhdr_t *h;
+    uint32_t tail=__atomic_load_n(&b->tail,__ATOMIC_ACQUIRE);
+    uint32_t off=b->head&(TRBUFSIZE-1),end=TRBUFSIZE-off;
+    
+    if (end<TRMAXREC) { /* pad to end of buffer */
+        if (TRBUFSIZE-(b->head-tail)<end+TRMAXREC) return NULL;
+        h=(trhdr_t *)(b->buff+off);
+        h->len=end;
+        h->id=TRID_PAD;
+        __atomic_store_n(&b->head,b->head+end,__ATOMIC_RELEASE);
+        return b->buff;
+    }
+    if (TRBUFSIZE-(b->head-tail)<TRMAXREC) return NULL;
+    if (b->head-tail>TRBUFSIZE/2&&!__atomic_load_n(&trwake,__ATOMIC_RELAXED)) {
+        __atomic_store_n(&trwake,1,__ATOMIC_RELAXED);
+    }
+    return b->buff+off;
+}
+/* commit trace record -------------------------------------------------------*/
+static void trcommit(trbuf_t *b, uint8_t *p, const uint8_t *q, int id,
+                     int level, int flag)
+{
+    trhdr_t *h=(trhdr_t *)p;
+    
+    h->len=(uint32_t)((q-p+15)&~15);
+    h->id=(uint16_t)id;
+    h->level=(uint8_t)level;
+    h->flag=(uint8_t)flag;
+    h->seq=__atomic_fetch_add(&trseq,1,__ATOMIC_RELAXED);
+    __atomic_store_n(&b->head,b->head+h->len,__ATOMIC_RELEASE);
+}
+/* wait for space of full trace buffer -----------------------------------------
+* wake the flushing thread and wait until the buffer is written to the file.
+* the record is dropped if no space within TRMAXWAIT ms.
+* return : space of trace record (NULL: record dropped)
+*-----------------------------------------------------------------------------*/
+static uint8_t *trwait(trbuf_t *b)
+{
+    uint8_t *p;
+    int i;
+    
+    __atomic_store_n(&trwake,1,__ATOMIC_RELAXED);
+    
+    for (i=0;i<TRMAXWAIT;i++) {
+        sleepms(1);
+        if ((p=trreserve(b))) return p;
+    }
+    __atomic_store_n(&b->drop,b->drop+1,__ATOMIC_RELAXED);
+    return NULL;
+}
+/* write trace record ----------------------------------------------------------
+* write trace record of format id and raw arguments to trace buffer of thread
+* (text formatted by the thread if the format is not supported)
+*-----------------------------------------------------------------------------*/
+static void trrecord(int level, int flag, const char *format, va_list ap)
+{
+    const trfmt_t *f;
+    const char *s;
+    trbuf_t *b;
+    uint8_t *p,*q,*e;
+    uint32_t tick,len;
+    uint16_t slen;
+    int64_t ival;
+    double dval;
+    int i,n;
+    
+    if (!(b=trgetbuf())) return;
+    
+    if (!(p=trreserve(b))&&!(p=trwait(b))) return;
+    q=p+sizeof(trhdr_t);
+    e=p+TRMAXREC;
+    
+    if (flag&TRF_TICK) {
+        tick=tickget()-tick_trace;
+        memcpy(q,&tick,4); q+=4;
+    }
+    if (!(f=trgetfmt(format))) { /* text record */
+        n=vsnprintf((char *)q+4,e-q-4,format,ap);
+        len=n<0?0:(n<e-q-4?(uint32_t)n:(uint32_t)(e-q-5));
+        memcpy(q,&len,4);
+        trcommit(b,p,q+4+len,TRID_TEXT,level,flag);
+        return;
+    }
+    for (i=0;i<f->narg;i++) {
+        switch (f->type[i]) {
+            case TA_INT  : ival=va_arg(ap,int      ); break;
+            case TA_LONG : ival=va_arg(ap,long     ); break;
+            case TA_LLONG: ival=va_arg(ap,long long); break;
+            case TA_SIZE : ival=(int64_t)va_arg(ap,size_t); break;
+            case TA_PTR  : ival=(int64_t)(intptr_t)va_arg(ap,void *); break;
+            case TA_DBL  : dval=va_arg(ap,double);
+                           memcpy(q,&dval,8); q+=8; continue;
+            case TA_LDBL : dval=(double)va_arg(ap,long double);
+                           memcpy(q,&dval,8); q+=8; continue;
+            case TA_STR  : if (!(s=va_arg(ap,const char *))) s="(null)";
+                           for (n=0;n<TRMAXSTR&&s[n];n++) ;
+                           slen=(uint16_t)(s[n]?n|TRSTRCUT:n);
+                           memcpy(q,&slen,2); memcpy(q+2,s,n);
+                           q+=2+n; continue;
+            default      : continue;
+        }
+        memcpy(q,&ival,8); q+=8;
+    }
+    trcommit(b,p,q,(int)(f-trfmts),level,flag);
+}
+/* write trace text without level prefix -------------------------------------*/
+static void trprint(int level, const char *format, ...)
+{
+    va_list ap;
+    
+    va_start(ap,format); trrecord(level,0,format,ap); va_end(ap);
+}
+/* write block of trace file -------------------------------------------------*/
+static void trblock(int type, const void *p1, uint32_t n1, const void *p2,
+                    uint32_t n2)
+{
+    uint32_t h[2];
+    
+    h[0]=(uint32_t)type;
+    h[1]=n1+n2;
+    fwrite(h,4,2,fp_trace);
+    if (n1>0) fwrite(p1,1,n1,fp_trace);
+    if (n2>0) fwrite(p2,1,n2,fp_trace);
+}
+/* write header of trace file ------------------------------------------------*/
+static void trheader(void)
+{
+    uint32_t h[2]={TRMAGIC,TRVER};
+    
+    fwrite(h,4,2,fp_trace);
+    nfmtout=TRID_FMT; /* formats written to each file */
+}
 static void traceswap(void)
 {
     gtime_t time=utc2gpst(timeget());
     char path[1024];
     
-    lock(&lock_trace);
-    
     if ((int)(time2gpst(time      ,NULL)/INT_SWAP_TRAC)==
         (int)(time2gpst(time_trace,NULL)/INT_SWAP_TRAC)) {
-        unlock(&lock_trace);
         return;
     }
     time_trace=time;
     
     if (!reppath(file_trace,path,time,"","")) {
-        unlock(&lock_trace);
         return;
     }
-    if (fp_trace) fclose(fp_trace);
+    fclose(fp_trace);
+    
+    if ((fp_trace=fopen(path,"wb"))) trheader();
+}
+/* write trace buffers to trace file -------------------------------------------
+* write new formats and the records of the trace buffers to trace file (called
+* with the trace lock)
+*-----------------------------------------------------------------------------*/
+static void trdrain(void)
+{
+    trbuf_t *b;
+    uint32_t head,off,n;
+    uint16_t id;
+    int state;
+    
+    if (!fp_trace) return;
+    
+    traceswap();
+    if (!fp_trace) return;
+    
+    for (;nfmtout<nfmt;nfmtout++) {
+        id=(uint16_t)nfmtout;
+        trblock(TRB_FMT,&id,2,trfmts[id].fmt,(uint32_t)strlen(trfmts[id].fmt));
+    }
+    for (b=trbufs;b;b=b->next) {
+        state=__atomic_load_n(&b->state,__ATOMIC_ACQUIRE);
+        head=__atomic_load_n(&b->head,__ATOMIC_ACQUIRE);
+        
+        if ((n=head-b->tail)>0) {
+            off=b->tail&(TRBUFSIZE-1);
+            if (off+n<=TRBUFSIZE) {
+                trblock(TRB_REC,b->buff+off,n,NULL,0);
+            }
+            else {
+                trblock(TRB_REC,b->buff+off,TRBUFSIZE-off,b->buff,
+                        n-(TRBUFSIZE-off));
+            }
+            __atomic_store_n(&b->tail,head,__ATOMIC_RELEASE);
+        }
+        if ((n=__atomic_load_n(&b->drop,__ATOMIC_RELAXED)-b->ndrop)>0) {
+            trblock(TRB_DROP,&n,4,NULL,0);
+            b->ndrop+=n;
+        }
+        if (state==1) b->state=2; /* free buffer of exited thread */
+    }
+    fflush(fp_trace);
+}
+/* trace flushing thread -----------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI trflush(void *arg)
+#else
+static void *trflush(void *arg)
+#endif
+{
+    int i,quit;
     
-    if (!(fp_trace=fopen(path,"w"))) {
-        fp_trace=stderr;
+    for (;;) {
+        rtklib_lock(&lock_trace);
+        trdrain();
+        quit=trquit;
+        rtklib_unlock(&lock_trace);
+        if (quit) break;
+        
+        /* sleep until interval or buffer over half full */
+        for (i=0;i<TRFLUSHMS&&!__atomic_load_n(&trwake,__ATOMIC_RELAXED);i++) {
+            sleepms(1);
+        }
+        __atomic_store_n(&trwake,0,__ATOMIC_RELAXED);
     }
-    unlock(&lock_trace);
+    return 0;
 }
 extern void traceopen(const char *file)
 {
     gtime_t time=utc2gpst(timeget());
     char path[1024];
     
+    if (!init_trace) {
+        initlock(&lock_trace);
+#ifdef WIN32
+        trexitkey=FlsAlloc(trexit);
+#else
+        pthread_key_create(&trexitkey,trexit);
+#endif
+        init_trace=1;
+    }
+    traceclose();
+    
     reppath(file,path,time,"","");
-    if (!*path||!(fp_trace=fopen(path,"w"))) fp_trace=stderr;
+    if (!*path||!(fp_trace=fopen(path,"wb"))) return;
     strcpy(file_trace,file);
     tick_trace=tickget();
     time_trace=time;
-    initlock(&lock_trace);
+    trquit=0;
+    trheader();
+    
+#ifdef WIN32
+    if (!(trthread=CreateThread(NULL,0,trflush,NULL,0,NULL))) {
+#else
+    if (pthread_create(&trthread,NULL,trflush,NULL)) {
+#endif
+        fclose(fp_trace);
+        fp_trace=NULL;
+    }
 }
 extern void traceclose(void)
 {
-    if (fp_trace&&fp_trace!=stderr) fclose(fp_trace);
+    if (!fp_trace) return;
+    
+    rtklib_lock(&lock_trace);
+    trquit=1;
+    rtklib_unlock(&lock_trace);
+#ifdef WIN32
+    WaitForSingleObject(trthread,INFINITE);
+    CloseHandle(trthread);
+#else
+    pthread_join(trthread,NULL);
+#endif
+    if (fp_trace) fclose(fp_trace);
     fp_trace=NULL;
     file_trace[0]='\0';
 }
@@ -3080,30 +3721,39 @@ extern void trace(int level, const char *format, ...)
 {
     va_list ap;
     
-    /* print error message to stderr */
-    if (level<=1) {
+    /* print error message to stderr while tracing */
+    if (fp_trace&&level<=1) {
         va_start(ap,format); vfprintf(stderr,format,ap); va_end(ap);
     }
     if (!fp_trace||level>level_trace) return;
-    traceswap();
-    fprintf(fp_trace,"%d ",level);
-    va_start(ap,format); vfprintf(fp_trace,format,ap); va_end(ap);
-    fflush(fp_trace);
+    va_start(ap,format); trrecord(level,TRF_LEVEL,format,ap); va_end(ap);
 }
 extern void tracet(int level, const char *format, ...)
 {
     va_list ap;
     
     if (!fp_trace||level>level_trace) return;
-    traceswap();
-    fprintf(fp_trace,"%d %9.3f: ",level,(tickget()-tick_trace)/1000.0);
-    va_start(ap,format); vfprintf(fp_trace,format,ap); va_end(ap);
-    fflush(fp_trace);
+    va_start(ap,format); trrecord(level,TRF_LEVEL|TRF_TICK,format,ap); va_end(ap);
 }
 extern void tracemat(int level, const double *A, int n, int m, int p, int q)
 {
-    if (!fp_trace||level>level_trace) return;
-    matfprint(A,n,m,p,q,fp_trace); fflush(fp_trace);
+    trbuf_t *b;
+    uint8_t *r,*s;
+    int32_t h[4];
+    int i,j,k,nr=(int)((TRMAXREC-sizeof(trhdr_t)-sizeof(h))/(8*(m>0?m:1)));
+    
+    if (!fp_trace||level>level_trace||m<=0||nr<=0||!(b=trgetbuf())) return;
+    
+    for (i=0;i<n;i+=nr) { /* records of rows */
+        if (!(r=trreserve(b))&&!(r=trwait(b))) return;
+        s=r+sizeof(trhdr_t);
+        h[0]=i+nr<n?nr:n-i; h[1]=m; h[2]=p; h[3]=q;
+        memcpy(s,h,sizeof(h)); s+=sizeof(h);
+        for (j=i;j<i+h[0];j++) for (k=0;k<m;k++) {
+            memcpy(s,A+j+k*n,8); s+=8;
+        }
+        trcommit(b,r,s,TRID_MAT,level,0);
+    }
 }
 extern void traceobs(int level, const obsd_t *obs, int n)
 {
@@ -3114,12 +3764,11 @@ extern void traceobs(int level, const obsd_t *obs, int n)
     for (i=0;i<n;i++) {
         time2str(obs[i].time,str,3);
         satno2id(obs[i].sat,id);
-        fprintf(fp_trace," (%2d) %s %-3s rcv%d %13.3f %13.3f %13.3f %13.3f %d %d %d %d %3.1f %3.1f\n",
+        trprint(level," (%2d) %s %-3s rcv%d %13.3f %13.3f %13.3f %13.3f %d %d %d %d %3.1f %3.1f\n",
               i+1,str,id,obs[i].rcv,obs[i].L[0],obs[i].L[1],obs[i].P[0],
               obs[i].P[1],obs[i].LLI[0],obs[i].LLI[1],obs[i].code[0],
               obs[i].code[1],obs[i].SNR[0]*SNR_UNIT,obs[i].SNR[1]*SNR_UNIT);
     }
-    fflush(fp_trace);
 }
 extern void tracenav(int level, const nav_t *nav)
 {
@@ -3131,14 +3780,14 @@ extern void tracenav(int level, const nav_t *nav)
         time2str(nav->eph[i].toe,s1,0);
         time2str(nav->eph[i].ttr,s2,0);
         satno2id(nav->eph[i].sat,id);
-        fprintf(fp_trace,"(%3d) %-3s : %s %s %3d %3d %02x\n",i+1,
+        trprint(level,"(%3d) %-3s : %s %s %3d %3d %02x\n",i+1,
                 id,s1,s2,nav->eph[i].iode,nav->eph[i].iodc,nav->eph[i].svh);
     }
-    fprintf(fp_trace,"(ion) %9.4e %9.4e %9.4e %9.4e\n",nav->ion_gps[0],
+    trprint(level,"(ion) %9.4e %9.4e %9.4e %9.4e\n",nav->ion_gps[0],
             nav->ion_gps[1],nav->ion_gps[2],nav->ion_gps[3]);
-    fprintf(fp_trace,"(ion) %9.4e %9.4e %9.4e %9.4e\n",nav->ion_gps[4],
+    trprint(level,"(ion) %9.4e %9.4e %9.4e %9.4e\n",nav->ion_gps[4],
             nav->ion_gps[5],nav->ion_gps[6],nav->ion_gps[7]);
-    fprintf(fp_trace,"(ion) %9.4e %9.4e %9.4e %9.4e\n",nav->ion_gal[0],
+    trprint(level,"(ion) %9.4e %9.4e %9.4e %9.4e\n",nav->ion_gal[0],
             nav->ion_gal[1],nav->ion_gal[2],nav->ion_gal[3]);
 }
 extern void tracegnav(int level, const nav_t *nav)
@@ -3151,7 +3800,7 @@ extern void tracegnav(int level, const nav_t *nav)
         time2str(nav->geph[i].toe,s1,0);
         time2str(nav->geph[i].tof,s2,0);
         satno2id(nav->geph[i].sat,id);
-        fprintf(fp_trace,"(%3d) %-3s : %s %s %2d %2d %8.3f\n",i+1,
+        trprint(level,"(%3d) %-3s : %s %s %2d %2d %8.3f\n",i+1,
                 id,s1,s2,nav->geph[i].frq,nav->geph[i].svh,nav->geph[i].taun*1E6);
     }
 }
@@ -3165,7 +3814,7 @@ extern void tracehnav(int level, const nav_t *nav)
         time2str(nav->seph[i].t0,s1,0);
         time2str(nav->seph[i].tof,s2,0);
         satno2id(nav->seph[i].sat,id);
-        fprintf(fp_trace,"(%3d) %-3s : %s %s %2d %2d\n",i+1,
+        trprint(level,"(%3d) %-3s : %s %s %2d %2d\n",i+1,
                 id,s1,s2,nav->seph[i].svh,nav->seph[i].sva);
     }
 }
@@ -3180,7 +3829,7 @@ extern void tracepeph(int level, const nav_t *nav)
         time2str(nav->peph[i].time,s,0);
         for (j=0;j<MAXSAT;j++) {
             satno2id(j+1,id);
-            fprintf(fp_trace,"%-3s %d %-3s %13.3f %13.3f %13.3f %13.3f %6.3f %6.3f %6.3f %6.3f\n",
+            trprint(level,"%-3s %d %-3s %13.3f %13.3f %13.3f %13.3f %6.3f %6.3f %6.3f %6.3f\n",
                     s,nav->peph[i].index,id,
                     nav->peph[i].pos[j][0],nav->peph[i].pos[j][1],
                     nav->peph[i].pos[j][2],nav->peph[i].pos[j][3]*1E9,
@@ -3200,7 +3849,7 @@ extern void tracepclk(int level, const nav_t *nav)
         time2str(nav->pclk[i].time,s,0);
         for (j=0;j<MAXSAT;j++) {
             satno2id(j+1,id);
-            fprintf(fp_trace,"%-3s %d %-3s %13.3f %6.3f\n",
+            trprint(level,"%-3s %d %-3s %13.3f %6.3f\n",
                     s,nav->pclk[i].index,id,
                     nav->pclk[i].clk[j][0]*1E9,nav->pclk[i].std[j][0]*1E9);
         }
@@ -3208,10 +3857,15 @@ extern void tracepclk(int level, const nav_t *nav)
 }
 extern void traceb(int level, const uint8_t *p, int n)
 {
+    char str[TRMAXSTR+1]="",*q=str;
     int i;
+    
     if (!fp_trace||level>level_trace) return;
-    for (i=0;i<n;i++) fprintf(fp_trace,"%02X%s",*p++,i%8==7?" ":"");
-    fprintf(fp_trace,"\n");
+    for (i=0;i<n;i++) {
+        q+=sprintf(q,"%02X%s",*p++,i%8==7?" ":"");
+        if (q-str>TRMAXSTR-4) {trprint(level,"%s",str); *(q=str)='\0';}
+    }
+    trprint(level,"%s\n",str);
 }
 #else
 extern void traceopen(const char *file) {}
@@ -3229,6 +3883,200 @@ extern void tracepclk(int level, const nav_t *nav) {}
 extern void traceb  (int level, const uint8_t *p, int n) {}
 
 #endif /* TRACE */
+/* output trace record as text -----------------------------------------------*/
+static void trout(FILE *fp, const uint8_t *p, char **fmts)
+{
+    trhdr_t h;
+    const uint8_t *q=p+sizeof(trhdr_t),*e;
+    const char *f,*t;
+    char spec[64],str[TRMAXSTR+4];
+    uint32_t tick=0,len;
+    uint16_t slen;
+    int32_t m[4];
+    int64_t ival=0;
+    double dval=0.0;
+    int i,j,n,type[3],arg[2];
+    
+    memcpy(&h,p,sizeof(h));
+    e=p+h.len;
+    
+    if (h.flag&TRF_TICK) {
+        memcpy(&tick,q,4); q+=4;
+    }
+    if (h.flag&TRF_LEVEL) {
+        if (h.flag&TRF_TICK) fprintf(fp,"%d %9.3f: ",h.level,tick/1000.0);
+        else fprintf(fp,"%d ",h.level);
+    }
+    if (h.id==TRID_TEXT) {
+        memcpy(&len,q,4);
+        if (q+4+len<=e) fwrite(q+4,1,len,fp);
+        return;
+    }
+    if (h.id==TRID_MAT) {
+        memcpy(m,q,sizeof(m)); q+=sizeof(m);
+        for (i=0;i<m[0]&&q+8*m[1]<=e;i++) {
+            for (j=0;j<m[1];j++,q+=8) {
+                memcpy(&dval,q,8);
+                fprintf(fp," %*.*f",m[2],m[3],dval);
+            }
+            fprintf(fp,"\n");
+        }
+        return;
+    }
+    if (h.id>=TRMAXFMT||!(f=fmts[h.id])) {
+        fprintf(fp,"(unknown trace format %d)\n",h.id);
+        return;
+    }
+    while (*f) {
+        if (*f!='%') {
+            fputc(*f++,fp);
+            continue;
+        }
+        t=trspec(f,type,&n);
+        i=t-f<(int)sizeof(spec)?(int)(t-f):(int)sizeof(spec)-1;
+        memcpy(spec,f,i); spec[i]='\0';
+        f=t;
+        
+        if (n<=0) { /* "%%" or invalid specification */
+            fputs(!strcmp(spec,"%%")?"%":spec,fp);
+            continue;
+        }
+        for (i=0;i<n-1&&q+8<=e;i++,q+=8) { /* width/precision of '*' */
+            memcpy(&ival,q,8);
+            arg[i]=(int)ival;
+        }
+        if (type[n-1]==TA_STR) {
+            if (q+2>e) break;
+            memcpy(&slen,q,2);
+            i=slen&~TRSTRCUT;
+            if (i>TRMAXSTR||q+2+i>e) break;
+            memcpy(str,q+2,i); q+=2+i;
+            strcpy(str+i,slen&TRSTRCUT?"...":""); /* mark truncation */
+        }
+        else {
+            if (q+8>e) break;
+            memcpy(type[n-1]>=TA_DBL?(void *)&dval:(void *)&ival,q,8);
+            q+=8;
+        }
+#define TROUT(v) (n==1?fprintf(fp,spec,v):n==2?fprintf(fp,spec,arg[0],v):\
+                  fprintf(fp,spec,arg[0],arg[1],v))
+        switch (type[n-1]) {
+            case TA_INT  : TROUT((int)ival); break;
+            case TA_LONG : TROUT((long)ival); break;
+            case TA_LLONG: TROUT((long long)ival); break;
+            case TA_SIZE : TROUT((size_t)ival); break;
+            case TA_PTR  : TROUT((void *)(intptr_t)ival); break;
+            case TA_DBL  : TROUT(dval); break;
+            case TA_LDBL : TROUT((long double)dval); break;
+            case TA_STR  : TROUT(str); break;
+        }
+#undef TROUT
+    }
+}
+/* compare sequence numbers of trace records ---------------------------------*/
+static int cmptrace(const void *p1, const void *p2)
+{
+    trhdr_t h1,h2;
+    
+    memcpy(&h1,*(const uint8_t **)p1,sizeof(trhdr_t));
+    memcpy(&h2,*(const uint8_t **)p2,sizeof(trhdr_t));
+    return h1.seq<h2.seq?-1:(h1.seq>h2.seq?1:0);
+}
+/* convert binary trace file to text -------------------------------------------
+* convert binary trace file written by the trace functions to text
+* args   : char   *infile   I   binary trace file
+*          char   *outfile  I   text output file ("":stdout)
+* return : number of trace records (-1:error)
+* notes  : the records of all threads are output in the order of the trace
+*          calls. the number of records dropped with full trace buffers is
+*          output at the end.
+*-----------------------------------------------------------------------------*/
+extern int convtrace(const char *infile, const char *outfile)
+{
+    FILE *fp,*ofp=stdout;
+    trhdr_t h;
+    uint8_t *buff,*p,*q,*e,**recs=NULL,**r;
+    uint32_t magic,blk[2],ndrop=0,n;
+    uint16_t id;
+    char *fmts[TRMAXFMT]={0};
+    long size;
+    int i,nrec=0,nmax=0;
+    
+    trace(3,"convtrace: infile=%s outfile=%s\n",infile,outfile);
+    
+    if (!(fp=fopen(infile,"rb"))) return -1;
+    
+    fseek(fp,0,SEEK_END);
+    size=ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    
+    if (size<8||!(buff=(uint8_t *)malloc(size))) {
+        fclose(fp);
+        return -1;
+    }
+    if (fread(buff,size,1,fp)!=1) {
+        free(buff);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    
+    memcpy(&magic,buff,4);
+    if (magic!=TRMAGIC) {
+        free(buff);
+        return -1;
+    }
+    
+    /* formats and records of blocks */
+    for (p=buff+8;p+8<=buff+size;p=e) {
+        memcpy(blk,p,8);
+        q=p+8;
+        if ((e=q+blk[1])>buff+size) break;
+        
+        if (blk[0]==TRB_FMT&&blk[1]>=2) {
+            memcpy(&id,q,2);
+            if (id>=TRMAXFMT) continue;
+            free(fmts[id]);
+            if (!(fmts[id]=(char *)malloc(blk[1]-1))) continue;
+            memcpy(fmts[id],q+2,blk[1]-2);
+            fmts[id][blk[1]-2]='\0';
+        }
+        else if (blk[0]==TRB_REC) {
+            for (;q+sizeof(h)<=e;q+=h.len) {
+                memcpy(&h,q,sizeof(h));
+                if (h.len<sizeof(h)||q+h.len>e) break;
+                if (h.id==TRID_PAD) continue;
+                if (nrec>=nmax) {
+                    nmax=nmax<=0?65536:nmax*2;
+                    if (!(r=(uint8_t **)realloc(recs,sizeof(uint8_t *)*nmax))) {
+                        break;
+                    }
+                    recs=r;
+                }
+                recs[nrec++]=q;
+            }
+        }
+        else if (blk[0]==TRB_DROP&&blk[1]>=4) {
+            memcpy(&n,q,4);
+            ndrop+=n;
+        }
+    }
+    qsort(recs,nrec,sizeof(uint8_t *),cmptrace);
+    
+    if (*outfile&&!(ofp=fopen(outfile,"w"))) {
+        nrec=-1;
+    }
+    else {
+        for (i=0;i<nrec;i++) trout(ofp,recs[i],fmts);
+        
+        if (ndrop>0) fprintf(ofp,"trace: %u records dropped\n",ndrop);
+        if (ofp!=stdout) fclose(ofp);
+    }
+    for (i=0;i<TRMAXFMT;i++) free(fmts[i]);
+    free(recs);
+    free(buff);
+    return nrec;
+}
 
 /* execute command -------------------------------------------------------------
 * execute command line by operating system shell
@@ -3391,6 +4239,33 @@ extern void createdir(const char *path)
     
     mkdir_r(buff);
 }
+/* truncate file ---------------------------------------------------------------
+* truncate file to size
+* args   : char   *file     I   file path
+*          long   size      I   size (bytes)
+* return : status (0:ok,-1:error or file shorter than size)
+*-----------------------------------------------------------------------------*/
+extern int truncfile(const char *file, long size)
+{
+    FILE *fp;
+    int stat;
+    
+    tracet(3,"truncfile: file=%s size=%ld\n",file,size);
+    
+    if (!(fp=fopen(file,"r+b"))) return size>0?-1:0;
+    
+    if (fseek(fp,0,SEEK_END)||ftell(fp)<size) {
+        fclose(fp);
+        return -1;
+    }
+#ifdef WIN32
+    stat=_chsize(_fileno(fp),size);
+#else
+    stat=ftruncate(fileno(fp),(off_t)size);
+#endif
+    fclose(fp);
+    return stat?-1:0;
+}
 /* replace string ------------------------------------------------------------*/
 static int repstr(char *str, const char *pat, const char *rep)
 {
@@ -285,6 +285,7 @@ extern "C" {
 #define MAXOBS      96                  /* max number of obs in an epoch */
 #endif
 #define MAXRCV      64                  /* max receiver number (1 to MAXRCV) */
+#define MAXBASE     8                   /* max number of base stations of multi-base rtk */
 #define MAXOBSTYPE  64                  /* max number of obs type in RINEX */
 #ifdef OBS_100HZ
 #define DTTOL       0.005               /* tolerance of time difference (s) */
@@ -430,6 +431,10 @@ extern "C" {
 #define SOLF_NMEA   3                   /* solution format: NMEA-183 */
 #define SOLF_STAT   4                   /* solution format: solution status */
 #define SOLF_GSIF   5                   /* solution format: GSI F1/F2 */
+#define SOLF_BIN    6                   /* solution format: binary */
+
+#define SOLB_SOL    0                   /* binary file type: solution */
+#define SOLB_STAT   1                   /* binary file type: solution status */
 
 #define SOLQ_NONE   0                   /* solution status: no solution */
 #define SOLQ_FIX    1                   /* solution status: fix */
@@ -544,6 +549,15 @@ extern "C" {
 #define LLI_HALFA   0x40                /* LLI: half-cycle added */
 #define LLI_HALFS   0x80                /* LLI: half-cycle subtracted */
 
+#define MEM_OBS     0                   /* memory subsystem: observation data */
+#define MEM_NAV     1                   /* memory subsystem: broadcast ephemeris/erp */
+#define MEM_PREC    2                   /* memory subsystem: precise ephemeris/clock */
+#define MEM_TEC     3                   /* memory subsystem: ionosphere maps */
+#define MEM_PCV     4                   /* memory subsystem: antenna parameters */
+#define MEM_SOL     5                   /* memory subsystem: solution buffers */
+#define MEM_FILT    6                   /* memory subsystem: filter states */
+#define MEM_NSUB    7                   /* number of memory subsystems */
+
 #define P2_5        0.03125             /* 2^-5 */
 #define P2_6        0.015625            /* 2^-6 */
 #define P2_11       4.882812500000000E-04 /* 2^-11 */
@@ -569,12 +583,22 @@ extern "C" {
 #define P2_50       8.881784197001252E-16 /* 2^-50 */
 #define P2_55       2.775557561562891E-17 /* 2^-55 */
 
+#define NS_SEC      1000000000          /* ns per second */
+#define NSADD(t,sec) ((t)+(gtimens_t)floor((sec)*1E9+0.5)) /* t (ns)+sec (s) */
+
 #ifdef WIN32
 #define thread_t    HANDLE
 #define lock_t      CRITICAL_SECTION
 #define initlock(f) InitializeCriticalSection(f)
 #define lock(f)     EnterCriticalSection(f)
 #define unlock(f)   LeaveCriticalSection(f)
+#define rtklib_lock(f)     EnterCriticalSection(f)
+#define rtklib_unlock(f)   LeaveCriticalSection(f)
+#define cond_t      CONDITION_VARIABLE
+#define initcond(c) InitializeConditionVariable(c)
+#define condwait(c,f) SleepConditionVariableCS(c,f,INFINITE)
+#define condsignal(c) WakeAllConditionVariable(c)
+#define THREADLOCAL __declspec(thread)
 #define FILEPATHSEP '\\'
 #else
 #define thread_t    pthread_t
@@ -582,6 +606,11 @@ extern "C" {
 #define initlock(f) pthread_mutex_init(f,NULL)
 #define rtklib_lock(f)     pthread_mutex_lock(f)
 #define rtklib_unlock(f)   pthread_mutex_unlock(f)
+#define cond_t      pthread_cond_t
+#define initcond(c) pthread_cond_init(c,NULL)
+#define condwait(c,f) pthread_cond_wait(c,f)
+#define condsignal(c) pthread_cond_broadcast(c)
+#define THREADLOCAL __thread
 #define FILEPATHSEP '/'
 #endif
 
@@ -592,6 +621,8 @@ typedef struct {        /* time struct */
     double sec;         /* fraction of second under 1 s */
 } gtime_t;
 
+typedef int64_t gtimens_t; /* time (ns) since 1970/1/1 (system of gtime_t) */
+
 typedef struct {        /* observation data record */
     gtime_t time;       /* receiver sampling time (GPST) */
     uint8_t sat,rcv;    /* satellite/receiver number */
@@ -608,6 +639,19 @@ typedef struct {        /* observation data */
     obsd_t *data;       /* observation data records */
 } obs_t;
 
+typedef struct {        /* observation data of epoch (structure of arrays) */
+    int n;              /* number of observation data */
+    gtime_t time[MAXOBS*2]; /* receiver sampling time (GPST) */
+    uint8_t sat[MAXOBS*2],rcv[MAXOBS*2]; /* satellite/receiver number */
+    uint16_t SNR[NFREQ+NEXOBS][MAXOBS*2]; /* signal strength (0.001 dBHz) */
+    uint8_t  LLI[NFREQ+NEXOBS][MAXOBS*2]; /* loss of lock indicator */
+    uint8_t code[NFREQ+NEXOBS][MAXOBS*2]; /* code indicator (CODE_???) */
+    double L[NFREQ+NEXOBS][MAXOBS*2]; /* carrier-phase (cycle) */
+    double P[NFREQ+NEXOBS][MAXOBS*2]; /* pseudorange (m) */
+    float  D[NFREQ+NEXOBS][MAXOBS*2]; /* doppler frequency (Hz) */
+    double freq[NFREQ+NEXOBS][MAXOBS*2]; /* carrier frequency (Hz) (0:none) */
+} obsb_t;
+
 typedef struct {        /* earth rotation parameter data type */
     double mjd;         /* mjd (days) */
     double xp,yp;       /* pole offset (rad) */
@@ -928,6 +972,19 @@ typedef struct {        /* solution buffer type */
     int nb;             /* number of byte in message buffer */
 } solbuf_t;
 
+typedef struct {        /* buffered binary writer type */
+    FILE *fp;           /* output file pointer */
+    uint8_t *buff[2];   /* write buffers */
+    int nbuff;          /* size of write buffers (bytes) */
+    int nb[2];          /* number of bytes in write buffers */
+    int wp;             /* index of buffer being filled */
+    int flush;          /* index of buffer being flushed (-1:none) */
+    int state;          /* writer state (0:closed,1:open) */
+    thread_t thread;    /* flushing thread */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* condition of buffer state */
+} binw_t;
+
 typedef struct {        /* solution status type */
     gtime_t time;       /* time (GPST) */
     uint8_t sat;        /* satellite number */
@@ -1073,6 +1130,21 @@ typedef struct {        /* processing options type */
     double odisp[2][6*11]; /* ocean tide loading parameters {rov,base} */
     int  freqopt;       /* disable L2-AR */
     char pppopt[256];   /* ppp option */
+    int  measonly;      /* measurement-only preprocessing (0:off,1:on) */
+    int  nthread;       /* number of threads for processing units (0,1:serial) */
+    double tuwarm;      /* warm-up overlap of processing units (s) */
+    int  nshard;        /* number of processing shards (0,1:off) */
+    int  ishard;        /* index of processing shard (0:first) */
+    int  shmprod;       /* shared memory product store (0:off,1:on) */
+    double ckptint;     /* checkpoint interval of filter (s) (0:off) */
+    int  resume;        /* resume from checkpoint (0:off,1:on) */
+    int  arpart;        /* partial AR by subsets of ambiguities (0:off,1:on) */
+    int  arthread;      /* number of threads of partial AR (0,1:serial) */
+    int  artime;        /* time budget of partial AR per epoch (ms) (0:no limit) */
+    int  arppp;         /* PPP AR (0:off,1:wide-lane/narrow-lane) */
+    int  nbase;         /* number of base stations of multi-base rtk (0,1:single) */
+    int  basesel;       /* solution of multi-base rtk (0:best,1:blended) */
+    double rbs[MAXBASE-1][3]; /* positions of additional base stations (ecef) (m) (0:rinex) */
 } prcopt_t;
 
 typedef struct {        /* solution options type */
@@ -1110,8 +1182,19 @@ typedef struct {        /* file options type */
     char geexe  [MAXSTRPATH]; /* google earth exec file */
     char solstat[MAXSTRPATH]; /* solution statistics file */
     char trace  [MAXSTRPATH]; /* debug trace file */
+    char warmst [MAXSTRPATH]; /* checkpoint file for warm start */
 } filopt_t;
 
+typedef struct {        /* processing shard type */
+    int index;          /* index of shard (0:first) */
+    int count;          /* number of shards */
+    gtime_t ts,te;      /* output time span [ts-DTTOL,te) of shard (gpst) */
+    double warmup;      /* warm-up overlap (s) */
+    char solfile [MAXSTRPATH]; /* partial solution file (binary) */
+    char statfile[MAXSTRPATH]; /* partial solution status file ("":none) */
+    char bagfile [MAXSTRPATH]; /* partial measurement bag file ("":none) */
+} shard_t;
+
 typedef struct {        /* RINEX options type */
     gtime_t ts,te;      /* time start/end */
     double tint;        /* time interval (s) */
@@ -1184,6 +1267,14 @@ typedef struct {        /* ambiguity control type */
     char flags[MAXSAT]; /* fix flags */
 } ambc_t;
 
+typedef struct {        /* satellite states of rover obs data type */
+    int n;              /* number of rover obs data (-1:none) */
+    double rs[MAXOBS*6]; /* satellite positions/velocities (ecef) (m|m/s) */
+    double dts[MAXOBS*2]; /* satellite clock biases/drifts (s|s/s) */
+    double var[MAXOBS]; /* satellite position and clock error variances (m^2) */
+    int svh[MAXOBS];    /* satellite health flags */
+} satst_t;
+
 typedef struct {        /* RTK control/result type */
     sol_t  sol;         /* RTK solution */
     double rb[6];       /* base position/velocity (ecef) (m|m/s) */
@@ -1191,12 +1282,17 @@ typedef struct {        /* RTK control/result type */
     double tt;          /* time difference between current and previous (s) */
     double *x, *P;      /* float states and their covariance */
     double *xa,*Pa;     /* fixed states and their covariance */
+    void *work;         /* work buffer of ppp (pppos()) */
+    size_t nwork;       /* size of work buffer (bytes) */
     int nfix;           /* number of continuous fixes of ambiguity */
     ambc_t ambc[MAXSAT]; /* ambibuity control */
     ssat_t ssat[MAXSAT]; /* satellite status */
     int neb;            /* bytes in error message buffer */
     char errbuf[MAXERRMSG]; /* error message buffer */
     prcopt_t opt;       /* processing options */
+    const satst_t *satu; /* satellite states of rover shared by filters (NULL:no) */
+    void *arpool;       /* worker pool of partial AR (NULL:none) */
+    obsb_t *ob;         /* obs data of epoch for rtkpos() (NULL:error) */
 } rtk_t;
 
 typedef struct {        /* receiver raw data control type */
@@ -1420,6 +1516,10 @@ EXPORT gtime_t timeadd  (gtime_t t, double sec);
 EXPORT double  timediff (gtime_t t1, gtime_t t2);
 EXPORT gtime_t gpst2utc (gtime_t t);
 EXPORT gtime_t utc2gpst (gtime_t t);
+EXPORT gtimens_t time2ns(gtime_t t);
+EXPORT gtime_t ns2time  (gtimens_t t);
+EXPORT gtimens_t gpst2utcns(gtimens_t t);
+EXPORT gtimens_t utc2gpstns(gtimens_t t);
 EXPORT gtime_t gpst2bdt (gtime_t t);
 EXPORT gtime_t bdt2gpst (gtime_t t);
 EXPORT gtime_t timeget  (void);
@@ -1453,6 +1553,7 @@ EXPORT double dms2deg(const double *dms);
 /* input and output functions ------------------------------------------------*/
 EXPORT void readpos(const char *file, const char *rcv, double *pos);
 EXPORT int  sortobs(obs_t *obs);
+EXPORT int  setobsb(const obsd_t *obs, int n, const nav_t *nav, obsb_t *ob);
 EXPORT void uniqnav(nav_t *nav);
 EXPORT int  screent(gtime_t time, gtime_t ts, gtime_t te, double tint);
 EXPORT int  readnav(const char *file, nav_t *nav);
@@ -1463,6 +1564,12 @@ EXPORT int  readblq(const char *file, const char *sta, double *odisp);
 EXPORT int  readerp(const char *file, erp_t *erp);
 EXPORT int  geterp (const erp_t *erp, gtime_t time, double *val);
 
+/* memory accounting ---------------------------------------------------------*/
+EXPORT void memacct (int sub, int64_t bytes);
+EXPORT void memstat (int sub, int64_t *cur, int64_t *peak);
+EXPORT const char *memname(int sub);
+EXPORT void memreport(char *buff);
+
 /* debug trace functions -----------------------------------------------------*/
 EXPORT void traceopen(const char *file);
 EXPORT void traceclose(void);
@@ -1477,11 +1584,13 @@ EXPORT void tracehnav(int level, const nav_t *nav);
 EXPORT void tracepeph(int level, const nav_t *nav);
 EXPORT void tracepclk(int level, const nav_t *nav);
 EXPORT void traceb   (int level, const uint8_t *p, int n);
+EXPORT int  convtrace(const char *infile, const char *outfile);
 
 /* platform dependent functions ----------------------------------------------*/
 EXPORT int execcmd(const char *cmd);
 EXPORT int expath (const char *path, char *paths[], int nmax);
 EXPORT void createdir(const char *path);
+EXPORT int truncfile(const char *file, long size);
 
 /* positioning models --------------------------------------------------------*/
 EXPORT double satazel(const double *pos, const double *e, double *azel);
@@ -1579,6 +1688,10 @@ EXPORT void satposs(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
 EXPORT void setseleph(int sys, int sel);
 EXPORT int  getseleph(int sys);
 EXPORT void readsp3(const char *file, nav_t *nav, int opt);
+EXPORT void shmreadsp3(const char *file, nav_t *nav, int opt);
+EXPORT void shmreadtec(const char *file, nav_t *nav, int opt);
+EXPORT int  shmreadpcv(const char *file, pcvs_t *pcvs);
+EXPORT void shmfree(void *p);
 EXPORT int  readsap(const char *file, gtime_t time, nav_t *nav);
 EXPORT int  readdcb(const char *file, nav_t *nav, const sta_t *sta);
 EXPORT int  readfcb(const char *file, nav_t *nav);
@@ -1675,6 +1788,20 @@ EXPORT int readsolstatt(char *files[], int nfile, gtime_t ts, gtime_t te,
                         double tint, solstatbuf_t *statbuf);
 EXPORT int inputsol(uint8_t data, gtime_t ts, gtime_t te, double tint,
                     int qflag, const solopt_t *opt, solbuf_t *solbuf);
+EXPORT int convsolbin(const char *infile, const char *outfile,
+                      const solopt_t *opt);
+EXPORT int mergesolbin(char **infile, const gtime_t *ts, const gtime_t *te,
+                       int n, const char *outfile);
+
+EXPORT int  binwopen (binw_t *w, FILE *fp, int nbuff);
+EXPORT int  binwrite (binw_t *w, const uint8_t *data, int n);
+EXPORT void binwflush(binw_t *w);
+EXPORT void binwclose(binw_t *w);
+EXPORT int outsolbinh(uint8_t *buff, int type);
+EXPORT int outsolbin (uint8_t *buff, const sol_t *sol, const double *rb);
+EXPORT int insolbin  (const uint8_t *buff, sol_t *sol, double *rb);
+EXPORT int outstatbin(uint8_t *buff, gtime_t time, const char *msg, int n);
+EXPORT int outssatbin(uint8_t *buff, int sat, int frq, const ssat_t *ssat);
 
 EXPORT int outprcopts(uint8_t *buff, const prcopt_t *opt);
 EXPORT int outsolheads(uint8_t *buff, const solopt_t *opt);
@@ -1732,6 +1859,10 @@ EXPORT void resetsysopts(void);
 EXPORT void getsysopts(prcopt_t *popt, solopt_t *sopt, filopt_t *fopt);
 EXPORT void setsysopts(const prcopt_t *popt, const solopt_t *sopt,
                        const filopt_t *fopt);
+EXPORT int saveshard(const char *file, const shard_t *shard,
+                     const prcopt_t *popt, const solopt_t *sopt);
+EXPORT int loadshard(const char *file, shard_t *shard, prcopt_t *popt,
+                     solopt_t *sopt);
 
 /* stream data input and output functions ------------------------------------*/
 EXPORT void strinitcom(void);
@@ -1770,17 +1901,28 @@ EXPORT int pntpos(const obsd_t *obs, int n, const nav_t *nav,
 EXPORT void rtkinit(rtk_t *rtk, const prcopt_t *opt);
 EXPORT void rtkfree(rtk_t *rtk);
 EXPORT int  rtkpos (rtk_t *rtk, const obsd_t *obs, int nobs, const nav_t *nav);
+EXPORT int  rtkposb(rtk_t *rtk, const obsd_t *obs, const obsb_t *ob,
+                    const nav_t *nav);
 EXPORT int  rtkopenstat(const char *file, int level);
+EXPORT int  rtkopenstatb(const char *file, int level);
+EXPORT int  rtkresumestat(const char *file, int level, int bin, long size);
+EXPORT long rtkflushstat(void);
 EXPORT void rtkclosestat(void);
+EXPORT void rtkstatspan(gtime_t ts, gtime_t te);
 EXPORT int  rtkoutstat(rtk_t *rtk, char *buff);
+EXPORT int  rtksave(const rtk_t *rtk, FILE *fp);
+EXPORT int  rtkload(rtk_t *rtk, FILE *fp);
 
 /* precise point positioning -------------------------------------------------*/
 EXPORT void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav);
 EXPORT int pppnx(const prcopt_t *opt);
 EXPORT int pppoutstat(rtk_t *rtk, char *buff);
+EXPORT double gfmeas(const obsd_t *obs, const nav_t *nav);
+EXPORT double mwmeas(const obsd_t *obs, const nav_t *nav);
 
 EXPORT int ppp_ar(rtk_t *rtk, const obsd_t *obs, int n, int *exc,
-                  const nav_t *nav, const double *azel, double *x, double *P);
+                  const nav_t *nav, const double *azel, const int *jx, int na,
+                  double *x, double *P);
 
 /* post-processing positioning -----------------------------------------------*/
 EXPORT int postpos(gtime_t ts, gtime_t te, double ti, double tu,
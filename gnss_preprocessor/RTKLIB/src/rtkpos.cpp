@@ -49,6 +49,7 @@
 *-----------------------------------------------------------------------------*/
 #include <stdarg.h>
 #include "rtklib.h"
+#include "publish.h"
 
 #include <ros/ros.h>
 #include <gnss_msgs/GNSS_Raw_Array.h>
@@ -79,6 +80,9 @@
 #define TTOL_MOVEB  (1.0+2*DTTOL)
                              /* time sync tolerance for moving-baseline (s) */
 
+#define RTKSMAGIC   0x534B5452 /* magic number of saved rtk state ("RTKS") */
+#define RTKSVER     1        /* version of saved rtk state */
+
 /* number of parameters (pos,ionos,tropos,hw-bias,phase-bias,real,estimated) */
 #define NF(opt)     ((opt)->ionoopt==IONOOPT_IFLC?1:(opt)->nf)
 #define NP(opt)     ((opt)->dynamics==0?3:9)
@@ -95,18 +99,62 @@
 #define IL(f,opt)   (NP(opt)+NI(opt)+NT(opt)+(f))   /* receiver h/w bias */
 #define IB(s,f,opt) (NR(opt)+MAXSAT*(f)+(s)-1) /* phase bias (s:satno,f:freq) */
 
-/* global variables ----------------------------------------------------------*/
-static int statlevel=0;          /* rtk status output level (0:off) */
-static FILE *fp_stat=NULL;       /* rtk status file pointer */
-static char file_stat[1024]="";  /* rtk status file original path */
-static gtime_t time_stat={0};    /* rtk status file time */
+#define MAXHNZ      (3+2+6+2) /* max non-zero partials of DD residual (pos,
+                                 ionos,tropos+gradients of rov/ref,biases) */
+#define MAXDDBLK    (6*NFREQ*2+1) /* max blocks of DD measurement error cov */
+#define MIN_VARDD   1E-12    /* min SD measurement error variance (m^2) */
+#define MIN_NB_PAR  4        /* min number of ambiguities of partial AR */
+#define MAXARTHR    16       /* max number of threads of partial AR */
 
-ros::Publisher pub_station_raw;
+/* type definitions ----------------------------------------------------------*/
+typedef struct {        /* partial derivatives of DD residual (sparse row) */
+    int n;              /* number of non-zero partials */
+    int idx[MAXHNZ];    /* state index (ascending order) */
+    double val[MAXHNZ]; /* partial derivatives */
+} ddh_t;
 
-extern void rtkposRegisterPub(ros::NodeHandle &n)
-{
-    pub_station_raw = n.advertise<gnss_msgs::GNSS_Raw_Array>("gnss_raw_base", 1000);
-}
+typedef struct {        /* DD measurement error covariance (block diagonal) */
+    int n;              /* number of blocks (system/frequency/phase-code) */
+    int nb[MAXDDBLK];   /* number of DD residuals in each block */
+    double *Ri;         /* SD variance of reference satellite (ny x 1) */
+    double *Rj;         /* SD variance of target satellite (ny x 1) */
+} ddr_t;
+
+typedef struct {        /* partial AR candidate type */
+    int n;              /* number of DD ambiguities */
+    int *idx;           /* index of DD ambiguities (ascending order) */
+    double *b;          /* fixed DD ambiguities (n x 1) */
+    double ratio;       /* ratio of residuals of lambda search */
+    int stat;           /* status (0:not evaluated,1:validated,-1:rejected) */
+} arcand_t;
+
+typedef struct {        /* partial AR thread pool type */
+    arcand_t *cand;     /* candidates (in order of evaluation) */
+    int n,next;         /* number of candidates/next candidate to evaluate */
+    int nb;             /* number of DD ambiguities */
+    const double *y;    /* float DD ambiguities (nb x 1) */
+    const double *Qb;   /* covariance of float DD ambiguities (nb x nb) */
+    double thres;       /* threshold of ratio-test */
+    int nfix;           /* number of ambiguities of validated subset */
+    int tmax;           /* time budget (ms) (0:no limit) */
+    uint32_t tend;      /* end time of time budget (tick) */
+    int gen;            /* generation of candidates (incremented per epoch) */
+    int nrun;           /* number of workers on current generation */
+    int stop;           /* stop request of workers */
+    int nt;             /* number of worker threads */
+    thread_t thread[MAXARTHR]; /* worker threads */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* condition of generation and workers */
+} arpool_t;
+
+/* global variables (for each processing thread) -----------------------------*/
+static THREADLOCAL int statlevel=0;         /* rtk status output level (0:off) */
+static THREADLOCAL FILE *fp_stat=NULL;      /* rtk status file pointer */
+static THREADLOCAL char file_stat[1024]=""; /* rtk status file original path */
+static THREADLOCAL gtime_t time_stat={0};   /* rtk status file time */
+static THREADLOCAL binw_t binw_stat;        /* rtk status binary writer */
+static THREADLOCAL gtime_t ts_stat={0};     /* rtk status output start time */
+static THREADLOCAL gtime_t te_stat={0};     /* rtk status output end time */
 
 /* open solution status file ---------------------------------------------------
 * open solution status file and set output level
@@ -197,6 +245,82 @@ extern int rtkopenstat(const char *file, int level)
     statlevel=level;
     return 1;
 }
+/* open binary solution status file --------------------------------------------
+* open solution status file in binary format and set output level
+* args   : char     *file   I   rtk status file
+*          int      level   I   rtk status level (0: off)
+* return : status (1:ok,0:error)
+* notes  : the records are written by a background thread through large
+*          buffers. see outsolbinh() for the format. the file can be read by
+*          readsolstatt() and converted to the text format by convsolbin().
+*-----------------------------------------------------------------------------*/
+extern int rtkopenstatb(const char *file, int level)
+{
+    uint8_t buff[16];
+    int n;
+    
+    trace(3,"rtkopenstatb: file=%s level=%d\n",file,level);
+    
+    if (!rtkopenstat(file,level)) return 0;
+    
+    n=outsolbinh(buff,SOLB_STAT);
+    fwrite(buff,n,1,fp_stat);
+    
+    if (!binwopen(&binw_stat,fp_stat,0)) {
+        trace(1,"rtkopenstatb: binary writer open error\n");
+        rtkclosestat();
+        return 0;
+    }
+    return 1;
+}
+/* resume solution status file -------------------------------------------------
+* truncate solution status file to the size at a checkpoint and open it for
+* append
+* args   : char     *file   I   rtk status file
+*          int      level   I   rtk status level (0: off)
+*          int      bin     I   binary format (0:text,1:binary)
+*          long     size    I   size of file at checkpoint (bytes)
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int rtkresumestat(const char *file, int level, int bin, long size)
+{
+    gtime_t time=utc2gpst(timeget());
+    char path[1024];
+    
+    trace(3,"rtkresumestat: file=%s level=%d size=%ld\n",file,level,size);
+    
+    if (level<=0) return 0;
+    
+    reppath(file,path,time,"","");
+    
+    if (truncfile(path,size)<0||!(fp_stat=fopen(path,"ab"))) {
+        trace(1,"rtkresumestat: file open error path=%s\n",path);
+        return 0;
+    }
+    strcpy(file_stat,file);
+    time_stat=time;
+    statlevel=level;
+    
+    if (bin&&!binwopen(&binw_stat,fp_stat,0)) {
+        trace(1,"rtkresumestat: binary writer open error\n");
+        rtkclosestat();
+        return 0;
+    }
+    return 1;
+}
+/* flush solution status file --------------------------------------------------
+* write buffered solution status to file
+* args   : none
+* return : size of solution status file (bytes) (0: not open)
+*-----------------------------------------------------------------------------*/
+extern long rtkflushstat(void)
+{
+    if (!fp_stat) return 0;
+    
+    binwflush(&binw_stat);
+    fflush(fp_stat);
+    return ftell(fp_stat);
+}
 /* close solution status file --------------------------------------------------
 * close solution status file
 * args   : none
@@ -206,11 +330,23 @@ extern void rtkclosestat(void)
 {
     trace(3,"rtkclosestat:\n");
     
+    binwclose(&binw_stat);
     if (fp_stat) fclose(fp_stat);
     fp_stat=NULL;
     file_stat[0]='\0';
     statlevel=0;
 }
+/* set time span of solution status output -------------------------------------
+* limit solution status output of the calling thread to a time span
+* args   : gtime_t  ts      I   start time (ts.time==0: no limit)
+*          gtime_t  te      I   end time, exclusive (te.time==0: no limit)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void rtkstatspan(gtime_t ts, gtime_t te)
+{
+    ts_stat=ts;
+    te_stat=te;
+}
 /* write solution status to buffer -------------------------------------------*/
 extern int rtkoutstat(rtk_t *rtk, char *buff)
 {
@@ -302,7 +438,9 @@ extern int rtkoutstat(rtk_t *rtk, char *buff)
 static void swapsolstat(void)
 {
     gtime_t time=utc2gpst(timeget());
+    uint8_t buff[16];
     char path[1024];
+    int bin=binw_stat.state,n;
     
     if ((int)(time2gpst(time     ,NULL)/INT_SWAP_STAT)==
         (int)(time2gpst(time_stat,NULL)/INT_SWAP_STAT)) {
@@ -313,12 +451,18 @@ static void swapsolstat(void)
     if (!reppath(file_stat,path,time,"","")) {
         return;
     }
+    binwclose(&binw_stat);
     if (fp_stat) fclose(fp_stat);
     
     if (!(fp_stat=fopen(path,"w"))) {
         trace(2,"swapsolstat: file open error path=%s\n",path);
         return;
     }
+    if (bin) {
+        n=outsolbinh(buff,SOLB_STAT);
+        fwrite(buff,n,1,fp_stat);
+        binwopen(&binw_stat,fp_stat,0);
+    }
     trace(3,"swapsolstat: path=%s\n",path);
 }
 /* output solution status ----------------------------------------------------*/
@@ -327,24 +471,44 @@ static void outsolstat(rtk_t *rtk)
     ssat_t *ssat;
     double tow;
     char buff[MAXSOLMSG+1],id[32];
+    uint8_t bbuff[MAXSOLMSG+64];
     int i,j,n,week,nfreq,nf=NF(&rtk->opt);
     
     if (statlevel<=0||!fp_stat||!rtk->sol.stat) return;
     
+    if ((ts_stat.time&&timediff(rtk->sol.time,ts_stat)<-DTTOL)||
+        (te_stat.time&&timediff(rtk->sol.time,te_stat)>=0.0  )) return;
+    
     trace(3,"outsolstat:\n");
     
     /* swap solution status file */
-    swapsolstat();
+    if (strchr(file_stat,'%')) swapsolstat();
     
     /* write solution status */
     n=rtkoutstat(rtk,buff); buff[n]='\0';
     
+    nfreq=rtk->opt.mode>=PMODE_DGPS?nf:1;
+    
+    if (binw_stat.state) { /* binary */
+        n=outstatbin(bbuff,rtk->sol.time,buff,n);
+        binwrite(&binw_stat,bbuff,n);
+        
+        if (rtk->sol.stat==SOLQ_NONE||statlevel<=1) return;
+        
+        for (i=0;i<MAXSAT;i++) {
+            if (!rtk->ssat[i].vs) continue;
+            for (j=0;j<nfreq;j++) {
+                n=outssatbin(bbuff,i+1,j,rtk->ssat+i);
+                binwrite(&binw_stat,bbuff,n);
+            }
+        }
+        return;
+    }
     fputs(buff,fp_stat);
     
     if (rtk->sol.stat==SOLQ_NONE||statlevel<=1) return;
     
     tow=time2gpst(rtk->sol.time,&week);
-    nfreq=rtk->opt.mode>=PMODE_DGPS?nf:1;
     
     /* write residuals and status */
     for (i=0;i<MAXSAT;i++) {
@@ -377,21 +541,21 @@ static void errmsg(rtk_t *rtk, const char *format, ...)
     trace(2,"%s",buff);
 }
 /* single-differenced observable ---------------------------------------------*/
-static double sdobs(const obsd_t *obs, int i, int j, int k)
+static double sdobs(const obsb_t *ob, int i, int j, int k)
 {
-    double pi=(k<NFREQ)?obs[i].L[k]:obs[i].P[k-NFREQ];
-    double pj=(k<NFREQ)?obs[j].L[k]:obs[j].P[k-NFREQ];
+    double pi=(k<NFREQ)?ob->L[k][i]:ob->P[k-NFREQ][i];
+    double pj=(k<NFREQ)?ob->L[k][j]:ob->P[k-NFREQ][j];
     return pi==0.0||pj==0.0?0.0:pi-pj;
 }
 /* single-differenced geometry-free linear combination of phase --------------*/
-static double gfobs(const obsd_t *obs, int i, int j, int k, const nav_t *nav)
+static double gfobs(const obsb_t *ob, int i, int j, int k)
 {
     double freq1,freq2,L1,L2;
     
-    freq1=sat2freq(obs[i].sat,obs[i].code[0],nav);
-    freq2=sat2freq(obs[i].sat,obs[i].code[k],nav);
-    L1=sdobs(obs,i,j,0);
-    L2=sdobs(obs,i,j,k);
+    freq1=ob->freq[0][i];
+    freq2=ob->freq[k][i];
+    L1=sdobs(ob,i,j,0);
+    L2=sdobs(ob,i,j,k);
     if (freq1==0.0||freq2==0.0||L1==0.0||L2==0.0) return 0.0;
     return L1*CLIGHT/freq1-L2*CLIGHT/freq2;
 }
@@ -428,7 +592,7 @@ static void initx(rtk_t *rtk, double xi, double var, int i)
     }
 }
 /* select common satellites between rover and reference station --------------*/
-static int selsat(const obsd_t *obs, double *azel, int nu, int nr,
+static int selsat(const obsb_t *ob, double *azel, int nu, int nr,
                   const prcopt_t *opt, int *sat, int *iu, int *ir)
 {
     int i,j,k=0;
@@ -436,11 +600,11 @@ static int selsat(const obsd_t *obs, double *azel, int nu, int nr,
     trace(3,"selsat  : nu=%d nr=%d\n",nu,nr);
     
     for (i=0,j=nu;i<nu&&j<nu+nr;i++,j++) {
-        if      (obs[i].sat<obs[j].sat) j--;
-        else if (obs[i].sat>obs[j].sat) i--;
+        if      (ob->sat[i]<ob->sat[j]) j--;
+        else if (ob->sat[i]>ob->sat[j]) i--;
         else if (azel[1+j*2]>=opt->elmin) { /* elevation at base station */
-            sat[k]=obs[i].sat; iu[k]=i; ir[k++]=j;
-            trace(4,"(%2d) sat=%3d iu=%2d ir=%2d\n",k-1,obs[i].sat,i,j);
+            sat[k]=ob->sat[i]; iu[k]=i; ir[k++]=j;
+            trace(4,"(%2d) sat=%3d iu=%2d ir=%2d\n",k-1,ob->sat[i],i,j);
         }
     }
     return k;
@@ -610,17 +774,17 @@ static void udrcvbias(rtk_t *rtk, double tt)
     }
 }
 /* detect cycle slip by LLI --------------------------------------------------*/
-static void detslp_ll(rtk_t *rtk, const obsd_t *obs, int i, int rcv)
+static void detslp_ll(rtk_t *rtk, const obsb_t *ob, int i, int rcv)
 {
     uint32_t slip,LLI;
-    int f,sat=obs[i].sat;
+    int f,sat=ob->sat[i];
     
     trace(3,"detslp_ll: i=%d rcv=%d\n",i,rcv);
     
     for (f=0;f<rtk->opt.nf;f++) {
         
-        if (obs[i].L[f]==0.0||
-            fabs(timediff(obs[i].time,rtk->ssat[sat-1].pt[rcv-1][f]))<DTTOL) {
+        if (ob->L[f][i]==0.0||
+            fabs(timediff(ob->time[i],rtk->ssat[sat-1].pt[rcv-1][f]))<DTTOL) {
             continue;
         }
         /* restore previous LLI */
@@ -629,11 +793,11 @@ static void detslp_ll(rtk_t *rtk, const obsd_t *obs, int i, int rcv)
         
         /* detect slip by cycle slip flag in LLI */
         if (rtk->tt>=0.0) { /* forward */
-            if (obs[i].LLI[f]&1) {
+            if (ob->LLI[f][i]&1) {
                 errmsg(rtk,"slip detected forward  (sat=%2d rcv=%d F=%d LLI=%x)\n",
-                       sat,rcv,f+1,obs[i].LLI[f]);
+                       sat,rcv,f+1,ob->LLI[f][i]);
             }
-            slip=obs[i].LLI[f];
+            slip=ob->LLI[f][i];
         }
         else { /* backward */
             if (LLI&1) {
@@ -643,31 +807,30 @@ static void detslp_ll(rtk_t *rtk, const obsd_t *obs, int i, int rcv)
             slip=LLI;
         }
         /* detect slip by parity unknown flag transition in LLI */
-        if (((LLI&2)&&!(obs[i].LLI[f]&2))||(!(LLI&2)&&(obs[i].LLI[f]&2))) {
+        if (((LLI&2)&&!(ob->LLI[f][i]&2))||(!(LLI&2)&&(ob->LLI[f][i]&2))) {
             errmsg(rtk,"slip detected half-cyc (sat=%2d rcv=%d F=%d LLI=%x->%x)\n",
-                   sat,rcv,f+1,LLI,obs[i].LLI[f]);
+                   sat,rcv,f+1,LLI,ob->LLI[f][i]);
             slip|=1;
         }
         /* save current LLI */
-        if (rcv==1) setbitu(&rtk->ssat[sat-1].slip[f],0,2,obs[i].LLI[f]);
-        else        setbitu(&rtk->ssat[sat-1].slip[f],2,2,obs[i].LLI[f]);
+        if (rcv==1) setbitu(&rtk->ssat[sat-1].slip[f],0,2,ob->LLI[f][i]);
+        else        setbitu(&rtk->ssat[sat-1].slip[f],2,2,ob->LLI[f][i]);
         
         /* save slip and half-cycle valid flag */
         rtk->ssat[sat-1].slip[f]|=(uint8_t)slip;
-        rtk->ssat[sat-1].half[f]=(obs[i].LLI[f]&2)?0:1;
+        rtk->ssat[sat-1].half[f]=(ob->LLI[f][i]&2)?0:1;
     }
 }
 /* detect cycle slip by geometry free phase jump -----------------------------*/
-static void detslp_gf(rtk_t *rtk, const obsd_t *obs, int i, int j,
-                      const nav_t *nav)
+static void detslp_gf(rtk_t *rtk, const obsb_t *ob, int i, int j)
 {
-    int k,sat=obs[i].sat;
+    int k,sat=ob->sat[i];
     double g0,g1;
     
     trace(3,"detslp_gf: i=%d j=%d\n",i,j);
     
     for (k=1;k<rtk->opt.nf;k++) {
-        if ((g1=gfobs(obs,i,j,k,nav))==0.0) return;
+        if ((g1=gfobs(ob,i,j,k))==0.0) return;
          
         g0=rtk->ssat[sat-1].gf[k-1];
         rtk->ssat[sat-1].gf[k-1]=g1;
@@ -681,28 +844,28 @@ static void detslp_gf(rtk_t *rtk, const obsd_t *obs, int i, int j,
     }
 }
 /* detect cycle slip by doppler and phase difference -------------------------*/
-static void detslp_dop(rtk_t *rtk, const obsd_t *obs, int i, int rcv,
+static void detslp_dop(rtk_t *rtk, const obsb_t *ob, int i, int rcv,
                        const nav_t *nav)
 {
 #if 0 /* detection with doppler disabled because of clock-jump issue (v.2.3.0) */
-    int f,sat=obs[i].sat;
+    int f,sat=ob->sat[i];
     double tt,dph,dpt,lam,thres;
     
     trace(3,"detslp_dop: i=%d rcv=%d\n",i,rcv);
     
     for (f=0;f<rtk->opt.nf;f++) {
-        if (obs[i].L[f]==0.0||obs[i].D[f]==0.0||rtk->ph[rcv-1][sat-1][f]==0.0) {
+        if (ob->L[f][i]==0.0||ob->D[f][i]==0.0||rtk->ph[rcv-1][sat-1][f]==0.0) {
             continue;
         }
-        if (fabs(tt=timediff(obs[i].time,rtk->pt[rcv-1][sat-1][f]))<DTTOL) continue;
+        if (fabs(tt=timediff(ob->time[i],rtk->pt[rcv-1][sat-1][f]))<DTTOL) continue;
         if ((lam=nav->lam[sat-1][f])<=0.0) continue;
         
         /* cycle slip threshold (cycle) */
         thres=MAXACC*tt*tt/2.0/lam+rtk->opt.err[4]*fabs(tt)*4.0;
         
         /* phase difference and doppler x time (cycle) */
-        dph=obs[i].L[f]-rtk->ph[rcv-1][sat-1][f];
-        dpt=-obs[i].D[f]*tt;
+        dph=ob->L[f][i]-rtk->ph[rcv-1][sat-1][f];
+        dpt=-ob->D[f][i]*tt;
         
         if (fabs(dph-dpt)<=thres) continue;
         
@@ -714,7 +877,7 @@ static void detslp_dop(rtk_t *rtk, const obsd_t *obs, int i, int rcv,
 #endif
 }
 /* temporal update of phase biases -------------------------------------------*/
-static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
+static void udbias(rtk_t *rtk, double tt, const obsb_t *ob, const int *sat,
                    const int *iu, const int *ir, int ns, const nav_t *nav)
 {
     double cp,pr,cp1,cp2,pr1,pr2,*bias,offset,freqi,freq1,freq2,C1,C2;
@@ -726,20 +889,20 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
         
         /* detect cycle slip by LLI */
         for (k=0;k<rtk->opt.nf;k++) rtk->ssat[sat[i]-1].slip[k]&=0xFC;
-        detslp_ll(rtk,obs,iu[i],1);
-        detslp_ll(rtk,obs,ir[i],2);
+        detslp_ll(rtk,ob,iu[i],1);
+        detslp_ll(rtk,ob,ir[i],2);
         
         /* detect cycle slip by geometry-free phase jump */
-        detslp_gf(rtk,obs,iu[i],ir[i],nav);
+        detslp_gf(rtk,ob,iu[i],ir[i]);
         
         /* detect cycle slip by doppler and phase difference */
-        detslp_dop(rtk,obs,iu[i],1,nav);
-        detslp_dop(rtk,obs,ir[i],2,nav);
+        detslp_dop(rtk,ob,iu[i],1,nav);
+        detslp_dop(rtk,ob,ir[i],2,nav);
         
         /* update half-cycle valid flag */
         for (k=0;k<nf;k++) {
             rtk->ssat[sat[i]-1].half[k]=
-                !((obs[iu[i]].LLI[k]&2)||(obs[ir[i]].LLI[k]&2));
+                !((ob->LLI[k][iu[i]]&2)||(ob->LLI[k][ir[i]]&2));
         }
     }
     for (k=0;k<nf;k++) {
@@ -777,20 +940,20 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
         for (i=j=0,offset=0.0;i<ns;i++) {
             
             if (rtk->opt.ionoopt!=IONOOPT_IFLC) {
-                cp=sdobs(obs,iu[i],ir[i],k); /* cycle */
-                pr=sdobs(obs,iu[i],ir[i],k+NFREQ);
-                freqi=sat2freq(sat[i],obs[iu[i]].code[k],nav);
+                cp=sdobs(ob,iu[i],ir[i],k); /* cycle */
+                pr=sdobs(ob,iu[i],ir[i],k+NFREQ);
+                freqi=ob->freq[k][iu[i]];
                 if (cp==0.0||pr==0.0||freqi==0.0) continue;
                 
                 bias[i]=cp-pr*freqi/CLIGHT;
             }
             else {
-                cp1=sdobs(obs,iu[i],ir[i],0);
-                cp2=sdobs(obs,iu[i],ir[i],1);
-                pr1=sdobs(obs,iu[i],ir[i],NFREQ);
-                pr2=sdobs(obs,iu[i],ir[i],NFREQ+1);
-                freq1=sat2freq(sat[i],obs[iu[i]].code[0],nav);
-                freq2=sat2freq(sat[i],obs[iu[i]].code[1],nav);
+                cp1=sdobs(ob,iu[i],ir[i],0);
+                cp2=sdobs(ob,iu[i],ir[i],1);
+                pr1=sdobs(ob,iu[i],ir[i],NFREQ);
+                pr2=sdobs(ob,iu[i],ir[i],NFREQ+1);
+                freq1=ob->freq[0][iu[i]];
+                freq2=ob->freq[1][iu[i]];
                 if (cp1==0.0||cp2==0.0||pr1==0.0||pr2==0.0||freq1==0.0||freq2<=0.0) continue;
                 
                 C1= SQR(freq1)/(SQR(freq1)-SQR(freq2));
@@ -816,8 +979,8 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
         free(bias);
     }
 }
-/* temporal update of states --------------------------------------------------*/
-static void udstate(rtk_t *rtk, const obsd_t *obs, const int *sat,
+/* temporal update of states -------------------------------------------------*/
+static void udstate(rtk_t *rtk, const obsb_t *ob, const int *sat,
                     const int *iu, const int *ir, int ns, const nav_t *nav)
 {
     double tt=rtk->tt,bl,dr[3];
@@ -842,56 +1005,58 @@ static void udstate(rtk_t *rtk, const obsd_t *obs, const int *sat,
     }
     /* temporal update of phase-bias */
     if (rtk->opt.mode>PMODE_DGPS) {
-        udbias(rtk,tt,obs,sat,iu,ir,ns,nav);
+        udbias(rtk,tt,ob,sat,iu,ir,ns,nav);
     }
 }
 /* UD (undifferenced) phase/code residual for satellite ----------------------*/
-static void zdres_sat(int base, double r, const obsd_t *obs, const nav_t *nav,
+static void zdres_sat(int base, double r, const obsb_t *ob, int j,
                       const double *azel, const double *dant,
-                      const prcopt_t *opt, double *y, double *freq)
+                      const prcopt_t *opt, double *y)
 {
     double freq1,freq2,C1,C2,dant_if;
     int i,nf=NF(opt);
     
     if (opt->ionoopt==IONOOPT_IFLC) { /* iono-free linear combination */
-        freq1=sat2freq(obs->sat,obs->code[0],nav);
-        freq2=sat2freq(obs->sat,obs->code[1],nav);
+        freq1=ob->freq[0][j];
+        freq2=ob->freq[1][j];
         if (freq1==0.0||freq2==0.0) return;
         
-        if (testsnr(base,0,azel[1],obs->SNR[0]*SNR_UNIT,&opt->snrmask)||
-            testsnr(base,1,azel[1],obs->SNR[1]*SNR_UNIT,&opt->snrmask)) return;
+        if (testsnr(base,0,azel[1],ob->SNR[0][j]*SNR_UNIT,&opt->snrmask)||
+            testsnr(base,1,azel[1],ob->SNR[1][j]*SNR_UNIT,&opt->snrmask)) {
+            return;
+        }
         
         C1= SQR(freq1)/(SQR(freq1)-SQR(freq2));
         C2=-SQR(freq2)/(SQR(freq1)-SQR(freq2));
         dant_if=C1*dant[0]+C2*dant[1];
         
-        if (obs->L[0]!=0.0&&obs->L[1]!=0.0) {
-            y[0]=C1*obs->L[0]*CLIGHT/freq1+C2*obs->L[1]*CLIGHT/freq2-r-dant_if;
+        if (ob->L[0][j]!=0.0&&ob->L[1][j]!=0.0) {
+            y[0]=C1*ob->L[0][j]*CLIGHT/freq1+C2*ob->L[1][j]*CLIGHT/freq2-r-
+                 dant_if;
         }
-        if (obs->P[0]!=0.0&&obs->P[1]!=0.0) {
-            y[1]=C1*obs->P[0]+C2*obs->P[1]-r-dant_if;
+        if (ob->P[0][j]!=0.0&&ob->P[1][j]!=0.0) {
+            y[1]=C1*ob->P[0][j]+C2*ob->P[1][j]-r-dant_if;
         }
-        freq[0]=1.0;
     }
     else {
         for (i=0;i<nf;i++) {
-            if ((freq[i]=sat2freq(obs->sat,obs->code[i],nav))==0.0) continue;
+            if ((freq1=ob->freq[i][j])==0.0) continue;
             
             /* check SNR mask */
-            if (testsnr(base,i,azel[1],obs->SNR[i]*SNR_UNIT,&opt->snrmask)) {
+            if (testsnr(base,i,azel[1],ob->SNR[i][j]*SNR_UNIT,&opt->snrmask)) {
                 continue;
             }
             /* residuals = observable - pseudorange */
-            if (obs->L[i]!=0.0) y[i   ]=obs->L[i]*CLIGHT/freq[i]-r-dant[i];
-            if (obs->P[i]!=0.0) y[i+nf]=obs->P[i]               -r-dant[i];
+            if (ob->L[i][j]!=0.0) y[i   ]=ob->L[i][j]*CLIGHT/freq1-r-dant[i];
+            if (ob->P[i][j]!=0.0) y[i+nf]=ob->P[i][j]               -r-dant[i];
         }
     }
 }
 /* UD (undifferenced) phase/code residuals -----------------------------------*/
-static int zdres(int base, const obsd_t *obs, int n, const double *rs,
+static int zdres(int base, const obsb_t *ob, int i0, int n, const double *rs,
                  const double *dts, const double *var, const int *svh,
                  const nav_t *nav, const double *rr, const prcopt_t *opt,
-                 int index, double *y, double *e, double *azel, double *freq)
+                 int index, double *y, double *e, double *azel)
 {
     double r,rr_[3],pos[3],dant[NFREQ]={0},disp[3];
     double zhd,zazel[]={0.0,90.0*D2R};
@@ -907,7 +1072,7 @@ static int zdres(int base, const obsd_t *obs, int n, const double *rs,
     
     /* earth tide correction */
     if (opt->tidecorr) {
-        tidedisp(gpst2utc(obs[0].time),rr_,opt->tidecorr,&nav->erp,
+        tidedisp(gpst2utc(ob->time[i0]),rr_,opt->tidecorr,&nav->erp,
                  opt->odisp[base],disp);
         for (i=0;i<3;i++) rr_[i]+=disp[i];
     }
@@ -919,27 +1084,27 @@ static int zdres(int base, const obsd_t *obs, int n, const double *rs,
         if (satazel(pos,e+i*3,azel+i*2)<opt->elmin) continue;
         
         /* excluded satellite? */
-        if (satexclude(obs[i].sat,var[i],svh[i],opt)) continue;
+        if (satexclude(ob->sat[i0+i],var[i],svh[i],opt)) continue;
         
         /* satellite clock-bias */
         r+=-CLIGHT*dts[i*2];
         
         /* troposphere delay model (hydrostatic) */
-        zhd=tropmodel(obs[0].time,pos,zazel,0.0);
-        r+=tropmapf(obs[i].time,pos,azel+i*2,NULL)*zhd;
+        zhd=tropmodel(ob->time[i0],pos,zazel,0.0);
+        r+=tropmapf(ob->time[i0+i],pos,azel+i*2,NULL)*zhd;
         
         /* receiver antenna phase center correction */
         antmodel(opt->pcvr+index,opt->antdel[index],azel+i*2,opt->posopt[1],
                  dant);
         
         /* UD phase/code residual for satellite */
-        zdres_sat(base,r,obs+i,nav,azel+i*2,dant,opt,y+i*nf*2,freq+i*nf);
+        zdres_sat(base,r,ob,i0+i,azel+i*2,dant,opt,y+i*nf*2);
     }
     trace(4,"rr_=%.3f %.3f %.3f\n",rr_[0],rr_[1],rr_[2]);
     trace(4,"pos=%.9f %.9f %.3f\n",pos[0]*R2D,pos[1]*R2D,pos[2]);
     for (i=0;i<n;i++) {
         trace(4,"sat=%2d %13.3f %13.3f %13.3f %13.10f %6.1f %5.1f\n",
-              obs[i].sat,rs[i*6],rs[1+i*6],rs[2+i*6],dts[i*2],azel[i*2]*R2D,
+              ob->sat[i0+i],rs[i*6],rs[1+i*6],rs[2+i*6],dts[i*2],azel[i*2]*R2D,
               azel[1+i*2]*R2D);
     }
     trace(4,"y=\n"); tracemat(4,y,nf*2,n,13,3);
@@ -953,26 +1118,59 @@ static int validobs(int i, int j, int f, int nf, double *y)
     return y[f+i*nf*2]!=0.0&&y[f+j*nf*2]!=0.0&&
            (f<nf||(y[f-nf+i*nf*2]!=0.0&&y[f-nf+j*nf*2]!=0.0));
 }
-/* DD (double-differenced) measurement error covariance ----------------------*/
-static void ddcov(const int *nb, int n, const double *Ri, const double *Rj,
-                  int nv, double *R)
+/* DD (double-differenced) measurement error covariance ------------------------
+* each block of DD residuals shares the reference satellite, so that the
+* covariance of the block is Ri*1*1'+diag(Rj)
+*-----------------------------------------------------------------------------*/
+static void ddcov(const ddr_t *R)
 {
-    int i,j,k=0,b;
+    int i,k=0,b;
     
-    trace(3,"ddcov   : n=%d\n",n);
+    trace(3,"ddcov   : n=%d\n",R->n);
     
-    for (i=0;i<nv*nv;i++) R[i]=0.0;
-    for (b=0;b<n;k+=nb[b++]) {
-        
-        for (i=0;i<nb[b];i++) for (j=0;j<nb[b];j++) {
-            R[k+i+(k+j)*nv]=Ri[k+i]+(i==j?Rj[k+i]:0.0);
-        }
+    for (b=0;b<R->n;k+=R->nb[b++]) {
+        trace(5,"block %2d: Ri=%10.6f Rj=",b,R->nb[b]>0?R->Ri[k]:0.0);
+        for (i=0;i<R->nb[b];i++) trace(5," %10.6f",R->Rj[k+i]);
+        trace(5,"\n");
+    }
+}
+/* set partial derivative of DD residual -------------------------------------*/
+static void setddh(ddh_t *h, int i, double val)
+{
+    int j,k;
+    
+    for (j=0;j<h->n&&h->idx[j]<i;j++) ;
+    
+    if (j<h->n&&h->idx[j]==i) {
+        h->val[j]=val;
+        return;
+    }
+    if (h->n>=MAXHNZ) {
+        trace(1,"setddh: too many partials of DD residual n=%d i=%d\n",h->n,i);
+        return;
+    }
+    for (k=h->n;k>j;k--) {
+        h->idx[k]=h->idx[k-1];
+        h->val[k]=h->val[k-1];
+    }
+    h->idx[j]=i;
+    h->val[j]=val;
+    h->n++;
+}
+/* trace partial derivatives of DD residuals ---------------------------------*/
+static void traceddh(int level, const ddh_t *H, int m)
+{
+    int i,j;
+    
+    for (i=0;i<m;i++) {
+        trace(level,"%3d:",i);
+        for (j=0;j<H[i].n;j++) trace(level," %d:%.4f",H[i].idx[j],H[i].val[j]);
+        trace(level,"\n");
     }
-    trace(5,"R=\n"); tracemat(5,R,nv,nv,8,6);
 }
 /* baseline length constraint ------------------------------------------------*/
-static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
-                   double *H, double *Ri, double *Rj, int index)
+static int constbl(rtk_t *rtk, const double *x, const double *P, int np,
+                   double *v, ddh_t *H, double *Ri, double *Rj, int index)
 {
     const double thres=0.1; /* threshold for nonliearity (v.2.3.0) */
     double xb[3],b[3],bb,var=0.0;
@@ -992,7 +1190,7 @@ static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
     
     /* approximate variance of solution */
     if (P) {
-        for (i=0;i<3;i++) var+=P[i+i*rtk->nx];
+        for (i=0;i<3;i++) var+=P[i+i*np];
         var/=3.0;
     }
     /* check nonlinearity */
@@ -1003,7 +1201,8 @@ static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
     /* constraint to baseline length */
     v[index]=rtk->opt.baseline[0]-bb;
     if (H) {
-        for (i=0;i<3;i++) H[i+index*rtk->nx]=b[i]/bb;
+        H[index].n=0;
+        for (i=0;i<3;i++) setddh(H+index,i,b[i]/bb);
     }
     Ri[index]=0.0;
     Rj[index]=SQR(rtk->opt.baseline[1]);
@@ -1052,22 +1251,25 @@ static int test_sys(int sys, int m)
     return 0;
 }
 /* DD (double-differenced) phase/code residuals ------------------------------*/
-static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
-                 const double *P, const int *sat, double *y, double *e,
-                 double *azel, double *freq, const int *iu, const int *ir,
-                 int ns, double *v, double *H, double *R, int *vflg)
+static int ddres(rtk_t *rtk, const obsb_t *ob, const nav_t *nav, double dt,
+                 const double *x, const double *P, int np, const int *sat,
+                 double *y, double *e, double *azel, const int *iu,
+                 const int *ir, int ns, double *v, ddh_t *H, ddr_t *R,
+                 int *vflg)
 {
     prcopt_t *opt=&rtk->opt;
     double bl,dr[3],posu[3],posr[3],didxi=0.0,didxj=0.0,*im;
-    double *tropr,*tropu,*dtdxr,*dtdxu,*Ri,*Rj,freqi,freqj,*Hi=NULL;
-    int i,j,k,m,f,nv=0,nb[NFREQ*4*2+2]={0},b=0,sysi,sysj,nf=NF(opt);
+    double *tropr,*tropu,*dtdxr,*dtdxu,*Ri=R->Ri,*Rj=R->Rj,freqi,freqj;
+    ddh_t *Hi=NULL;
+    int i,j,k,m,f,nv=0,*nb=R->nb,b=0,sysi,sysj,nf=NF(opt);
     
     trace(3,"ddres   : dt=%.1f nx=%d ns=%d\n",dt,rtk->nx,ns);
     
     bl=baseline(x,rtk->rb,dr);
     ecef2pos(x,posu); ecef2pos(rtk->rb,posr);
     
-    Ri=mat(ns*nf*2+2,1); Rj=mat(ns*nf*2+2,1); im=mat(ns,1);
+    for (i=0;i<MAXDDBLK;i++) nb[i]=0;
+    im=mat(ns,1);
     tropu=mat(ns,1); tropr=mat(ns,1); dtdxu=mat(ns,3); dtdxr=mat(ns,3);
     
     for (i=0;i<MAXSAT;i++) for (j=0;j<NFREQ;j++) {
@@ -1101,14 +1303,14 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
             if (i==j) continue;
             sysi=rtk->ssat[sat[i]-1].sys;
             sysj=rtk->ssat[sat[j]-1].sys;
-            freqi=freq[f%nf+iu[i]*nf];
-            freqj=freq[f%nf+iu[j]*nf];
+            freqi=ob->freq[f%nf][iu[i]];
+            freqj=ob->freq[f%nf][iu[j]];
             if (!test_sys(sysj,m)) continue;
             if (!validobs(iu[j],ir[j],f,nf,y)) continue;
             
             if (H) {
-                Hi=H+nv*rtk->nx;
-                for (k=0;k<rtk->nx;k++) Hi[k]=0.0;
+                Hi=H+nv;
+                Hi->n=0;
             }
             /* DD residual */
             v[nv]=(y[f+iu[i]*nf*2]-y[f+ir[i]*nf*2])-
@@ -1117,7 +1319,7 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
             /* partial derivatives by rover position */
             if (H) {
                 for (k=0;k<3;k++) {
-                    Hi[k]=-e[k+iu[i]*3]+e[k+iu[j]*3];
+                    setddh(Hi,k,-e[k+iu[i]*3]+e[k+iu[j]*3]);
                 }
             }
             /* DD ionospheric delay term */
@@ -1126,8 +1328,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
                 didxj=(f<nf?-1.0:1.0)*im[j]*SQR(FREQ1/freqj);
                 v[nv]-=didxi*x[II(sat[i],opt)]-didxj*x[II(sat[j],opt)];
                 if (H) {
-                    Hi[II(sat[i],opt)]= didxi;
-                    Hi[II(sat[j],opt)]=-didxj;
+                    setddh(Hi,II(sat[i],opt), didxi);
+                    setddh(Hi,II(sat[j],opt),-didxj);
                 }
             }
             /* DD tropospheric delay term */
@@ -1135,8 +1337,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
                 v[nv]-=(tropu[i]-tropu[j])-(tropr[i]-tropr[j]);
                 for (k=0;k<(opt->tropopt<TROPOPT_ESTG?1:3);k++) {
                     if (!H) continue;
-                    Hi[IT(0,opt)+k]= (dtdxu[k+i*3]-dtdxu[k+j*3]);
-                    Hi[IT(1,opt)+k]=-(dtdxr[k+i*3]-dtdxr[k+j*3]);
+                    setddh(Hi,IT(0,opt)+k, (dtdxu[k+i*3]-dtdxu[k+j*3]));
+                    setddh(Hi,IT(1,opt)+k,-(dtdxr[k+i*3]-dtdxr[k+j*3]));
                 }
             }
             /* DD phase-bias term */
@@ -1145,15 +1347,15 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
                     v[nv]-=CLIGHT/freqi*x[IB(sat[i],f,opt)]-
                            CLIGHT/freqj*x[IB(sat[j],f,opt)];
                     if (H) {
-                        Hi[IB(sat[i],f,opt)]= CLIGHT/freqi;
-                        Hi[IB(sat[j],f,opt)]=-CLIGHT/freqj;
+                        setddh(Hi,IB(sat[i],f,opt), CLIGHT/freqi);
+                        setddh(Hi,IB(sat[j],f,opt),-CLIGHT/freqj);
                     }
                 }
                 else {
                     v[nv]-=x[IB(sat[i],f,opt)]-x[IB(sat[j],f,opt)];
                     if (H) {
-                        Hi[IB(sat[i],f,opt)]= 1.0;
-                        Hi[IB(sat[j],f,opt)]=-1.0;
+                        setddh(Hi,IB(sat[i],f,opt), 1.0);
+                        setddh(Hi,IB(sat[j],f,opt),-1.0);
                     }
                 }
             }
@@ -1192,16 +1394,17 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
     /* end of system loop */
     
     /* baseline length constraint for moving baseline */
-    if (opt->mode==PMODE_MOVEB&&constbl(rtk,x,P,v,H,Ri,Rj,nv)) {
+    if (opt->mode==PMODE_MOVEB&&constbl(rtk,x,P,np,v,H,Ri,Rj,nv)) {
         vflg[nv++]=3<<4;
         nb[b++]++;
     }
-    if (H) {trace(5,"H=\n"); tracemat(5,H,rtk->nx,nv,7,4);}
+    if (H) {trace(5,"H=\n"); traceddh(5,H,nv);}
     
     /* DD measurement error covariance */
-    ddcov(nb,b,Ri,Rj,nv,R);
+    R->n=b;
+    ddcov(R);
     
-    free(Ri); free(Rj); free(im);
+    free(im);
     free(tropu); free(tropr); free(dtdxu); free(dtdxr);
     
     return nv;
@@ -1210,10 +1413,11 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
 static double intpres(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
                       rtk_t *rtk, double *y)
 {
-    static obsd_t obsb[MAXOBS];
-    static double yb[MAXOBS*NFREQ*2],rs[MAXOBS*6],dts[MAXOBS*2],var[MAXOBS];
-    static double e[MAXOBS*3],azel[MAXOBS*2],freq[MAXOBS*NFREQ];
-    static int nb=0,svh[MAXOBS*2];
+    static THREADLOCAL obsd_t obsb[MAXOBS];
+    static THREADLOCAL obsb_t ob;
+    static THREADLOCAL double yb[MAXOBS*NFREQ*2],rs[MAXOBS*6],dts[MAXOBS*2];
+    static THREADLOCAL double var[MAXOBS],e[MAXOBS*3],azel[MAXOBS*2];
+    static THREADLOCAL int nb=0,svh[MAXOBS*2];
     prcopt_t *opt=&rtk->opt;
     double tt=timediff(time,obs[0].time),ttb,*p,*q;
     int i,j,k,nf=NF(opt);
@@ -1228,8 +1432,9 @@ static double intpres(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
     if (fabs(ttb)>opt->maxtdiff*2.0||ttb==tt) return tt;
     
     satposs(time,obsb,nb,nav,opt->sateph,rs,dts,var,svh);
+    setobsb(obsb,nb,nav,&ob);
     
-    if (!zdres(1,obsb,nb,rs,dts,var,svh,nav,rtk->rb,opt,1,yb,e,azel,freq)) {
+    if (!zdres(1,&ob,0,nb,rs,dts,var,svh,nav,rtk->rb,opt,1,yb,e,azel)) {
         return tt;
     }
     for (i=0;i<n;i++) {
@@ -1269,6 +1474,8 @@ static int ddidx(rtk_t *rtk, int *ix)
                 }
                 else rtk->ssat[i-k].fix[f]=1;
             }
+            if (i>=k+MAXSAT) continue; /* no reference satellite */
+            
             for (j=k;j<k+MAXSAT;j++) {
                 if (i==j||rtk->x[j]==0.0||!test_sys(rtk->ssat[j-k].sys,m)||
                     !rtk->ssat[j-k].vsat[f]) {
@@ -1315,15 +1522,130 @@ static void restamb(rtk_t *rtk, const double *bias, int nb, double *xa)
         }
     }
 }
+/* index of active states ----------------------------------------------------*/
+static int actidx(const double *x, const double *P, int n, int *ix, int *jx)
+{
+    int i,na=0;
+    
+    for (i=0;i<n;i++) {
+        if (x[i]!=0.0&&P[i+i*n]>0.0) {
+            jx[i]=na;
+            ix[na++]=i;
+        }
+        else jx[i]=-1;
+    }
+    return na;
+}
+/* get/put active states and covariance --------------------------------------*/
+static void getact(const double *x, const double *P, int n, const int *ix,
+                   int na, double *xa, double *Pa)
+{
+    int i,j;
+    
+    for (i=0;i<na;i++) {
+        xa[i]=x[ix[i]];
+        for (j=0;j<na;j++) Pa[i+j*na]=P[ix[i]+ix[j]*n];
+    }
+}
+static void putact(const double *xa, const double *Pa, const int *ix, int na,
+                   int n, double *x, double *P)
+{
+    int i,j;
+    
+    for (i=0;i<na;i++) {
+        x[ix[i]]=xa[i];
+        for (j=0;j<na;j++) P[ix[i]+ix[j]*n]=Pa[i+j*na];
+    }
+}
+/* kalman filter with DD partial derivatives -----------------------------------
+* kalman filter state update of active states by sparse partial derivatives of
+* DD residuals. The DD residuals are whitened by blocks with the closed-form
+* inverse square root of Ri*1*1'+diag(Rj) and processed by sequential scalar
+* measurement updates, so no inversion of the innovation covariance is needed.
+* args   : double *x        IO  active states (n x 1)
+*          double *P        IO  covariance of active states (n x n)
+*          ddh_t  *H        I   partial derivatives of residuals (m rows)
+*          double *v        I   innovation (measurement - model) (m x 1)
+*          ddr_t  *R        I   covariance of measurement error (m x m)
+*          int    *jx       I   index of states in active states (-1:inactive)
+*          int    n,m       I   number of active states and measurements
+* return : status (0:ok,<0:error)
+* notes  : x and P are undefined on error
+*-----------------------------------------------------------------------------*/
+static int ddfilter(double *x, double *P, const ddh_t *H, const double *v,
+                    const ddr_t *R, const int *jx, int n, int m)
+{
+    double *Hw,*vw,*sr,*f,*dx,*h,q,c,s,y;
+    int i,j,k,l,b,nb,nh,*ih,info=0;
+    
+    Hw=zeros(n,m); vw=mat(m,1); sr=mat(m,1); f=mat(n,1); dx=zeros(n,1);
+    ih=imat(n,1);
+    
+    /* H of active states */
+    for (j=0;j<m;j++) for (k=0;k<H[j].n;k++) {
+        if ((i=jx[H[j].idx[k]])>=0) Hw[i+j*n]=H[j].val[k];
+    }
+    /* whitening of DD residuals by blocks (W*R*W'=I):
+       W=(I-c*d*d')*diag(Rj)^-1/2, d=sqrt(1/Rj), c=(1-1/sqrt(1+Ri*d'*d))/d'*d */
+    for (b=l=0;b<R->n;l+=R->nb[b++]) {
+        nb=R->nb[b];
+        for (i=0,q=s=0.0;i<nb;i++) {
+            sr[l+i]=R->Rj[l+i]>MIN_VARDD?R->Rj[l+i]:MIN_VARDD;
+            q+=1.0/sr[l+i];
+            s+=v[l+i]/sr[l+i];
+        }
+        c=(1.0-1.0/sqrt(1.0+R->Ri[l]*q))/q;
+        for (i=0;i<nb;i++) {
+            sr[l+i]=sqrt(sr[l+i]);
+            vw[l+i]=(v[l+i]-c*s)/sr[l+i];
+        }
+        for (k=0;k<n;k++) {
+            for (i=0,s=0.0;i<nb;i++) s+=Hw[k+(l+i)*n]/SQR(sr[l+i]);
+            for (i=0;i<nb;i++) Hw[k+(l+i)*n]=(Hw[k+(l+i)*n]-c*s)/sr[l+i];
+        }
+    }
+    /* sequential measurement updates of whitened residuals */
+    for (j=0;j<m;j++) {
+        h=Hw+j*n;
+        for (i=nh=0;i<n;i++) if (h[i]!=0.0) ih[nh++]=i;
+        if (nh<=0) continue;
+        
+        /* f=P*h, s=h'*P*h+1, y=v-h'*dx */
+        for (i=0;i<n;i++) {
+            for (k=0,f[i]=0.0;k<nh;k++) f[i]+=P[i+ih[k]*n]*h[ih[k]];
+        }
+        for (k=0,s=1.0,y=vw[j];k<nh;k++) {
+            s+=h[ih[k]]*f[ih[k]];
+            y-=h[ih[k]]*dx[ih[k]];
+        }
+        if (s<=0.0) {
+            info=-1;
+            break;
+        }
+        /* dx=dx+f*y/s, P=P-f*f'/s */
+        for (i=0;i<n;i++) {
+            dx[i]+=f[i]*y/s;
+            for (k=0;k<=i;k++) P[k+i*n]=P[i+k*n]-=f[i]*f[k]/s;
+        }
+    }
+    if (!info) {
+        for (i=0;i<n;i++) x[i]+=dx[i];
+    }
+    free(Hw); free(vw); free(sr); free(f); free(dx); free(ih);
+    return info;
+}
 /* hold integer ambiguity ----------------------------------------------------*/
 static void holdamb(rtk_t *rtk, const double *xa)
 {
-    double *v,*H,*R;
-    int i,n,m,f,info,index[MAXSAT],nb=rtk->nx-rtk->na,nv=0,nf=NF(&rtk->opt);
+    double *v,*xs,*Ps;
+    ddh_t *H;
+    ddr_t R={0};
+    int i,n,m,f,na,info,index[MAXSAT],nb=rtk->nx-rtk->na,nv=0,nf=NF(&rtk->opt);
+    int *ix,*jx;
     
     trace(3,"holdamb :\n");
     
-    v=mat(nb,1); H=zeros(nb,rtk->nx);
+    v=mat(nb,1); H=(ddh_t *)malloc(sizeof(ddh_t)*nb);
     
     for (m=0;m<5;m++) for (f=0;f<nf;f++) {
         
@@ -1339,29 +1661,336 @@ static void holdamb(rtk_t *rtk, const double *xa)
         for (i=1;i<n;i++) {
             v[nv]=(xa[index[0]]-xa[index[i]])-(rtk->x[index[0]]-rtk->x[index[i]]);
             
-            H[index[0]+nv*rtk->nx]= 1.0;
-            H[index[i]+nv*rtk->nx]=-1.0;
+            H[nv].n=0;
+            setddh(H+nv,index[0], 1.0);
+            setddh(H+nv,index[i],-1.0);
             nv++;
         }
     }
     if (nv>0) {
-        R=zeros(nv,nv);
-        for (i=0;i<nv;i++) R[i+i*nv]=VAR_HOLDAMB;
+        R.n=1; R.nb[0]=nv; R.Ri=zeros(nv,1); R.Rj=mat(nv,1);
+        for (i=0;i<nv;i++) R.Rj[i]=VAR_HOLDAMB;
+        
+        ix=imat(rtk->nx,1); jx=imat(rtk->nx,1);
+        na=actidx(rtk->x,rtk->P,rtk->nx,ix,jx);
+        xs=mat(na,1); Ps=mat(na,na);
+        getact(rtk->x,rtk->P,rtk->nx,ix,na,xs,Ps);
         
         /* update states with constraints */
-        if ((info=filter(rtk->x,rtk->P,H,v,R,rtk->nx,nv))) {
+        if ((info=ddfilter(xs,Ps,H,v,&R,jx,na,nv))) {
             errmsg(rtk,"filter error (info=%d)\n",info);
         }
-        free(R);
+        else putact(xs,Ps,ix,na,rtk->nx,rtk->x,rtk->P);
+        
+        free(R.Ri); free(R.Rj); free(ix); free(jx); free(xs); free(Ps);
     }
     free(v); free(H);
 }
+/* satellite/frequency of DD ambiguity ---------------------------------------*/
+static ssat_t *ddsat(rtk_t *rtk, int j, int *f)
+{
+    *f=(j-rtk->na)/MAXSAT;
+    return rtk->ssat+(j-rtk->na)%MAXSAT;
+}
+/* add partial AR candidate --------------------------------------------------*/
+static void addcand(arcand_t *cand, int *n, const int *idx, int k)
+{
+    int i,j;
+    
+    cand[*n].n=k;
+    cand[*n].idx=imat(k,1);
+    cand[*n].b=mat(k,1);
+    cand[*n].ratio=0.0;
+    cand[*n].stat=0;
+    
+    /* index of DD ambiguities in ascending order */
+    for (i=0;i<k;i++) {
+        for (j=i;j>0&&cand[*n].idx[j-1]>idx[i];j--) {
+            cand[*n].idx[j]=cand[*n].idx[j-1];
+        }
+        cand[*n].idx[j]=idx[i];
+    }
+    (*n)++;
+}
+/* generate partial AR candidates ----------------------------------------------
+* generate subsets of DD ambiguities: excluding the DD ambiguities one by one
+* in ascending order of elevation of the target satellite (other ambiguities
+* of the same satellite are kept), per satellite system and per frequency.
+* the candidates are sorted by number of ambiguities in descending order.
+*-----------------------------------------------------------------------------*/
+static int arcands(rtk_t *rtk, const int *ix, int nb, arcand_t *cand)
+{
+    arcand_t c;
+    double *el;
+    int i,j,k,m,f,fi,n=0,*idx;
+    
+    el=mat(nb,1); idx=imat(nb,1);
+    
+    /* DD ambiguities in order of elevation of target satellite */
+    for (i=0;i<nb;i++) {
+        el[i]=ddsat(rtk,ix[i*2+1],&f)->azel[1];
+        for (j=i;j>0&&el[idx[j-1]]<el[i];j--) idx[j]=idx[j-1];
+        idx[j]=i;
+    }
+    for (k=nb-1;k>=MIN_NB_PAR;k--) {
+        addcand(cand,&n,idx,k);
+    }
+    /* per satellite system */
+    for (m=0;m<6;m++) {
+        for (i=k=0;i<nb;i++) {
+            if (test_sys(ddsat(rtk,ix[i*2+1],&f)->sys,m)) idx[k++]=i;
+        }
+        if (k>=MIN_NB_PAR&&k<nb) addcand(cand,&n,idx,k);
+    }
+    /* per frequency */
+    for (f=0;f<NF(&rtk->opt);f++) {
+        for (i=k=0;i<nb;i++) {
+            ddsat(rtk,ix[i*2+1],&fi);
+            if (fi==f) idx[k++]=i;
+        }
+        if (k>=MIN_NB_PAR&&k<nb) addcand(cand,&n,idx,k);
+    }
+    /* sort by number of ambiguities */
+    for (i=1;i<n;i++) {
+        c=cand[i];
+        for (j=i;j>0&&cand[j-1].n<c.n;j--) cand[j]=cand[j-1];
+        cand[j]=c;
+    }
+    free(el); free(idx);
+    return n;
+}
+/* evaluate partial AR candidates of generation ------------------------------*/
+static void arevals(arpool_t *pool, int gen, int nb)
+{
+    arcand_t *cand;
+    double *y,*Q,*F,s[2];
+    int i,j,k,n,nfix;
+    
+    y=mat(nb,1); Q=mat(nb,nb); F=mat(nb,2);
+    
+    for (;;) {
+        rtklib_lock(&pool->lock);
+        n=pool->gen==gen?pool->n:0;
+        k=pool->next++;
+        nfix=pool->nfix;
+        rtklib_unlock(&pool->lock);
+        if (k>=n) break;
+        
+        cand=pool->cand+k;
+        
+        /* skip smaller subsets than validated one and out of time budget */
+        if (cand->n<nfix) continue;
+        if (pool->tmax>0&&(int)(tickget()-pool->tend)>=0) continue;
+        
+        for (i=0;i<cand->n;i++) {
+            y[i]=pool->y[cand->idx[i]];
+            for (j=0;j<cand->n;j++) {
+                Q[i+j*cand->n]=pool->Qb[cand->idx[i]+cand->idx[j]*pool->nb];
+            }
+        }
+        if (lambda(cand->n,2,y,Q,F,s)) {
+            cand->stat=-1;
+            continue;
+        }
+        matcpy(cand->b,F,cand->n,1);
+        cand->ratio=s[0]>0.0?s[1]/s[0]:999.9;
+        
+        /* validation by ratio-test */
+        if (s[0]<=0.0||s[1]/s[0]>=pool->thres) {
+            cand->stat=1;
+            rtklib_lock(&pool->lock);
+            if (cand->n>pool->nfix) pool->nfix=cand->n;
+            rtklib_unlock(&pool->lock);
+        }
+        else cand->stat=-1;
+    }
+    free(y); free(Q); free(F);
+}
+/* partial AR worker thread ----------------------------------------------------
+* wait for a new generation of candidates, evaluate them with the calling
+* thread of parlambda() and the other workers and wait for the next one
+*-----------------------------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI arthread(void *arg)
+#else
+static void *arthread(void *arg)
+#endif
+{
+    arpool_t *pool=(arpool_t *)arg;
+    int gen,nb;
+    
+    rtklib_lock(&pool->lock);
+    gen=pool->gen;
+    for (;;) {
+        while (!pool->stop&&pool->gen==gen) condwait(&pool->cond,&pool->lock);
+        if (pool->stop) break;
+        gen=pool->gen;
+        nb=pool->nb;
+        pool->nrun++;
+        rtklib_unlock(&pool->lock);
+        
+        arevals(pool,gen,nb);
+        
+        rtklib_lock(&pool->lock);
+        if (--pool->nrun<=0) condsignal(&pool->cond);
+    }
+    rtklib_unlock(&pool->lock);
+    return 0;
+}
+/* open partial AR thread pool -------------------------------------------------
+* create the worker threads of partial AR once for the filter
+* args   : int    nt        I   number of worker threads (excl. calling thread)
+* return : thread pool (NULL: error)
+*-----------------------------------------------------------------------------*/
+static arpool_t *aropen(int nt)
+{
+    arpool_t *pool;
+    
+    if (!(pool=(arpool_t *)calloc(1,sizeof(arpool_t)))) return NULL;
+    initlock(&pool->lock);
+    initcond(&pool->cond);
+    
+    for (;pool->nt<nt&&pool->nt<MAXARTHR;pool->nt++) {
+#ifdef WIN32
+        if (!(pool->thread[pool->nt]=CreateThread(NULL,0,arthread,pool,0,
+                                                  NULL))) break;
+#else
+        if (pthread_create(pool->thread+pool->nt,NULL,arthread,pool)) break;
+#endif
+    }
+    trace(3,"aropen  : nt=%d\n",pool->nt);
+    memacct(MEM_FILT,(int64_t)sizeof(arpool_t));
+    return pool;
+}
+/* close partial AR thread pool ----------------------------------------------*/
+static void arclose(arpool_t *pool)
+{
+    int i;
+    
+    if (!pool) return;
+    
+    rtklib_lock(&pool->lock);
+    pool->stop=1;
+    condsignal(&pool->cond);
+    rtklib_unlock(&pool->lock);
+    
+    for (i=0;i<pool->nt;i++) {
+#ifdef WIN32
+        WaitForSingleObject(pool->thread[i],INFINITE);
+        CloseHandle(pool->thread[i]);
+#else
+        pthread_join(pool->thread[i],NULL);
+#endif
+    }
+    memacct(MEM_FILT,-(int64_t)sizeof(arpool_t));
+    free(pool);
+}
+/* partial ambiguity resolution ------------------------------------------------
+* resolve integer ambiguity of subsets of DD ambiguities on a pool of threads
+* args   : rtk_t  *rtk      IO  rtk control/result struct
+*          int    *ix       IO  index of SD to DD transformation (nb x 2)
+*          int    nb        I   number of DD ambiguities
+*          double *y        IO  float DD ambiguities (nb x 1)
+*          double *Qb       IO  covariance of float DD ambiguities (nb x nb)
+*          double *Qab      IO  covariance of states and DD ambiguities (na x nb)
+*          double *b        O   fixed DD ambiguities (nb x 1)
+*          double *ratio    O   ratio of residuals of fixed subset
+* return : number of fixed ambiguities (0:no fix)
+* notes  : the candidates are evaluated with the largest subsets first until
+*          opt.artime (ms) is elapsed, by the calling thread and the workers of
+*          rtk->arpool (created by rtkinit()). the validated subset with most
+*          ambiguities (and highest ratio) is selected.
+*          ix, y, Qb and Qab are compacted to the selected subset and the
+*          excluded satellites are unfixed (ssat[].fix=1).
+*-----------------------------------------------------------------------------*/
+static int parlambda(rtk_t *rtk, int *ix, int nb, double *y, double *Qb,
+                     double *Qab, double *b, double *ratio)
+{
+    prcopt_t *opt=&rtk->opt;
+    arpool_t pool0={0},*pool=rtk->arpool?(arpool_t *)rtk->arpool:&pool0;
+    arcand_t *cand;
+    ssat_t *ssat;
+    const int *S;
+    int i,j,k,f,n,gen,na=rtk->na,best=-1,*sel;
+    
+    trace(3,"parlambda: nb=%d\n",nb);
+    
+    if (nb<=MIN_NB_PAR) return 0;
+    
+    cand=(arcand_t *)malloc(sizeof(arcand_t)*(nb+6+NFREQ));
+    n=arcands(rtk,ix,nb,cand);
+    
+    /* new generation of candidates for workers */
+    if (pool==&pool0) initlock(&pool->lock);
+    rtklib_lock(&pool->lock);
+    pool->cand=cand;
+    pool->n=n; pool->next=0;
+    pool->nb=nb; pool->y=y; pool->Qb=Qb;
+    pool->thres=opt->thresar[0];
+    pool->nfix=0;
+    pool->tmax=opt->artime;
+    pool->tend=tickget()+(uint32_t)opt->artime;
+    gen=++pool->gen;
+    if (pool->nt>0) condsignal(&pool->cond);
+    rtklib_unlock(&pool->lock);
+    
+    /* evaluate candidates with workers and wait for workers */
+    arevals(pool,gen,nb);
+    
+    rtklib_lock(&pool->lock);
+    while (pool->nrun>0) condwait(&pool->cond,&pool->lock);
+    pool->n=0;
+    rtklib_unlock(&pool->lock);
+    
+    /* select validated subset with most ambiguities */
+    for (i=0;i<n;i++) {
+        if (cand[i].stat!=1) continue;
+        if (best<0||cand[i].n>cand[best].n||
+            (cand[i].n==cand[best].n&&cand[i].ratio>cand[best].ratio)) best=i;
+    }
+    for (i=k=0;i<n;i++) if (cand[i].stat) k++;
+    trace(3,"parlambda: ncand=%d evaluated=%d best=%d\n",n,k,best);
+    
+    if (best<0) {
+        for (i=0;i<n;i++) {free(cand[i].idx); free(cand[i].b);}
+        free(cand);
+        return 0;
+    }
+    S=cand[best].idx; k=cand[best].n;
+    
+    /* unfix targets of excluded ambiguities (and references without target) */
+    sel=imat(nb,1);
+    for (i=0;i<nb;i++) sel[i]=0;
+    for (i=0;i<k;i++) sel[S[i]]=1;
+    for (i=0;i<nb;i++) {
+        if (sel[i]) continue;
+        ssat=ddsat(rtk,ix[i*2+1],&f); ssat->fix[f]=1;
+        for (j=0;j<k;j++) if (ix[S[j]*2]==ix[i*2]) break;
+        if (j<k) continue;
+        ssat=ddsat(rtk,ix[i*2],&f); ssat->fix[f]=1;
+    }
+    /* compact DD ambiguities to selected subset */
+    for (i=0;i<k;i++) {
+        ix[i*2]=ix[S[i]*2]; ix[i*2+1]=ix[S[i]*2+1];
+        y[i]=y[S[i]];
+        b[i]=cand[best].b[i];
+        for (j=0;j<na;j++) Qab[j+i*na]=Qab[j+S[i]*na];
+    }
+    for (j=0;j<k;j++) for (i=0;i<k;i++) {
+        Qb[i+j*k]=Qb[S[i]+S[j]*nb];
+    }
+    *ratio=cand[best].ratio;
+    
+    for (i=0;i<n;i++) {free(cand[i].idx); free(cand[i].b);}
+    free(cand); free(sel);
+    return k;
+}
 /* resolve integer ambiguity by LAMBDA ---------------------------------------*/
 static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
 {
     prcopt_t *opt=&rtk->opt;
-    int i,j,nb,info,nx=rtk->nx,na=rtk->na;
-    double *DP,*y,*b,*db,*Qb,*Qab,*QQ,s[2];
+    int i,j,k,nb,info,fix=0,nx=rtk->nx,na=rtk->na;
+    double *y,*b,*db,*Qb,*Qab,*QQ,s[2],ratio;
     int *ix;
 
     trace(3,"resamb_LAMBDA : nx=%d\n",nx);
@@ -1379,18 +2008,16 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
         free(ix);
         return 0;
     }
-    y=mat(nb,1); DP=mat(nb,nx-na); b=mat(nb,2); db=mat(nb,1); Qb=mat(nb,nb);
+    y=mat(nb,1); b=mat(nb,2); db=mat(nb,1); Qb=mat(nb,nb);
     Qab=mat(na,nb); QQ=mat(na,nb);
     
-    /* y=D*xc, Qb=D*Qc*D', Qab=Qac*D' */
+    /* y=D*xc, Qb=D*Qc*D', Qab=Qac*D' (D by index pairs of SD ambiguities) */
     for (i=0;i<nb;i++) {
         y[i]=rtk->x[ix[i*2]]-rtk->x[ix[i*2+1]];
     }
-    for (j=0;j<nx-na;j++) for (i=0;i<nb;i++) {
-        DP[i+j*nb]=rtk->P[ix[i*2]+(na+j)*nx]-rtk->P[ix[i*2+1]+(na+j)*nx];
-    }
     for (j=0;j<nb;j++) for (i=0;i<nb;i++) {
-        Qb[i+j*nb]=DP[i+(ix[j*2]-na)*nb]-DP[i+(ix[j*2+1]-na)*nb];
+        Qb[i+j*nb]=(rtk->P[ix[i*2]+ix[j*2  ]*nx]-rtk->P[ix[i*2+1]+ix[j*2  ]*nx])-
+                   (rtk->P[ix[i*2]+ix[j*2+1]*nx]-rtk->P[ix[i*2+1]+ix[j*2+1]*nx]);
     }
     for (j=0;j<nb;j++) for (i=0;i<na;i++) {
         Qab[i+j*na]=rtk->P[i+ix[j*2]*nx]-rtk->P[i+ix[j*2+1]*nx];
@@ -1405,129 +2032,86 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
         
         /* validation by popular ratio-test */
         if (s[0]<=0.0||s[1]/s[0]>=opt->thresar[0]) {
-            
-            /* transform float to fixed solution (xa=xa-Qab*Qb\(b0-b)) */
-            for (i=0;i<na;i++) {
-                rtk->xa[i]=rtk->x[i];
-                for (j=0;j<na;j++) rtk->Pa[i+j*na]=rtk->P[i+j*nx];
-            }
-            for (i=0;i<nb;i++) {
-                bias[i]=b[i];
-                y[i]-=b[i];
-            }
-            if (!matinv(Qb,nb)) {
-                matmul("NN",nb,1,nb, 1.0,Qb ,y,0.0,db);
-                matmul("NN",na,1,nb,-1.0,Qab,db,1.0,rtk->xa);
-                
-                /* covariance of fixed solution (Qa=Qa-Qab*Qb^-1*Qab') */
-                matmul("NN",na,nb,nb, 1.0,Qab,Qb ,0.0,QQ);
-                matmul("NT",na,na,nb,-1.0,QQ ,Qab,1.0,rtk->Pa);
-                
-                trace(3,"resamb : validation ok (nb=%d ratio=%.2f s=%.2f/%.2f)\n",
-                      nb,s[0]==0.0?0.0:s[1]/s[0],s[0],s[1]);
-                
-                /* restore SD ambiguity */
-                restamb(rtk,bias,nb,xa);
-            }
-            else nb=0;
+            fix=1;
         }
         else { /* validation failed */
             errmsg(rtk,"ambiguity validation failed (nb=%d ratio=%.2f s=%.2f/%.2f)\n",
                    nb,s[1]/s[0],s[0],s[1]);
-            nb=0;
         }
     }
     else {
         errmsg(rtk,"lambda error (info=%d)\n",info);
-        nb=0;
     }
+    /* partial ambiguity resolution by subsets of ambiguities */
+    if (!fix&&opt->arpart&&(k=parlambda(rtk,ix,nb,y,Qb,Qab,b,&ratio))>0) {
+        trace(3,"resamb : partial fix (nb=%d/%d ratio=%.2f)\n",k,nb,ratio);
+        rtk->sol.ratio=ratio>999.9?999.9f:(float)ratio;
+        nb=k;
+        fix=1;
+    }
+    if (fix) {
+        
+        /* transform float to fixed solution (xa=xa-Qab*Qb\(b0-b)) */
+        for (i=0;i<na;i++) {
+            rtk->xa[i]=rtk->x[i];
+            for (j=0;j<na;j++) rtk->Pa[i+j*na]=rtk->P[i+j*nx];
+        }
+        for (i=0;i<nb;i++) {
+            bias[i]=b[i];
+            y[i]-=b[i];
+        }
+        if (!matinv(Qb,nb)) {
+            matmul("NN",nb,1,nb, 1.0,Qb ,y,0.0,db);
+            matmul("NN",na,1,nb,-1.0,Qab,db,1.0,rtk->xa);
+            
+            /* covariance of fixed solution (Qa=Qa-Qab*Qb^-1*Qab') */
+            matmul("NN",na,nb,nb, 1.0,Qab,Qb ,0.0,QQ);
+            matmul("NT",na,na,nb,-1.0,QQ ,Qab,1.0,rtk->Pa);
+            
+            trace(3,"resamb : validation ok (nb=%d ratio=%.2f)\n",nb,
+                  rtk->sol.ratio);
+            
+            /* restore SD ambiguity */
+            restamb(rtk,bias,nb,xa);
+        }
+        else nb=0;
+    }
+    else nb=0;
+    
     free(ix);
-    free(y); free(DP); free(b); free(db); free(Qb); free(Qab); free(QQ);
+    free(y); free(b); free(db); free(Qb); free(Qab); free(QQ);
     
     return nb; /* number of ambiguities */
 }
 /* validation of solution ----------------------------------------------------*/
-static int valpos(rtk_t *rtk, const double *v, const double *R, const int *vflg,
+static int valpos(rtk_t *rtk, const double *v, const ddr_t *R, const int *vflg,
                   int nv, double thres)
 {
-    double fact=thres*thres;
+    double fact=thres*thres,var;
     int i,stat=1,sat1,sat2,type,freq;
     
     trace(3,"valpos  : nv=%d thres=%.1f\n",nv,thres);
     
     /* post-fit residual test */
     for (i=0;i<nv;i++) {
-        if (v[i]*v[i]<=fact*R[i+i*nv]) continue;
+        var=R->Ri[i]+R->Rj[i];
+        if (v[i]*v[i]<=fact*var) continue;
         sat1=(vflg[i]>>16)&0xFF;
         sat2=(vflg[i]>> 8)&0xFF;
         type=(vflg[i]>> 4)&0xF;
         freq=vflg[i]&0xF;
         const char *stype =type==0?"L":(type==1?"L":"C");
         errmsg(rtk,"large residual (sat=%2d-%2d %s%d v=%6.3f sig=%.3f)\n",
-              sat1,sat2,stype,freq+1,v[i],SQRT(R[i+i*nv]));
+              sat1,sat2,stype,freq+1,v[i],SQRT(var));
     }
     return stat;
 }
-/* relative positioning ------------------------------------------------------*/
-static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
-                  const nav_t *nav)
+/* publish base station measurements of common satellites --------------------*/
+static void pubbase(rtk_t *rtk, const obsd_t *obs, int nu, int ns,
+                    const int *ir, const double *rs, const double *dts,
+                    const nav_t *nav)
 {
-    prcopt_t *opt=&rtk->opt;
-    gtime_t time=obs[0].time;
-    double *rs,*dts,*var,*y,*e,*azel,*freq,*v,*H,*R,*xp,*Pp,*xa,*bias,dt;
-    int i,j,f,n=nu+nr,ns,ny,nv,sat[MAXSAT],iu[MAXSAT],ir[MAXSAT],niter;
-    int info,vflg[MAXOBS*NFREQ*2+1],svh[MAXOBS*2];
-    int stat=rtk->opt.mode<=PMODE_DGPS?SOLQ_DGPS:SOLQ_FLOAT;
-    int nf=opt->ionoopt==IONOOPT_IFLC?1:opt->nf;
-    
-    trace(3,"relpos  : nx=%d nu=%d nr=%d\n",rtk->nx,nu,nr);
-    
-    dt=timediff(time,obs[nu].time);
-    
-    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); y=mat(nf*2,n); e=mat(3,n);
-    azel=zeros(2,n); freq=zeros(nf,n);
-    
-    for (i=0;i<MAXSAT;i++) {
-        rtk->ssat[i].sys=satsys(i+1,NULL);
-        for (j=0;j<NFREQ;j++) rtk->ssat[i].vsat[j]=0;
-        for (j=1;j<NFREQ;j++) rtk->ssat[i].snr [j]=0;
-    }
-    /* satellite positions/clocks */
-    satposs(time,obs,n,nav,opt->sateph,rs,dts,var,svh);
-    
-    /* UD (undifferenced) residuals for base station */
-    if (!zdres(1,obs+nu,nr,rs+nu*6,dts+nu*2,var+nu,svh+nu,nav,rtk->rb,opt,1,
-               y+nu*nf*2,e+nu*3,azel+nu*2,freq+nu*nf)) {
-        errmsg(rtk,"initial base station position error\n");
-        
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
-        free(freq);
-        return 0;
-    }
-    /* time-interpolation of residuals (for post-processing) */
-    if (opt->intpref) {
-        dt=intpres(time,obs+nu,nr,nav,rtk,y+nu*nf*2);
-    }
-    /* select common satellites between rover and base-station */
-    if ((ns=selsat(obs,azel,nu,nr,opt,sat,iu,ir))<=0) {
-        errmsg(rtk,"no common satellite\n");
-        
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
-        free(freq);
-        return 0;
-    }
-    ROS_INFO_STREAM("number of common satellite-> " << ns);
-    double epoch_time[100];
-    time2epoch(obs[nu].time, epoch_time);
-    std::cout << "epoch_time-> "<< epoch_time[0]<<"/"<<epoch_time[1]<<"/"<<epoch_time[2]<< " "<<epoch_time[3]<<":"<<epoch_time[4]<<":"<<epoch_time[5]<<std::endl;
-
-    /* temporal update of states
-     * cycle slip detection can also be done here.
-     */
-    udstate(rtk,obs,sat,iu,ir,ns,nav);
-    // rtk->ssat[sat-1].slip[f]
-
-    gnss_msgs::GNSS_Raw_Array gnss_data; // station data to be published
+    gnss_msgs::GNSS_Raw_Array::Ptr gnss_data(new gnss_msgs::GNSS_Raw_Array); // station data to be published
     int current_week;
     double current_tow;
     current_tow = time2gpst(obs[nu].time, &current_week);
@@ -1540,12 +2124,12 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         gnss_raw.snr = obs[ir[is]].SNR[0] * 0.001;
         
 
-        gnss_raw.visable = rtk->ssat[obs[ir[is]].sat-1].slip[f]; // sat=obs[i].sat;
+        gnss_raw.visable = rtk->ssat[obs[ir[is]].sat-1].slip[0]; // sat=obs[i].sat;
         
         gnss_raw.raw_pseudorange = obs[ir[is]].P[0];
         gnss_raw.carrier_phase = obs[ir[is]].L[0];
         double freq;
-        if ((freq=sat2freq(obs[is].sat,obs[is].code[0],nav)) == 0.0)
+        if ((freq=sat2freq(obs[ir[is]].sat,obs[ir[is]].code[0],nav)) == 0.0)
         {
             continue;
         }
@@ -1572,57 +2156,185 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
 
         gnss_raw.pseudorange = obs[ir[is]].P[0];
         gnss_raw.pseudorange = gnss_raw.pseudorange + gnss_raw.sat_clk_err;
-        gnss_data.GNSS_Raws.push_back(gnss_raw);
+        gnss_data->GNSS_Raws.push_back(gnss_raw);
+        
+    }
+    pubrawbase(obs[0].time, gnss_data);
+}
+/* measurement-only processing -------------------------------------------------
+* rover/base epoch matching, satellite positions, slip detection and emission
+* of base station measurements without filter update or ambiguity resolution
+*-----------------------------------------------------------------------------*/
+static int relobs(rtk_t *rtk, const obsd_t *obs, const obsb_t *ob, int nu,
+                  int nr, const nav_t *nav)
+{
+    prcopt_t *opt=&rtk->opt;
+    gtime_t time=obs[0].time;
+    double *rs,*dts,*var,*y,*e,*azel;
+    int i,j,k,n=nu+nr,ns,sat[MAXSAT],iu[MAXSAT],ir[MAXSAT],svh[MAXOBS*2];
+    int nf=opt->ionoopt==IONOOPT_IFLC?1:opt->nf;
+    
+    trace(3,"relobs  : nu=%d nr=%d\n",nu,nr);
+    
+    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); y=mat(nf*2,n); e=mat(3,n);
+    azel=zeros(2,n);
+    
+    /* satellite positions/clocks */
+    satposs(time,obs,n,nav,opt->sateph,rs,dts,var,svh);
+    
+    /* UD (undifferenced) residuals for base station */
+    if (!zdres(1,ob,nu,nr,rs+nu*6,dts+nu*2,var+nu,svh+nu,nav,rtk->rb,opt,1,
+               y+nu*nf*2,e+nu*3,azel+nu*2)) {
+        errmsg(rtk,"initial base station position error\n");
+        
+        free(rs); free(dts); free(var); free(y); free(e); free(azel);
+        return 0;
+    }
+    /* select common satellites between rover and base-station */
+    if ((ns=selsat(ob,azel,nu,nr,opt,sat,iu,ir))>0) {
+        
+        /* detect cycle slip by LLI and geometry-free phase jump */
+        for (i=0;i<ns;i++) {
+            for (k=0;k<opt->nf;k++) rtk->ssat[sat[i]-1].slip[k]&=0xFC;
+            detslp_ll(rtk,ob,iu[i],1);
+            detslp_ll(rtk,ob,ir[i],2);
+            detslp_gf(rtk,ob,iu[i],ir[i]);
+        }
+        pubbase(rtk,obs,nu,ns,ir,rs,dts,nav);
+    }
+    else errmsg(rtk,"no common satellite\n");
+    
+    for (i=0;i<n;i++) for (j=0;j<nf;j++) {
+        if (ob->L[j][i]==0.0) continue;
+        rtk->ssat[ob->sat[i]-1].pt[ob->rcv[i]-1][j]=ob->time[i];
+        rtk->ssat[ob->sat[i]-1].ph[ob->rcv[i]-1][j]=ob->L[j][i];
+    }
+    free(rs); free(dts); free(var); free(y); free(e); free(azel);
+    
+    return ns>0;
+}
+/* relative positioning ------------------------------------------------------*/
+static int relpos(rtk_t *rtk, const obsd_t *obs, const obsb_t *ob, int nu,
+                  int nr, const nav_t *nav)
+{
+    prcopt_t *opt=&rtk->opt;
+    gtime_t time=obs[0].time;
+    double *rs,*dts,*var,*y,*e,*azel,*v,*xp,*xs,*Ps,*Pp=NULL,*xa;
+    double *bias,dt;
+    ddh_t *H;
+    ddr_t R={0};
+    int i,j,f,n=nu+nr,ns,ny,nv,na,sat[MAXSAT],iu[MAXSAT],ir[MAXSAT],niter;
+    int info,vflg[MAXOBS*NFREQ*2+1],svh[MAXOBS*2],*ix,*jx;
+    int stat=rtk->opt.mode<=PMODE_DGPS?SOLQ_DGPS:SOLQ_FLOAT;
+    int nf=opt->ionoopt==IONOOPT_IFLC?1:opt->nf;
+    
+    trace(3,"relpos  : nx=%d nu=%d nr=%d\n",rtk->nx,nu,nr);
+    
+    dt=timediff(time,obs[nu].time);
+    
+    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); y=mat(nf*2,n); e=mat(3,n);
+    azel=zeros(2,n);
+    
+    for (i=0;i<MAXSAT;i++) {
+        rtk->ssat[i].sys=satsys(i+1,NULL);
+        for (j=0;j<NFREQ;j++) rtk->ssat[i].vsat[j]=0;
+        for (j=1;j<NFREQ;j++) rtk->ssat[i].snr [j]=0;
+    }
+    /* satellite positions/clocks (of rover shared by filters) */
+    if (rtk->satu&&rtk->satu->n==nu) {
+        matcpy(rs ,rtk->satu->rs ,6,nu);
+        matcpy(dts,rtk->satu->dts,2,nu);
+        matcpy(var,rtk->satu->var,1,nu);
+        for (i=0;i<nu;i++) svh[i]=rtk->satu->svh[i];
+        satposs(time,obs+nu,nr,nav,opt->sateph,rs+nu*6,dts+nu*2,var+nu,
+                svh+nu);
+    }
+    else satposs(time,obs,n,nav,opt->sateph,rs,dts,var,svh);
+    
+    /* UD (undifferenced) residuals for base station */
+    if (!zdres(1,ob,nu,nr,rs+nu*6,dts+nu*2,var+nu,svh+nu,nav,rtk->rb,opt,1,
+               y+nu*nf*2,e+nu*3,azel+nu*2)) {
+        errmsg(rtk,"initial base station position error\n");
+        
+        free(rs); free(dts); free(var); free(y); free(e); free(azel);
+        return 0;
+    }
+    /* time-interpolation of residuals (for post-processing) */
+    if (opt->intpref) {
+        dt=intpres(time,obs+nu,nr,nav,rtk,y+nu*nf*2);
+    }
+    /* select common satellites between rover and base-station */
+    if ((ns=selsat(ob,azel,nu,nr,opt,sat,iu,ir))<=0) {
+        errmsg(rtk,"no common satellite\n");
         
+        free(rs); free(dts); free(var); free(y); free(e); free(azel);
+        return 0;
     }
-    pub_station_raw.publish(gnss_data);
+    pubstatcommon(ns);
+
+    /* temporal update of states
+     * cycle slip detection can also be done here.
+     */
+    udstate(rtk,ob,sat,iu,ir,ns,nav);
+    // rtk->ssat[sat-1].slip[f]
+
+    pubbase(rtk,obs,nu,ns,ir,rs,dts,nav);
     
     trace(4,"x(0)="); tracemat(4,rtk->x,1,NR(opt),13,4);
     
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx); xa=mat(rtk->nx,1);
+    xp=mat(rtk->nx,1); xa=mat(rtk->nx,1);
     matcpy(xp,rtk->x,rtk->nx,1);
     
+    /* active states of filter */
+    ix=imat(rtk->nx,1); jx=imat(rtk->nx,1);
+    na=actidx(rtk->x,rtk->P,rtk->nx,ix,jx);
+    xs=mat(na,1); Ps=mat(na,na);
+    
     ny=ns*nf*2+2;
-    v=mat(ny,1); H=zeros(rtk->nx,ny); R=mat(ny,ny); bias=mat(rtk->nx,1);
+    v=mat(ny,1); H=(ddh_t *)malloc(sizeof(ddh_t)*ny); R.Ri=mat(ny,1);
+    R.Rj=mat(ny,1); bias=mat(rtk->nx,1);
     
     /* add 2 iterations for baseline-constraint moving-base */
     niter=opt->niter+(opt->mode==PMODE_MOVEB&&opt->baseline[0]>0.0?2:0);
     
     for (i=0;i<niter;i++) {
         /* UD (undifferenced) residuals for rover */
-        if (!zdres(0,obs,nu,rs,dts,var,svh,nav,xp,opt,0,y,e,azel,freq)) {
+        if (!zdres(0,ob,0,nu,rs,dts,var,svh,nav,xp,opt,0,y,e,azel)) {
             errmsg(rtk,"rover initial position error\n");
             stat=SOLQ_NONE;
             break;
         }
         /* DD (double-differenced) residuals and partial derivatives */
-        if ((nv=ddres(rtk,nav,dt,xp,Pp,sat,y,e,azel,freq,iu,ir,ns,v,H,R,
+        if ((nv=ddres(rtk,ob,nav,dt,xp,Pp,na,sat,y,e,azel,iu,ir,ns,v,H,&R,
                       vflg))<1) {
             errmsg(rtk,"no double-differenced residual\n");
             stat=SOLQ_NONE;
             break;
         }
         /* Kalman filter measurement update */
-        matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        getact(xp,rtk->P,rtk->nx,ix,na,xs,Ps);
+        if ((info=ddfilter(xs,Ps,H,v,&R,jx,na,nv))) {
             errmsg(rtk,"filter error (info=%d)\n",info);
             stat=SOLQ_NONE;
             break;
         }
+        for (j=0;j<na;j++) xp[ix[j]]=xs[j];
+        Pp=Ps;
         trace(4,"x(%d)=",i+1); tracemat(4,xp,1,NR(opt),13,4);
     }
-    if (stat!=SOLQ_NONE&&zdres(0,obs,nu,rs,dts,var,svh,nav,xp,opt,0,y,e,azel,
-                               freq)) {
+    if (stat!=SOLQ_NONE&&zdres(0,ob,0,nu,rs,dts,var,svh,nav,xp,opt,0,y,e,
+                               azel)) {
         
         /* post-fit residuals for float solution */
-        nv=ddres(rtk,nav,dt,xp,Pp,sat,y,e,azel,freq,iu,ir,ns,v,NULL,R,vflg);
+        nv=ddres(rtk,ob,nav,dt,xp,Pp,na,sat,y,e,azel,iu,ir,ns,v,NULL,&R,
+                 vflg);
         
         /* validation of float solution */
-        if (valpos(rtk,v,R,vflg,nv,4.0)) {
+        if (valpos(rtk,v,&R,vflg,nv,4.0)) {
             
             /* update state and covariance matrix */
             matcpy(rtk->x,xp,rtk->nx,1);
-            matcpy(rtk->P,Pp,rtk->nx,rtk->nx);
+            putact(xs,Ps,ix,na,rtk->nx,rtk->x,rtk->P);
             
             /* update ambiguity control struct */
             rtk->sol.ns=0;
@@ -1640,14 +2352,14 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
     /* resolve integer ambiguity by LAMBDA */
     if (stat!=SOLQ_NONE&&resamb_LAMBDA(rtk,bias,xa)>1) {
         
-        if (zdres(0,obs,nu,rs,dts,var,svh,nav,xa,opt,0,y,e,azel,freq)) {
+        if (zdres(0,ob,0,nu,rs,dts,var,svh,nav,xa,opt,0,y,e,azel)) {
             
             /* post-fit reisiduals for fixed solution */
-            nv=ddres(rtk,nav,dt,xa,NULL,sat,y,e,azel,freq,iu,ir,ns,v,NULL,R,
+            nv=ddres(rtk,ob,nav,dt,xa,NULL,0,sat,y,e,azel,iu,ir,ns,v,NULL,&R,
                      vflg);
             
             /* validation of fixed solution */
-            if (valpos(rtk,v,R,vflg,nv,4.0)) {
+            if (valpos(rtk,v,&R,vflg,nv,4.0)) {
                 
                 /* hold integer ambiguity */
                 if (++rtk->nfix>=rtk->opt.minfix&&
@@ -1699,21 +2411,22 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         rtk->nfix=0;
     }
     for (i=0;i<n;i++) for (j=0;j<nf;j++) {
-        if (obs[i].L[j]==0.0) continue;
-        rtk->ssat[obs[i].sat-1].pt[obs[i].rcv-1][j]=obs[i].time;
-        rtk->ssat[obs[i].sat-1].ph[obs[i].rcv-1][j]=obs[i].L[j];
+        if (ob->L[j][i]==0.0) continue;
+        rtk->ssat[ob->sat[i]-1].pt[ob->rcv[i]-1][j]=ob->time[i];
+        rtk->ssat[ob->sat[i]-1].ph[ob->rcv[i]-1][j]=ob->L[j][i];
     }
     for (i=0;i<ns;i++) for (j=0;j<nf;j++) {
         
         /* output snr of rover receiver */
-        rtk->ssat[sat[i]-1].snr[j]=obs[iu[i]].SNR[j];
+        rtk->ssat[sat[i]-1].snr[j]=ob->SNR[j][iu[i]];
     }
     for (i=0;i<MAXSAT;i++) for (j=0;j<nf;j++) {
         if (rtk->ssat[i].fix[j]==2&&stat!=SOLQ_FIX) rtk->ssat[i].fix[j]=1;
         if (rtk->ssat[i].slip[j]&1) rtk->ssat[i].slipc[j]++;
     }
-    free(rs); free(dts); free(var); free(y); free(e); free(azel); free(freq);
-    free(xp); free(Pp);  free(xa);  free(v); free(H); free(R); free(bias);
+    free(rs); free(dts); free(var); free(y); free(e); free(azel);
+    free(xp); free(xs); free(Ps); free(xa); free(v); free(H); free(R.Ri);
+    free(R.Rj); free(bias); free(ix); free(jx);
     
     if (stat!=SOLQ_NONE) rtk->sol.stat=stat;
     
@@ -1743,6 +2456,13 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     rtk->P=zeros(rtk->nx,rtk->nx);
     rtk->xa=zeros(rtk->na,1);
     rtk->Pa=zeros(rtk->na,rtk->na);
+    memacct(MEM_FILT,(int64_t)sizeof(double)*(rtk->nx*(rtk->nx+1)+
+                                              rtk->na*(rtk->na+1)));
+    rtk->work=NULL;
+    rtk->nwork=0;
+    if ((rtk->ob=(obsb_t *)malloc(sizeof(obsb_t)))) {
+        memacct(MEM_FILT,(int64_t)sizeof(obsb_t));
+    }
     rtk->nfix=rtk->neb=0;
     for (i=0;i<MAXSAT;i++) {
         rtk->ambc[i]=ambc0;
@@ -1750,6 +2470,13 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     }
     for (i=0;i<MAXERRMSG;i++) rtk->errbuf[i]=0;
     rtk->opt=*opt;
+    rtk->satu=NULL;
+    
+    /* worker threads of partial AR */
+    rtk->arpool=NULL;
+    if (opt->mode>PMODE_DGPS&&opt->arpart&&opt->arthread>1) {
+        rtk->arpool=aropen(opt->arthread-1);
+    }
 }
 /* free rtk control ------------------------------------------------------------
 * free memory for rtk control struct
@@ -1760,11 +2487,122 @@ extern void rtkfree(rtk_t *rtk)
 {
     trace(3,"rtkfree :\n");
     
+    memacct(MEM_FILT,-(int64_t)sizeof(double)*(rtk->nx*(rtk->nx+1)+
+                                               rtk->na*(rtk->na+1))-
+                      (int64_t)rtk->nwork);
     rtk->nx=rtk->na=0;
     free(rtk->x ); rtk->x =NULL;
     free(rtk->P ); rtk->P =NULL;
     free(rtk->xa); rtk->xa=NULL;
     free(rtk->Pa); rtk->Pa=NULL;
+    free(rtk->work); rtk->work=NULL; rtk->nwork=0;
+    if (rtk->ob) memacct(MEM_FILT,-(int64_t)sizeof(obsb_t));
+    free(rtk->ob); rtk->ob=NULL;
+    arclose((arpool_t *)rtk->arpool); rtk->arpool=NULL;
+}
+/* save rtk control ------------------------------------------------------------
+* write filter state of rtk control struct to file
+* args   : rtk_t    *rtk    I   rtk control/result struct
+*          FILE     *fp     I   output file
+* return : status (1:ok,0:error)
+* notes  : the solution, base position, float/fixed states and covariances,
+*          fix count, ambiguity control and satellite status are written in
+*          the binary layout of the host. processing options are not saved.
+*-----------------------------------------------------------------------------*/
+extern int rtksave(const rtk_t *rtk, FILE *fp)
+{
+    int32_t head[7];
+    
+    trace(3,"rtksave : nx=%d na=%d\n",rtk->nx,rtk->na);
+    
+    head[0]=RTKSMAGIC;
+    head[1]=RTKSVER;
+    head[2]=(int32_t)sizeof(sol_t);
+    head[3]=(int32_t)sizeof(ambc_t);
+    head[4]=(int32_t)sizeof(ssat_t);
+    head[5]=rtk->nx;
+    head[6]=rtk->na;
+    
+    if (fwrite(head,sizeof(head),1,fp)!=1||
+        fwrite(&rtk->sol,sizeof(sol_t),1,fp)!=1||
+        fwrite(rtk->rb,sizeof(double),6,fp)!=6||
+        fwrite(&rtk->tt,sizeof(double),1,fp)!=1||
+        fwrite(&rtk->nfix,sizeof(int),1,fp)!=1||
+        fwrite(rtk->x ,sizeof(double),rtk->nx,fp)!=(size_t)rtk->nx||
+        fwrite(rtk->P ,sizeof(double),rtk->nx*rtk->nx,fp)!=
+            (size_t)(rtk->nx*rtk->nx)||
+        fwrite(rtk->xa,sizeof(double),rtk->na,fp)!=(size_t)rtk->na||
+        fwrite(rtk->Pa,sizeof(double),rtk->na*rtk->na,fp)!=
+            (size_t)(rtk->na*rtk->na)||
+        fwrite(rtk->ambc,sizeof(ambc_t),MAXSAT,fp)!=MAXSAT||
+        fwrite(rtk->ssat,sizeof(ssat_t),MAXSAT,fp)!=MAXSAT) {
+        trace(1,"rtksave: write error\n");
+        return 0;
+    }
+    return 1;
+}
+/* load rtk control ------------------------------------------------------------
+* read filter state of rtk control struct written by rtksave()
+* args   : rtk_t    *rtk    IO  rtk control/result struct
+*          FILE     *fp     I   input file
+* return : status (1:ok,0:error)
+* notes  : rtk has to be initialized by rtkinit() with processing options of
+*          the same number of states. rtk is not changed on error.
+*-----------------------------------------------------------------------------*/
+extern int rtkload(rtk_t *rtk, FILE *fp)
+{
+    rtk_t *r;
+    int32_t head[7];
+    int stat=0;
+    
+    trace(3,"rtkload : nx=%d na=%d\n",rtk->nx,rtk->na);
+    
+    if (fread(head,sizeof(head),1,fp)!=1||head[0]!=RTKSMAGIC||
+        head[1]!=RTKSVER||head[2]!=(int32_t)sizeof(sol_t)||
+        head[3]!=(int32_t)sizeof(ambc_t)||head[4]!=(int32_t)sizeof(ssat_t)) {
+        trace(1,"rtkload: invalid rtk state\n");
+        return 0;
+    }
+    if (head[5]!=rtk->nx||head[6]!=rtk->na) {
+        trace(1,"rtkload: number of states mismatch nx=%d na=%d\n",head[5],
+              head[6]);
+        return 0;
+    }
+    if (!(r=(rtk_t *)malloc(sizeof(rtk_t)))) return 0;
+    
+    r->x =mat(rtk->nx,1); r->P =mat(rtk->nx,rtk->nx);
+    r->xa=mat(rtk->na,1); r->Pa=mat(rtk->na,rtk->na);
+    
+    if (fread(&r->sol,sizeof(sol_t),1,fp)==1&&
+        fread(r->rb,sizeof(double),6,fp)==6&&
+        fread(&r->tt,sizeof(double),1,fp)==1&&
+        fread(&r->nfix,sizeof(int),1,fp)==1&&
+        fread(r->x ,sizeof(double),rtk->nx,fp)==(size_t)rtk->nx&&
+        fread(r->P ,sizeof(double),rtk->nx*rtk->nx,fp)==
+            (size_t)(rtk->nx*rtk->nx)&&
+        fread(r->xa,sizeof(double),rtk->na,fp)==(size_t)rtk->na&&
+        fread(r->Pa,sizeof(double),rtk->na*rtk->na,fp)==
+            (size_t)(rtk->na*rtk->na)&&
+        fread(r->ambc,sizeof(ambc_t),MAXSAT,fp)==MAXSAT&&
+        fread(r->ssat,sizeof(ssat_t),MAXSAT,fp)==MAXSAT) {
+        
+        rtk->sol=r->sol;
+        matcpy(rtk->rb,r->rb,6,1);
+        rtk->tt=r->tt;
+        rtk->nfix=r->nfix;
+        matcpy(rtk->x ,r->x ,rtk->nx,1);
+        matcpy(rtk->P ,r->P ,rtk->nx,rtk->nx);
+        matcpy(rtk->xa,r->xa,rtk->na,1);
+        matcpy(rtk->Pa,r->Pa,rtk->na,rtk->na);
+        memcpy(rtk->ambc,r->ambc,sizeof(ambc_t)*MAXSAT);
+        memcpy(rtk->ssat,r->ssat,sizeof(ssat_t)*MAXSAT);
+        stat=1;
+    }
+    else trace(1,"rtkload: read error\n");
+    
+    free(r->x); free(r->P); free(r->xa); free(r->Pa);
+    free(r);
+    return stat;
 }
 /* precise positioning ---------------------------------------------------------
 * input observation data and navigation message, compute rover position by 
@@ -1823,13 +2661,37 @@ extern void rtkfree(rtk_t *rtk)
 * return : status (0:no solution,1:valid solution)
 * notes  : before calling function, base station position rtk->sol.rb[] should
 *          be properly set for relative mode except for moving-baseline
+*          the structure of arrays of the epoch is set to rtk->ob (allocated by
+*          rtkinit()) and passed to rtkposb().
 *-----------------------------------------------------------------------------*/
 extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
+{
+    if (!rtk->ob) {
+        errmsg(rtk,"observation data memory allocation error\n");
+        return 0;
+    }
+    setobsb(obs,n,nav,rtk->ob);
+    return rtkposb(rtk,obs,rtk->ob,nav);
+}
+/* precise positioning with observation data of structure of arrays ------------
+* same as rtkpos() with observation data of the epoch also given as structure
+* of arrays set by setobsb()
+* args   : rtk_t  *rtk      IO  RTK control/result struct (see rtkpos())
+*          obsd_t *obs      I   observation data for an epoch
+*          obsb_t *ob       I   observation data for the epoch set by setobsb()
+*          nav_t  *nav      I   navigation messages
+* return : status (0:no solution,1:valid solution)
+* notes  : number of observation data is ob->n. the measurement models (slip
+*          detection, state update, UD and DD residuals) use ob, point
+*          positioning, satellite positions and ppp use obs.
+*-----------------------------------------------------------------------------*/
+extern int rtkposb(rtk_t *rtk, const obsd_t *obs, const obsb_t *ob,
+                   const nav_t *nav)
 {
     prcopt_t *opt=&rtk->opt;
     sol_t solb={{0}};
     gtime_t time;
-    int i,nu,nr;
+    int i,nu,nr,n=ob->n;
     char msg[128]="";
     
     trace(3,"rtkpos  : time=%s n=%d\n",time_str(obs[0].time,3),n);
@@ -1852,10 +2714,11 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     double current_tow;
     current_tow = time2gpst(obs[0].time, &current_week);
     // if(current_tow<46699) sleepms(1);
-    if(current_tow<start_gps_sec) sleepms(1);
-    else 
-        sleepms(delayms);
-    printf("current_week = %4d - current_tow = %6.0f\n", current_week, current_tow);
+    if(!opt->measonly) { /* no pacing in measurement-only preprocessing */
+        if(current_tow<start_gps_sec) sleepms(1);
+        else 
+            sleepms(delayms);
+    }
     
     /* rover position by single point positioning */
     if (!pntpos(obs,nu,nav,&rtk->opt,&rtk->sol,NULL,rtk->ssat,msg)) {
@@ -1866,7 +2729,9 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             return 0;
         }
     }
-    if (time.time!=0) rtk->tt=timediff(rtk->sol.time,time);
+    if (time.time!=0) { /* time difference of epochs by integer ns */
+        rtk->tt=(double)(time2ns(rtk->sol.time)-time2ns(time))/NS_SEC;
+    }
     
     /* single point positioning */
     if (opt->mode==PMODE_SINGLE) {
@@ -1874,11 +2739,11 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         return 1;
     }
     /* suppress output of single solution */
-    if (!opt->outsingle) {
+    if (!opt->outsingle&&!opt->measonly) {
         rtk->sol.stat=SOLQ_NONE;
     }
     /* precise point positioning */
-    if (opt->mode>=PMODE_PPP_KINEMA) {
+    if (opt->mode>=PMODE_PPP_KINEMA&&!opt->measonly) {
         pppos(rtk,obs,nu,nav);
         outsolstat(rtk);
         return 1;
@@ -1916,8 +2781,13 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             return 1;
         }
     }
+    /* measurement-only preprocessing */
+    if (opt->measonly) {
+        if (opt->mode<PMODE_PPP_KINEMA) relobs(rtk,obs,ob,nu,nr,nav);
+        return 1;
+    }
     /* relative potitioning */
-    relpos(rtk,obs,nu,nr,nav);
+    relpos(rtk,obs,ob,nu,nr,nav);
     outsolstat(rtk);
 
     // LOG(INFO)<<"Warming! Chi-square Success Finish with RTK solution!!!"<<current_tow;
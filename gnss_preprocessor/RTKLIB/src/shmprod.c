@@ -0,0 +1,504 @@
+/*------------------------------------------------------------------------------
+* shmprod.c : shared memory product store
+*
+* the parsed products (antenna parameters, precise ephemerides and ionex tec
+* grids) are published to posix shared memory by the first process reading a
+* product file (first-loader-wins) and attached read-only by the other
+* processes reading the same file. the shared memory objects are named by the
+* hash of the file contents and the read options and are kept as a cache
+* until they are removed (/dev/shm/gnsspre.*).
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/17 1.0  new
+*-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SHMMAGIC    0x50524F44      /* magic number of shared product */
+#define SHMTIMEOUT  120000          /* timeout waiting for loader (ms) */
+#define MAXSHMREG   64              /* max number of attached products */
+#define ALIGN8(n)   (((n)+7)&~(size_t)7)
+
+#define PROD_PCV    1               /* product type: antenna parameters */
+#define PROD_SP3    2               /* product type: precise ephemeris */
+#define PROD_TEC    3               /* product type: ionex tec grid */
+
+typedef struct {        /* shared product header type */
+    uint32_t magic;     /* magic number */
+    int32_t stat;       /* status (0:loading,1:ready,-1:error) */
+    uint64_t size;      /* size of shared memory object (bytes) */
+    int32_t type;       /* product type (PROD_???) */
+    int32_t n;          /* number of records */
+    int32_t pid;        /* process id of loader */
+    int32_t reserved;   /* reserved */
+} shmhdr_t;
+
+typedef struct {        /* attached product type */
+    char name[64];      /* shared memory object name */
+    const uint8_t *addr; /* mapped address */
+    size_t size;        /* mapped size (bytes) */
+} shmreg_t;
+
+#ifndef WIN32
+static shmreg_t shmreg[MAXSHMREG];  /* attached products */
+static int nshmreg=0;               /* number of attached products */
+static pthread_mutex_t shmlock=PTHREAD_MUTEX_INITIALIZER;
+
+/* hash of data (fnv-1a) -----------------------------------------------------*/
+static uint64_t fnv1a(uint64_t h, const void *data, size_t n)
+{
+    const uint8_t *p=(const uint8_t *)data;
+    size_t i;
+    
+    for (i=0;i<n;i++) h=(h^p[i])*1099511628211ULL;
+    return h;
+}
+/* name of shared product ------------------------------------------------------
+* the name depends on the contents of the file, the product type, the read
+* options and the record size (layout of the struct)
+*-----------------------------------------------------------------------------*/
+static int shmname(const char *file, int type, int opt, size_t rsize,
+                   char *name)
+{
+    FILE *fp;
+    uint8_t buff[65536];
+    uint64_t h=14695981039346656037ULL;
+    int32_t par[4];
+    size_t n;
+    
+    if (strchr(file,'*')||!(fp=fopen(file,"rb"))) return 0;
+    
+    par[0]=type; par[1]=opt; par[2]=(int32_t)rsize; par[3]=MAXSAT;
+    h=fnv1a(h,par,sizeof(par));
+    while ((n=fread(buff,1,sizeof(buff),fp))>0) h=fnv1a(h,buff,n);
+    fclose(fp);
+    sprintf(name,"/gnsspre.%d.%016llx",type,(unsigned long long)h);
+    return 1;
+}
+/* test attached product data ------------------------------------------------*/
+static int shmattached(const void *p)
+{
+    const uint8_t *q=(const uint8_t *)p;
+    int i;
+    
+    pthread_mutex_lock(&shmlock);
+    for (i=0;i<nshmreg;i++) {
+        if (shmreg[i].addr<=q&&q<shmreg[i].addr+shmreg[i].size) break;
+    }
+    pthread_mutex_unlock(&shmlock);
+    return i<nshmreg;
+}
+/* private copy of attached product data ---------------------------------------
+* copy attached data before appending to them (realloc) or modifying them
+*-----------------------------------------------------------------------------*/
+static void *shmprivate(void *p, size_t size)
+{
+    void *q;
+    
+    if (!p||!shmattached(p)) return p;
+    if (!(q=malloc(size))) return NULL;
+    memcpy(q,p,size);
+    return q;
+}
+/* search attached product ---------------------------------------------------*/
+static const shmhdr_t *shmsearch(const char *name)
+{
+    const shmhdr_t *hdr=NULL;
+    int i;
+    
+    pthread_mutex_lock(&shmlock);
+    for (i=0;i<nshmreg;i++) {
+        if (!strcmp(shmreg[i].name,name)) {
+            hdr=(const shmhdr_t *)shmreg[i].addr;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shmlock);
+    return hdr;
+}
+/* map shared product read-only and register it ------------------------------*/
+static const shmhdr_t *shmmap(int fd, const char *name, size_t size)
+{
+    const shmhdr_t *hdr;
+    void *addr;
+    
+    if ((addr=mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0))==MAP_FAILED) {
+        return NULL;
+    }
+    hdr=(const shmhdr_t *)addr;
+    if (hdr->magic!=SHMMAGIC||hdr->stat!=1||hdr->size!=size) {
+        munmap(addr,size);
+        return NULL;
+    }
+    pthread_mutex_lock(&shmlock);
+    if (nshmreg<MAXSHMREG) {
+        sprintf(shmreg[nshmreg].name,"%.63s",name);
+        shmreg[nshmreg].addr=(const uint8_t *)addr;
+        shmreg[nshmreg++].size=size;
+    }
+    else { /* too many products: read privately */
+        munmap(addr,size);
+        hdr=NULL;
+    }
+    pthread_mutex_unlock(&shmlock);
+    return hdr;
+}
+/* open shared product ---------------------------------------------------------
+* attach the shared product or become its loader
+* args   : char   *name     I   object name
+*          int    *fd       O   object of loader (-1: not loader)
+* return : header of attached product (NULL: not attached)
+* notes  : if the loader of the product terminated before publishing it, the
+*          object is removed and the product is read privately
+*-----------------------------------------------------------------------------*/
+static const shmhdr_t *shmopenprod(const char *name, int *fd)
+{
+    const shmhdr_t *hdr;
+    shmhdr_t h={0};
+    struct stat st;
+    int f,t;
+    
+    *fd=-1;
+    
+    if ((hdr=shmsearch(name))) return hdr;
+    
+    if ((f=shm_open(name,O_RDWR|O_CREAT|O_EXCL,0644))>=0) { /* loader */
+        h.magic=SHMMAGIC;
+        h.pid=(int32_t)getpid();
+        h.size=sizeof(h);
+        if (ftruncate(f,sizeof(h))||pwrite(f,&h,sizeof(h),0)!=sizeof(h)) {
+            shm_unlink(name);
+            close(f);
+            return NULL;
+        }
+        *fd=f;
+        return NULL;
+    }
+    if (errno!=EEXIST||(f=shm_open(name,O_RDONLY,0))<0) return NULL;
+    
+    for (t=0;t<SHMTIMEOUT;t+=10) { /* wait for loader */
+        if (pread(f,&h,sizeof(h),0)==sizeof(h)) {
+            if (h.magic!=SHMMAGIC||h.stat<0) break;
+            if (h.stat==1) {
+                hdr=fstat(f,&st)?NULL:shmmap(f,name,(size_t)st.st_size);
+                close(f);
+                return hdr;
+            }
+            if (kill(h.pid,0)<0&&errno==ESRCH) { /* loader terminated */
+                shm_unlink(name);
+                break;
+            }
+        }
+        sleepms(10);
+    }
+    close(f);
+    return NULL;
+}
+/* create shared product by loader -------------------------------------------*/
+static uint8_t *shmcreate(int fd, const char *name, int type, int n,
+                          size_t size)
+{
+    shmhdr_t *hdr;
+    void *addr;
+    
+    if (posix_fallocate(fd,0,size)) return NULL;
+    
+    addr=mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    if (addr==MAP_FAILED) return NULL;
+    hdr=(shmhdr_t *)addr;
+    hdr->type=type;
+    hdr->n=n;
+    hdr->size=size;
+    return (uint8_t *)addr;
+}
+/* publish shared product by loader --------------------------------------------
+* publish the product created by shmcreate() or the error (buff=NULL) and
+* attach the product read-only
+*-----------------------------------------------------------------------------*/
+static const shmhdr_t *shmcommit(int fd, const char *name, uint8_t *buff,
+                                 size_t size)
+{
+    const shmhdr_t *hdr=NULL;
+    shmhdr_t h={0};
+    
+    if (buff) {
+        __atomic_store_n(&((shmhdr_t *)buff)->stat,1,__ATOMIC_RELEASE);
+        munmap(buff,size);
+        hdr=shmmap(fd,name,size);
+    }
+    else { /* error: waiting processes read privately */
+        h.magic=SHMMAGIC;
+        h.stat=-1;
+        if (pwrite(fd,&h,sizeof(h),0)!=sizeof(h)) trace(2,"shm write error\n");
+        shm_unlink(name);
+    }
+    close(fd);
+    return hdr;
+}
+#endif /* WIN32 */
+
+/* read antenna parameters via shared memory -----------------------------------
+* read antenna parameters (see readpcv()). if the pcvs is empty, the antenna
+* parameters are attached read-only from the shared memory product store.
+* args   : char   *file     I   antenna parameter file (antex)
+*          pcvs_t *pcvs     IO  antenna parameters
+* return : status (1:ok,0:file open error)
+* notes  : free attached pcvs->pcv by shmfree()
+*-----------------------------------------------------------------------------*/
+extern int shmreadpcv(const char *file, pcvs_t *pcvs)
+{
+#ifndef WIN32
+    const shmhdr_t *hdr;
+    pcvs_t pcvs0={0};
+    uint8_t *buff;
+    char name[64];
+    size_t size;
+    int fd,stat;
+    
+    trace(3,"shmreadpcv: file=%s\n",file);
+    
+    if (pcvs->n>0||!shmname(file,PROD_PCV,0,sizeof(pcv_t),name)) {
+        if (!(pcvs->pcv=(pcv_t *)shmprivate(pcvs->pcv,sizeof(pcv_t)*pcvs->n))) {
+            pcvs->n=pcvs->nmax=0;
+        }
+        return readpcv(file,pcvs);
+    }
+    if (!(hdr=shmopenprod(name,&fd))&&fd>=0) { /* loader */
+        stat=readpcv(file,&pcvs0);
+        size=sizeof(shmhdr_t)+sizeof(pcv_t)*pcvs0.n;
+        if (stat&&(buff=shmcreate(fd,name,PROD_PCV,pcvs0.n,size))) {
+            memcpy(buff+sizeof(shmhdr_t),pcvs0.pcv,sizeof(pcv_t)*pcvs0.n);
+        }
+        else buff=NULL;
+        hdr=shmcommit(fd,name,buff,size);
+        if (!hdr) {
+            *pcvs=pcvs0;
+            return stat;
+        }
+        memacct(MEM_PCV,-(int64_t)sizeof(pcv_t)*pcvs0.nmax);
+        free(pcvs0.pcv);
+    }
+    if (!hdr) return readpcv(file,pcvs);
+    
+    pcvs->pcv=(pcv_t *)(hdr+1);
+    pcvs->n=pcvs->nmax=hdr->n;
+    memacct(MEM_PCV,(int64_t)sizeof(pcv_t)*pcvs->nmax);
+    return 1;
+#else
+    return readpcv(file,pcvs);
+#endif
+}
+/* read precise ephemeris via shared memory ------------------------------------
+* read sp3 precise ephemeris file (see readsp3()). if the precise ephemeris
+* of nav is empty, it is attached read-only from the shared memory product
+* store.
+* args   : char   *file     I   sp3-c precise ephemeris file
+*          nav_t  *nav      IO  navigation data
+*          int    opt       I   options (see readsp3())
+* return : none
+* notes  : free attached nav->peph by shmfree()
+*-----------------------------------------------------------------------------*/
+extern void shmreadsp3(const char *file, nav_t *nav, int opt)
+{
+#ifndef WIN32
+    const shmhdr_t *hdr;
+    const char *ext;
+    nav_t *nav0;
+    uint8_t *buff;
+    char name[64];
+    size_t size;
+    int fd;
+    
+    trace(3,"shmreadsp3: file=%s\n",file);
+    
+    /* only files with extensions of .sp3, .SP3, .eph* and .EPH* (readsp3()) */
+    if (!strchr(file,'*')&&(!(ext=strrchr(file,'.'))||
+        (!strstr(ext,".sp3")&&!strstr(ext,".SP3")&&
+         !strstr(ext,".eph")&&!strstr(ext,".EPH")))) {
+        return;
+    }
+    if (nav->ne>0||!shmname(file,PROD_SP3,opt,sizeof(peph_t),name)) {
+        nav->peph=(peph_t *)shmprivate(nav->peph,sizeof(peph_t)*nav->ne);
+        if (!nav->peph) {
+            nav->ne=nav->nemax=0;
+        }
+        readsp3(file,nav,opt);
+        return;
+    }
+    if (!(hdr=shmopenprod(name,&fd))&&fd>=0) { /* loader */
+        if (!(nav0=(nav_t *)calloc(1,sizeof(nav_t)))) {
+            shmcommit(fd,name,NULL,0);
+            readsp3(file,nav,opt);
+            return;
+        }
+        readsp3(file,nav0,opt);
+        size=sizeof(shmhdr_t)+sizeof(peph_t)*nav0->ne;
+        if ((buff=shmcreate(fd,name,PROD_SP3,nav0->ne,size))) {
+            memcpy(buff+sizeof(shmhdr_t),nav0->peph,sizeof(peph_t)*nav0->ne);
+        }
+        if (!(hdr=shmcommit(fd,name,buff,size))) {
+            nav->peph=nav0->peph; nav->ne=nav0->ne; nav->nemax=nav0->nemax;
+            free(nav0);
+            return;
+        }
+        memacct(MEM_PREC,-(int64_t)sizeof(peph_t)*nav0->nemax);
+        free(nav0->peph);
+        free(nav0);
+    }
+    if (!hdr) {
+        readsp3(file,nav,opt);
+        return;
+    }
+    if (hdr->n<=0) return;
+    nav->peph=(peph_t *)(hdr+1);
+    nav->ne=nav->nemax=hdr->n;
+    memacct(MEM_PREC,(int64_t)sizeof(peph_t)*nav->nemax);
+#else
+    readsp3(file,nav,opt);
+#endif
+}
+/* read ionex tec grid via shared memory ---------------------------------------
+* read ionex ionospheric tec grid file (see readtec()). if the tec grid of nav
+* is empty, the tec grid data are attached read-only from the shared memory
+* product store.
+* args   : char   *file     I   ionex tec grid file
+*          nav_t  *nav      IO  navigation data
+*          int    opt       I   read option (see readtec())
+* return : none
+* notes  : free attached nav->tec[i].data and rms by shmfree()
+*          only the p1-p2 dcbs provided by the ionex file (nonzero) are set
+*          layout: header, p1-p2 dcb (m), tec grids, offsets of data and rms,
+*          data and rms of tec grids
+*-----------------------------------------------------------------------------*/
+extern void shmreadtec(const char *file, nav_t *nav, int opt)
+{
+#ifndef WIN32
+    const shmhdr_t *hdr;
+    const uint64_t *off;
+    const double *dcb;
+    nav_t *nav0;
+    tec_t *tec;
+    uint64_t *offs;
+    uint8_t *buff;
+    char name[64];
+    size_t size,nd;
+    int i,fd;
+    
+    trace(3,"shmreadtec: file=%s\n",file);
+    
+    if (!opt) {
+        memacct(MEM_TEC,-(int64_t)sizeof(tec_t)*nav->ntmax);
+        free(nav->tec); nav->tec=NULL; nav->nt=nav->ntmax=0;
+    }
+    if (nav->nt>0||!shmname(file,PROD_TEC,0,sizeof(tec_t),name)) {
+        for (i=0;i<nav->nt;i++) { /* tec grids may be combined */
+            nd=(size_t)nav->tec[i].ndata[0]*nav->tec[i].ndata[1]*
+               nav->tec[i].ndata[2];
+            nav->tec[i].data=(double *)shmprivate(nav->tec[i].data,
+                                                  sizeof(double)*nd);
+            nav->tec[i].rms =(float  *)shmprivate(nav->tec[i].rms,
+                                                  sizeof(float)*nd);
+        }
+        readtec(file,nav,1);
+        return;
+    }
+    if (!(hdr=shmopenprod(name,&fd))&&fd>=0) { /* loader */
+        if (!(nav0=(nav_t *)calloc(1,sizeof(nav_t)))) {
+            shmcommit(fd,name,NULL,0);
+            readtec(file,nav,1);
+            return;
+        }
+        readtec(file,nav0,1);
+        size=sizeof(shmhdr_t)+sizeof(double)*MAXSAT+
+             ALIGN8(sizeof(tec_t)*nav0->nt)+sizeof(uint64_t)*2*nav0->nt;
+        for (i=0;i<nav0->nt;i++) {
+            nd=(size_t)nav0->tec[i].ndata[0]*nav0->tec[i].ndata[1]*
+               nav0->tec[i].ndata[2];
+            size+=sizeof(double)*nd+ALIGN8(sizeof(float)*nd);
+        }
+        if ((buff=shmcreate(fd,name,PROD_TEC,nav0->nt,size))) {
+            for (i=0;i<MAXSAT;i++) {
+                ((double *)(buff+sizeof(shmhdr_t)))[i]=nav0->cbias[i][0];
+            }
+            tec=(tec_t *)(buff+sizeof(shmhdr_t)+sizeof(double)*MAXSAT);
+            offs=(uint64_t *)((uint8_t *)tec+ALIGN8(sizeof(tec_t)*nav0->nt));
+            size=(uint8_t *)(offs+2*nav0->nt)-buff;
+            for (i=0;i<nav0->nt;i++) {
+                nd=(size_t)nav0->tec[i].ndata[0]*nav0->tec[i].ndata[1]*
+                   nav0->tec[i].ndata[2];
+                tec[i]=nav0->tec[i];
+                tec[i].data=NULL;
+                tec[i].rms=NULL;
+                offs[2*i]=size;
+                memcpy(buff+size,nav0->tec[i].data,sizeof(double)*nd);
+                size+=sizeof(double)*nd;
+                offs[2*i+1]=size;
+                memcpy(buff+size,nav0->tec[i].rms,sizeof(float)*nd);
+                size+=ALIGN8(sizeof(float)*nd);
+            }
+        }
+        if (!(hdr=shmcommit(fd,name,buff,size))) {
+            nav->tec=nav0->tec; nav->nt=nav0->nt; nav->ntmax=nav0->ntmax;
+            for (i=0;i<MAXSAT;i++) {
+                if (nav0->cbias[i][0]!=0.0) nav->cbias[i][0]=nav0->cbias[i][0];
+            }
+            free(nav0);
+            return;
+        }
+        for (i=0;i<nav0->nt;i++) {
+            nd=(size_t)nav0->tec[i].ndata[0]*nav0->tec[i].ndata[1]*
+               nav0->tec[i].ndata[2];
+            memacct(MEM_TEC,-(int64_t)(sizeof(double)+sizeof(float))*nd);
+            free(nav0->tec[i].data);
+            free(nav0->tec[i].rms );
+        }
+        memacct(MEM_TEC,-(int64_t)sizeof(tec_t)*nav0->ntmax);
+        free(nav0->tec);
+        free(nav0);
+    }
+    if (!hdr) {
+        readtec(file,nav,1);
+        return;
+    }
+    /* P1-P2 dcb provided by ionex (keep dcb of others) */
+    dcb=(const double *)(hdr+1);
+    for (i=0;i<MAXSAT;i++) if (dcb[i]!=0.0) nav->cbias[i][0]=dcb[i];
+    
+    if (hdr->n<=0||!(nav->tec=(tec_t *)malloc(sizeof(tec_t)*hdr->n))) return;
+    
+    memcpy(nav->tec,dcb+MAXSAT,sizeof(tec_t)*hdr->n);
+    off=(const uint64_t *)((const uint8_t *)(dcb+MAXSAT)+
+                           ALIGN8(sizeof(tec_t)*hdr->n));
+    for (i=0;i<hdr->n;i++) {
+        nav->tec[i].data=(double *)((const uint8_t *)hdr+off[2*i]);
+        nav->tec[i].rms =(float  *)((const uint8_t *)hdr+off[2*i+1]);
+        nd=(size_t)nav->tec[i].ndata[0]*nav->tec[i].ndata[1]*
+           nav->tec[i].ndata[2];
+        memacct(MEM_TEC,(int64_t)(sizeof(double)+sizeof(float))*nd);
+    }
+    nav->nt=nav->ntmax=hdr->n;
+    memacct(MEM_TEC,(int64_t)sizeof(tec_t)*nav->ntmax);
+#else
+    readtec(file,nav,opt);
+#endif
+}
+/* free product data -----------------------------------------------------------
+* free the data unless they are attached from the shared memory product store
+* args   : void   *p        I   data to free
+* return : none
+* notes  : attached products are mapped until the process exits
+*-----------------------------------------------------------------------------*/
+extern void shmfree(void *p)
+{
+#ifndef WIN32
+    if (p&&shmattached(p)) return;
+#endif
+    free(p);
+}
@@ -0,0 +1,286 @@
+/*------------------------------------------------------------------------------
+* shmpub.cpp : publication of measurement epochs to a shared memory ring
+*
+* notes  : the ring is created by shmpubopen() as posix shared memory object
+*          with the layout of shmring.h. an existing object of the same name is
+*          removed first, readers attached to it keep their mapping. the
+*          object is kept after shmpubclose() (hdr->stat=1), so that readers
+*          can consume the remaining epochs.
+*
+*          the products of an epoch are written directly to the slot of the
+*          epoch. the slot is committed by shmpubcommit() or when a product of
+*          another epoch or rover (or a product already in the slot) is
+*          written. a combined solution of an epoch already committed is added
+*          to the slot of the epoch and rover if it is still in the ring (see
+*          shmring.h). there must be only one writing thread.
+*-----------------------------------------------------------------------------*/
+#include <stddef.h>
+
+#include "shmpub.h"
+
+/* type definitions ----------------------------------------------------------*/
+
+struct shmpub_t {                   /* writer of shared memory ring */
+    char name[256];                 /* name of shared memory object */
+    shmr_hdr_t *hdr;                /* mapped ring */
+    size_t size;                    /* size of mapped ring (bytes) */
+    uint64_t n;                     /* epoch of open slot */
+    shmr_epoch_t *ep;               /* open slot (NULL: no open slot) */
+    gtime_t time;                   /* epoch time of open slot (gpst) */
+    uint32_t rover;                 /* rover of open slot (shmrrovid()) */
+    uint64_t ns;                    /* epoch of last added combined solution */
+};
+
+/* slot of epoch -------------------------------------------------------------*/
+static shmr_epoch_t *epslot(const shmpub_t *w, uint64_t n)
+{
+    return (shmr_epoch_t *)((uint8_t *)w->hdr+SHMR_HDRSIZE+
+                            (n%w->hdr->nslot)*w->hdr->slotsize);
+}
+/* open slot for products of an epoch ----------------------------------------*/
+static shmr_epoch_t *openslot(shmpub_t *w, gtime_t time, const char *rov,
+                              uint32_t flag)
+{
+    shmr_epoch_t *ep;
+    uint32_t rover=shmrrovid(rov);
+    int week;
+    
+    if (w->ep&&(fabs(timediff(time,w->time))>DTTOL||rover!=w->rover||
+                (w->ep->flag&flag))) {
+        shmpubcommit(w);
+    }
+    if (w->ep) return w->ep;
+    
+    /* mark slot as being written before overwriting it */
+    ep=epslot(w,w->n);
+    __atomic_store_n(&ep->seq,2*w->n+1,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    memset((uint8_t *)ep+sizeof(ep->seq),0,
+           offsetof(shmr_epoch_t,raw)-sizeof(ep->seq));
+    ep->time=time2gpst(time,&week);
+    ep->time+=week*604800.0;
+    ep->rover=rover;
+    w->time=time;
+    w->rover=rover;
+    return w->ep=ep;
+}
+/* committed slot of epoch without combined solution (NULL: none) ------------*/
+static shmr_epoch_t *smoothslot(shmpub_t *w, gtime_t time, const char *rov)
+{
+    shmr_epoch_t *ep;
+    uint64_t i,i0,n,n0,n1;
+    uint32_t rover=shmrrovid(rov);
+    double t;
+    int week;
+    
+    t=time2gpst(time,&week);
+    t+=week*604800.0;
+    
+    /* committed epochs n0,...,n1-1 still in the ring */
+    n1=w->n;
+    n0=n1>=w->hdr->nslot?n1-w->hdr->nslot+(w->ep?1:0):0;
+    
+    /* search from last added epoch (combined solutions in time order) */
+    i0=w->ns>n0&&w->ns<n1?w->ns:n0;
+    for (i=0;i<n1-n0;i++) {
+        n=i0+i<n1?i0+i:i0+i-(n1-n0);
+        ep=epslot(w,n);
+        if (fabs(ep->time-t)<=DTTOL&&ep->rover==rover&&
+            !(ep->flag&SHMR_SMOOTH)) {
+            w->ns=n;
+            return ep;
+        }
+    }
+    return NULL;
+}
+/* set satellite measurements ------------------------------------------------*/
+static uint32_t setsats(shmr_sat_t *sat, const gnss_msgs::GNSS_Raw_Array &msg,
+                        uint32_t *flag)
+{
+    uint32_t i,n=(uint32_t)msg.GNSS_Raws.size();
+    
+    if (n>SHMR_MAXSAT) {
+        n=SHMR_MAXSAT;
+        *flag|=SHMR_TRUNC;
+    }
+    for (i=0;i<n;i++) {
+        const gnss_msgs::GNSS_Raw &r=msg.GNSS_Raws[i];
+        
+        sat[i].GNSS_time           =r.GNSS_time;
+        sat[i].pseudorange         =r.pseudorange;
+        sat[i].raw_pseudorange     =r.raw_pseudorange;
+        sat[i].carrier_phase       =r.carrier_phase;
+        sat[i].lamda               =r.lamda;
+        sat[i].snr                 =r.snr;
+        sat[i].elevation           =r.elevation;
+        sat[i].azimuth             =r.azimuth;
+        sat[i].err_tropo           =r.err_tropo;
+        sat[i].err_iono            =r.err_iono;
+        sat[i].sat_clk_err         =r.sat_clk_err;
+        sat[i].sat_pos[0]          =r.sat_pos_x;
+        sat[i].sat_pos[1]          =r.sat_pos_y;
+        sat[i].sat_pos[2]          =r.sat_pos_z;
+        sat[i].total_sv            =(int32_t)r.total_sv;
+        sat[i].prn_satellites_index=(int32_t)r.prn_satellites_index;
+        sat[i].visable             =(int32_t)r.visable;
+        sat[i].valid               =r.valid?1:0;
+        memset(sat[i].sat_system,0,sizeof(sat[i].sat_system));
+        r.sat_system.copy(sat[i].sat_system,sizeof(sat[i].sat_system));
+    }
+    return n;
+}
+/* open shared memory ring -----------------------------------------------------
+* create shared memory ring for the publication of measurement epochs
+* args   : char   *name     I   name of shared memory object ("/..." or "...")
+*          int    nslot     I   number of slots (epochs)
+* return : writer of ring (NULL: error)
+*-----------------------------------------------------------------------------*/
+extern shmpub_t *shmpubopen(const char *name, int nslot)
+{
+#ifndef WIN32
+    shmpub_t *w;
+    size_t slotsize=(sizeof(shmr_epoch_t)+63)/64*64;
+    void *p;
+    int fd;
+    
+    trace(3,"shmpubopen: name=%s nslot=%d\n",name,nslot);
+    
+    if (nslot<=0||!(w=(shmpub_t *)calloc(1,sizeof(shmpub_t)))) return NULL;
+    
+    sprintf(w->name,"%s%.250s",*name=='/'?"":"/",name);
+    w->size=SHMR_HDRSIZE+slotsize*nslot;
+    
+    shm_unlink(w->name);
+    if ((fd=shm_open(w->name,O_CREAT|O_EXCL|O_RDWR,0644))<0) {
+        trace(1,"shmpubopen: shm_open error name=%s\n",w->name);
+        free(w);
+        return NULL;
+    }
+    if (ftruncate(fd,(off_t)w->size)||
+        (p=mmap(NULL,w->size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0))==
+        MAP_FAILED) {
+        trace(1,"shmpubopen: mmap error name=%s\n",w->name);
+        close(fd);
+        shm_unlink(w->name);
+        free(w);
+        return NULL;
+    }
+    close(fd);
+    
+    w->hdr=(shmr_hdr_t *)p;
+    w->hdr->version =SHMR_VERSION;
+    w->hdr->nslot   =(uint32_t)nslot;
+    w->hdr->slotsize=(uint32_t)slotsize;
+    w->hdr->maxsat  =SHMR_MAXSAT;
+    w->hdr->pid     =(uint64_t)getpid();
+    __atomic_store_n(&w->hdr->magic,SHMR_MAGIC,__ATOMIC_RELEASE);
+    return w;
+#else
+    return NULL;
+#endif
+}
+/* close shared memory ring ----------------------------------------------------
+* commit the open slot and mark the ring as closed
+* args   : shmpub_t *w      IO  writer of ring (NULL: none)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void shmpubclose(shmpub_t *w)
+{
+    trace(3,"shmpubclose:\n");
+    
+    if (!w) return;
+#ifndef WIN32
+    shmpubcommit(w);
+    __atomic_store_n(&w->hdr->stat,1,__ATOMIC_RELEASE);
+    munmap(w->hdr,w->size);
+#endif
+    free(w);
+}
+/* write measurements ----------------------------------------------------------
+* args   : shmpub_t *w      IO  writer of ring (NULL: none)
+*          gtime_t  time    I   epoch time (gpst)
+*          char     *rov    I   rover id ("": unnamed)
+*          int      base    I   base station measurements (0:rover,1:base)
+*          GNSS_Raw_Array &msg I measurements
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void shmpubraw(shmpub_t *w, gtime_t time, const char *rov, int base,
+                      const gnss_msgs::GNSS_Raw_Array &msg)
+{
+    shmr_epoch_t *ep;
+    
+    if (!w||!(ep=openslot(w,time,rov,base?SHMR_BASE:SHMR_RAW))) return;
+    
+    if (base) {
+        ep->nbase=setsats(ep->base,msg,&ep->flag);
+        ep->flag|=SHMR_BASE;
+    }
+    else {
+        ep->nraw=setsats(ep->raw,msg,&ep->flag);
+        ep->flag|=SHMR_RAW;
+    }
+}
+/* write position or combined solution -----------------------------------------
+* args   : shmpub_t *w      IO  writer of ring (NULL: none)
+*          gtime_t  time    I   epoch time (gpst)
+*          char     *rov    I   rover id ("": unnamed)
+*          int      smoothed I  combined solution (0:position,1:combined)
+*          NavSatFix &msg   I   position
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void shmpubfix(shmpub_t *w, gtime_t time, const char *rov,
+                      int smoothed, const sensor_msgs::NavSatFix &msg)
+{
+    shmr_epoch_t *ep;
+    shmr_fix_t *fix;
+    int i,upd=0;
+    
+    if (!w) return;
+    
+    /* combined solution of committed epoch to the slot of the epoch */
+    if (smoothed&&(!w->ep||fabs(timediff(time,w->time))>DTTOL||
+                   shmrrovid(rov)!=w->rover)&&
+        (ep=smoothslot(w,time,rov))) {
+        upd=1;
+    }
+    else if (!(ep=openslot(w,time,rov,smoothed?SHMR_SMOOTH:SHMR_FIX))) return;
+    
+    fix=smoothed?&ep->smoothed:&ep->fix;
+    fix->latitude =msg.latitude;
+    fix->longitude=msg.longitude;
+    fix->altitude =msg.altitude;
+    for (i=0;i<9;i++) fix->cov[i]=msg.position_covariance[i];
+    fix->covtype=msg.position_covariance_type;
+    
+    /* solution of committed slot visible to readers only with the flag */
+    if (upd) __atomic_fetch_or(&ep->flag,SHMR_SMOOTH,__ATOMIC_RELEASE);
+    else ep->flag|=smoothed?SHMR_SMOOTH:SHMR_FIX;
+}
+/* write velocity ------------------------------------------------------------*/
+extern void shmpubvel(shmpub_t *w, gtime_t time, const char *rov,
+                      const geometry_msgs::TwistStamped &msg)
+{
+    shmr_epoch_t *ep;
+    
+    if (!w||!(ep=openslot(w,time,rov,SHMR_VEL))) return;
+    
+    ep->vel[0]=msg.twist.linear.x;
+    ep->vel[1]=msg.twist.linear.y;
+    ep->vel[2]=msg.twist.linear.z;
+    ep->flag|=SHMR_VEL;
+}
+/* commit open slot ------------------------------------------------------------
+* make the products of the open slot visible to the readers
+* args   : shmpub_t *w      IO  writer of ring (NULL: none)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void shmpubcommit(shmpub_t *w)
+{
+    if (!w||!w->ep) return;
+    
+    __atomic_store_n(&w->ep->seq,2*w->n+2,__ATOMIC_RELEASE);
+    w->n++;
+    __atomic_store_n(&w->hdr->head,w->n,__ATOMIC_RELEASE);
+    w->ep=NULL;
+}
@@ -0,0 +1,33 @@
+/*------------------------------------------------------------------------------
+* shmpub.h : publication of measurement epochs to a shared memory ring
+*
+* notes  : the products of an epoch are written to the open slot of the ring
+*          (see shmring.h) as they are published and made visible to the
+*          readers by shmpubcommit().
+*-----------------------------------------------------------------------------*/
+#ifndef SHMPUB_H
+#define SHMPUB_H
+#include "rtklib.h"
+#include "shmring.h"
+
+#include <geometry_msgs/TwistStamped.h>
+#include <sensor_msgs/NavSatFix.h>
+#include <gnss_msgs/GNSS_Raw_Array.h>
+
+/* type definitions ----------------------------------------------------------*/
+
+struct shmpub_t;                    /* writer of shared memory ring */
+
+/* function prototypes -------------------------------------------------------*/
+
+extern shmpub_t *shmpubopen(const char *name, int nslot);
+extern void shmpubclose (shmpub_t *w);
+extern void shmpubraw   (shmpub_t *w, gtime_t time, const char *rov, int base,
+                         const gnss_msgs::GNSS_Raw_Array &msg);
+extern void shmpubfix   (shmpub_t *w, gtime_t time, const char *rov,
+                         int smoothed, const sensor_msgs::NavSatFix &msg);
+extern void shmpubvel   (shmpub_t *w, gtime_t time, const char *rov,
+                         const geometry_msgs::TwistStamped &msg);
+extern void shmpubcommit(shmpub_t *w);
+
+#endif /* SHMPUB_H */
@@ -0,0 +1,236 @@
+/*------------------------------------------------------------------------------
+* shmring.h : shared memory ring of measurement epochs
+*
+* notes  : the preprocessor (parameter shm_ring) writes the products of every
+*          epoch (rover/base measurements, position, velocity and combined
+*          solution) to a posix shared memory object with the fixed binary
+*          layout below. the header is self-contained (no ros, no rtklib) and
+*          includes the functions for readers on the same host.
+*
+*              offset 0                  : shmr_hdr_t
+*              offset SHMR_HDRSIZE+i*size: slot i (shmr_epoch_t), size is
+*                                          hdr->slotsize
+*
+*          epoch n (0,1,2,...) is written to slot n%nslot. the sequence
+*          counter of the slot is 2*n+1 while epoch n is written and 2*n+2
+*          when it is complete. hdr->head is the number of complete epochs.
+*          a reader can use an epoch in place (shmrget()) and check with
+*          shmrcheck() afterwards that it was not overwritten meanwhile, or
+*          copy it (shmrcopy()). an epoch is overwritten (overrun) when the
+*          writer is more than nslot epochs ahead of the reader.
+*
+*          a combined solution published after its epoch was completed (e.g.
+*          combined solutions after a forward pass) is added to the slot of the
+*          epoch while the epoch is still in the ring. the sequence counter of
+*          the slot is not changed, so it never moves backwards. the solution
+*          is written first and then the flag SHMR_SMOOTH is set with release
+*          order. read the flag of a slot in place with shmrflag(): the
+*          combined solution is valid and no longer changes once SHMR_SMOOTH
+*          is set. a solution is added to a slot only once.
+*
+*          the products of each rover are written to slots of their own. the
+*          rover of a slot is shmrrovid() of the rover id (0: unnamed rover of
+*          single-rover processing).
+*
+*          all numbers are in the byte order of the host.
+*-----------------------------------------------------------------------------*/
+#ifndef SHMRING_H
+#define SHMRING_H
+#include <stdint.h>
+#include <string.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* constants -----------------------------------------------------------------*/
+
+#define SHMR_MAGIC    0x474E5352    /* magic number ("RSNG") */
+#define SHMR_VERSION  1             /* version of layout */
+#define SHMR_HDRSIZE  128           /* size of header (bytes) */
+#define SHMR_MAXSAT   128           /* max satellites of measurement array */
+
+#define SHMR_RAW      0x01          /* product: rover measurements */
+#define SHMR_FIX      0x02          /* product: rover position */
+#define SHMR_VEL      0x04          /* product: rover velocity */
+#define SHMR_BASE     0x08          /* product: base station measurements */
+#define SHMR_SMOOTH   0x10          /* product: combined solution */
+#define SHMR_TRUNC    0x100         /* measurements truncated to SHMR_MAXSAT */
+
+/* type definitions ----------------------------------------------------------*/
+
+typedef struct {                    /* ring header */
+    uint32_t magic;                 /* magic number (SHMR_MAGIC) */
+    uint32_t version;               /* version of layout (SHMR_VERSION) */
+    uint32_t nslot;                 /* number of slots */
+    uint32_t slotsize;              /* size of slot (bytes) */
+    uint32_t maxsat;                /* max satellites of measurement array */
+    uint32_t stat;                  /* writer state (0:writing,1:closed) */
+    uint64_t pid;                   /* process id of writer */
+    uint64_t head;                  /* number of complete epochs */
+    uint8_t reserved[SHMR_HDRSIZE-40];
+} shmr_hdr_t;
+
+typedef struct {                    /* satellite measurement (GNSS_Raw) */
+    double GNSS_time;               /* gps time (s since 1980/1/6) */
+    double pseudorange;             /* corrected pseudorange (m) */
+    double raw_pseudorange;         /* raw pseudorange (m) */
+    double carrier_phase;           /* carrier phase (cycle) */
+    double lamda;                   /* wavelength (m) */
+    double snr;                     /* signal strength (dBHz) */
+    double elevation;               /* elevation angle (deg) */
+    double azimuth;                 /* azimuth angle (deg) */
+    double err_tropo;               /* tropospheric delay (m) */
+    double err_iono;                /* ionospheric delay (m) */
+    double sat_clk_err;             /* satellite clock bias (m) */
+    double sat_pos[3];              /* satellite position (ecef) (m) */
+    int32_t total_sv;               /* number of satellites of epoch */
+    int32_t prn_satellites_index;   /* satellite number */
+    int32_t visable;                /* visible/slip flag */
+    int32_t valid;                  /* valid flag */
+    char sat_system[8];             /* navigation system ("GPS",...) */
+} shmr_sat_t;
+
+typedef struct {                    /* position (NavSatFix) */
+    double latitude;                /* latitude (deg) */
+    double longitude;               /* longitude (deg) */
+    double altitude;                /* height (m) */
+    double cov[9];                  /* covariance (enu) (m^2) */
+    int32_t covtype;                /* covariance type of NavSatFix */
+    int32_t reserved;
+} shmr_fix_t;
+
+typedef struct {                    /* epoch of ring slot */
+    uint64_t seq;                   /* sequence counter (2*n+2: epoch n) */
+    double time;                    /* epoch time (gps s since 1980/1/6) */
+    uint32_t flag;                  /* products (SHMR_???) */
+    uint32_t nraw;                  /* number of rover measurements */
+    uint32_t nbase;                 /* number of base station measurements */
+    uint32_t rover;                 /* rover (shmrrovid() of rover id) */
+    shmr_fix_t fix;                 /* rover position */
+    shmr_fix_t smoothed;            /* combined solution */
+    double vel[3];                  /* rover velocity (ecef) (m/s) */
+    shmr_sat_t raw [SHMR_MAXSAT];   /* rover measurements */
+    shmr_sat_t base[SHMR_MAXSAT];   /* base station measurements */
+} shmr_epoch_t;
+
+typedef struct {                    /* attached ring of reader */
+    const shmr_hdr_t *hdr;          /* mapped ring */
+    size_t size;                    /* size of mapped ring (bytes) */
+} shmr_t;
+
+/* rover of slot of rover id (0: unnamed) --------------------------------------
+* 32 bit fnv-1a hash of the rover id
+*-----------------------------------------------------------------------------*/
+static inline uint32_t shmrrovid(const char *rov)
+{
+    uint32_t id=2166136261u;
+    
+    if (!*rov) return 0;
+    for (;*rov;rov++) id=(id^(uint8_t)*rov)*16777619u;
+    return id?id:1;
+}
+/* functions of reader -------------------------------------------------------*/
+#ifndef WIN32
+
+/* attach ring read-only (1:ok,0:error) --------------------------------------*/
+static inline int shmrattach(shmr_t *r, const char *name)
+{
+    struct stat st;
+    void *p;
+    int fd;
+    
+    r->hdr=NULL;
+    if ((fd=shm_open(name,O_RDONLY,0))<0) return 0;
+    if (fstat(fd,&st)||st.st_size<SHMR_HDRSIZE) {
+        close(fd);
+        return 0;
+    }
+    p=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (p==MAP_FAILED) return 0;
+    r->hdr=(const shmr_hdr_t *)p;
+    r->size=(size_t)st.st_size;
+    
+    if (__atomic_load_n(&r->hdr->magic,__ATOMIC_ACQUIRE)!=SHMR_MAGIC||
+        r->hdr->version!=SHMR_VERSION||
+        SHMR_HDRSIZE+(size_t)r->hdr->nslot*r->hdr->slotsize>r->size) {
+        munmap((void *)r->hdr,r->size);
+        r->hdr=NULL;
+        return 0;
+    }
+    return 1;
+}
+/* detach ring ---------------------------------------------------------------*/
+static inline void shmrdetach(shmr_t *r)
+{
+    if (r->hdr) munmap((void *)r->hdr,r->size);
+    r->hdr=NULL;
+}
+/* number of complete epochs -------------------------------------------------*/
+static inline uint64_t shmrhead(const shmr_t *r)
+{
+    return __atomic_load_n(&r->hdr->head,__ATOMIC_ACQUIRE);
+}
+/* writer closed the ring (no more epochs) -----------------------------------*/
+static inline int shmrclosed(const shmr_t *r)
+{
+    return __atomic_load_n(&r->hdr->stat,__ATOMIC_ACQUIRE)==1;
+}
+/* slot of epoch n -----------------------------------------------------------*/
+static inline const shmr_epoch_t *shmrslot(const shmr_t *r, uint64_t n)
+{
+    return (const shmr_epoch_t *)((const uint8_t *)r->hdr+SHMR_HDRSIZE+
+                                  (n%r->hdr->nslot)*r->hdr->slotsize);
+}
+/* epoch n in place (NULL: not complete yet or overwritten) ------------------*/
+static inline const shmr_epoch_t *shmrget(const shmr_t *r, uint64_t n)
+{
+    const shmr_epoch_t *ep=shmrslot(r,n);
+    
+    if (__atomic_load_n(&ep->seq,__ATOMIC_ACQUIRE)!=2*n+2) return NULL;
+    return ep;
+}
+/* products of epoch got by shmrget() (SHMR_???) -----------------------------*/
+static inline uint32_t shmrflag(const shmr_epoch_t *ep)
+{
+    return __atomic_load_n(&ep->flag,__ATOMIC_ACQUIRE);
+}
+/* check that epoch n got by shmrget() was not overwritten while used --------*/
+static inline int shmrcheck(const shmr_epoch_t *ep, uint64_t n)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&ep->seq,__ATOMIC_RELAXED)==2*n+2;
+}
+/* copy epoch n (1:ok,0:not complete yet,-1:overwritten) ---------------------*/
+static inline int shmrcopy(const shmr_t *r, uint64_t n, shmr_epoch_t *ep)
+{
+    const shmr_epoch_t *p=shmrslot(r,n);
+    uint64_t seq=__atomic_load_n(&p->seq,__ATOMIC_ACQUIRE);
+    uint32_t nraw,nbase,flag;
+    
+    if (seq<2*n+2) return 0;
+    if (seq>2*n+2) return -1;
+    
+    /* combined solution only if complete before the copy */
+    flag=shmrflag(p);
+    memcpy(ep,p,(size_t)((const uint8_t *)p->raw-(const uint8_t *)p));
+    ep->flag=flag;
+    nraw =ep->nraw <SHMR_MAXSAT?ep->nraw :SHMR_MAXSAT;
+    nbase=ep->nbase<SHMR_MAXSAT?ep->nbase:SHMR_MAXSAT;
+    memcpy(ep->raw ,p->raw ,sizeof(shmr_sat_t)*nraw );
+    memcpy(ep->base,p->base,sizeof(shmr_sat_t)*nbase);
+    
+    return shmrcheck(p,n)?1:-1;
+}
+#endif /* WIN32 */
+    
+#ifdef __cplusplus
+}
+#endif
+#endif /* SHMRING_H */
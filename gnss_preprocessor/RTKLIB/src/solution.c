@@ -68,6 +68,18 @@
 
 #define KNOT2M     0.514444444  /* m/knot */
 
+#define SOLBSYNC   0xB5         /* binary solution record sync code */
+#define SOLBVER    1            /* binary solution format version */
+#define SOLBHLEN   8            /* binary solution file header length */
+#define SOLBRLEN   4            /* binary solution record header length */
+#define SOLBR_SOL  1            /* binary record: solution */
+#define SOLBR_STAT 2            /* binary record: solution status text */
+#define SOLBR_SAT  3            /* binary record: satellite status */
+#define SOLBLEN_SOL 200         /* length of solution record payload */
+#define SOLBLEN_SAT 60          /* length of satellite status record payload */
+#define MAXSOLBREC 65535       /* max length of binary record payload */
+#define NBUFFBINW  1048576      /* default size of binary writer buffers */
+
 static const int nmea_sys[]={ /* NMEA systems */
     SYS_GPS|SYS_SBS,SYS_GLO,SYS_GAL,SYS_CMP,SYS_QZS,SYS_IRN,0
 };
@@ -90,6 +102,29 @@ static const int nmea_solq[]={  /* NMEA GPS quality indicator [1] */
     SOLQ_NONE ,SOLQ_SINGLE, SOLQ_DGPS, SOLQ_PPP , SOLQ_FIX,
     SOLQ_FLOAT,SOLQ_DR    , SOLQ_NONE, SOLQ_NONE, SOLQ_NONE
 };
+/* get fields (little-endian) ------------------------------------------------*/
+#define U1(p) (*((uint8_t *)(p)))
+static uint16_t U2(const uint8_t *p) {uint16_t u; memcpy(&u,p,2); return u;}
+static uint32_t U4(const uint8_t *p) {uint32_t u; memcpy(&u,p,4); return u;}
+static int32_t  I4(const uint8_t *p) {int32_t  i; memcpy(&i,p,4); return i;}
+static float    R4(const uint8_t *p) {float    r; memcpy(&r,p,4); return r;}
+static double   R8(const uint8_t *p) {double   r; memcpy(&r,p,8); return r;}
+static gtime_t  TM(const uint8_t *p)
+{
+    gtime_t t; int64_t i; memcpy(&i,p,8); t.time=(time_t)i; t.sec=R8(p+8);
+    return t;
+}
+/* set fields (little-endian) ------------------------------------------------*/
+static void setU1(uint8_t *p, uint8_t  u) {*p=u;}
+static void setU2(uint8_t *p, uint16_t u) {memcpy(p,&u,2);}
+static void setU4(uint8_t *p, uint32_t u) {memcpy(p,&u,4);}
+static void setI4(uint8_t *p, int32_t  i) {memcpy(p,&i,4);}
+static void setR4(uint8_t *p, float    r) {memcpy(p,&r,4);}
+static void setR8(uint8_t *p, double   r) {memcpy(p,&r,8);}
+static void setTM(uint8_t *p, gtime_t  t)
+{
+    int64_t i=(int64_t)t.time; memcpy(p,&i,8); setR8(p+8,t.sec);
+}
 /* solution option to field separator ----------------------------------------*/
 static const char *opt2sep(const solopt_t *opt)
 {
@@ -794,6 +829,84 @@ static int readsoldata(FILE *fp, gtime_t ts, gtime_t te, double tint, int qflag,
     }
     return solbuf->n>0;
 }
+/* read binary solution file header --------------------------------------------
+* return : file type (SOLB_???,-1:no binary solution file)
+*-----------------------------------------------------------------------------*/
+static int readsolbinh(FILE *fp)
+{
+    uint8_t buff[SOLBHLEN];
+    
+    if (fread(buff,SOLBHLEN,1,fp)==1&&!memcmp(buff,"RTKB",4)&&
+        U1(buff+4)==SOLBVER) {
+        return U1(buff+5);
+    }
+    rewind(fp);
+    return -1;
+}
+/* read binary solution record -------------------------------------------------
+* return : record type (SOLBR_???,0:end of file)
+*-----------------------------------------------------------------------------*/
+static int readsolbinr(FILE *fp, uint8_t *buff, int *len)
+{
+    uint8_t head[SOLBRLEN-1];
+    int c,type;
+    
+    while ((c=fgetc(fp))!=EOF) {
+        
+        /* synchronize record header */
+        if (c!=SOLBSYNC) continue;
+        
+        if (fread(head,SOLBRLEN-1,1,fp)!=1) return 0;
+        type=U1(head);
+        *len=U2(head+1);
+        if (type<SOLBR_SOL||type>SOLBR_SAT) continue;
+        if (*len>0&&fread(buff,*len,1,fp)!=1) return 0;
+        return type;
+    }
+    return 0;
+}
+/* decode binary solution record ---------------------------------------------*/
+static void decode_solbin(const uint8_t *p, sol_t *sol, double *rb)
+{
+    int i;
+    
+    sol->time=TM(p);
+    for (i=0;i<6;i++) sol->rr [i]=R8(p+ 16+i*8);
+    for (i=0;i<6;i++) sol->qr [i]=R4(p+ 64+i*4);
+    for (i=0;i<6;i++) sol->qv [i]=R4(p+ 88+i*4);
+    for (i=0;i<6;i++) sol->dtr[i]=R8(p+112+i*8);
+    sol->type =U1(p+160);
+    sol->stat =U1(p+161);
+    sol->ns   =U1(p+162);
+    sol->age  =R4(p+164);
+    sol->ratio=R4(p+168);
+    sol->thres=R4(p+172);
+    for (i=0;i<3;i++) rb[i]=R8(p+176+i*8);
+}
+/* read binary solution data -------------------------------------------------*/
+static int readsolbin(FILE *fp, gtime_t ts, gtime_t te, double tint, int qflag,
+                      solbuf_t *solbuf)
+{
+    sol_t sol={{0}};
+    uint8_t buff[MAXSOLBREC];
+    double rb[3];
+    int type,len;
+    
+    trace(3,"readsolbin:\n");
+    
+    while ((type=readsolbinr(fp,buff,&len))) {
+        if (type!=SOLBR_SOL||len<SOLBLEN_SOL) continue;
+        decode_solbin(buff,&sol,rb);
+        
+        if (norm(solbuf->rb,3)<=0.0) matcpy(solbuf->rb,rb,3,1);
+        
+        if (!screent(sol.time,ts,te,tint)||(qflag&&sol.stat!=qflag)) {
+            continue;
+        }
+        addsol(solbuf,&sol);
+    }
+    return solbuf->n>0;
+}
 /* compare solution data -----------------------------------------------------*/
 static int cmpsol(const void *p1, const void *p2)
 {
@@ -810,6 +923,7 @@ static int sort_solbuf(solbuf_t *solbuf)
     
     if (solbuf->n<=0) return 0;
     
+    memacct(MEM_SOL,-(int64_t)sizeof(sol_t)*solbuf->nmax);
     if (!(solbuf_data=(sol_t *)realloc(solbuf->data,sizeof(sol_t)*solbuf->n))) {
         trace(1,"sort_solbuf: memory allocation error\n");
         free(solbuf->data); solbuf->data=NULL; solbuf->n=solbuf->nmax=0;
@@ -818,6 +932,7 @@ static int sort_solbuf(solbuf_t *solbuf)
     solbuf->data=solbuf_data;
     qsort(solbuf->data,solbuf->n,sizeof(sol_t),cmpsol);
     solbuf->nmax=solbuf->n;
+    memacct(MEM_SOL,(int64_t)sizeof(sol_t)*solbuf->nmax);
     solbuf->start=0;
     solbuf->end=solbuf->n-1;
     return 1;
@@ -832,6 +947,7 @@ static int sort_solbuf(solbuf_t *solbuf)
 *         (int    qflag)    I  quality flag  (0: all)
 *          solbuf_t *solbuf O  solution buffer
 * return : status (1:ok,0:no data or error)
+* notes  : binary solution files (SOLF_BIN) are detected by the header
 *-----------------------------------------------------------------------------*/
 extern int readsolt(char *files[], int nfile, gtime_t ts, gtime_t te,
                     double tint, int qflag, solbuf_t *solbuf)
@@ -849,6 +965,14 @@ extern int readsolt(char *files[], int nfile, gtime_t ts, gtime_t te,
             trace(2,"readsolt: file open error %s\n",files[i]);
             continue;
         }
+        /* read binary solution data */
+        if (readsolbinh(fp)==SOLB_SOL) {
+            if (!readsolbin(fp,ts,te,tint,qflag,solbuf)) {
+                trace(2,"readsolt: no solution in %s\n",files[i]);
+            }
+            fclose(fp);
+            continue;
+        }
         /* read solution options in header */
         readsolopt(fp,&opt);
         rewind(fp);
@@ -893,6 +1017,7 @@ extern int addsol(solbuf_t *solbuf, const sol_t *sol)
         return 1;
     }
     if (solbuf->n>=solbuf->nmax) {
+        memacct(MEM_SOL,-(int64_t)sizeof(sol_t)*solbuf->nmax);
         solbuf->nmax=solbuf->nmax==0?8192:solbuf->nmax*2;
         if (!(solbuf_data=(sol_t *)realloc(solbuf->data,sizeof(sol_t)*solbuf->nmax))) {
             trace(1,"addsol: memory allocation error\n");
@@ -900,6 +1025,7 @@ extern int addsol(solbuf_t *solbuf, const sol_t *sol)
             return 0;
         }
         solbuf->data=solbuf_data;
+        memacct(MEM_SOL,(int64_t)sizeof(sol_t)*solbuf->nmax);
     }
     solbuf->data[solbuf->n++]=*sol;
     return 1;
@@ -952,6 +1078,7 @@ extern void initsolbuf(solbuf_t *solbuf, int cyclic, int nmax)
             return;
         }
         solbuf->nmax=nmax;
+        memacct(MEM_SOL,(int64_t)sizeof(sol_t)*nmax);
     }
 }
 /* free solution ---------------------------------------------------------------
@@ -965,6 +1092,7 @@ extern void freesolbuf(solbuf_t *solbuf)
     
     trace(3,"freesolbuf: n=%d\n",solbuf->n);
     
+    memacct(MEM_SOL,-(int64_t)sizeof(sol_t)*solbuf->nmax);
     free(solbuf->data);
     solbuf->n=solbuf->nmax=solbuf->start=solbuf->end=solbuf->nb=0;
     solbuf->data=NULL;
@@ -976,6 +1104,7 @@ extern void freesolstatbuf(solstatbuf_t *solstatbuf)
 {
     trace(3,"freesolstatbuf: n=%d\n",solstatbuf->n);
     
+    memacct(MEM_SOL,-(int64_t)sizeof(solstat_t)*solstatbuf->nmax);
     solstatbuf->n=solstatbuf->nmax=0;
     free(solstatbuf->data);
     solstatbuf->data=NULL;
@@ -996,6 +1125,7 @@ static int sort_solstat(solstatbuf_t *statbuf)
     
     if (statbuf->n<=0) return 0;
     
+    memacct(MEM_SOL,-(int64_t)sizeof(solstat_t)*statbuf->nmax);
     if (!(statbuf_data=realloc(statbuf->data,sizeof(solstat_t)*statbuf->n))) {
         trace(1,"sort_solstat: memory allocation error\n");
         free(statbuf->data); statbuf->data=NULL; statbuf->n=statbuf->nmax=0;
@@ -1004,6 +1134,7 @@ static int sort_solstat(solstatbuf_t *statbuf)
     statbuf->data=statbuf_data;
     qsort(statbuf->data,statbuf->n,sizeof(solstat_t),cmpsolstat);
     statbuf->nmax=statbuf->n;
+    memacct(MEM_SOL,(int64_t)sizeof(solstat_t)*statbuf->nmax);
     return 1;
 }
 /* decode solution status ----------------------------------------------------*/
@@ -1056,6 +1187,7 @@ static void addsolstat(solstatbuf_t *statbuf, const solstat_t *stat)
     trace(4,"addsolstat:\n");
     
     if (statbuf->n>=statbuf->nmax) {
+        memacct(MEM_SOL,-(int64_t)sizeof(solstat_t)*statbuf->nmax);
         statbuf->nmax=statbuf->nmax==0?8192:statbuf->nmax*2;
         if (!(statbuf_data=(solstat_t *)realloc(statbuf->data,sizeof(solstat_t)*
                                                 statbuf->nmax))) {
@@ -1064,6 +1196,7 @@ static void addsolstat(solstatbuf_t *statbuf, const solstat_t *stat)
             return;
         }
         statbuf->data=statbuf_data;
+        memacct(MEM_SOL,(int64_t)sizeof(solstat_t)*statbuf->nmax);
     }
     statbuf->data[statbuf->n++]=*stat;
 }
@@ -1088,6 +1221,48 @@ static int readsolstatdata(FILE *fp, gtime_t ts, gtime_t te, double tint,
     }
     return statbuf->n>0;
 }
+/* decode binary satellite status record -------------------------------------*/
+static void decode_ssatbin(const uint8_t *p, gtime_t time, solstat_t *stat)
+{
+    static const solstat_t stat0={{0}};
+    
+    *stat=stat0;
+    stat->time =time;
+    stat->sat  =U1(p);
+    stat->frq  =U1(p+1);
+    stat->flag =(uint8_t)((U1(p+2)<<5)+((U1(p+4)&3)<<3)+U1(p+3));
+    stat->az   =(float)R8(p+ 8);
+    stat->el   =(float)R8(p+16);
+    stat->resp =(float)R8(p+24);
+    stat->resc =(float)R8(p+32);
+    stat->snr  =U2(p+40);
+    stat->lock =(uint16_t)I4(p+44);
+    stat->outc =(uint16_t)U4(p+48);
+    stat->slipc=(uint16_t)U4(p+52);
+    stat->rejc =(uint16_t)U4(p+56);
+}
+/* read binary solution status data ------------------------------------------*/
+static int readsolstatbin(FILE *fp, gtime_t ts, gtime_t te, double tint,
+                          solstatbuf_t *statbuf)
+{
+    solstat_t stat;
+    gtime_t time={0};
+    uint8_t buff[MAXSOLBREC];
+    int type,len;
+    
+    trace(3,"readsolstatbin:\n");
+    
+    while ((type=readsolbinr(fp,buff,&len))) {
+        if (type==SOLBR_STAT&&len>=16) time=TM(buff);
+        if (type!=SOLBR_SAT||len<SOLBLEN_SAT) continue;
+        decode_ssatbin(buff,time,&stat);
+        
+        if (screent(stat.time,ts,te,tint)) {
+            addsolstat(statbuf,&stat);
+        }
+    }
+    return statbuf->n>0;
+}
 /* read solution status --------------------------------------------------------
 * read solution status from solution status files
 * args   : char   *files[]  I  solution status files
@@ -1097,6 +1272,7 @@ static int readsolstatdata(FILE *fp, gtime_t ts, gtime_t te, double tint,
 *         (double tint)     I  time interval (0: all)
 *          solstatbuf_t *statbuf O  solution status buffer
 * return : status (1:ok,0:no data or error)
+* notes  : binary solution status files (SOLF_BIN) are detected by the header
 *-----------------------------------------------------------------------------*/
 extern int readsolstatt(char *files[], int nfile, gtime_t ts, gtime_t te,
                         double tint, solstatbuf_t *statbuf)
@@ -1117,10 +1293,18 @@ extern int readsolstatt(char *files[], int nfile, gtime_t ts, gtime_t te,
         else {
             sprintf(path,"%s.stat",files[i]);
         }
-        if (!(fp=fopen(path,"r"))) {
+        if (!(fp=fopen(path,"rb"))) {
             trace(2,"readsolstatt: file open error %s\n",path);
             continue;
         }
+        /* read binary solution status data */
+        if (readsolbinh(fp)==SOLB_STAT) {
+            if (!readsolstatbin(fp,ts,te,tint,statbuf)) {
+                trace(2,"readsolstatt: no solution in %s\n",path);
+            }
+            fclose(fp);
+            continue;
+        }
         /* read solution status data */
         if (!readsolstatdata(fp,ts,te,tint,statbuf)) {
             trace(2,"readsolstatt: no solution in %s\n",path);
@@ -1235,7 +1419,7 @@ static int outenu(uint8_t *buff, const char *s, const sol_t *sol,
 /* output solution in the form of NMEA RMC sentence --------------------------*/
 extern int outnmea_rmc(uint8_t *buff, const sol_t *sol)
 {
-    static double dirp=0.0;
+    static THREADLOCAL double dirp=0.0;
     gtime_t time;
     double ep[6],pos[3],enuv[3],dms1[3],dms2[3],vel,dir,amag=0.0;
     char *p=(char *)buff,*q,sum;
@@ -1504,6 +1688,9 @@ extern int outsolheads(uint8_t *buff, const solopt_t *opt)
     if (opt->posf==SOLF_NMEA||opt->posf==SOLF_STAT||opt->posf==SOLF_GSIF) {
         return 0;
     }
+    if (opt->posf==SOLF_BIN) {
+        return outsolbinh(buff,SOLB_SOL);
+    }
     if (opt->outhead) {
         p+=sprintf(p,"%s (",COMMENTH);
         if      (opt->posf==SOLF_XYZ) p+=sprintf(p,"x/y/z-ecef=WGS84");
@@ -1600,6 +1787,9 @@ extern int outsols(uint8_t *buff, const sol_t *sol, const double *rb,
     if (sol->stat<=SOLQ_NONE||(opt->posf==SOLF_ENU&&norm(rb,3)<=0.0)) {
         return 0;
     }
+    if (opt->posf==SOLF_BIN) {
+        return outsolbin(buff,sol,rb);
+    }
     timeu=opt->timeu<0?0:(opt->timeu>20?20:opt->timeu);
     
     time=sol->time;
@@ -1730,3 +1920,399 @@ extern void outsolex(FILE *fp, const sol_t *sol, const ssat_t *ssat,
         fwrite(buff,n,1,fp);
     }
 }
+/* binary writer thread ------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI binwthread(void *arg)
+#else
+static void *binwthread(void *arg)
+#endif
+{
+    binw_t *w=(binw_t *)arg;
+    int i;
+    
+    for (;;) {
+        rtklib_lock(&w->lock);
+        while (w->flush<0&&w->state) condwait(&w->cond,&w->lock);
+        if ((i=w->flush)<0) {
+            rtklib_unlock(&w->lock);
+            break;
+        }
+        rtklib_unlock(&w->lock);
+        
+        fwrite(w->buff[i],w->nb[i],1,w->fp);
+        
+        rtklib_lock(&w->lock);
+        w->nb[i]=0;
+        w->flush=-1;
+        condsignal(&w->cond);
+        rtklib_unlock(&w->lock);
+    }
+    fflush(w->fp);
+    return 0;
+}
+/* open binary writer ----------------------------------------------------------
+* open buffered writer flushing full buffers to file by a background thread
+* args   : binw_t *w        IO  binary writer
+*          FILE   *fp       I   output file pointer
+*          int    nbuff     I   size of write buffers (bytes) (0:default)
+* return : status (1:ok,0:error)
+* notes  : the file is not closed by binwclose()
+*-----------------------------------------------------------------------------*/
+extern int binwopen(binw_t *w, FILE *fp, int nbuff)
+{
+    trace(3,"binwopen: nbuff=%d\n",nbuff);
+    
+    w->fp=fp;
+    w->nbuff=nbuff>0?nbuff:NBUFFBINW;
+    w->nb[0]=w->nb[1]=w->wp=0;
+    w->flush=-1;
+    if (!(w->buff[0]=(uint8_t *)malloc(w->nbuff))||
+        !(w->buff[1]=(uint8_t *)malloc(w->nbuff))) {
+        free(w->buff[0]); w->buff[0]=w->buff[1]=NULL;
+        w->state=0;
+        return 0;
+    }
+    initlock(&w->lock);
+    initcond(&w->cond);
+    w->state=1;
+#ifdef WIN32
+    if (!(w->thread=CreateThread(NULL,0,binwthread,w,0,NULL))) {
+#else
+    if (pthread_create(&w->thread,NULL,binwthread,w)) {
+#endif
+        free(w->buff[0]); free(w->buff[1]); w->buff[0]=w->buff[1]=NULL;
+        w->state=0;
+        return 0;
+    }
+    return 1;
+}
+/* write data to binary writer -------------------------------------------------
+* args   : binw_t *w        IO  binary writer
+*          uint8_t *data    I   data
+*          int    n         I   data length (bytes)
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int binwrite(binw_t *w, const uint8_t *data, int n)
+{
+    if (!w->state) return 0;
+    
+    if (w->nb[w->wp]+n>w->nbuff) {
+        rtklib_lock(&w->lock);
+        while (w->flush>=0) condwait(&w->cond,&w->lock);
+        
+        /* hand over filled buffer to writer thread */
+        w->flush=w->wp;
+        w->wp^=1;
+        condsignal(&w->cond);
+        
+        /* write large data directly after buffer flushed */
+        if (n>w->nbuff) {
+            while (w->flush>=0) condwait(&w->cond,&w->lock);
+            fwrite(data,n,1,w->fp);
+            rtklib_unlock(&w->lock);
+            return 1;
+        }
+        rtklib_unlock(&w->lock);
+    }
+    memcpy(w->buff[w->wp]+w->nb[w->wp],data,n);
+    w->nb[w->wp]+=n;
+    return 1;
+}
+/* flush binary writer ---------------------------------------------------------
+* write all buffered data to file and wait until written
+* args   : binw_t *w        IO  binary writer
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void binwflush(binw_t *w)
+{
+    if (!w->state) return;
+    
+    rtklib_lock(&w->lock);
+    while (w->flush>=0) condwait(&w->cond,&w->lock);
+    if (w->nb[w->wp]>0) {
+        w->flush=w->wp;
+        w->wp^=1;
+        condsignal(&w->cond);
+        while (w->flush>=0) condwait(&w->cond,&w->lock);
+    }
+    fflush(w->fp);
+    rtklib_unlock(&w->lock);
+}
+/* close binary writer ---------------------------------------------------------
+* flush buffered data and stop writer thread
+* args   : binw_t *w        IO  binary writer
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void binwclose(binw_t *w)
+{
+    trace(3,"binwclose:\n");
+    
+    if (!w->state) return;
+    
+    rtklib_lock(&w->lock);
+    while (w->flush>=0) condwait(&w->cond,&w->lock);
+    if (w->nb[w->wp]>0) w->flush=w->wp;
+    w->state=0;
+    condsignal(&w->cond);
+    rtklib_unlock(&w->lock);
+#ifdef WIN32
+    WaitForSingleObject(w->thread,10000);
+    CloseHandle(w->thread);
+#else
+    pthread_join(w->thread,NULL);
+#endif
+    free(w->buff[0]); free(w->buff[1]); w->buff[0]=w->buff[1]=NULL;
+}
+/* binary record header ------------------------------------------------------*/
+static int outsolbinr(uint8_t *buff, int type, int len)
+{
+    setU1(buff  ,SOLBSYNC);
+    setU1(buff+1,(uint8_t)type);
+    setU2(buff+2,(uint16_t)len);
+    return SOLBRLEN;
+}
+/* output binary solution file header ------------------------------------------
+* args   : uint8_t *buff    IO  output buffer
+*          int    type      I   file type (SOLB_???)
+* return : number of output bytes
+* notes  : binary solution file format (little-endian)
+*
+*          header : "RTKB",version(U1),type(U1),reserved(U2)
+*          record : sync(U1:0xB5),record type(U1),length(U2),payload
+*
+*          record type 1 (solution): time(I8,R8),rr(R8x6),qr(R4x6),qv(R4x6),
+*              dtr(R8x6),type(U1),stat(U1),ns(U1),reserved(U1),age(R4),
+*              ratio(R4),thres(R4),rb(R8x3)
+*          record type 2 (solution status): time(I8,R8),$POS,$VELACC,$CLK,
+*              $ION,$TROP and $HWBIAS records as text
+*          record type 3 (satellite status): sat(U1),frq(U1),vsat(U1),
+*              fix(U1),slip(U1),reserved(U1x3),az(R8),el(R8),resp(R8),
+*              resc(R8),snr(U2),reserved(U2),lock(I4),outc(U4),slipc(U4),
+*              rejc(U4) (time of preceding solution status record)
+*-----------------------------------------------------------------------------*/
+extern int outsolbinh(uint8_t *buff, int type)
+{
+    memcpy(buff,"RTKB",4);
+    setU1(buff+4,SOLBVER);
+    setU1(buff+5,(uint8_t)type);
+    setU2(buff+6,0);
+    return SOLBHLEN;
+}
+/* output binary solution record -----------------------------------------------
+* args   : uint8_t *buff    IO  output buffer
+*          sol_t  *sol      I   solution
+*          double *rb       I   base station position {x,y,z} (ecef) (m)
+* return : number of output bytes
+*-----------------------------------------------------------------------------*/
+extern int outsolbin(uint8_t *buff, const sol_t *sol, const double *rb)
+{
+    uint8_t *p=buff+outsolbinr(buff,SOLBR_SOL,SOLBLEN_SOL);
+    int i;
+    
+    setTM(p,sol->time);
+    for (i=0;i<6;i++) setR8(p+ 16+i*8,sol->rr [i]);
+    for (i=0;i<6;i++) setR4(p+ 64+i*4,sol->qr [i]);
+    for (i=0;i<6;i++) setR4(p+ 88+i*4,sol->qv [i]);
+    for (i=0;i<6;i++) setR8(p+112+i*8,sol->dtr[i]);
+    setU1(p+160,sol->type);
+    setU1(p+161,sol->stat);
+    setU1(p+162,sol->ns);
+    setU1(p+163,0);
+    setR4(p+164,sol->age);
+    setR4(p+168,sol->ratio);
+    setR4(p+172,sol->thres);
+    for (i=0;i<3;i++) setR8(p+176+i*8,rb?rb[i]:0.0);
+    return SOLBRLEN+SOLBLEN_SOL;
+}
+/* input binary solution record ------------------------------------------------
+* args   : uint8_t *buff    I   binary solution record (sync to payload)
+*          sol_t  *sol      O   solution
+*          double *rb       O   base station position {x,y,z} (ecef) (m)
+* return : number of input bytes (0: no solution record)
+*-----------------------------------------------------------------------------*/
+extern int insolbin(const uint8_t *buff, sol_t *sol, double *rb)
+{
+    if (U1(buff)!=SOLBSYNC||U1(buff+1)!=SOLBR_SOL||
+        U2(buff+2)<SOLBLEN_SOL) return 0;
+    decode_solbin(buff+SOLBRLEN,sol,rb);
+    return SOLBRLEN+U2(buff+2);
+}
+/* output binary solution status record ----------------------------------------
+* args   : uint8_t *buff    IO  output buffer
+*          gtime_t time     I   solution time (gpst)
+*          char   *msg      I   solution status records (text)
+*          int    n         I   length of solution status records
+* return : number of output bytes
+*-----------------------------------------------------------------------------*/
+extern int outstatbin(uint8_t *buff, gtime_t time, const char *msg, int n)
+{
+    uint8_t *p;
+    
+    if (n>MAXSOLBREC-16) n=MAXSOLBREC-16;
+    p=buff+outsolbinr(buff,SOLBR_STAT,16+n);
+    setTM(p,time);
+    memcpy(p+16,msg,n);
+    return SOLBRLEN+16+n;
+}
+/* output binary satellite status record ---------------------------------------
+* args   : uint8_t *buff    IO  output buffer
+*          int    sat       I   satellite number
+*          int    frq       I   frequency index (0:L1,1:L2,...)
+*          ssat_t *ssat     I   satellite status
+* return : number of output bytes
+* notes  : the record belongs to the preceding solution status record
+*-----------------------------------------------------------------------------*/
+extern int outssatbin(uint8_t *buff, int sat, int frq, const ssat_t *ssat)
+{
+    uint8_t *p=buff+outsolbinr(buff,SOLBR_SAT,SOLBLEN_SAT);
+    
+    setU1(p  ,(uint8_t)sat);
+    setU1(p+1,(uint8_t)(frq+1));
+    setU1(p+2,ssat->vsat[frq]);
+    setU1(p+3,ssat->fix [frq]);
+    setU1(p+4,ssat->slip[frq]);
+    setU1(p+5,0); setU2(p+6,0);
+    setR8(p+ 8,ssat->azel[0]);
+    setR8(p+16,ssat->azel[1]);
+    setR8(p+24,ssat->resp[frq]);
+    setR8(p+32,ssat->resc[frq]);
+    setU2(p+40,ssat->snr[frq]);
+    setU2(p+42,0);
+    setI4(p+44,ssat->lock [frq]);
+    setU4(p+48,ssat->outc [frq]);
+    setU4(p+52,ssat->slipc[frq]);
+    setU4(p+56,ssat->rejc [frq]);
+    return SOLBRLEN+SOLBLEN_SAT;
+}
+/* convert binary satellite status record to text ----------------------------*/
+static int conv_ssatbin(const uint8_t *p, gtime_t time, char *buff)
+{
+    double tow;
+    int week;
+    char id[32];
+    
+    tow=time2gpst(time,&week);
+    satno2id(U1(p),id);
+    return sprintf(buff,"$SAT,%d,%.3f,%s,%d,%.1f,%.1f,%.4f,%.4f,%d,%.1f,%d,%d,%d,%d,%d,%d\n",
+                   week,tow,id,U1(p+1),R8(p+8)*R2D,R8(p+16)*R2D,R8(p+24),
+                   R8(p+32),U1(p+2),U2(p+40)*SNR_UNIT,U1(p+3),U1(p+4)&3,
+                   I4(p+44),(int)U4(p+48),(int)U4(p+52),(int)U4(p+56));
+}
+/* convert binary solution file to text ----------------------------------------
+* convert binary solution or solution status file to the text formats
+* args   : char   *infile   I   binary solution or solution status file
+*          char   *outfile  I   output file ("": stdout)
+*          solopt_t *opt    I   solution options of output
+* return : status (1:ok,0:error)
+* notes  : solution status is converted to the format of rtkopenstat()
+*-----------------------------------------------------------------------------*/
+extern int convsolbin(const char *infile, const char *outfile,
+                      const solopt_t *opt)
+{
+    FILE *ifp,*ofp=stdout;
+    sol_t sol={{0}};
+    gtime_t time={0};
+    solopt_t opt_=*opt;
+    uint8_t buff[MAXSOLBREC],out[MAXSOLMSG+1];
+    double rb[3];
+    int type,rtype,len,n;
+    
+    trace(3,"convsolbin: infile=%s outfile=%s\n",infile,outfile);
+    
+    if (opt_.posf==SOLF_BIN) opt_.posf=SOLF_LLH;
+    
+    if (!(ifp=fopen(infile,"rb"))) {
+        trace(2,"convsolbin: file open error %s\n",infile);
+        return 0;
+    }
+    if ((type=readsolbinh(ifp))<0) {
+        trace(2,"convsolbin: no binary solution file %s\n",infile);
+        fclose(ifp);
+        return 0;
+    }
+    if (*outfile&&!(ofp=fopen(outfile,"wb"))) {
+        trace(2,"convsolbin: file open error %s\n",outfile);
+        fclose(ifp);
+        return 0;
+    }
+    if (type==SOLB_SOL) outsolhead(ofp,&opt_);
+    
+    while ((rtype=readsolbinr(ifp,buff,&len))) {
+        if (type==SOLB_SOL&&rtype==SOLBR_SOL&&len>=SOLBLEN_SOL) {
+            decode_solbin(buff,&sol,rb);
+            outsol(ofp,&sol,rb,&opt_);
+        }
+        else if (type==SOLB_STAT&&rtype==SOLBR_STAT&&len>=16) {
+            time=TM(buff);
+            fwrite(buff+16,len-16,1,ofp);
+        }
+        else if (type==SOLB_STAT&&rtype==SOLBR_SAT&&len>=SOLBLEN_SAT) {
+            n=conv_ssatbin(buff,time,(char *)out);
+            fwrite(out,n,1,ofp);
+        }
+    }
+    fclose(ifp);
+    if (*outfile) fclose(ofp);
+    return 1;
+}
+/* merge binary solution files -------------------------------------------------
+* merge binary solution or solution status files of consecutive time spans
+* args   : char   **infile  I   binary solution or solution status files
+*          gtime_t *ts      I   start time of output span of files (gpst)
+*          gtime_t *te      I   end time of output span of files, exclusive (gpst)
+*          int    n         I   number of files (in time order)
+*          char   *outfile  I   output binary file
+* return : number of merged records (-1:error)
+* notes  : records out of the output span of a file (warm-up) are discarded.
+*          records in the overlap with the span of the preceding file are
+*          taken from the preceding file. satellite status records follow the
+*          preceding solution status record.
+*-----------------------------------------------------------------------------*/
+extern int mergesolbin(char **infile, const gtime_t *ts, const gtime_t *te,
+                       int n, const char *outfile)
+{
+    FILE *ifp,*ofp;
+    gtime_t time;
+    uint8_t buff[MAXSOLBREC],head[SOLBHLEN];
+    int i,type=-1,rtype,len,out=0,nrec=0;
+    
+    trace(3,"mergesolbin: n=%d outfile=%s\n",n,outfile);
+    
+    if (!(ofp=fopen(outfile,"wb"))) {
+        trace(2,"mergesolbin: file open error %s\n",outfile);
+        return -1;
+    }
+    for (i=0;i<n;i++) {
+        if (!(ifp=fopen(infile[i],"rb"))) {
+            trace(2,"mergesolbin: file open error %s\n",infile[i]);
+            nrec=-1;
+            break;
+        }
+        rtype=readsolbinh(ifp);
+        if (rtype<0||(type>=0&&rtype!=type)) {
+            trace(2,"mergesolbin: invalid binary solution file %s\n",infile[i]);
+            fclose(ifp);
+            nrec=-1;
+            break;
+        }
+        if (type<0) {
+            type=rtype;
+            fwrite(head,outsolbinh(head,type),1,ofp);
+        }
+        for (out=0;(rtype=readsolbinr(ifp,buff,&len));) {
+            if (rtype==SOLBR_SOL||rtype==SOLBR_STAT) {
+                if (len<16) continue;
+                time=TM(buff);
+                out=timediff(time,ts[i])>=-DTTOL&&timediff(time,te[i])<0.0&&
+                    (i==0||timediff(time,te[i-1])>=0.0);
+            }
+            if (!out) continue;
+            fwrite(head,outsolbinr(head,rtype,len),1,ofp);
+            if (len>0) fwrite(buff,len,1,ofp);
+            nrec++;
+        }
+        fclose(ifp);
+    }
+    fclose(ofp);
+    return nrec;
+}
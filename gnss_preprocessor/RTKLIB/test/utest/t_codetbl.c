@@ -0,0 +1,356 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : satellite number and obs code tables
+*
+* the table lookups of satno(), satsys(), code2idx(), code2freq(),
+* getcodepri() and sat2freq() are compared with the previous implementations
+* (old_*()) copied below.
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/rtklib.h"
+
+static const int syss[]={SYS_NONE,SYS_GPS,SYS_SBS,SYS_GLO,SYS_GAL,SYS_QZS,
+                         SYS_CMP,SYS_IRN,SYS_LEO,SYS_GPS|SYS_GLO,SYS_ALL};
+
+static char codepris[7][MAXFREQ][16]={  /* default code priority */
+   /*    0         1          2          3         4         5     */
+    {"CPYWMNSL","PYWCMNDLSX","IQX"     ,""       ,""       ,""      ,""}, /* GPS */
+    {"CPABX"   ,"PCABX"     ,"IQX"     ,""       ,""       ,""      ,""}, /* GLO */
+    {"CABXZ"   ,"IQX"       ,"IQX"     ,"ABCXZ"  ,"IQX"    ,""      ,""}, /* GAL */
+    {"CLSXZ"   ,"LSX"       ,"IQXDPZ"  ,"LSXEZ"  ,""       ,""      ,""}, /* QZS */
+    {"C"       ,"IQX"       ,""        ,""       ,""       ,""      ,""}, /* SBS */
+    {"IQXDPAN" ,"IQXDPZ"    ,"DPX"     ,"IQXA"   ,"DPX"    ,""      ,""}, /* BDS */
+    {"ABCX"    ,"ABCX"      ,""        ,""       ,""       ,""      ,""}  /* IRN */
+};
+/* previous satno() ---------------------------------------------------------*/
+static int old_satno(int sys, int prn)
+{
+    if (prn<=0) return 0;
+    switch (sys) {
+        case SYS_GPS:
+            if (prn<MINPRNGPS||MAXPRNGPS<prn) return 0;
+            return prn-MINPRNGPS+1;
+        case SYS_GLO:
+            if (prn<MINPRNGLO||MAXPRNGLO<prn) return 0;
+            return NSATGPS+prn-MINPRNGLO+1;
+        case SYS_GAL:
+            if (prn<MINPRNGAL||MAXPRNGAL<prn) return 0;
+            return NSATGPS+NSATGLO+prn-MINPRNGAL+1;
+        case SYS_QZS:
+            if (prn<MINPRNQZS||MAXPRNQZS<prn) return 0;
+            return NSATGPS+NSATGLO+NSATGAL+prn-MINPRNQZS+1;
+        case SYS_CMP:
+            if (prn<MINPRNCMP||MAXPRNCMP<prn) return 0;
+            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+prn-MINPRNCMP+1;
+        case SYS_IRN:
+            if (prn<MINPRNIRN||MAXPRNIRN<prn) return 0;
+            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+NSATCMP+prn-MINPRNIRN+1;
+        case SYS_LEO:
+            if (prn<MINPRNLEO||MAXPRNLEO<prn) return 0;
+            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+NSATCMP+NSATIRN+
+                   prn-MINPRNLEO+1;
+        case SYS_SBS:
+            if (prn<MINPRNSBS||MAXPRNSBS<prn) return 0;
+            return NSATGPS+NSATGLO+NSATGAL+NSATQZS+NSATCMP+NSATIRN+NSATLEO+
+                   prn-MINPRNSBS+1;
+    }
+    return 0;
+}
+/* previous satsys() --------------------------------------------------------*/
+static int old_satsys(int sat, int *prn)
+{
+    int sys=SYS_NONE;
+    if (sat<=0||MAXSAT<sat) sat=0;
+    else if (sat<=NSATGPS) {
+        sys=SYS_GPS; sat+=MINPRNGPS-1;
+    }
+    else if ((sat-=NSATGPS)<=NSATGLO) {
+        sys=SYS_GLO; sat+=MINPRNGLO-1;
+    }
+    else if ((sat-=NSATGLO)<=NSATGAL) {
+        sys=SYS_GAL; sat+=MINPRNGAL-1;
+    }
+    else if ((sat-=NSATGAL)<=NSATQZS) {
+        sys=SYS_QZS; sat+=MINPRNQZS-1;
+    }
+    else if ((sat-=NSATQZS)<=NSATCMP) {
+        sys=SYS_CMP; sat+=MINPRNCMP-1;
+    }
+    else if ((sat-=NSATCMP)<=NSATIRN) {
+        sys=SYS_IRN; sat+=MINPRNIRN-1;
+    }
+    else if ((sat-=NSATIRN)<=NSATLEO) {
+        sys=SYS_LEO; sat+=MINPRNLEO-1;
+    }
+    else if ((sat-=NSATLEO)<=NSATSBS) {
+        sys=SYS_SBS; sat+=MINPRNSBS-1;
+    }
+    else sat=0;
+    if (prn) *prn=sat;
+    return sys;
+}
+/* previous code2freq_GPS() -------------------------------------------------*/
+static int old_code2freq_GPS(uint8_t code, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    switch (obs[0]) {
+        case '1': *freq=FREQ1; return 0; /* L1 */
+        case '2': *freq=FREQ2; return 1; /* L2 */
+        case '5': *freq=FREQ5; return 2; /* L5 */
+    }
+    return -1;
+}
+/* previous code2freq_GLO() -------------------------------------------------*/
+static int old_code2freq_GLO(uint8_t code, int fcn, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    if (fcn<-7||fcn>6) return -1;
+    
+    switch (obs[0]) {
+        case '1': *freq=FREQ1_GLO+DFRQ1_GLO*fcn; return 0; /* G1 */
+        case '2': *freq=FREQ2_GLO+DFRQ2_GLO*fcn; return 1; /* G2 */
+        case '3': *freq=FREQ3_GLO;               return 2; /* G3 */
+        case '4': *freq=FREQ1a_GLO;              return 0; /* G1a */
+        case '6': *freq=FREQ2a_GLO;              return 1; /* G2a */
+    }
+    return -1;
+}
+/* previous code2freq_GAL() -------------------------------------------------*/
+static int old_code2freq_GAL(uint8_t code, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    switch (obs[0]) {
+        case '1': *freq=FREQ1; return 0; /* E1 */
+        case '7': *freq=FREQ7; return 1; /* E5b */
+        case '5': *freq=FREQ5; return 2; /* E5a */
+        case '6': *freq=FREQ6; return 3; /* E6 */
+        case '8': *freq=FREQ8; return 4; /* E5ab */
+    }
+    return -1;
+}
+/* previous code2freq_QZS() -------------------------------------------------*/
+static int old_code2freq_QZS(uint8_t code, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    switch (obs[0]) {
+        case '1': *freq=FREQ1; return 0; /* L1 */
+        case '2': *freq=FREQ2; return 1; /* L2 */
+        case '5': *freq=FREQ5; return 2; /* L5 */
+        case '6': *freq=FREQ6; return 3; /* L6 */
+    }
+    return -1;
+}
+/* previous code2freq_SBS() -------------------------------------------------*/
+static int old_code2freq_SBS(uint8_t code, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    switch (obs[0]) {
+        case '1': *freq=FREQ1; return 0; /* L1 */
+        case '5': *freq=FREQ5; return 1; /* L5 */
+    }
+    return -1;
+}
+/* previous code2freq_BDS() -------------------------------------------------*/
+static int old_code2freq_BDS(uint8_t code, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    switch (obs[0]) {
+        case '1': *freq=FREQ1;     return 0; /* B1C */
+        case '2': *freq=FREQ1_CMP; return 0; /* B1I */
+        case '7': *freq=FREQ2_CMP; return 1; /* B2I/B2b */
+        case '5': *freq=FREQ5;     return 2; /* B2a */
+        case '6': *freq=FREQ3_CMP; return 3; /* B3 */
+        case '8': *freq=FREQ8;     return 4; /* B2ab */
+    }
+    return -1;
+}
+/* previous code2freq_IRN() -------------------------------------------------*/
+static int old_code2freq_IRN(uint8_t code, double *freq)
+{
+    char *obs=code2obs(code);
+    
+    switch (obs[0]) {
+        case '5': *freq=FREQ5; return 0; /* L5 */
+        case '9': *freq=FREQ9; return 1; /* S */
+    }
+    return -1;
+}
+/* previous code2idx() ------------------------------------------------------*/
+static int old_code2idx(int sys, uint8_t code)
+{
+    double freq;
+    
+    switch (sys) {
+        case SYS_GPS: return old_code2freq_GPS(code,&freq);
+        case SYS_GLO: return old_code2freq_GLO(code,0,&freq);
+        case SYS_GAL: return old_code2freq_GAL(code,&freq);
+        case SYS_QZS: return old_code2freq_QZS(code,&freq);
+        case SYS_SBS: return old_code2freq_SBS(code,&freq);
+        case SYS_CMP: return old_code2freq_BDS(code,&freq);
+        case SYS_IRN: return old_code2freq_IRN(code,&freq);
+    }
+    return -1;
+}
+/* previous code2freq() -----------------------------------------------------*/
+static double old_code2freq(int sys, uint8_t code, int fcn)
+{
+    double freq=0.0;
+    
+    switch (sys) {
+        case SYS_GPS: (void)old_code2freq_GPS(code,&freq); break;
+        case SYS_GLO: (void)old_code2freq_GLO(code,fcn,&freq); break;
+        case SYS_GAL: (void)old_code2freq_GAL(code,&freq); break;
+        case SYS_QZS: (void)old_code2freq_QZS(code,&freq); break;
+        case SYS_SBS: (void)old_code2freq_SBS(code,&freq); break;
+        case SYS_CMP: (void)old_code2freq_BDS(code,&freq); break;
+        case SYS_IRN: (void)old_code2freq_IRN(code,&freq); break;
+    }
+    return freq;
+}
+/* previous getcodepri() ---------------------------------------------------*/
+static int old_getcodepri(int sys, uint8_t code, const char *opt)
+{
+    const char *p,*optstr;
+    char *obs,str[8]="";
+    int i,j;
+    
+    switch (sys) {
+        case SYS_GPS: i=0; optstr="-GL%2s"; break;
+        case SYS_GLO: i=1; optstr="-RL%2s"; break;
+        case SYS_GAL: i=2; optstr="-EL%2s"; break;
+        case SYS_QZS: i=3; optstr="-JL%2s"; break;
+        case SYS_SBS: i=4; optstr="-SL%2s"; break;
+        case SYS_CMP: i=5; optstr="-CL%2s"; break;
+        case SYS_IRN: i=6; optstr="-IL%2s"; break;
+        default: return 0;
+    }
+    if ((j=old_code2idx(sys,code))<0) return 0;
+    obs=code2obs(code);
+    
+    /* parse code options */
+    for (p=opt;p&&(p=strchr(p,'-'));p++) {
+        if (sscanf(p,optstr,str)<1||str[0]!=obs[0]) continue;
+        return str[1]==obs[1]?15:0;
+    }
+    /* search code priority */
+    return (p=strchr(codepris[i][j],obs[1]))?14-(int)(p-codepris[i][j]):0;
+}
+/* satno(), satsys() */
+void utest1(void)
+{
+    int i,sys,sat,prn,prn0,prn1;
+    
+    for (i=0;i<(int)(sizeof(syss)/sizeof(*syss));i++) {
+        for (prn=-1;prn<=256;prn++) {
+            assert(satno(syss[i],prn)==old_satno(syss[i],prn));
+        }
+    }
+    for (sat=-1;sat<=MAXSAT+2;sat++) {
+        prn0=prn1=-1;
+        assert(satsys(sat,&prn0)==old_satsys(sat,&prn1));
+        assert(prn0==prn1);
+        assert(satsys(sat,NULL)==old_satsys(sat,NULL));
+        if (sat<1||sat>MAXSAT) continue;
+        sys=satsys(sat,&prn);
+        assert(satno(sys,prn)==sat);
+    }
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* code2idx(), code2freq() */
+void utest2(void)
+{
+    int i,code,fcn;
+    
+    for (i=0;i<(int)(sizeof(syss)/sizeof(*syss));i++) {
+        for (code=0;code<=MAXCODE+1;code++) {
+            assert(code2idx(syss[i],(uint8_t)code)==
+                   old_code2idx(syss[i],(uint8_t)code));
+            for (fcn=-9;fcn<=8;fcn++) {
+                assert(code2freq(syss[i],(uint8_t)code,fcn)==
+                       old_code2freq(syss[i],(uint8_t)code,fcn));
+            }
+        }
+    }
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* getcodepri(), setcodepri() */
+void utest3(void)
+{
+    const char *opts[]={
+        NULL,"","-GL1P","-GL1C -GL2X","-RL2C -EL1X","-JL5X -CL2I -IL5A",
+        "-GL1","-SL1C -GL5Q-GL2L"
+    };
+    int i,j,code;
+    
+    for (i=0;i<(int)(sizeof(syss)/sizeof(*syss));i++) {
+        for (j=0;j<(int)(sizeof(opts)/sizeof(*opts));j++) {
+            for (code=0;code<=MAXCODE+1;code++) {
+                assert(getcodepri(syss[i],(uint8_t)code,opts[j])==
+                       old_getcodepri(syss[i],(uint8_t)code,opts[j]));
+            }
+        }
+    }
+    /* changed priorities */
+    setcodepri(SYS_GPS|SYS_QZS,0,"XLSC");
+    strcpy(codepris[0][0],"XLSC");
+    strcpy(codepris[3][0],"XLSC");
+    setcodepri(SYS_CMP,1,"ZD");
+    strcpy(codepris[5][1],"ZD");
+    
+    for (i=0;i<(int)(sizeof(syss)/sizeof(*syss));i++) {
+        for (code=0;code<=MAXCODE+1;code++) {
+            assert(getcodepri(syss[i],(uint8_t)code,NULL)==
+                   old_getcodepri(syss[i],(uint8_t)code,NULL));
+        }
+    }
+    printf("%s utest3 : OK\n",__FILE__);
+}
+/* sat2freq() with GLONASS fcn of ephemeris search and of uniqnav() */
+void utest4(void)
+{
+    nav_t nav={0};
+    geph_t *geph;
+    int sat1=satno(SYS_GLO,5),sat2=satno(SYS_GLO,7),sat3=satno(SYS_GLO,9);
+    double f1,f2;
+    
+    geph=(geph_t *)calloc(3,sizeof(geph_t));
+    geph[0].sat=sat1; geph[0].frq=-3;
+    geph[1].sat=sat2; geph[1].frq=4;
+    geph[2].sat=sat2; geph[2].frq=4; geph[2].toe.time=900;
+    nav.geph=geph; nav.ng=nav.ngmax=3;
+    nav.glo_fcn[8]=1+8; /* fcn of rinex header without ephemeris */
+    
+    f1=sat2freq(sat1,CODE_L1C,&nav);
+    f2=sat2freq(sat2,CODE_L2P,&nav);
+    assert(f1==old_code2freq(SYS_GLO,CODE_L1C,-3));
+    assert(f2==old_code2freq(SYS_GLO,CODE_L2P,4));
+    assert(!nav.glo_fcn[4]&&!nav.glo_fcn[6]);
+    
+    uniqnav(&nav);
+    assert(nav.glo_fcn[4]==-3+8&&nav.glo_fcn[6]==4+8&&nav.glo_fcn[8]==1+8);
+    nav.ng=0; /* fcn without ephemeris search */
+    assert(sat2freq(sat1,CODE_L1C,&nav)==f1);
+    assert(sat2freq(sat2,CODE_L2P,&nav)==f2);
+    assert(sat2freq(sat3,CODE_L1C,&nav)==old_code2freq(SYS_GLO,CODE_L1C,1));
+    assert(sat2freq(satno(SYS_GLO,10),CODE_L1C,&nav)==0.0);
+    assert(sat2freq(sat1,CODE_L1C,NULL)==0.0);
+    assert(sat2freq(satno(SYS_GPS,1),CODE_L5Q,NULL)==FREQ5);
+    freenav(&nav,0xFF);
+    
+    printf("%s utest4 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    utest3();
+    utest4();
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : kalman filter of DD residuals
+*
+* the static functions of rtkpos.cpp are tested by including the source.
+* the block update of ddfilter() is compared with filter() of the dense design
+* matrix and the dense DD measurement error covariance.
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/rtkpos.cpp"
+
+#define NSTA        24          /* number of states */
+#define NPOS        7           /* number of position/iono/tropo states */
+#define MAXM        32          /* max number of DD residuals */
+
+/* uniform random number in [a,b) --------------------------------------------*/
+static double rnd(double a, double b)
+{
+    return a+(b-a)*rand()/((double)RAND_MAX+1.0);
+}
+/* set random states and covariance of inactive states (x[i]==0) -------------*/
+static void setstate(double *x, double *P, const int *inact, int ninact)
+{
+    double *A;
+    int i,j;
+    
+    A=mat(NSTA,NSTA);
+    for (i=0;i<NSTA*NSTA;i++) A[i]=rnd(-1.0,1.0);
+    matmul("NT",NSTA,NSTA,NSTA,1.0,A,A,0.0,P); /* symmetric positive definite */
+    for (i=0;i<NSTA;i++) {
+        P[i+i*NSTA]+=NSTA;
+        x[i]=rnd(1.0,10.0);
+    }
+    for (i=0;i<ninact;i++) {
+        x[inact[i]]=0.0;
+        for (j=0;j<NSTA;j++) P[inact[i]+j*NSTA]=P[j+inact[i]*NSTA]=0.0;
+    }
+    free(A);
+}
+/* set DD residuals of blocks sharing reference satellite --------------------*/
+static int setdd(ddh_t *H, double *v, ddr_t *R, const int *nb, int nblk,
+                 int hold)
+{
+    int i,j,b,m=0,ref;
+    
+    R->n=nblk;
+    for (b=0;b<nblk;b++) {
+        R->nb[b]=nb[b];
+        ref=NPOS+rand()%(NSTA-NPOS);
+        for (i=0;i<nb[b];i++,m++) {
+            H[m].n=0;
+            if (!hold) {
+                for (j=0;j<3;j++) setddh(H+m,j,rnd(-1.0,1.0));
+                setddh(H+m,3+rand()%(NPOS-3),rnd(-1.0,1.0));
+            }
+            setddh(H+m,ref,1.0);
+            setddh(H+m,NPOS+(ref-NPOS+1+i)%(NSTA-NPOS),-1.0);
+            v[m]=rnd(-0.5,0.5);
+            R->Ri[m]=hold?0.0:rnd(1E-4,1E-2);
+            R->Rj[m]=rnd(1E-4,1E-2);
+        }
+        for (i=1;i<nb[b];i++) R->Ri[m-nb[b]+i]=R->Ri[m-nb[b]];
+    }
+    return m;
+}
+/* dense design matrix and measurement error covariance ----------------------*/
+static void densedd(const ddh_t *H, const ddr_t *R, int m, double *Hd,
+                    double *Rd)
+{
+    int i,j,k,b,l;
+    
+    for (i=0;i<NSTA*m;i++) Hd[i]=0.0;
+    for (i=0;i<m*m;i++) Rd[i]=0.0;
+    for (j=0;j<m;j++) for (k=0;k<H[j].n;k++) {
+        Hd[H[j].idx[k]+j*NSTA]=H[j].val[k];
+    }
+    for (b=l=0;b<R->n;l+=R->nb[b++]) {
+        for (i=0;i<R->nb[b];i++) for (j=0;j<R->nb[b];j++) {
+            Rd[l+i+(l+j)*m]=R->Ri[l]+(i==j?R->Rj[l+i]:0.0);
+        }
+    }
+}
+/* update by ddfilter() and filter() and compare states ----------------------*/
+static void cmpupdate(const int *nb, int nblk, const int *inact, int ninact,
+                      int hold)
+{
+    double x[NSTA],P[NSTA*NSTA],x1[NSTA],P1[NSTA*NSTA],v[MAXM],*Hd,*Rd,*xs,*Ps;
+    ddh_t H[MAXM];
+    ddr_t R={0};
+    int i,m,na,ix[NSTA],jx[NSTA];
+    
+    R.Ri=mat(MAXM,1); R.Rj=mat(MAXM,1);
+    setstate(x,P,inact,ninact);
+    m=setdd(H,v,&R,nb,nblk,hold);
+    
+    /* dense update of all states */
+    Hd=mat(NSTA,m); Rd=mat(m,m);
+    densedd(H,&R,m,Hd,Rd);
+    matcpy(x1,x,NSTA,1);
+    matcpy(P1,P,NSTA,NSTA);
+    assert(!filter(x1,P1,Hd,v,Rd,NSTA,m));
+    
+    /* block update of active states */
+    na=actidx(x,P,NSTA,ix,jx);
+    assert(na==NSTA-ninact);
+    xs=mat(na,1); Ps=mat(na,na);
+    getact(x,P,NSTA,ix,na,xs,Ps);
+    assert(!ddfilter(xs,Ps,H,v,&R,jx,na,m));
+    putact(xs,Ps,ix,na,NSTA,x,P);
+    
+    for (i=0;i<NSTA;i++) {
+        assert(fabs(x[i]-x1[i])<1E-9*(1.0+fabs(x1[i])));
+    }
+    for (i=0;i<NSTA*NSTA;i++) {
+        assert(fabs(P[i]-P1[i])<1E-9*(1.0+fabs(P1[i])));
+    }
+    free(Hd); free(Rd); free(xs); free(Ps); free(R.Ri); free(R.Rj);
+}
+/* ddfilter() compared with filter() */
+void utest1(void)
+{
+    const int nb1[]={5},nb2[]={4,3,6,1},nb3[]={8,8,8,8};
+    const int inact[]={NPOS+2,NPOS+9,NSTA-1};
+    int i;
+    
+    srand(1);
+    for (i=0;i<20;i++) {
+        cmpupdate(nb1,1,inact,0,0);
+        cmpupdate(nb2,4,inact,0,0);
+        cmpupdate(nb3,4,inact,0,0);
+    
+        /* partials of inactive states ignored */
+        cmpupdate(nb2,4,inact,3,0);
+    }
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* ddfilter() of constraints to fixed ambiguities (Ri=0) */
+void utest2(void)
+{
+    const int nb1[]={1},nb2[]={12};
+    const int inact[]={NPOS+4};
+    int i;
+    
+    srand(2);
+    for (i=0;i<20;i++) {
+        cmpupdate(nb1,1,inact,0,1);
+        cmpupdate(nb2,1,inact,1,1);
+    }
+    printf("%s utest2 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : ppp ambiguity resolution
+*
+* the static functions of ppp_ar.c are tested by including the source. the
+* measurements and the iono-free phase-bias states are simulated with known
+* integer ambiguities of L1 and L2.
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/ppp_ar.c"
+
+#define NSAT        5           /* number of satellites */
+
+static const int N1[NSAT]={12345,-2210,873,40012,-17};  /* L1 ambiguities */
+static const int N2[NSAT]={12340,-2199,880,39990,-31};  /* L2 ambiguities */
+static const double el[NSAT]={35.0,72.0,18.0,51.0,64.0}; /* elevation (deg) */
+
+static nav_t nav;
+
+/* uniform random number in [a,b) --------------------------------------------*/
+static double rnd(double a, double b)
+{
+    return a+(b-a)*rand()/((double)RAND_MAX+1.0);
+}
+/* simulate measurements of epoch --------------------------------------------*/
+static void simobs(obsd_t *obs, gtime_t time)
+{
+    double f1=FREQ1,f2=FREQ2,rho,ion;
+    int i;
+    
+    for (i=0;i<NSAT;i++) {
+        memset(obs+i,0,sizeof(obsd_t));
+        obs[i].time=time;
+        obs[i].sat=(uint8_t)satno(SYS_GPS,i+1);
+        obs[i].code[0]=CODE_L1C;
+        obs[i].code[1]=CODE_L2W;
+        rho=2.2E7+i*1.3E6+time.time%1000*0.7;
+        ion=2.0+i*0.5;
+        obs[i].P[0]=rho+ion+rnd(-0.1,0.1);
+        obs[i].P[1]=rho+ion*SQR(f1/f2)+rnd(-0.1,0.1);
+        obs[i].L[0]=(rho-ion)*f1/CLIGHT+N1[i];
+        obs[i].L[1]=(rho-ion*SQR(f1/f2))*f2/CLIGHT+N2[i];
+    }
+}
+/* average Melbourne-Wubbena combinations of epochs --------------------------*/
+static gtime_t average(rtk_t *rtk, gtime_t time, int nep, const int *exc)
+{
+    obsd_t obs[NSAT];
+    int i;
+    
+    for (i=0;i<nep;i++) {
+        time=timeadd(time,30.0);
+        simobs(obs,time);
+        average_mw(rtk,obs,NSAT,exc,&nav);
+    }
+    return time;
+}
+/* initialize rtk control of ppp ---------------------------------------------*/
+static void initppp(rtk_t *rtk)
+{
+    prcopt_t opt=prcopt_default;
+    
+    opt.mode=PMODE_PPP_KINEMA;
+    opt.nf=2;
+    opt.ionoopt=IONOOPT_IFLC;
+    opt.arppp=1;
+    rtkinit(rtk,&opt);
+}
+/* average_mw(), fix_wl() */
+void utest1(void)
+{
+    rtk_t rtk;
+    gtime_t time=gpst2time(2050,3600.0);
+    double Nw;
+    int i,exc[NSAT]={0};
+    
+    srand(1);
+    initppp(&rtk);
+    
+    time=average(&rtk,time,MIN_NEP_WL-1,exc);
+    assert(rtk.ambc[0].n[0]==MIN_NEP_WL-1);
+    assert(!fix_wl(&rtk,1,2,&Nw));
+    
+    time=average(&rtk,time,1,exc);
+    for (i=0;i<NSAT;i++) {
+        assert(rtk.ambc[i].n[0]==MIN_NEP_WL);
+        assert(fabs(rtk.ambc[i].LC[0]-(N1[i]-N2[i]))<0.1);
+    }
+    for (i=1;i<NSAT;i++) {
+        assert(fix_wl(&rtk,1,i+1,&Nw));
+        assert(Nw==(N1[i]-N2[i])-(N1[0]-N2[0]));
+    }
+    /* cycle slip, excluded satellite and data gap */
+    rtk.ssat[1].slip[1]=1;
+    exc[2]=1;
+    time=average(&rtk,time,1,exc);
+    assert(rtk.ambc[1].n[0]==1&&!fix_wl(&rtk,1,2,&Nw));
+    assert(rtk.ambc[2].n[0]==MIN_NEP_WL&&rtk.ambc[3].n[0]==MIN_NEP_WL+1);
+    rtk.ssat[1].slip[1]=0;
+    exc[2]=0;
+    time=average(&rtk,timeadd(time,MAX_GAP_WL),1,exc);
+    for (i=0;i<NSAT;i++) assert(rtk.ambc[i].n[0]==1);
+    
+    rtkfree(&rtk);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* sel_amb(), fix_amb() with narrow-lane offset of iono-free phase-bias */
+void utest2(void)
+{
+    rtk_t rtk;
+    sdamb_t amb[NSAT*NFREQ];
+    gtime_t time=gpst2time(2050,7200.0);
+    obsd_t obs[NSAT];
+    double f1=FREQ1,f2=FREQ2,azel[NSAT*2],B[NSAT],x[NSAT],x0[NSAT];
+    double P[NSAT*NSAT],Nw,e0,e1;
+    int i,j,k,na,ref=1,exc[NSAT]={0},*jx;
+    
+    srand(2);
+    initppp(&rtk);
+    jx=imat(rtk.nx,1);
+    for (i=0;i<rtk.nx;i++) jx[i]=-1;
+    for (i=0;i<NSAT;i++) {
+        j=satno(SYS_GPS,i+1);
+        nav.ssr[j-1].pbias[CODE_L1C-1]=0.1;
+        nav.ssr[j-1].pbias[CODE_L2W-1]=0.2;
+        rtk.ssat[j-1].vsat[0]=1;
+        jx[IB(j,0,&rtk.opt)]=i;
+        azel[i*2]=0.0;
+        azel[1+i*2]=el[i]*D2R;
+    
+        /* iono-free phase-bias with receiver bias (m) */
+        B[i]=(f1*N1[i]-f2*N2[i])*CLIGHT/(SQR(f1)-SQR(f2))+3.21;
+    }
+    time=average(&rtk,time,MIN_NEP_WL,exc);
+    simobs(obs,time);
+    
+    na=sel_amb(&rtk,obs,NSAT,exc,&nav,azel,jx,amb);
+    assert(na==NSAT-1);
+    for (k=0;k<na;k++) {
+        i=amb[k].sat2-1;
+        assert(amb[k].sat1==ref+1&&amb[k].f==0);
+        assert(k==0||amb[k].el<=amb[k-1].el);
+        assert(fabs(amb[k].lam-CLIGHT/(f1+f2))<1E-12);
+        Nw=(N1[i]-N2[i])-(N1[ref]-N2[ref]);
+        assert(fabs(amb[k].offset-CLIGHT*f2/(SQR(f1)-SQR(f2))*Nw)<1E-9);
+    
+        /* single-differenced phase-bias is integer narrow-lane plus offset */
+        Nw=(B[i]-B[ref]-amb[k].offset)/amb[k].lam;
+        assert(fabs(Nw-(N1[i]-N1[ref]))<1E-6);
+    }
+    /* float phase-biases between integers not fixed */
+    for (i=0;i<NSAT;i++) {
+        x[i]=B[i]+(i!=ref?0.5*CLIGHT/(f1+f2):0.0);
+        for (j=0;j<NSAT;j++) P[i+j*NSAT]=i==j?1E-6:0.0;
+    }
+    matcpy(x0,x,NSAT,1);
+    assert(!fix_amb(&rtk,amb,na,jx,NSAT,x,P));
+    for (i=0;i<NSAT;i++) assert(x[i]==x0[i]);
+    
+    /* fixed to the simulated ambiguities */
+    for (i=0;i<NSAT;i++) x0[i]=x[i]=B[i]+rnd(-0.01,0.01);
+    assert(fix_amb(&rtk,amb,na,jx,NSAT,x,P));
+    assert(rtk.sol.ratio>=rtk.opt.thresar[0]);
+    for (k=0,e0=e1=0.0;k<na;k++) {
+        i=amb[k].sat2-1;
+        Nw=(x[i]-x[ref]-amb[k].offset)/amb[k].lam;
+        assert(ROUND(Nw)==N1[i]-N1[ref]);
+        assert(rtk.ssat[i].fix[0]==2&&rtk.ssat[ref].fix[0]==2);
+        e0+=SQR((x0[i]-x0[ref])-(B[i]-B[ref]));
+        e1+=SQR((x [i]-x [ref])-(B[i]-B[ref]));
+    }
+    assert(e1<e0); /* constrained to fixed ambiguities */
+    free(jx);
+    rtkfree(&rtk);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* ppp_ar() enabled by option */
+void utest3(void)
+{
+    rtk_t rtk;
+    obsd_t obs[NSAT];
+    double azel[NSAT*2]={0},x[1],P[1];
+    int i,exc[NSAT]={0},*jx;
+    
+    initppp(&rtk);
+    jx=imat(rtk.nx,1);
+    for (i=0;i<rtk.nx;i++) jx[i]=-1;
+    simobs(obs,gpst2time(2050,0.0));
+    
+    rtk.opt.arppp=0;
+    assert(!ppp_ar(&rtk,obs,NSAT,exc,&nav,azel,jx,0,x,P));
+    assert(rtk.ambc[0].n[0]==0);
+    
+    rtk.opt.arppp=1;
+    assert(!ppp_ar(&rtk,obs,NSAT,exc,&nav,azel,jx,0,x,P));
+    assert(rtk.ambc[0].n[0]==1);
+    
+    free(jx);
+    rtkfree(&rtk);
+    printf("%s utest3 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    utest3();
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : save and load of rtk filter state
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include "../../src/rtklib.h"
+
+#define FILE_STATE  "t_rtksave.rtk"
+
+/* set test filter state -----------------------------------------------------*/
+static void setrtk(rtk_t *rtk, int seed)
+{
+    int i,j,f;
+    
+    rtk->sol.time=gpst2time(2050,1234.5+seed);
+    rtk->sol.stat=SOLQ_FIX;
+    rtk->sol.ns=(uint8_t)(10+seed);
+    rtk->sol.ratio=(float)(3.5+seed);
+    for (i=0;i<6;i++) {
+        rtk->sol.rr[i]=-2414266.9197*(i+1)+seed;
+        rtk->rb[i]=5386768.9868+i*0.25+seed;
+    }
+    rtk->tt=1.0+seed;
+    rtk->nfix=7+seed;
+    for (i=0;i<rtk->nx;i++) {
+        rtk->x[i]=i%5?(i+seed)*0.125:0.0;
+        for (j=0;j<rtk->nx;j++) rtk->P[i+j*rtk->nx]=i==j?i+1.0:1E-3*(i-j+seed);
+    }
+    for (i=0;i<rtk->na;i++) {
+        rtk->xa[i]=(i+seed)*0.5;
+        for (j=0;j<rtk->na;j++) rtk->Pa[i+j*rtk->na]=i==j?2.0:1E-4*(i+j);
+    }
+    for (i=0;i<MAXSAT;i++) {
+        rtk->ambc[i].n[0]=i%7+seed;
+        rtk->ambc[i].LC[0]=i*0.1;
+        rtk->ssat[i].sys=(uint8_t)satsys(i+1,NULL);
+        rtk->ssat[i].vs=(uint8_t)(i%2);
+        rtk->ssat[i].azel[1]=i*0.01;
+        for (f=0;f<NFREQ;f++) {
+            rtk->ssat[i].lock[f]=i+f+seed;
+            rtk->ssat[i].slip[f]=(uint8_t)((i+f)%3);
+            rtk->ssat[i].fix[f]=(uint8_t)((i+f)%4);
+        }
+    }
+}
+/* compare filter states -----------------------------------------------------*/
+static int eqrtk(const rtk_t *a, const rtk_t *b)
+{
+    return timediff(a->sol.time,b->sol.time)==0.0&&
+           !memcmp(a->sol.rr,b->sol.rr,sizeof(double)*6)&&
+           a->sol.stat==b->sol.stat&&a->sol.ns==b->sol.ns&&
+           a->sol.ratio==b->sol.ratio&&
+           !memcmp(a->rb,b->rb,sizeof(double)*6)&&a->tt==b->tt&&
+           a->nfix==b->nfix&&a->nx==b->nx&&a->na==b->na&&
+           !memcmp(a->x ,b->x ,sizeof(double)*a->nx)&&
+           !memcmp(a->P ,b->P ,sizeof(double)*a->nx*a->nx)&&
+           !memcmp(a->xa,b->xa,sizeof(double)*a->na)&&
+           !memcmp(a->Pa,b->Pa,sizeof(double)*a->na*a->na)&&
+           !memcmp(a->ambc,b->ambc,sizeof(ambc_t)*MAXSAT)&&
+           !memcmp(a->ssat,b->ssat,sizeof(ssat_t)*MAXSAT);
+}
+/* rtksave(), rtkload() round trip */
+void utest1(void)
+{
+    prcopt_t opt=prcopt_default;
+    rtk_t rtk1,rtk2;
+    FILE *fp;
+    
+    opt.mode=PMODE_KINEMA;
+    opt.nf=2;
+    rtkinit(&rtk1,&opt);
+    rtkinit(&rtk2,&opt);
+    setrtk(&rtk1,1);
+    setrtk(&rtk2,2);
+    assert(!eqrtk(&rtk1,&rtk2));
+    
+    assert((fp=fopen(FILE_STATE,"wb")));
+    assert(rtksave(&rtk1,fp));
+    assert(rtksave(&rtk2,fp)); /* second state in the same file */
+    fclose(fp);
+    
+    setrtk(&rtk2,3);
+    assert((fp=fopen(FILE_STATE,"rb")));
+    assert(rtkload(&rtk2,fp));
+    assert(eqrtk(&rtk1,&rtk2));
+    setrtk(&rtk1,2);
+    assert(rtkload(&rtk2,fp));
+    assert(eqrtk(&rtk1,&rtk2));
+    assert(!rtkload(&rtk2,fp)); /* end of file */
+    assert(eqrtk(&rtk1,&rtk2));
+    fclose(fp);
+    
+    rtkfree(&rtk1);
+    rtkfree(&rtk2);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* rtkload() of other options or truncated state keeps the filter state */
+void utest2(void)
+{
+    prcopt_t opt=prcopt_default;
+    rtk_t rtk1,rtk2;
+    FILE *fp;
+    long size;
+    
+    opt.mode=PMODE_KINEMA;
+    opt.nf=2;
+    rtkinit(&rtk1,&opt);
+    setrtk(&rtk1,1);
+    assert((fp=fopen(FILE_STATE,"wb")));
+    assert(rtksave(&rtk1,fp));
+    size=ftell(fp);
+    fclose(fp);
+    
+    /* other number of states */
+    opt.nf=1;
+    rtkinit(&rtk2,&opt);
+    setrtk(&rtk2,2);
+    assert((fp=fopen(FILE_STATE,"rb")));
+    assert(!rtkload(&rtk2,fp));
+    fclose(fp);
+    rtkfree(&rtk2);
+    
+    /* truncated state */
+    opt.nf=2;
+    rtkinit(&rtk2,&opt);
+    setrtk(&rtk2,2);
+    assert(!truncate(FILE_STATE,size-1));
+    assert((fp=fopen(FILE_STATE,"rb")));
+    assert(!rtkload(&rtk2,fp));
+    fclose(fp);
+    setrtk(&rtk1,2);
+    assert(eqrtk(&rtk1,&rtk2));
+    
+    rtkfree(&rtk1);
+    rtkfree(&rtk2);
+    remove(FILE_STATE);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : shared memory ring of measurement epochs
+*
+* the epochs written by shmpub.cpp are read by the functions of the reader in
+* shmring.h.
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/shmpub.h"
+
+#define RING        "/t_shmring"
+#define NSLOT       8
+
+/* time of epoch n -----------------------------------------------------------*/
+static gtime_t eptime(int n)
+{
+    return gpst2time(2050,100.0+n*0.1);
+}
+/* gps seconds of epoch n ----------------------------------------------------*/
+static double epsec(int n)
+{
+    double tow;
+    int week;
+    
+    tow=time2gpst(eptime(n),&week);
+    return tow+week*604800.0;
+}
+/* write measurements and position of epoch n --------------------------------*/
+static void putepoch(shmpub_t *w, int n, const char *rov)
+{
+    gnss_msgs::GNSS_Raw_Array raw;
+    sensor_msgs::NavSatFix fix;
+    int i;
+    
+    for (i=0;i<=n%5;i++) {
+        gnss_msgs::GNSS_Raw r;
+        r.prn_satellites_index=i+1;
+        r.pseudorange=2E7+n*10.0+i;
+        r.sat_system="GPS";
+        raw.GNSS_Raws.push_back(r);
+    }
+    fix.latitude=22.0+n*1E-6;
+    fix.longitude=114.0;
+    fix.altitude=n;
+    shmpubraw(w,eptime(n),rov,0,raw);
+    shmpubfix(w,eptime(n),rov,0,fix);
+}
+/* check epoch n of slot -----------------------------------------------------*/
+static int cmpepoch(const shmr_epoch_t *ep, int n, const char *rov)
+{
+    return fabs(ep->time-epsec(n))<1E-6&&ep->nraw==(uint32_t)(n%5+1)&&
+           ep->raw[n%5].pseudorange==2E7+n*10.0+n%5&&
+           ep->fix.altitude==n&&ep->rover==shmrrovid(rov)&&
+           (ep->flag&(SHMR_RAW|SHMR_FIX))==(SHMR_RAW|SHMR_FIX);
+}
+/* shmrget(), shmrcheck() and shmrcopy() under overwrite */
+void utest1(void)
+{
+    static shmr_epoch_t ep;
+    const shmr_epoch_t *p,*q;
+    shmpub_t *w;
+    shmr_t r;
+    int n;
+    
+    assert((w=shmpubopen(RING,NSLOT)));
+    assert(shmrattach(&r,RING));
+    assert(r.hdr->nslot==NSLOT&&shmrhead(&r)==0&&!shmrclosed(&r));
+    
+    /* open slot not complete */
+    putepoch(w,0,"");
+    assert(!shmrget(&r,0));
+    assert(shmrcopy(&r,0,&ep)==0);
+    
+    for (n=1;n<NSLOT;n++) putepoch(w,n,"");
+    shmpubcommit(w);
+    assert(shmrhead(&r)==NSLOT);
+    
+    assert((p=shmrget(&r,0)));
+    assert(cmpepoch(p,0,"")&&shmrcheck(p,0));
+    assert((q=shmrget(&r,NSLOT-1)));
+    assert(cmpepoch(q,NSLOT-1,"")&&shmrcheck(q,NSLOT-1));
+    assert(shmrcopy(&r,3,&ep)==1&&cmpepoch(&ep,3,""));
+    
+    /* epoch 0 being overwritten by epoch NSLOT */
+    putepoch(w,NSLOT,"");
+    assert(!shmrcheck(p,0));
+    assert(!shmrget(&r,0)&&!shmrget(&r,NSLOT));
+    assert(shmrcopy(&r,0,&ep)==-1);
+    assert(shmrcopy(&r,NSLOT,&ep)==0);
+    assert(shmrcheck(q,NSLOT-1));
+    
+    /* epoch 0 overwritten */
+    shmpubcommit(w);
+    assert(!shmrcheck(p,0)&&!shmrget(&r,0));
+    assert((p=shmrget(&r,NSLOT))&&cmpepoch(p,NSLOT,""));
+    assert(shmrcopy(&r,0,&ep)==-1);
+    
+    /* the writer NSLOT epochs ahead */
+    for (n=NSLOT+1;n<3*NSLOT;n++) putepoch(w,n,"");
+    shmpubclose(w);
+    assert(shmrclosed(&r)&&shmrhead(&r)==3*NSLOT);
+    for (n=0;n<3*NSLOT;n++) {
+        if (n<2*NSLOT) {
+            assert(!shmrget(&r,n)&&shmrcopy(&r,n,&ep)==-1);
+            continue;
+        }
+        assert((p=shmrget(&r,n))&&cmpepoch(p,n,"")&&shmrcheck(p,n));
+        assert(shmrcopy(&r,n,&ep)==1&&cmpepoch(&ep,n,""));
+    }
+    shmrdetach(&r);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* combined solutions added to slots already read */
+void utest2(void)
+{
+    static shmr_epoch_t ep;
+    const shmr_epoch_t *p[NSLOT];
+    sensor_msgs::NavSatFix fix;
+    shmpub_t *w;
+    shmr_t r;
+    int n;
+    
+    assert((w=shmpubopen(RING,NSLOT)));
+    assert(shmrattach(&r,RING));
+    
+    for (n=0;n<NSLOT;n++) putepoch(w,n,"");
+    shmpubcommit(w);
+    for (n=0;n<NSLOT;n++) {
+        assert((p[n]=shmrget(&r,n)));
+        assert(!(shmrflag(p[n])&SHMR_SMOOTH));
+    }
+    /* combined solutions of epochs 2,...,NSLOT-1 after the forward pass */
+    for (n=2;n<NSLOT;n++) {
+        fix.altitude=100.0+n;
+        shmpubfix(w,eptime(n),"",1,fix);
+    }
+    assert(shmrhead(&r)==NSLOT); /* no new slot */
+    for (n=0;n<NSLOT;n++) {
+        assert(shmrcheck(p[n],n)); /* sequence counter not changed */
+        assert(!(shmrflag(p[n])&SHMR_SMOOTH)==(n<2));
+        assert(n<2||p[n]->smoothed.altitude==100.0+n);
+        assert(shmrcopy(&r,n,&ep)==1&&cmpepoch(&ep,n,""));
+        assert(!(ep.flag&SHMR_SMOOTH)==(n<2));
+    }
+    /* second combined solution of an epoch to a new slot */
+    fix.altitude=200.0;
+    shmpubfix(w,eptime(3),"",1,fix);
+    shmpubcommit(w);
+    assert(shmrhead(&r)==NSLOT+1);
+    assert(shmrcopy(&r,NSLOT,&ep)==1&&ep.flag==SHMR_SMOOTH);
+    assert(fabs(ep.time-epsec(3))<1E-6&&ep.smoothed.altitude==200.0);
+    assert(shmrcheck(p[1],1)&&!shmrcheck(p[0],0));
+    
+    shmpubclose(w);
+    shmrdetach(&r);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* epochs of multiple rovers */
+void utest3(void)
+{
+    static shmr_epoch_t ep;
+    sensor_msgs::NavSatFix fix;
+    shmpub_t *w;
+    shmr_t r;
+    int n;
+    
+    assert(shmrrovid("")==0&&shmrrovid("r1")!=shmrrovid("r2"));
+    
+    assert((w=shmpubopen(RING,NSLOT)));
+    assert(shmrattach(&r,RING));
+    
+    for (n=0;n<3;n++) {
+        putepoch(w,n,"r1");
+        putepoch(w,n,"r2");
+    }
+    fix.altitude=300.0;
+    shmpubfix(w,eptime(1),"r2",1,fix);
+    shmpubclose(w);
+    
+    assert(shmrhead(&r)==6);
+    for (n=0;n<6;n++) {
+        assert(shmrcopy(&r,n,&ep)==1);
+        assert(cmpepoch(&ep,n/2,n%2?"r2":"r1"));
+        assert(!(ep.flag&SHMR_SMOOTH)==(n!=3));
+    }
+    assert(shmrcopy(&r,3,&ep)==1&&ep.smoothed.altitude==300.0);
+    shmrdetach(&r);
+    shm_unlink(RING);
+    printf("%s utest3 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    utest3();
+    return 0;
+}
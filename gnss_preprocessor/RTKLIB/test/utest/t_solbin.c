@@ -0,0 +1,287 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : binary solution output
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/rtklib.h"
+
+#define FILE_BIN    "t_solbin.bin"
+#define FILE_TEXT   "t_solbin.pos"
+#define FILE_CONV   "t_solbin.conv"
+#define FILE_MERGE  "t_solbin.mrg"
+#define FILE_STAT   "t_solbin.stat"
+#define NSOL        10000
+#define NSPAN       3           /* number of merged spans */
+#define LSPAN       300         /* epochs of span */
+#define NWARM       50          /* epochs of warm-up before span */
+#define NOVER       20          /* epochs of overlap with following span */
+
+static const double rb[3]={-2414266.9197,5386768.9868,2407460.0314};
+
+/* set test solution */
+static void setsol(sol_t *sol, int i)
+{
+    int j;
+    
+    memset(sol,0,sizeof(sol_t));
+    sol->time=gpst2time(2050,i*0.1);
+    for (j=0;j<3;j++) {
+        sol->rr[j]=rb[j]+(j+1)*0.123456789*(i%100)+i*1E-4;
+        sol->rr[j+3]=(i%7)*0.01*(j+1);
+        sol->qr[j]=(float)(1E-4*(j+1)+i*1E-7);
+        sol->qr[j+3]=(float)(-1E-5*(j+1));
+        sol->qv[j]=(float)(1E-3*(j+1));
+        sol->dtr[j]=i*1E-9*(j+1);
+    }
+    sol->type=0;
+    sol->stat=i%13==0?SOLQ_NONE:(i%3==0?SOLQ_FIX:SOLQ_FLOAT);
+    sol->ns=(uint8_t)(5+i%20);
+    sol->age=(float)(i%30*0.1);
+    sol->ratio=(float)(i%50*0.37);
+    sol->thres=3.0f;
+}
+/* compare solutions */
+static int eqsol(const sol_t *sol1, const sol_t *sol2)
+{
+    int j;
+    
+    if (sol1->time.time!=sol2->time.time||sol1->time.sec!=sol2->time.sec) {
+        return 0;
+    }
+    for (j=0;j<6;j++) {
+        if (sol1->rr[j]!=sol2->rr[j]||sol1->qr[j]!=sol2->qr[j]||
+            sol1->qv[j]!=sol2->qv[j]||sol1->dtr[j]!=sol2->dtr[j]) return 0;
+    }
+    return sol1->type==sol2->type&&sol1->stat==sol2->stat&&
+           sol1->ns==sol2->ns&&sol1->age==sol2->age&&
+           sol1->ratio==sol2->ratio&&sol1->thres==sol2->thres;
+}
+/* compare files */
+static int cmpfile(const char *file1, const char *file2)
+{
+    FILE *fp1,*fp2;
+    int c1,c2;
+    
+    if (!(fp1=fopen(file1,"rb"))) return 0;
+    if (!(fp2=fopen(file2,"rb"))) {fclose(fp1); return 0;}
+    do {
+        c1=fgetc(fp1); c2=fgetc(fp2);
+    } while (c1==c2&&c1!=EOF);
+    fclose(fp1); fclose(fp2);
+    return c1==c2;
+}
+/* span of merged output of epoch i (-1: out of spans) */
+static int spanof(int i)
+{
+    int k;
+    
+    for (k=0;k<NSPAN;k++) {
+        if (i>=NWARM+LSPAN*k&&i<NWARM+LSPAN*(k+1)+(k<NSPAN-1?NOVER:0)) {
+            return k;
+        }
+    }
+    return -1;
+}
+/* write files of spans of merge and set output spans */
+static void writespans(char **files, gtime_t *ts, gtime_t *te, int type)
+{
+    const ssat_t ssat0={0};
+    ssat_t ssat=ssat0;
+    sol_t sol;
+    FILE *fp;
+    uint8_t buff[MAXSOLMSG+1];
+    int i,k,n;
+    
+    for (k=0;k<NSPAN;k++) {
+        sprintf(files[k],"t_solbin_%d.bin",k);
+        assert((fp=fopen(files[k],"wb")));
+        fwrite(buff,outsolbinh(buff,type),1,fp);
+        
+        /* warm-up, output span and overlap with following span */
+        for (i=LSPAN*k;i<NWARM+LSPAN*(k+1)+NOVER;i++) {
+            setsol(&sol,i);
+            sol.ns=(uint8_t)k;
+            if (type==SOLB_SOL) {
+                fwrite(buff,outsolbin(buff,&sol,rb),1,fp);
+                continue;
+            }
+            n=outstatbin(buff,sol.time,"$POS\n",5);
+            fwrite(buff,n,1,fp);
+            ssat.resp[0]=k;
+            ssat.azel[1]=i*1E-3;
+            fwrite(buff,outssatbin(buff,1,0,&ssat),1,fp);
+            fwrite(buff,outssatbin(buff,2,0,&ssat),1,fp);
+        }
+        fclose(fp);
+        setsol(&sol,NWARM+LSPAN*k);
+        ts[k]=sol.time;
+        setsol(&sol,NWARM+LSPAN*(k+1)+(k<NSPAN-1?NOVER:0));
+        te[k]=sol.time;
+    }
+}
+/* outsolbin(), insolbin() */
+void utest1(void)
+{
+    sol_t sol1,sol2;
+    uint8_t buff[MAXSOLMSG+1];
+    double rb2[3];
+    int i,n;
+    
+    for (i=1;i<100;i++) {
+        setsol(&sol1,i);
+        n=outsolbin(buff,&sol1,rb);
+        assert(n>0&&n<=MAXSOLMSG);
+        assert(insolbin(buff,&sol2,rb2)==n);
+        assert(eqsol(&sol1,&sol2));
+        assert(rb2[0]==rb[0]&&rb2[1]==rb[1]&&rb2[2]==rb[2]);
+    }
+    buff[0]^=0xFF; /* sync error */
+    assert(insolbin(buff,&sol2,rb2)==0);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* binary solution file written by binary writer and read by readsol() */
+void utest2(void)
+{
+    solopt_t opt=solopt_default;
+    solbuf_t solbuf;
+    sol_t sol;
+    binw_t w;
+    FILE *fp;
+    uint8_t buff[MAXSOLMSG+1];
+    char *files[]={FILE_BIN};
+    int i,n,nsol=0;
+    
+    opt.posf=SOLF_BIN;
+    assert((fp=fopen(FILE_BIN,"wb")));
+    assert(binwopen(&w,fp,4096)); /* small buffers to swap often */
+    
+    n=outsolheads(buff,&opt);
+    assert(binwrite(&w,buff,n));
+    for (i=0;i<NSOL;i++) {
+        setsol(&sol,i);
+        if (!(n=outsols(buff,&sol,rb,&opt))) continue;
+        assert(binwrite(&w,buff,n));
+        nsol++;
+    }
+    binwclose(&w);
+    fclose(fp);
+    
+    assert(readsol(files,1,&solbuf));
+    assert(solbuf.n==nsol);
+    assert(solbuf.rb[0]==rb[0]&&solbuf.rb[1]==rb[1]&&solbuf.rb[2]==rb[2]);
+    for (i=n=0;i<NSOL;i++) {
+        setsol(&sol,i);
+        if (sol.stat==SOLQ_NONE) continue;
+        assert(eqsol(&sol,solbuf.data+n++));
+    }
+    freesolbuf(&solbuf);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* convsolbin() compared with text solution output */
+void utest3(void)
+{
+    solopt_t opt=solopt_default;
+    sol_t sol;
+    FILE *fp;
+    int i;
+    
+    assert((fp=fopen(FILE_TEXT,"wb")));
+    outsolhead(fp,&opt);
+    for (i=0;i<NSOL;i++) {
+        setsol(&sol,i);
+        outsol(fp,&sol,rb,&opt);
+    }
+    fclose(fp);
+    
+    assert(convsolbin(FILE_BIN,FILE_CONV,&opt));
+    assert(cmpfile(FILE_TEXT,FILE_CONV));
+    
+    remove(FILE_BIN); remove(FILE_TEXT); remove(FILE_CONV);
+    printf("%s utest3 : OK\n",__FILE__);
+}
+/* mergesolbin() of solution files with warm-up and overlaps */
+void utest4(void)
+{
+    gtime_t ts[NSPAN],te[NSPAN];
+    sol_t sol1,sol2;
+    FILE *fp;
+    uint8_t buff[MAXSOLMSG+1];
+    char file[NSPAN][32],*files[NSPAN];
+    double rb2[3];
+    int i,k;
+    
+    for (k=0;k<NSPAN;k++) files[k]=file[k];
+    writespans(files,ts,te,SOLB_SOL);
+    
+    assert(mergesolbin(files,ts,te,NSPAN,FILE_MERGE)==NSPAN*LSPAN);
+    
+    assert((fp=fopen(FILE_MERGE,"rb")));
+    assert(fread(buff,8,1,fp)==1&&!memcmp(buff,"RTKB",4)&&buff[5]==SOLB_SOL);
+    for (i=0;i<NWARM+LSPAN*NSPAN+NOVER;i++) {
+        if ((k=spanof(i))<0) continue;
+        assert(fread(buff,4+200,1,fp)==1);
+        assert(insolbin(buff,&sol2,rb2)==4+200);
+        setsol(&sol1,i);
+        assert(sol2.ns==k); /* epochs of overlap from preceding file */
+        sol1.ns=sol2.ns;
+        assert(eqsol(&sol1,&sol2));
+    }
+    assert(fread(buff,1,1,fp)==0);
+    fclose(fp);
+    
+    /* missing file */
+    remove(files[1]);
+    assert(mergesolbin(files,ts,te,NSPAN,FILE_MERGE)==-1);
+    
+    for (k=0;k<NSPAN;k++) remove(files[k]);
+    remove(FILE_MERGE);
+    printf("%s utest4 : OK\n",__FILE__);
+}
+/* mergesolbin() of solution status files */
+void utest5(void)
+{
+    gtime_t ts[NSPAN],te[NSPAN];
+    solstatbuf_t statbuf={0};
+    sol_t sol;
+    char file[NSPAN][32],*files[NSPAN],*mfile[]={FILE_STAT};
+    int i,j,k,m;
+    
+    for (k=0;k<NSPAN;k++) files[k]=file[k];
+    writespans(files,ts,te,SOLB_STAT);
+    
+    /* satellite status records follow the solution status records */
+    assert(mergesolbin(files,ts,te,NSPAN,FILE_STAT)==NSPAN*LSPAN*3);
+    
+    assert(readsolstat(mfile,1,&statbuf));
+    assert(statbuf.n==NSPAN*LSPAN*2);
+    for (i=NWARM,j=0;i<NWARM+LSPAN*NSPAN;i++,j+=2) {
+        setsol(&sol,i);
+        k=spanof(i);
+        for (m=0;m<2;m++) {
+            assert(timediff(statbuf.data[j+m].time,sol.time)==0.0);
+            assert(statbuf.data[j+m].resp==(float)k);
+        }
+        assert(statbuf.data[j].sat+statbuf.data[j+1].sat==3);
+    }
+    freesolstatbuf(&statbuf);
+    
+    /* files of other types */
+    writespans(files,ts,te,SOLB_SOL);
+    files[0]=mfile[0];
+    assert(mergesolbin(files,ts,te,2,FILE_CONV)==-1);
+    files[0]=file[0];
+    
+    for (k=0;k<NSPAN;k++) remove(files[k]);
+    remove(FILE_STAT); remove(FILE_CONV);
+    printf("%s utest5 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    utest3();
+    utest4();
+    utest5();
+    return 0;
+}
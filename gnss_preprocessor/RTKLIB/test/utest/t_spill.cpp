@@ -0,0 +1,278 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : spilled solutions of combined mode
+*
+* the static functions of postpos.cpp are tested by including the source.
+* combres() is compared with the previous merge of forward/backward solutions
+* held in memory.
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/postpos.cpp"
+
+#define FILE_SPILL  "t_spill.fwd"
+#define FILE_COMB   "t_spill.comb"
+#define FILE_EXP    "t_spill.exp"
+#define NSOL        12000       /* over two windows of spilled solutions */
+
+static const double rb0[3]={-2414266.9197,5386768.9868,2407460.0314};
+
+/* set test solution of forward (dir=0) or backward (dir=1) pass -------------*/
+static void setsol(sol_t *sol, double *rb, int i, int dir)
+{
+    int j;
+    
+    memset(sol,0,sizeof(sol_t));
+    sol->time=gpst2time(2050,i*0.1);
+    for (j=0;j<3;j++) {
+        sol->rr[j]=rb0[j]+(j+1)*0.123456789*(i%100)+(dir?1E-3:-1E-3)*(i%7);
+        sol->rr[j+3]=(i%7)*0.01*(j+1)+dir*1E-3;
+        sol->qr[j]=(float)(1E-4*(j+1)*(1+dir)+i*1E-8);
+        sol->qr[j+3]=(float)(-1E-5*(j+1));
+        sol->qv[j]=(float)(1E-3*(j+1)*(2-dir));
+        sol->qv[j+3]=(float)(1E-5*(j+1));
+        rb[j]=rb0[j]+dir*0.5;
+    }
+    sol->stat=i%11==0?SOLQ_SINGLE:(i%3==dir?SOLQ_FLOAT:SOLQ_FIX);
+    if (i%97==0) sol->rr[0]+=1.0; /* fixed solutions of failed validation */
+    sol->ns=(uint8_t)(5+i%20);
+    sol->ratio=(float)(i%50*0.37);
+    sol->thres=3.0f;
+}
+/* epochs without solution of forward/backward pass --------------------------*/
+static int nosol(int i, int dir)
+{
+    return dir?i%23==7:i%17==5;
+}
+/* compare solutions ---------------------------------------------------------*/
+static int eqsol(const sol_t *sol1, const sol_t *sol2)
+{
+    int j;
+    
+    if (sol1->time.time!=sol2->time.time||sol1->time.sec!=sol2->time.sec) {
+        return 0;
+    }
+    for (j=0;j<6;j++) {
+        if (sol1->rr[j]!=sol2->rr[j]||sol1->qr[j]!=sol2->qr[j]||
+            sol1->qv[j]!=sol2->qv[j]) return 0;
+    }
+    return sol1->stat==sol2->stat&&sol1->ns==sol2->ns&&
+           sol1->ratio==sol2->ratio&&sol1->thres==sol2->thres;
+}
+/* compare files -------------------------------------------------------------*/
+static int cmpfile(const char *file1, const char *file2)
+{
+    FILE *fp1,*fp2;
+    int c1,c2;
+    
+    if (!(fp1=fopen(file1,"rb"))) return 0;
+    if (!(fp2=fopen(file2,"rb"))) {fclose(fp1); return 0;}
+    do {
+        c1=fgetc(fp1); c2=fgetc(fp2);
+    } while (c1==c2&&c1!=EOF);
+    fclose(fp1); fclose(fp2);
+    return c1==c2;
+}
+/* previous combres() of solutions in memory ---------------------------------*/
+static void old_combres(FILE *fp, const prcopt_t *popt, const solopt_t *sopt,
+                        const sol_t *solf, const double *rbf, int isolf,
+                        const sol_t *solb, const double *rbb, int isolb)
+{
+    sol_t sols={{0}};
+    double tt,Qf[9],Qb[9],Qs[9],rbs[3]={0},rr_f[3],rr_b[3],rr_s[3];
+    int i,j,k;
+    
+    for (i=0,j=isolb-1;i<isolf&&j>=0;i++,j--) {
+    
+        if ((tt=timediff(solf[i].time,solb[j].time))<-DTTOL) {
+            sols=solf[i];
+            for (k=0;k<3;k++) rbs[k]=rbf[k+i*3];
+            j++;
+        }
+        else if (tt>DTTOL) {
+            sols=solb[j];
+            for (k=0;k<3;k++) rbs[k]=rbb[k+j*3];
+            i--;
+        }
+        else if (solf[i].stat<solb[j].stat) {
+            sols=solf[i];
+            for (k=0;k<3;k++) rbs[k]=rbf[k+i*3];
+        }
+        else if (solf[i].stat>solb[j].stat) {
+            sols=solb[j];
+            for (k=0;k<3;k++) rbs[k]=rbb[k+j*3];
+        }
+        else {
+            sols=solf[i];
+            sols.time=timeadd(sols.time,-tt/2.0);
+    
+            if ((popt->mode==PMODE_KINEMA||popt->mode==PMODE_MOVEB)&&
+                sols.stat==SOLQ_FIX) {
+    
+                /* degrade fix to float if validation failed */
+                if (!valcomb(solf+i,solb+j)) sols.stat=SOLQ_FLOAT;
+            }
+            for (k=0;k<3;k++) {
+                Qf[k+k*3]=solf[i].qr[k];
+                Qb[k+k*3]=solb[j].qr[k];
+            }
+            Qf[1]=Qf[3]=solf[i].qr[3];
+            Qf[5]=Qf[7]=solf[i].qr[4];
+            Qf[2]=Qf[6]=solf[i].qr[5];
+            Qb[1]=Qb[3]=solb[j].qr[3];
+            Qb[5]=Qb[7]=solb[j].qr[4];
+            Qb[2]=Qb[6]=solb[j].qr[5];
+    
+            if (popt->mode==PMODE_MOVEB) {
+                for (k=0;k<3;k++) rr_f[k]=solf[i].rr[k]-rbf[k+i*3];
+                for (k=0;k<3;k++) rr_b[k]=solb[j].rr[k]-rbb[k+j*3];
+                if (smoother(rr_f,Qf,rr_b,Qb,3,rr_s,Qs)) continue;
+                for (k=0;k<3;k++) sols.rr[k]=rbs[k]+rr_s[k];
+            }
+            else {
+                if (smoother(solf[i].rr,Qf,solb[j].rr,Qb,3,sols.rr,Qs)) {
+                    continue;
+                }
+            }
+            sols.qr[0]=(float)Qs[0];
+            sols.qr[1]=(float)Qs[4];
+            sols.qr[2]=(float)Qs[8];
+            sols.qr[3]=(float)Qs[1];
+            sols.qr[4]=(float)Qs[5];
+            sols.qr[5]=(float)Qs[2];
+    
+            /* smoother for velocity solution */
+            if (popt->dynamics) {
+                for (k=0;k<3;k++) {
+                    Qf[k+k*3]=solf[i].qv[k];
+                    Qb[k+k*3]=solb[j].qv[k];
+                }
+                Qf[1]=Qf[3]=solf[i].qv[3];
+                Qf[5]=Qf[7]=solf[i].qv[4];
+                Qf[2]=Qf[6]=solf[i].qv[5];
+                Qb[1]=Qb[3]=solb[j].qv[3];
+                Qb[5]=Qb[7]=solb[j].qv[4];
+                Qb[2]=Qb[6]=solb[j].qv[5];
+                if (smoother(solf[i].rr+3,Qf,solb[j].rr+3,Qb,3,sols.rr+3,
+                             Qs)) continue;
+                sols.qv[0]=(float)Qs[0];
+                sols.qv[1]=(float)Qs[4];
+                sols.qv[2]=(float)Qs[8];
+                sols.qv[3]=(float)Qs[1];
+                sols.qv[4]=(float)Qs[5];
+                sols.qv[5]=(float)Qs[2];
+            }
+        }
+        outsol(fp,&sols,rbs,sopt);
+    }
+}
+/* spillsol(), spillget() */
+void utest1(void)
+{
+    spill_t sp;
+    sol_t sol1,sol2;
+    double rb1[3],rb2[3];
+    int i;
+    
+    assert(spillopen(&sp,"",0));
+    for (i=0;i<NSOL;i++) {
+        setsol(&sol1,rb1,i,0);
+        assert(spillsol(&sp,&sol1,rb1));
+    }
+    assert(sp.n==NSOL);
+    
+    /* forward, backward and across windows */
+    for (i=0;i<NSOL;i++) {
+        setsol(&sol1,rb1,i,0);
+        assert(spillget(&sp,i,&sol2,rb2));
+        assert(eqsol(&sol1,&sol2)&&!memcmp(rb1,rb2,sizeof(rb1)));
+    }
+    for (i=NSOL-1;i>=0;i-=7) {
+        setsol(&sol1,rb1,i,0);
+        assert(spillget(&sp,i,&sol2,rb2)&&eqsol(&sol1,&sol2));
+    }
+    for (i=0;i<NSOL;i+=NSOL/3-1) {
+        setsol(&sol1,rb1,NSOL-1-i,0);
+        assert(spillget(&sp,NSOL-1-i,&sol2,rb2)&&eqsol(&sol1,&sol2));
+        setsol(&sol1,rb1,i,0);
+        assert(spillget(&sp,i,&sol2,rb2)&&eqsol(&sol1,&sol2));
+    }
+    assert(!spillget(&sp,-1,&sol2,rb2)&&!spillget(&sp,NSOL,&sol2,rb2));
+    spillclose(&sp);
+    
+    /* named file truncated on resume */
+    assert(spillopen(&sp,FILE_SPILL,0));
+    for (i=0;i<100;i++) {
+        setsol(&sol1,rb1,i,0);
+        assert(spillsol(&sp,&sol1,rb1));
+    }
+    spillclose(&sp);
+    assert(spillopen(&sp,FILE_SPILL,60)&&sp.n==60);
+    for (i=60;i<100;i++) {
+        setsol(&sol1,rb1,i,1);
+        assert(spillsol(&sp,&sol1,rb1));
+    }
+    for (i=0;i<100;i++) {
+        setsol(&sol1,rb1,i,i<60?0:1);
+        assert(spillget(&sp,i,&sol2,rb2)&&eqsol(&sol1,&sol2));
+    }
+    spillclose(&sp);
+    remove(FILE_SPILL);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* combres() of spilled solutions compared with merge in memory */
+void utest2(void)
+{
+    prcopt_t popt=prcopt_default;
+    solopt_t sopt=solopt_default;
+    sol_t *solf,*solb;
+    double *rbf,*rbb;
+    FILE *fp;
+    int i,nf=0,nb=0;
+    
+    popt.mode=PMODE_KINEMA;
+    popt.dynamics=1;
+    sopt.posf=SOLF_BIN;
+    
+    solf=(sol_t *)malloc(sizeof(sol_t)*NSOL);
+    solb=(sol_t *)malloc(sizeof(sol_t)*NSOL);
+    rbf=(double *)malloc(sizeof(double)*3*NSOL);
+    rbb=(double *)malloc(sizeof(double)*3*NSOL);
+    assert(solf&&solb&&rbf&&rbb);
+    assert(spillopen(&spf,"",0)&&spillopen(&spb,"",0));
+    
+    for (i=0;i<NSOL;i++) { /* forward pass */
+        if (nosol(i,0)) continue;
+        setsol(solf+nf,rbf+nf*3,i,0);
+        assert(spillsol(&spf,solf+nf,rbf+nf*3));
+        nf++;
+    }
+    for (i=NSOL-1;i>=0;i--) { /* backward pass */
+        if (nosol(i,1)) continue;
+        setsol(solb+nb,rbb+nb*3,i,1);
+        assert(spillsol(&spb,solb+nb,rbb+nb*3));
+        nb++;
+    }
+    assert((fp=fopen(FILE_EXP,"wb")));
+    old_combres(fp,&popt,&sopt,solf,rbf,nf,solb,rbb,nb);
+    fclose(fp);
+    
+    assert((fp=fopen(FILE_COMB,"wb")));
+    combres(fp,&popt,&sopt);
+    assert(ftell(fp)>(long)NSOL*100); /* merged and separate solutions */
+    fclose(fp);
+    spillclose(&spf);
+    spillclose(&spb);
+    
+    assert(cmpfile(FILE_COMB,FILE_EXP));
+    
+    free(solf); free(solb); free(rbf); free(rbb);
+    remove(FILE_COMB); remove(FILE_EXP);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : integer nanosecond time
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/rtklib.h"
+
+static const double leapep[][7]={ /* start of leap seconds (utc), utc-gpst */
+    {2017,1,1,0,0,0,-18},
+    {2015,7,1,0,0,0,-17},
+    {2012,7,1,0,0,0,-16},
+    {2009,1,1,0,0,0,-15},
+    {2006,1,1,0,0,0,-14},
+    {1999,1,1,0,0,0,-13}
+};
+/* time2ns(), ns2time() */
+void utest1(void)
+{
+    double ep[]={2019,4,28,12,44,9.1234567891};
+    gtime_t t,u;
+    gtimens_t ns;
+    int i;
+    
+    t=epoch2time(ep);
+    ns=time2ns(t);
+    assert(ns==1556455449123456789LL);
+    u=ns2time(ns);
+    assert(u.time==t.time&&fabs(u.sec-t.sec)<1E-9);
+    
+    for (i=0;i<1000000;i++) {
+        ns=(gtimens_t)(300000000+i*1234)*NS_SEC+(gtimens_t)i*999983%NS_SEC;
+        assert(time2ns(ns2time(ns))==ns);
+    }
+    /* before 1970 */
+    ns=-1500000001LL;
+    u=ns2time(ns);
+    assert(u.time==-2&&fabs(u.sec-0.499999999)<1E-12);
+    assert(time2ns(u)==ns);
+    
+    /* sub-ns rounding and carry to next second */
+    t.time=1000; t.sec=0.9999999996;
+    assert(time2ns(t)==1001LL*NS_SEC);
+    
+    assert(NSADD(ns,1.5)==ns+1500000000LL);
+    assert(NSADD(ns,-1E-9)==ns-1);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* gpst2utcns(), utc2gpstns() across leap seconds */
+void utest2(void)
+{
+    gtimens_t tu,tg,ts;
+    gtime_t t;
+    int i,n;
+    
+    for (i=0;i<(int)(sizeof(leapep)/sizeof(*leapep));i++) {
+        tu=time2ns(epoch2time(leapep[i]));
+        n=-(int)leapep[i][6];
+        tg=tu+(gtimens_t)n*NS_SEC; /* gpst at start of leap second */
+    
+        assert(gpst2utcns(tg)==tu);
+        assert(gpst2utcns(tg+1)==tu+1);
+        assert(gpst2utcns(tg-1)==tg-1-(gtimens_t)(n-1)*NS_SEC);
+        assert(utc2gpstns(tu)==tg);
+        assert(utc2gpstns(tu-1)==tu-1+(gtimens_t)(n-1)*NS_SEC);
+    
+        /* round-trip (except inserted second) and consistency with gtime_t
+           conversions */
+        for (ts=tg-3LL*NS_SEC;ts<tg+3LL*NS_SEC;ts+=NS_SEC/4) {
+            if (ts<tg-NS_SEC||ts>=tg) {
+                assert(utc2gpstns(gpst2utcns(ts))==ts);
+            }
+            t=gpst2utc(ns2time(ts));
+            assert(time2ns(t)==gpst2utcns(ts));
+            t=utc2gpst(ns2time(ts));
+            assert(time2ns(t)==utc2gpstns(ts));
+        }
+    }
+    /* before first leap second of table */
+    tg=time2ns(gpst2time(0,0.0));
+    assert(gpst2utcns(tg)==tg);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : binary debug trace
+*
+* the trace written by trace() and tracemat() is converted to text by
+* convtrace() and compared with the same output formatted by fprintf().
+*-----------------------------------------------------------------------------*/
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <wchar.h>
+#include <pthread.h>
+#include "../../src/rtklib.h"
+
+#define FILE_TRACE  "t_trace.trace"
+#define FILE_TEXT   "t_trace.txt"
+#define FILE_EXP    "t_trace.exp"
+
+static FILE *fp_exp=NULL; /* expected text */
+
+/* trace and output expected text */
+#define TR(level,...) do { \
+    trace(level,__VA_ARGS__); \
+    if (level<=3) {fprintf(fp_exp,"%d ",level); fprintf(fp_exp,__VA_ARGS__);} \
+} while (0)
+
+/* compare files */
+static int cmpfile(const char *file1, const char *file2)
+{
+    FILE *fp1,*fp2;
+    int c1,c2;
+    
+    if (!(fp1=fopen(file1,"rb"))) return 0;
+    if (!(fp2=fopen(file2,"rb"))) {fclose(fp1); return 0;}
+    do {
+        c1=fgetc(fp1); c2=fgetc(fp2);
+    } while (c1==c2&&c1!=EOF);
+    fclose(fp1); fclose(fp2);
+    return c1==c2;
+}
+/* trace of other thread */
+static void *trthread(void *arg)
+{
+    int i;
+    
+    for (i=0;i<3;i++) trace(3,"thread %d i=%d\n",*(int *)arg,i);
+    return NULL;
+}
+/* trace(), trace formats */
+void utest1(void)
+{
+    const char *str="abcdefghijklmnopqrstuvwxyz";
+    double a=-1.234567890123,b=6.02214076E23;
+    long l=-1234567890L;
+    long long ll=-1234567890123456LL;
+    size_t sz=(size_t)1<<40;
+    unsigned int u=4000000000u;
+    char lstr[2001];
+    int i;
+    
+    for (i=0;i<2000;i++) lstr[i]='a'+i%26;
+    lstr[2000]='\0';
+    
+    assert((fp_exp=fopen(FILE_EXP,"w")));
+    traceopen(FILE_TRACE);
+    tracelevel(3);
+    
+    TR(2,"no argument\n");
+    TR(3,"int=%d %5d %-5d| %+d %x %X %o %c\n",-1,42,42,7,255,255,8,'Z');
+    TR(3,"unsigned=%u long=%ld %lu llong=%lld %llx size=%zu\n",u,l,
+       (unsigned long)l,ll,ll,sz);
+    TR(3,"double=%f %.3f %12.6e %g %G %10.1f|\n",a,a,b,b,1E-20,a);
+    TR(3,"string=%s %.5s %-8s| %10s|\n",str,str,"ab","cd");
+    TR(3,"width=%*d %-*d| %.*f %*.*f\n",6,12,4,3,2,a,9,4,a);
+    TR(3,"percent=100%% %d%%\n",5);
+    
+    /* strings longer than 1024 bytes truncated with "..." */
+    trace(3,"long=%s|%d\n",lstr,1);
+    fprintf(fp_exp,"3 long=%.1024s...|%d\n",lstr,1);
+    TR(3,"long=%s|%.5s|\n",lstr+2000-1024,lstr);
+    
+    TR(4,"filtered %d\n",4);
+    TR(5,"filtered %s\n",str);
+    for (i=0;i<1000;i++) TR(3,"loop i=%4d x=%8.3f\n",i,i*0.5);
+    
+    /* formats stored as text */
+    TR(3,"unsupported %C spec %d\n",(wint_t)'A',3);
+    TR(3,"many %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n",
+       1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19);
+    
+    traceclose();
+    fclose(fp_exp);
+    
+    assert(convtrace(FILE_TRACE,FILE_TEXT)>0);
+    assert(cmpfile(FILE_TEXT,FILE_EXP));
+    remove(FILE_TRACE); remove(FILE_TEXT); remove(FILE_EXP);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* tracemat() */
+void utest2(void)
+{
+    double A[200*3];
+    int i;
+    
+    for (i=0;i<200*3;i++) A[i]=(i-300)*1.0123456789;
+    
+    assert((fp_exp=fopen(FILE_EXP,"w")));
+    traceopen(FILE_TRACE);
+    tracelevel(3);
+    
+    TR(3,"A=\n");
+    tracemat(3,A,200,3,13,4); matfprint(A,200,3,13,4,fp_exp);
+    tracemat(4,A,200,3,13,4);
+    tracemat(3,A,3,2,8,2); matfprint(A,3,2,8,2,fp_exp);
+    
+    traceclose();
+    fclose(fp_exp);
+    
+    assert(convtrace(FILE_TRACE,FILE_TEXT)>0);
+    assert(cmpfile(FILE_TEXT,FILE_EXP));
+    remove(FILE_TRACE); remove(FILE_TEXT); remove(FILE_EXP);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* trace of threads in order of calls */
+void utest3(void)
+{
+    pthread_t thread;
+    int i,id=1;
+    
+    assert((fp_exp=fopen(FILE_EXP,"w")));
+    traceopen(FILE_TRACE);
+    tracelevel(3);
+    
+    TR(3,"main %d\n",0);
+    assert(!pthread_create(&thread,NULL,trthread,&id));
+    pthread_join(thread,NULL);
+    for (i=0;i<3;i++) fprintf(fp_exp,"3 thread %d i=%d\n",id,i);
+    TR(3,"main %d\n",1);
+    
+    traceclose();
+    fclose(fp_exp);
+    
+    assert(convtrace(FILE_TRACE,FILE_TEXT)>0);
+    assert(cmpfile(FILE_TEXT,FILE_EXP));
+    remove(FILE_TRACE); remove(FILE_TEXT); remove(FILE_EXP);
+    printf("%s utest3 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    utest3();
+    return 0;
+}
@@ -0,0 +1,78 @@
+%% Convert the columnar export of gnss_preprocessor (export_folder) to a .mat file
+
+clc
+close all
+clear
+
+%% Dataset selection
+Dataset = 1;
+%1: Berlin - Gendarmenmarkt
+%2: Berlin - Potsdamer Platz
+%3: Frankfurt - Main Tower
+%4: Frankfurt - Westend Tower
+
+%% export folder of the rover measurements (<export_folder>/gnss_raw)
+if Dataset == 1
+    Folder = 'smartloc_Berlin_Gendarmenmarkt_export/gnss_raw';
+elseif Dataset == 2
+    Folder = 'smartloc_Berlin_Potsdamer_Platz_export/gnss_raw';
+elseif Dataset == 3
+    Folder = 'smartloc_Frankfurt_Main_Tower_export/gnss_raw';
+elseif Dataset == 4
+    Folder = 'smartloc_Frankfurt_Westend_Tower_export/gnss_raw';
+end
+
+%% read columns (numpy files with a header of 128 bytes)
+readColumn = @(name, type) readNpy(fullfile(Folder, [name '.npy']), type);
+
+EpochOffset = readColumn('epoch_offset', 'int64');
+GNSSTime = readColumn('GNSS_time', 'double');
+
+if Dataset == 1
+    Data.Info.DatasetName = 'Berlin_Gendarmenmarkt';
+elseif Dataset == 2
+    Data.Info.DatasetName = 'Berlin_Potsdamer_Platz';
+elseif Dataset == 3
+    Data.Info.DatasetName = 'Frankfurt_Main_Tower';
+elseif Dataset == 4
+    Data.Info.DatasetName = 'Frankfurt_Westend_Tower';
+end
+
+% epochs without measurements are skipped as in convertRosbags.m
+First = double(EpochOffset(1:end-1)) + 1;
+First = First(First <= double(EpochOffset(2:end)));
+
+Data.Info.TimeRef = GNSSTime(First(1)); % absolute time reference
+
+Data.GT_ClockError.Time = GNSSTime(First) - Data.Info.TimeRef;
+Data.GT_ClockError.Mean = zeros(length(First), 1);
+
+Data.Pseudorange3.Time = GNSSTime - Data.Info.TimeRef; % generate relative time
+Data.Pseudorange3.Mean = readColumn('pseudorange', 'double');
+Data.Pseudorange3.Cov = zeros(length(GNSSTime), 1);
+Data.Pseudorange3.SatPos = [readColumn('sat_pos_x', 'double') readColumn('sat_pos_y', 'double') readColumn('sat_pos_z', 'double')];
+Data.Pseudorange3.SatID = double(readColumn('prn_satellites_index', 'int64'));
+Data.Pseudorange3.SatElevation = readColumn('elevation', 'double');
+Data.Pseudorange3.SNR = readColumn('snr', 'double');
+Data.Pseudorange3.Bonus_MeanRaw = readColumn('raw_pseudorange', 'double');
+Data.Pseudorange3.Bonus_Ionosphere = readColumn('err_iono', 'double');
+Data.Pseudorange3.Bonus_Troposphere = readColumn('err_tropo', 'double');
+Data.Pseudorange3.Bonus_SatClockBias = readColumn('sat_clk_err', 'double') / 299792458; % bias in seconds instead of meters
+
+if Dataset == 1
+    save('Data_Berlin_Gendarmenmarkt_gnss_converter.mat', 'Data')
+elseif Dataset == 2
+    save('Data_Berlin_Potsdamer_Platz_gnss_converter.mat', 'Data')
+elseif Dataset == 3
+    save('Data_Frankfurt_Main_Tower_gnss_converter.mat', 'Data')
+elseif Dataset == 4
+    save('Data_Frankfurt_Westend_Tower_gnss_converter.mat', 'Data')
+end
+
+%% read a column of the export
+function Column = readNpy(File, Type)
+    Fid = fopen(File, 'r', 'ieee-le');
+    fseek(Fid, 128, 'bof');
+    Column = fread(Fid, Inf, ['*' Type]);
+    fclose(Fid);
+end
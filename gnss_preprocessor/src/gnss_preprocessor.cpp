@@ -10,15 +10,18 @@
  * Date: 2020/11/27
  *******************************************************/
 
+#include <atomic>
+
 #include "../RTKLIB/src/rtklib.h"
+#include "../RTKLIB/src/publish.h"
+#include "gnss_preprocessor.h"
 #include <ros/ros.h>
 
-extern void rtkposRegisterPub(ros::NodeHandle &n);
-extern void pntposRegisterPub(ros::NodeHandle &n);
-
-bool checkFile(const std::string &ParamName, char * FileNamePointer)
+bool checkFile(const std::string &ParamName, char * FileNamePointer, const char *rover = "")
 {
     FILE *file;
+    gtime_t t0 = {0};
+    char path[1024];
     std::string FileName;
     const bool ParamExists = ros::param::has(ParamName);
     if (!ParamExists)
@@ -29,7 +32,10 @@ bool checkFile(const std::string &ParamName, char * FileNamePointer)
     else
     {
         ros::param::get(ParamName, FileName);
-        if (file = fopen(FileName.c_str(), "r")) 
+        
+        /* file of the (first) rover for the rover keyword %r */
+        reppath(FileName.c_str(), path, t0, rover, "");
+        if (file = fopen(strstr(FileName.c_str(), "%r") ? path : FileName.c_str(), "r")) 
         {
             fclose(file);
         } 
@@ -49,21 +55,25 @@ bool checkFile(const std::string &ParamName, char * FileNamePointer)
     return true;
 }
 
-int main(int argc, char **argv)
-{
+/* abort request of the processing (nodelet unloaded) */
+static std::atomic<bool> abort_request(false);
 
-    ros::init(argc, argv, "gnss_preprocessor_node");
-    ros::NodeHandle nh("~");
+int gnssPreprocessor(ros::NodeHandle &nh, bool &spin)
+{
+    spin = false;
+    abort_request = false;
     ROS_INFO("\033[1;32m----> gnss_preprocessor Started.\033[0m");
     
     /* input node handle */
-    rtkposRegisterPub(nh);
-    pntposRegisterPub(nh);
+    publishRegisterPub(nh);
 
     /* get setup parameters from yaml config */
-    int mode, nf, soltype, elevationmask;
+    std::string rovers, export_folder, shm_ring, epoch_store_file, warm_start_file;
+    int mode, nf, soltype, elevationmask, pubpolicy, solution_status, trace_level, threads, shard_index, shard_count, shm_ring_slots, epoch_cache, partial_ar_threads, partial_ar_budget, base_count, base_selection;
+    double time_unit, time_unit_warmup, checkpoint_interval;
     std::vector<std::string> satellites;
-    bool shared_ephemeris, precise_ephemeris, ionex_correction, custom_atx;
+    std::vector<double> base_positions;
+    bool shared_ephemeris, precise_ephemeris, ionex_correction, custom_atx, bias_correction, measurement_only, binary_output, shared_products, epoch_server, resume, partial_ar, ppp_ar;
     nh.getParam("/satellites", satellites);
     nh.param("/shared_ephemeris", shared_ephemeris, false);
     nh.param("/precise_ephemeris", precise_ephemeris, false);
@@ -71,14 +81,43 @@ int main(int argc, char **argv)
     nh.param("/nf",     nf, 2);
     nh.param("/soltype",soltype, 2);
     nh.param("/elevationmask",elevationmask, 0);
+    nh.param("/partial_ar",partial_ar, false);
+    nh.param("/partial_ar_threads",partial_ar_threads, 1);
+    nh.param("/partial_ar_budget",partial_ar_budget, 0);
+    nh.param("/base_count",base_count, 1);
+    nh.param("/base_selection",base_selection, 0);
+    nh.getParam("/base_positions", base_positions);
     nh.param("/ionex_correction",ionex_correction, true);
     nh.param("/custom_atx",custom_atx, false);
+    nh.param("/bias_correction",bias_correction, false);
+    nh.param("/ppp_ar",ppp_ar, false);
+    nh.param("/publish_policy",pubpolicy, PUBP_FORWARD);
+    nh.param("/measurement_only",measurement_only, false);
+    nh.param("/binary_output",binary_output, false);
+    nh.param("/solution_status",solution_status, 0);
+    nh.param("/trace_level",trace_level, 0);
+    nh.param("/time_unit",time_unit, 0.0);
+    nh.param("/time_unit_warmup",time_unit_warmup, 0.0);
+    nh.param("/threads",threads, 1);
+    nh.param("/shard_index",shard_index, 0);
+    nh.param("/shard_count",shard_count, 1);
+    nh.param("/rovers",rovers, std::string("rover"));
+    nh.param("/shared_products",shared_products, false);
+    nh.param("/export_folder",export_folder, std::string(""));
+    nh.param("/shm_ring",shm_ring, std::string(""));
+    nh.param("/shm_ring_slots",shm_ring_slots, 256);
+    nh.param("/epoch_server",epoch_server, false);
+    nh.param("/epoch_store_file",epoch_store_file, std::string(""));
+    nh.param("/epoch_cache",epoch_cache, 1000);
+    nh.param("/checkpoint_interval",checkpoint_interval, 0.0);
+    nh.param("/resume",resume, false);
+    nh.param("/warm_start_file",warm_start_file, std::string(""));
     
     /* load option structs*/
     prcopt_t prcopt = prcopt_default;   // processing option
     solopt_t solopt = solopt_default;   // output solution option
     filopt_t filopt = {""};             // file option
-    char *infile[10];                   // input files
+    char *infile[20];                   // input files
     
     /* set processing options*/
     prcopt.mode = mode;                 // Positioning mode
@@ -92,6 +131,24 @@ int main(int argc, char **argv)
     prcopt.ionoopt = IONOOPT_BRDC;      // default ionosphere correction
     prcopt.sateph = EPHOPT_BRDC;        // default ephemeris
     prcopt.modear = 3;                  // AR mode (0:off,1:continuous,2:instantaneous,3:fix and hold)
+    prcopt.arpart = partial_ar;         // partial AR by subsets of ambiguities (0:off,1:on)
+    prcopt.arthread = partial_ar_threads; // number of threads of partial AR (0,1:serial)
+    prcopt.artime = partial_ar_budget;  // time budget of partial AR per epoch (ms) (0:no limit)
+    prcopt.arppp = ppp_ar;              // PPP AR (0:off,1:wide-lane/narrow-lane)
+    prcopt.nbase = base_count;          // number of base stations of multi-base rtk (0,1:single)
+    prcopt.basesel = base_selection;    // solution of multi-base rtk (0:best,1:blended)
+    prcopt.measonly = measurement_only; // measurement-only preprocessing (0:off,1:on)
+    prcopt.nthread = threads;           // number of threads for units/rovers (0,1:serial)
+    prcopt.tuwarm = time_unit_warmup;   // warm-up overlap of processing units (s)
+    prcopt.nshard = shard_count;        // number of processing shards (0,1:off)
+    prcopt.ishard = shard_index;        // index of processing shard (0:first)
+    prcopt.shmprod = shared_products;   // shared memory product store (0:off,1:on)
+    prcopt.ckptint = checkpoint_interval; // checkpoint interval of filter (s) (0:off)
+    prcopt.resume = resume;             // resume from checkpoint (0:off,1:on)
+    strcpy(filopt.warmst, warm_start_file.c_str()); // checkpoint file for warm start
+    
+    /* pass of the combined solution publishing the measurements */
+    pubsetpolicy(pubpolicy);
     
     /* SNR mask is only for robust position estimation */
     prcopt.snrmask.ena[0] = 1;
@@ -109,19 +166,28 @@ int main(int argc, char **argv)
     prcopt.rb[0] = -2414266.9197;           // base position for relative mode {x,y,z} (ecef) (m)
     prcopt.rb[1] = 5386768.9868;            // base position for relative mode {x,y,z} (ecef) (m)
     prcopt.rb[2] = 2407460.0314;            // base position for relative mode {x,y,z} (ecef) (m)
+    
+    /* positions of the additional base stations {x,y,z,x,y,z,...} (rinex header if not set) */
+    for (int i = 0; i + 2 < (int)base_positions.size() && i / 3 < MAXBASE - 1; i += 3)
+    {
+        for (int j = 0; j < 3; j++) prcopt.rbs[i / 3][j] = base_positions[i + j];
+    }
 
     /* read paths for datasets specified in the launchfile */
     int n = 0;    
     
     /* set input files */
-    char infile_[10][1024]={""};
-    for (int i = 0; i < 10; i++) 
+    char infile_[20][1024]={""};
+    for (int i = 0; i < 20; i++) 
     {
             infile[i]=infile_[i];
     }
     
     /* observations of the rover */
-    if(!checkFile("roverMeasureFile", infile[n++]))
+    char rov[1024], rov1[64] = "";
+    sprintf(rov, "%.1023s", rovers.c_str());
+    sscanf(rov, "%63s", rov1);
+    if(!checkFile("roverMeasureFile", infile[n++], rov1))
     {
         return 0;  
     }
@@ -134,6 +200,15 @@ int main(int argc, char **argv)
         {
              return 0;   
         }   
+        
+        /* additional base stations baseMeasureFile2, baseMeasureFile3, ... */
+        for (int i = 2; i <= base_count && i <= MAXBASE; i++)
+        {
+            if(!checkFile("baseMeasureFile" + std::to_string(i), infile[n++]))
+            {
+                 return 0;   
+            }
+        }
     }
     
     /* read shared ephemeris file */
@@ -256,6 +331,27 @@ int main(int argc, char **argv)
         strcpy(filopt.rcvantp, buffer);
     }
     
+    /* satellite code and phase biases (SINEX-BIAS or DCB) */
+    if (bias_correction)
+    {
+        char buffer[1024];
+        if(!checkFile("biasFile", &buffer[0]))
+        {
+             return 0;   
+        }
+        strcpy(filopt.dcb, buffer);
+    }
+    
+    /* iono-free LC for wide-lane/narrow-lane ambiguity resolution in PPP */
+    if (ppp_ar && mode >= PMODE_PPP_KINEMA && nf >= 2)
+    {
+        if (prcopt.ionoopt != IONOOPT_BRDC)
+        {
+            ROS_INFO("\033[33m----> ppp_ar: ionosphere correction replaced by iono-free LC\033[0m");
+        }
+        prcopt.ionoopt = IONOOPT_IFLC;
+    }
+    
     /* set output file */
     char outfile[1024];
     std::string out_folder;
@@ -271,7 +367,7 @@ int main(int argc, char **argv)
 
     /* processing time setting */
     double ti=0.0;                      // processing interval  (s) (0:all)
-    double tu=0.0;                      // unit time (s) (0:all)
+    double tu=time_unit;                // unit time (s) (0:all)
     gtime_t ts={0},te={0};
     ts.time=0;                          // start time (0:all)
     te.time=0;                          // end time (0:all)
@@ -281,17 +377,53 @@ int main(int argc, char **argv)
     solopt.timeu = 3;                   // time digits under decimal point
     solopt.sep[0] = ',';                // field separator
     solopt.sstat= 0;                    // solution statistics level (0:off,1:states,2:residuals)
-    solopt.trace = 0;                   // debug trace level (0:off,1-5:debug)
-    solopt.sstat = 0;                   // get the solution file
-    solopt.posf = SOLF_LLH;
+    solopt.trace = trace_level;         // debug trace level (0:off,1-5:debug)
+    solopt.sstat = solution_status;     // get the solution file
+    solopt.posf = binary_output ? SOLF_BIN : SOLF_LLH;
     solopt.height = 0;
     
-    // rover and base id
-    char rov[] = "rover";
+    // base id (rover ids from the parameter rovers)
     const char base[] = "base";
 
+    /* shard mode: write the measurements to a bag next to the partial solution */
+    if (shard_count > 1)
+    {
+        std::string bagfile = std::string(outfile) + ".bag";
+        if (!pubopenbag(bagfile.c_str()))
+        {
+            return 0;
+        }
+    }
+
+    /* columnar export of the published measurements */
+    if (!export_folder.empty() && !pubopenexport(export_folder.c_str()))
+    {
+        pubclosebag();
+        return 0;
+    }
+
+    /* shared memory ring of the epochs for non-ROS consumers */
+    if (!shm_ring.empty() && !pubopenring(shm_ring.c_str(), shm_ring_slots))
+    {
+        pubclosebag();
+        pubcloseexport();
+        return 0;
+    }
+
+    /* epoch server, serving the past epochs while and after processing */
+    if (epoch_server && !pubopenstore(nh, epoch_store_file.c_str(), epoch_cache))
+    {
+        pubclosebag();
+        pubcloseexport();
+        pubclosering();
+        return 0;
+    }
+
     /* decode the RINEX file positioning */
     stat=postpos(ts,te,ti,tu,&prcopt,&solopt,&filopt,infile,n,outfile,&rov[0],&base[0]);
+    pubclosebag();
+    pubcloseexport();
+    pubclosering();
 
     printf("\n");
     if(stat==0){
@@ -304,10 +436,21 @@ int main(int argc, char **argv)
             ROS_INFO("\033[1;32m----> gnss_preprocessor Aborted!!!.\033[0m");
     }
 
-    ros::spin();
+    /* shards are merged offline, nothing left to publish */
+    if (shard_count > 1)
+    {
+        return stat;
+    }
+
+    spin = true;
     return 0;
 }
 
+void gnssPreprocessorAbort()
+{
+    abort_request = true;
+}
+
 /*****dummy application functions for shared library*****/
 extern int showmsg(const char *format,...) {
     va_list arg;
@@ -318,7 +461,7 @@ extern int showmsg(const char *format,...) {
         va_end(arg);
         printf("%s\n",buff);
     }
-    return 0;
+    return abort_request ? 1 : 0;
 }
 extern void settspan(gtime_t ts, gtime_t te) {}
 extern void settime(gtime_t time) {}
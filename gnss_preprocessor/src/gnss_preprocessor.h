@@ -0,0 +1,22 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: processing of gnss_preprocessor, shared by the node and the nodelet
+ *******************************************************/
+
+#ifndef GNSS_PREPROCESSOR_H
+#define GNSS_PREPROCESSOR_H
+
+#include <ros/ros.h>
+
+/* read the parameters, process the dataset and publish the measurements with
+   the publishers advertised on nh. spin is set if the products were published
+   and the publishers have to be kept alive. returns the exit status. */
+int gnssPreprocessor(ros::NodeHandle &nh, bool &spin);
+
+/* abort a running gnssPreprocessor() */
+void gnssPreprocessorAbort();
+
+#endif
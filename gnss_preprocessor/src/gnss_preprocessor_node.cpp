@@ -0,0 +1,30 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: gnss_preprocessor as node
+ *******************************************************/
+
+#include "../RTKLIB/src/publish.h"
+#include "gnss_preprocessor.h"
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "gnss_preprocessor_node");
+    ros::NodeHandle nh("~");
+    
+    /* services (epoch server) are served while processing */
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    
+    bool spin;
+    const int stat = gnssPreprocessor(nh, spin);
+    if (spin)
+    {
+        ros::waitForShutdown();
+    }
+    spinner.stop();
+    pubclosestore();
+    return spin ? 0 : stat;
+}
@@ -0,0 +1,52 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: gnss_preprocessor as nodelet. Consumers loaded into the same
+ *           nodelet manager receive the published measurements as
+ *           boost::shared_ptr<const> without serialization and copy.
+ *******************************************************/
+
+#include <thread>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "../RTKLIB/src/publish.h"
+#include "gnss_preprocessor.h"
+
+namespace gnss_preprocessor
+{
+
+class GnssPreprocessorNodelet : public nodelet::Nodelet
+{
+public:
+    ~GnssPreprocessorNodelet()
+    {
+        if (worker_.joinable())
+        {
+            gnssPreprocessorAbort();
+            worker_.join();
+        }
+        pubclosestore();
+    }
+
+private:
+    void onInit() override
+    {
+        /* process the dataset in a worker thread, the callbacks of the nodelet
+           manager are not blocked */
+        worker_ = std::thread([this]()
+        {
+            bool spin;
+            gnssPreprocessor(getPrivateNodeHandle(), spin);
+        });
+    }
+
+    std::thread worker_;
+};
+
+} // namespace gnss_preprocessor
+
+PLUGINLIB_EXPORT_CLASS(gnss_preprocessor::GnssPreprocessorNodelet, nodelet::Nodelet)
@@ -0,0 +1,112 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: print the epochs of the shared memory ring of gnss_preprocessor_node
+ *           (parameter shm_ring), example of a reader without ROS
+ *******************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../RTKLIB/src/shmring.h"
+
+static const char *help[]={
+"",
+" usage: gnss_ringcat [option]... name",
+"",
+" Print the epochs written to the shared memory ring name by the preprocessor,",
+" one line per epoch, until the ring is closed. Lost epochs (overrun) are",
+" reported on stderr.",
+"",
+" -s        print the satellites of the measurements",
+" -a        start at the oldest epoch in the ring [newest epoch]",
+" -r rover  print only the epochs of rover (id of parameter rovers) [all]",
+};
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* sleep ms ------------------------------------------------------------------*/
+static void sleepms(int ms)
+{
+    struct timespec ts={0,ms*1000000L};
+    nanosleep(&ts,NULL);
+}
+/* print epoch ---------------------------------------------------------------*/
+static void printepoch(const shmr_epoch_t *ep, uint64_t n, int sats)
+{
+    uint32_t i;
+    
+    printf("%llu %.3f flag=0x%02x nraw=%u nbase=%u",(unsigned long long)n,
+           ep->time,ep->flag,ep->nraw,ep->nbase);
+    if (ep->flag&SHMR_FIX) {
+        printf(" fix=%.9f,%.9f,%.3f",ep->fix.latitude,ep->fix.longitude,
+               ep->fix.altitude);
+    }
+    if (ep->flag&SHMR_SMOOTH) {
+        printf(" smoothed=%.9f,%.9f,%.3f",ep->smoothed.latitude,
+               ep->smoothed.longitude,ep->smoothed.altitude);
+    }
+    printf("\n");
+    for (i=0;sats&&i<ep->nraw;i++) {
+        printf("  raw  %3d %-7.7s %14.3f %5.1f\n",ep->raw[i].prn_satellites_index,
+               ep->raw[i].sat_system,ep->raw[i].pseudorange,ep->raw[i].elevation);
+    }
+    for (i=0;sats&&i<ep->nbase;i++) {
+        printf("  base %3d %-7.7s %14.3f %5.1f\n",ep->base[i].prn_satellites_index,
+               ep->base[i].sat_system,ep->base[i].pseudorange,ep->base[i].elevation);
+    }
+}
+/* gnss_ringcat main ---------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    static shmr_epoch_t ep;
+    shmr_t ring;
+    uint64_t n,head,lost=0;
+    const char *name="",*rov=NULL;
+    int i,sats=0,all=0,stat;
+    
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-s")) sats=1;
+        else if (!strcmp(argv[i],"-a")) all=1;
+        else if (!strcmp(argv[i],"-r")&&i+1<argc) rov=argv[++i];
+        else if (*argv[i]=='-') printhelp();
+        else name=argv[i];
+    }
+    if (!*name) printhelp();
+    
+    if (!shmrattach(&ring,name)) {
+        fprintf(stderr,"gnss_ringcat: no ring %s\n",name);
+        return -1;
+    }
+    head=shmrhead(&ring);
+    n=all&&head>ring.hdr->nslot?head-ring.hdr->nslot+1:(all?0:head);
+    
+    for (;;) {
+        if (n>=shmrhead(&ring)) {
+            if (shmrclosed(&ring)&&n>=shmrhead(&ring)) break;
+            sleepms(1);
+            continue;
+        }
+        if ((stat=shmrcopy(&ring,n,&ep))>0) {
+            if (!rov||ep.rover==shmrrovid(rov)) printepoch(&ep,n,sats);
+            n++;
+            continue;
+        }
+        /* overrun: continue with the oldest epoch in the ring */
+        head=shmrhead(&ring);
+        lost+=head-ring.hdr->nslot+1-n;
+        fprintf(stderr,"gnss_ringcat: overrun, %llu epochs lost\n",
+                (unsigned long long)(head-ring.hdr->nslot+1-n));
+        n=head-ring.hdr->nslot+1;
+    }
+    shmrdetach(&ring);
+    return lost?1:0;
+}
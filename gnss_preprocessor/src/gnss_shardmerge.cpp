@@ -0,0 +1,178 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: merge the partial outputs of the shards of gnss_preprocessor_node
+ *           (shard_count>1) into one solution, solution status and bag file
+ *******************************************************/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include "../RTKLIB/src/rtklib.h"
+
+static const char *help[]={
+"",
+" usage: gnss_shardmerge [option]... -o file manifest...",
+"",
+" Merge the partial outputs of all shards of a dataset, given by their",
+" manifests (<outfile>.shard), to file, file.stat and file.bag. Epochs in the",
+" warm-up overlap of the shards are taken from the preceding shard.",
+"",
+" -o file   output solution file",
+" -b        output solutions in binary format [format of shards]",
+};
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* path of partial output relative to manifest -------------------------------*/
+static std::string shardpath(const char *manifest, const char *file)
+{
+    const char *p=strrchr(manifest,FILEPATHSEP);
+
+    if (*file==FILEPATHSEP||!p) return file;
+    return std::string(manifest,p+1-manifest)+file;
+}
+/* compare index of shards ---------------------------------------------------*/
+static bool cmpshard(const shard_t &a, const shard_t &b)
+{
+    return a.index<b.index;
+}
+/* bag time of shard time ----------------------------------------------------*/
+static ros::Time bagtime(gtime_t time, double off)
+{
+    return ros::Time().fromNSec(gpst2utcns(NSADD(time2ns(time),off)));
+}
+/* merge partial solution or solution status files -----------------------------
+* solutions of text output format are merged in binary format and converted
+*-----------------------------------------------------------------------------*/
+static int mergesol(const std::vector<shard_t> &shard,
+                    const std::vector<std::string> &file, const char *outfile,
+                    const solopt_t *opt)
+{
+    std::vector<char *> infile;
+    std::vector<gtime_t> ts,te;
+    std::string tfile=std::string(outfile)+".tmp";
+    size_t i;
+    int stat;
+
+    for (i=0;i<shard.size();i++) {
+        infile.push_back((char *)file[i].c_str());
+        ts.push_back(shard[i].ts);
+        te.push_back(shard[i].te);
+    }
+    if (opt->posf==SOLF_BIN) {
+        return mergesolbin(&infile[0],&ts[0],&te[0],(int)infile.size(),outfile)>=0;
+    }
+    stat=mergesolbin(&infile[0],&ts[0],&te[0],(int)infile.size(),tfile.c_str())>=0&&
+         convsolbin(tfile.c_str(),outfile,opt);
+    remove(tfile.c_str());
+    return stat;
+}
+/* merge measurement bags ----------------------------------------------------*/
+static int mergebag(const std::vector<shard_t> &shard,
+                    const std::vector<std::string> &file, const char *outfile)
+{
+    rosbag::Bag out;
+    ros::Time ts,te;
+    size_t i;
+
+    try {
+        out.open(outfile,rosbag::bagmode::Write);
+
+        for (i=0;i<shard.size();i++) {
+            rosbag::Bag bag;
+            bag.open(file[i],rosbag::bagmode::Read);
+
+            /* messages in span of shard, overlap from preceding shard */
+            ts=bagtime(shard[i].ts,-DTTOL);
+            te=bagtime(shard[i].te,-1E-9);
+            if (i>0&&ts<bagtime(shard[i-1].te,0.0)) {
+                ts=bagtime(shard[i-1].te,0.0);
+            }
+            rosbag::View view(bag,ts,te);
+            for (const rosbag::MessageInstance &m : view) {
+                out.write(m.getTopic(),m.getTime(),m,m.getConnectionHeader());
+            }
+            bag.close();
+        }
+        out.close();
+    }
+    catch (const rosbag::BagException &e) {
+        fprintf(stderr,"gnss_shardmerge: %s\n",e.what());
+        return 0;
+    }
+    return 1;
+}
+/* gnss_shardmerge main ------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    std::vector<shard_t> shard;
+    std::vector<std::string> solfile,statfile,bagfile;
+    prcopt_t popt;
+    solopt_t sopt=solopt_default,sopt_;
+    shard_t s;
+    const char *outfile="";
+    int i,binary=0,nstat=0,nbag=0;
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-o")&&i+1<argc) outfile=argv[++i];
+        else if (!strcmp(argv[i],"-b")) binary=1;
+        else if (*argv[i]=='-') printhelp();
+        else {
+            if (!loadshard(argv[i],&s,&popt,&sopt_)) {
+                fprintf(stderr,"gnss_shardmerge: invalid shard manifest %s\n",argv[i]);
+                return -1;
+            }
+            if (shard.empty()) sopt=sopt_;
+
+            /* partial outputs relative to manifest */
+            strcpy(s.solfile,shardpath(argv[i],s.solfile).c_str());
+            if (*s.statfile) strcpy(s.statfile,shardpath(argv[i],s.statfile).c_str());
+            if (*s.bagfile ) strcpy(s.bagfile ,shardpath(argv[i],s.bagfile ).c_str());
+            shard.push_back(s);
+        }
+    }
+    if (!*outfile||shard.empty()) printhelp();
+
+    /* all shards of the dataset in time order */
+    std::stable_sort(shard.begin(),shard.end(),cmpshard);
+    for (i=0;i<(int)shard.size();i++) {
+        if (shard[i].count!=(int)shard.size()||shard[i].index!=i) {
+            fprintf(stderr,"gnss_shardmerge: shard %d/%d missing or duplicated\n",
+                    i,shard[0].count);
+            return -1;
+        }
+        solfile.push_back(shard[i].solfile);
+        statfile.push_back(shard[i].statfile);
+        bagfile.push_back(shard[i].bagfile);
+        if (*shard[i].statfile) nstat++;
+        if (*shard[i].bagfile ) nbag++;
+    }
+    if (binary) sopt.posf=SOLF_BIN;
+
+    if (!mergesol(shard,solfile,outfile,&sopt)) {
+        fprintf(stderr,"gnss_shardmerge: merging solutions failed\n");
+        return -1;
+    }
+    if (nstat==(int)shard.size()&&
+        !mergesol(shard,statfile,(std::string(outfile)+".stat").c_str(),&sopt)) {
+        fprintf(stderr,"gnss_shardmerge: merging solution status failed\n");
+        return -1;
+    }
+    if (nbag==(int)shard.size()&&
+        !mergebag(shard,bagfile,(std::string(outfile)+".bag").c_str())) {
+        fprintf(stderr,"gnss_shardmerge: merging measurement bags failed\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: convert binary solution and solution status files written with
+ *           solution format SOLF_BIN to the RTKLIB text formats
+ *******************************************************/
+
+#include "../RTKLIB/src/rtklib.h"
+
+static const char *help[]={
+"",
+" usage: gnss_solconv [option]... file",
+"",
+" Convert a binary solution (.pos) or solution status (.pos.stat) file to text",
+"",
+" -o file   output file [stdout]",
+" -p        output x/y/z-ecef [lat/lon/height]",
+" -e        output e/n/u-baseline [lat/lon/height]",
+" -n        output NMEA-183 GGA/RMC [lat/lon/height]",
+" -g        output latitude/longitude in the form of ddd mm ss.ss' [deg]",
+" -t        output time in the form of yyyy/mm/dd hh:mm:ss.ss [sssss.ss]",
+" -u        output time in utc [gpst]",
+" -d col    number of decimals in time [3]",
+" -s sep    field separator [',']",
+};
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* gnss_solconv main ---------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    solopt_t solopt=solopt_default;
+    const char *infile="",*outfile="";
+    int i;
+
+    solopt.outopt=1;
+    solopt.timef=0;
+    solopt.timeu=3;
+    solopt.sep[0]=',';
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-o")&&i+1<argc) outfile=argv[++i];
+        else if (!strcmp(argv[i],"-p")) solopt.posf=SOLF_XYZ;
+        else if (!strcmp(argv[i],"-e")) solopt.posf=SOLF_ENU;
+        else if (!strcmp(argv[i],"-n")) solopt.posf=SOLF_NMEA;
+        else if (!strcmp(argv[i],"-g")) solopt.degf=1;
+        else if (!strcmp(argv[i],"-t")) solopt.timef=1;
+        else if (!strcmp(argv[i],"-u")) solopt.times=TIMES_UTC;
+        else if (!strcmp(argv[i],"-d")&&i+1<argc) solopt.timeu=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-s")&&i+1<argc) strcpy(solopt.sep,argv[++i]);
+        else if (*argv[i]=='-') printhelp();
+        else infile=argv[i];
+    }
+    if (!*infile) printhelp();
+
+    if (!convsolbin(infile,outfile,&solopt)) {
+        fprintf(stderr,"gnss_solconv: no binary solution file %s\n",infile);
+        return -1;
+    }
+    return 0;
+}
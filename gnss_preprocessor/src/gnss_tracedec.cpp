@@ -0,0 +1,45 @@
+/*******************************************************
+ * This file is part of GraphGNSSLib.
+ * Licensed under the GNU General Public License v3.0;
+ * you may not use this file except in compliance with the License.
+ *
+ * Function: convert binary debug trace files written by traceopen() to the
+ *           RTKLIB text trace
+ *******************************************************/
+
+#include "../RTKLIB/src/rtklib.h"
+
+static const char *help[]={
+"",
+" usage: gnss_tracedec [option]... file",
+"",
+" Convert a binary debug trace (.trace) file to the RTKLIB text trace",
+"",
+" -o file   output file [stdout]",
+};
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* gnss_tracedec main --------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    const char *infile="",*outfile="";
+    int i;
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-o")&&i+1<argc) outfile=argv[++i];
+        else if (*argv[i]=='-') printhelp();
+        else infile=argv[i];
+    }
+    if (!*infile) printhelp();
+
+    if (convtrace(infile,outfile)<0) {
+        fprintf(stderr,"gnss_tracedec: no binary trace file %s\n",infile);
+        return -1;
+    }
+    return 0;
+}